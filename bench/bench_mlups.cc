@@ -0,0 +1,417 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Throughput benchmark in million lattice updates per second (MLUPS).
+//
+// Suites:
+//   size    periodic domains from in-cache to far beyond the last level cache
+//   mix     node type mixes: all fluid, a walled channel, a porous medium
+//   model   equilibria, forces, source terms and gray lattice solids
+//   strong  a fixed domain swept by 1, 2, 4, ... threads
+//   weak    a fixed number of columns per thread
+//
+// Every suite times IncompFlowSimulation::simulate. The scaling suites run
+// the solver's own sweep pool, set_sweep_config(SweepConfig(0, 0, t)), which
+// splits the columns of the lattice evenly between t threads.
+//
+// Bandwidth is estimated from the minimum traffic of a step: the particle
+// distributions are read and written once by streaming and once by the
+// collision, plus density, velocity, collision frequency and a node
+// descriptor pointer per node.
+//
+// With --trace, the solver records a strong scaling run on every thread as a
+// Chrome trace-event timeline: streaming, collision and barrier waits per
+// thread and tile.
+//
+// usage: bench_mlups [--quick] [--json FILE] [--suites a,b,...]
+//                    [--max-nodes N] [--threads N] [--reps N] [--trace FILE]
+
+#include "balbm.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+static double F[] = {1e-6, 0.0};
+
+//! Bytes moved per lattice update, see above
+const static double bytes_per_update =
+    4 * Lattice::num_k() * sizeof(double) + 4 * sizeof(double) +
+    sizeof(AbstractNodeDesc *);
+
+//! Approximate memory footprint per node
+const static double bytes_per_node =
+    2 * Lattice::num_k() * sizeof(double) + 4 * sizeof(double) +
+    sizeof(AbstractNodeDesc *);
+
+//! Benchmark options
+struct Options {
+  bool quick = false;
+  string json = "bench_mlups.json";
+  vector<string> suites = {"size", "mix", "model", "strong", "weak"};
+  size_t max_nodes = size_t(1) << 22;
+  unsigned max_threads = max(1u, thread::hardware_concurrency());
+  unsigned reps = 3;
+  string trace;
+};
+
+//! One measurement
+struct Result {
+  string suite;
+  string name;
+  unsigned ni;
+  unsigned nj;
+  unsigned threads;
+  unsigned steps;
+  double best_seconds;
+  double mean_seconds;
+};
+
+//! Collision model of a benchmark case
+enum class Model { BGK, Guo, SukopThorne, HeLuo, Axisymmetric, Gray };
+
+const char *model_name(const Model model) {
+  switch (model) {
+  case Model::BGK:
+    return "bgk";
+  case Model::Guo:
+    return "bgk_guo";
+  case Model::SukopThorne:
+    return "bgk_sukop_thorne";
+  case Model::HeLuo:
+    return "he_luo_guo";
+  case Model::Axisymmetric:
+    return "bgk_guo_axisymmetric";
+  case Model::Gray:
+    return "bgk_guo_gray";
+  }
+  return "";
+}
+
+//! Equilibrium of a model
+AbstractIncompFlowEqFunct *make_feq(const Model model) {
+  if (model == Model::HeLuo)
+    return new IncompFlowHLEqFunct(rho);
+  return new IncompFlowEqFunct();
+}
+
+//! Force of a model, if any
+AbstractForce *make_force(const Model model) {
+  if (model == Model::BGK)
+    return nullptr;
+  if (model == Model::SukopThorne)
+    return new SukopThorneForce(F);
+  return new GuoForce(F);
+}
+
+//! Source term of a model, if any
+AbstractSourceTerm *make_source(const Model model) {
+  if (model == Model::Axisymmetric)
+    return new AxisymmetricSourceTerm();
+  return nullptr;
+}
+
+//! Node type mixes
+enum class Mix { Fluid, Channel, Porous };
+
+const char *mix_name(const Mix mix) {
+  switch (mix) {
+  case Mix::Fluid:
+    return "periodic_fluid";
+  case Mix::Channel:
+    return "walled_channel";
+  case Mix::Porous:
+    return "porous_30pct";
+  }
+  return "";
+}
+
+//! Geometry of a node type mix
+Geometry make_geometry(const Mix mix, const unsigned ni, const unsigned nj) {
+  GeometryMask mask(ni, nj);
+  if (mix == Mix::Porous) {
+    // random solid blocks of 2 x 2 nodes, channel walls at the bottom and top
+    mt19937 gen(12345);
+    bernoulli_distribution solid(0.3);
+    for (unsigned i = 0; i < ni; i += 2)
+      for (unsigned j = 2; j + 3 < nj; j += 2)
+        if (solid(gen))
+          for (unsigned di = 0; di < 2 && i + di < ni; ++di)
+            for (unsigned dj = 0; dj < 2; ++dj)
+              mask.set_solid(i + di, j + dj);
+  }
+  return Geometry(mask, true, mix == Mix::Fluid);
+}
+
+//! Number of steps so that a repetition does a fixed amount of work
+unsigned steps_for(const Options &opts, const size_t nodes) {
+  const double updates = opts.quick ? 2e6 : 5e7;
+  return max(2u, static_cast<unsigned>(updates / nodes));
+}
+
+//! Time repetitions of a step function, after one warm up step
+template <typename StepFunct>
+Result measure(const Options &opts, const string &suite, const string &name,
+               const unsigned ni, const unsigned nj, const unsigned threads,
+               StepFunct &&simulate) {
+  Result result{suite, name, ni, nj, threads, steps_for(opts, size_t(ni) * nj),
+                0.0, 0.0};
+  simulate(1);
+  double total = 0.0;
+  result.best_seconds = 1e300;
+  for (unsigned rep = 0; rep < opts.reps; ++rep) {
+    const auto start = chrono::steady_clock::now();
+    simulate(result.steps);
+    const chrono::duration<double> elapsed =
+        chrono::steady_clock::now() - start;
+    result.best_seconds = min(result.best_seconds, elapsed.count());
+    total += elapsed.count();
+  }
+  result.mean_seconds = total / opts.reps;
+  return result;
+}
+
+//! Million lattice updates per second
+double mlups(const Result &r, const double seconds) {
+  return double(r.ni) * r.nj * r.steps / seconds / 1e6;
+}
+
+//! Simulation of a geometry with a model, swept by a number of threads
+unique_ptr<IncompFlowSimulation> make_simulation(const Geometry &geom,
+                                                 const Model model,
+                                                 const unsigned nthreads) {
+  const unsigned ni = geom.num_i(), nj = geom.num_j();
+  unique_ptr<IncompFlowSimulation> spsim(new IncompFlowSimulation(
+      ni, nj, rho, mu, make_feq(model), new NewtonianConstitutiveEq(mu),
+      make_force(model), nullptr, make_source(model)));
+  spsim->set_geometry(geom);
+  spsim->set_sweep_config(SweepConfig(0, 0, nthreads));
+  if (model == Model::Gray)
+    for (unsigned i = 0; i < ni; ++i)
+      for (unsigned j = 0; j < nj; ++j)
+        spsim->set_solid_fraction(i, j, ((i + j) % 7 == 0) ? 0.25 : 0.0);
+  return spsim;
+}
+
+//! Time a simulation swept by a number of threads
+Result measure_simulation(const Options &opts, const string &suite,
+                          const string &name, const Geometry &geom,
+                          const Model model, const unsigned nthreads = 1) {
+  const auto spsim = make_simulation(geom, model, nthreads);
+  return measure(opts, suite, name, geom.num_i(), geom.num_j(), nthreads,
+                 [&](const unsigned n) { spsim->simulate(n); });
+}
+
+//! Print a result as a row of the table
+void print_row(const Result &r) {
+  const double best = mlups(r, r.best_seconds);
+  cout << left << setw(7) << r.suite << setw(24) << r.name << right
+       << setw(6) << r.ni << " x " << left << setw(6) << r.nj << right
+       << setw(4) << r.threads << setw(10) << fixed << setprecision(1)
+       << double(r.ni) * r.nj * bytes_per_node / (1 << 20) << " MiB"
+       << setw(10) << setprecision(2) << best << " MLUPS" << setw(9)
+       << best * 1e6 * bytes_per_update / 1e9 << " GB/s\n";
+}
+
+//! Write results as JSON
+void write_json(const Options &opts, const vector<Result> &results) {
+  ofstream ofs(opts.json);
+  char host[256] = "unknown";
+  gethostname(host, sizeof(host) - 1);
+  const time_t now = time(nullptr);
+  char date[32];
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+  ofs << "{\n  \"benchmark\": \"bench_mlups\",\n"
+      << "  \"date\": \"" << date << "\",\n"
+      << "  \"host\": \"" << host << "\",\n"
+      << "  \"hardware_threads\": " << thread::hardware_concurrency() << ",\n"
+      << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+#ifdef __OPTIMIZE__
+      << "  \"optimized\": true,\n"
+#else
+      << "  \"optimized\": false,\n"
+#endif
+#ifdef BALBM_NO_ASSERT
+      << "  \"assertions\": false,\n"
+#else
+      << "  \"assertions\": true,\n"
+#endif
+      << "  \"quick\": " << (opts.quick ? "true" : "false") << ",\n"
+      << "  \"bytes_per_update\": " << bytes_per_update << ",\n"
+      << "  \"results\": [";
+  for (size_t n = 0; n < results.size(); ++n) {
+    const Result &r = results[n];
+    ofs << (n ? "," : "") << "\n    {\"suite\": \"" << r.suite
+        << "\", \"name\": \"" << r.name << "\", \"ni\": " << r.ni
+        << ", \"nj\": " << r.nj << ", \"nodes\": " << size_t(r.ni) * r.nj
+        << ", \"threads\": " << r.threads << ", \"steps\": " << r.steps
+        << setprecision(6) << ", \"best_seconds\": " << r.best_seconds
+        << ", \"mean_seconds\": " << r.mean_seconds
+        << ", \"mlups\": " << mlups(r, r.best_seconds)
+        << ", \"mean_mlups\": " << mlups(r, r.mean_seconds)
+        << ", \"bandwidth_gbs\": "
+        << mlups(r, r.best_seconds) * 1e6 * bytes_per_update / 1e9 << "}";
+  }
+  ofs << "\n  ]\n}\n";
+  if (!ofs)
+    throw runtime_error("Unable to write " + opts.json + '.');
+}
+
+//! Parse the command line
+Options parse(const int argc, char **argv) {
+  Options opts;
+  for (int a = 1; a < argc; ++a) {
+    const string arg = argv[a];
+    const auto value = [&]() {
+      if (a + 1 >= argc)
+        throw invalid_argument(arg + " requires a value.");
+      return string(argv[++a]);
+    };
+    if (arg == "--quick") {
+      opts.quick = true;
+    } else if (arg == "--json") {
+      opts.json = value();
+    } else if (arg == "--suites") {
+      opts.suites.clear();
+      istringstream iss(value());
+      for (string suite; getline(iss, suite, ',');)
+        opts.suites.push_back(suite);
+    } else if (arg == "--max-nodes") {
+      opts.max_nodes = stoull(value());
+    } else if (arg == "--threads") {
+      opts.max_threads = max(1, stoi(value()));
+    } else if (arg == "--reps") {
+      opts.reps = max(1, stoi(value()));
+    } else if (arg == "--trace") {
+      opts.trace = value();
+    } else {
+      throw invalid_argument("Unknown option " + arg + '.');
+    }
+  }
+  if (opts.quick)
+    opts.max_nodes = min(opts.max_nodes, size_t(1) << 16);
+  return opts;
+}
+
+//! 1, 2, 4, ... up to and including the maximum number of threads
+vector<unsigned> thread_counts(const Options &opts) {
+  vector<unsigned> counts;
+  for (unsigned t = 1; t < opts.max_threads; t *= 2)
+    counts.push_back(t);
+  counts.push_back(opts.max_threads);
+  return counts;
+}
+
+int main(int argc, char **argv) {
+  Options opts;
+  try {
+    opts = parse(argc, argv);
+  } catch (exception &e) {
+    cerr << e.what() << "\nusage: " << argv[0]
+         << " [--quick] [--json FILE] [--suites size,mix,model,strong,weak]"
+         << " [--max-nodes N] [--threads N] [--reps N] [--trace FILE]\n";
+    return 1;
+  }
+  const auto run = [&](const string &suite) {
+    return find(opts.suites.cbegin(), opts.suites.cend(), suite) !=
+           opts.suites.cend();
+  };
+
+  vector<Result> results;
+  const auto record = [&](const Result &r) {
+    print_row(r);
+    results.push_back(r);
+  };
+
+  if (run("size"))
+    for (unsigned n = 32; size_t(n) * n <= opts.max_nodes; n *= 2)
+      record(measure_simulation(opts, "size", to_string(n) + "x" +
+                                                  to_string(n),
+                                make_geometry(Mix::Fluid, n, n), Model::Guo));
+
+  const unsigned nmid = opts.quick ? 128 : 512;
+  if (run("mix"))
+    for (const Mix mix : {Mix::Fluid, Mix::Channel, Mix::Porous})
+      record(measure_simulation(opts, "mix", mix_name(mix),
+                                make_geometry(mix, nmid, nmid), Model::Guo));
+
+  if (run("model"))
+    for (const Model model : {Model::BGK, Model::Guo, Model::SukopThorne,
+                              Model::HeLuo, Model::Axisymmetric, Model::Gray})
+      record(measure_simulation(opts, "model", model_name(model),
+                                make_geometry(Mix::Channel, nmid, nmid),
+                                model));
+
+  if (run("strong")) {
+    const unsigned n = opts.quick ? 256 : 1024;
+    const Geometry geom = make_geometry(Mix::Fluid, n, n);
+    for (const unsigned t : thread_counts(opts))
+      record(measure_simulation(opts, "strong", "periodic_fluid", geom,
+                                Model::Guo, t));
+  }
+
+  if (run("weak")) {
+    const unsigned ncols = opts.quick ? 32 : 128;
+    const unsigned nj = opts.quick ? 128 : 512;
+    for (const unsigned t : thread_counts(opts))
+      record(measure_simulation(opts, "weak", "periodic_fluid",
+                                make_geometry(Mix::Fluid, ncols * t, nj),
+                                Model::Guo, t));
+  }
+
+  if (!opts.trace.empty()) {
+    const unsigned n = opts.quick ? 256 : 1024;
+    const auto spsim = make_simulation(make_geometry(Mix::Fluid, n, n),
+                                       Model::Guo, opts.max_threads);
+    TraceRecorder trace;
+    spsim->attach_trace(&trace);
+    spsim->simulate(opts.quick ? 20 : 200);
+    try {
+      trace.write_json(opts.trace);
+    } catch (exception &e) {
+      cerr << e.what() << '\n';
+      return 1;
+    }
+    cout << trace.size() << " trace events written to " << opts.trace << '\n';
+  }
+
+  try {
+    write_json(opts, results);
+  } catch (exception &e) {
+    cerr << e.what() << '\n';
+    return 1;
+  }
+  cout << "results written to " << opts.json << '\n';
+
+  return 0;
+}
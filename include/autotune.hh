@@ -0,0 +1,158 @@
+#ifndef AUTOTUNE_HH
+#define AUTOTUNE_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Sweeps of the lattice are split into rectangular tiles, traversed in
+// lattice order, and the tiles are shared out to threads in contiguous
+// chunks. Every node still streams and collides exactly once per step, so
+// any configuration reproduces the whole-lattice sweep bit for bit; only the
+// speed differs, and the fastest configuration depends on the machine and
+// the domain. The autotuner times candidates for a few steps and keeps the
+// fastest in a cache keyed by the CPU model and the domain size.
+//
+// Q: why a pool of persistent workers?
+// A: a sweep of a small domain takes microseconds, less than starting a
+//    thread. The workers are started once per configuration and run whole
+//    stretches of steps, meeting at a spinning barrier after streaming and
+//    after the swap of the populations.
+
+#include "balbm_config.hh"
+#include "collision_manager.hh"
+#include "lattice.hh"
+#include "multiscale_map.hh"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! \struct SweepConfig
+//!
+//! \brief Tile size and number of threads of the lattice sweeps
+//!
+//! A tile extent of 0 spans the lattice, except that the i-extent is then
+//! split evenly between the threads.
+struct SweepConfig {
+  SweepConfig(const unsigned tile_i = 0, const unsigned tile_j = 0,
+              const unsigned nthreads = 1)
+      : tile_i(tile_i), tile_j(tile_j), nthreads(nthreads) {}
+  inline bool operator==(const SweepConfig &rhs) const noexcept {
+    return tile_i == rhs.tile_i && tile_j == rhs.tile_j &&
+           nthreads == rhs.nthreads;
+  }
+  inline bool operator!=(const SweepConfig &rhs) const noexcept {
+    return !(*this == rhs);
+  }
+  unsigned tile_i;
+  unsigned tile_j;
+  unsigned nthreads;
+};
+
+using SweepTiles = std::vector<std::array<unsigned, 4>>;
+
+SweepTiles sweep_tiles(const unsigned, const unsigned, const SweepConfig &);
+
+//! \class SweepPool
+//!
+//! \brief Persistent worker threads that run a job on every thread at once
+//!
+//! The calling thread of run() is thread 0 and the workers are 1, 2, ...; the
+//! workers sleep in between runs. Inside a job the threads meet at barrier(),
+//! which spins, since the phases between barriers are too short to sleep in.
+//! Once a thread of a run throws, barrier() returns false on every thread so
+//! that the job can return, and run() rethrows the first exception.
+class SweepPool {
+public:
+  using Job = std::function<void(const unsigned)>;
+
+  SweepPool(const unsigned = 1);
+  SweepPool(const SweepPool &) = delete;
+  SweepPool &operator=(const SweepPool &) = delete;
+  ~SweepPool();
+  inline unsigned num_threads() const noexcept { return nthreads_; }
+  //! Whether a job runs; only meaningful on the calling thread of run()
+  inline bool running() const noexcept { return running_; }
+  void run(const Job &);
+  bool barrier();
+
+private:
+  unsigned nthreads_;
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  const Job *pjob_;
+  unsigned generation_;
+  unsigned nrunning_;
+  bool stop_;
+  bool running_;
+  std::vector<std::exception_ptr> errors_;
+  std::atomic<bool> failed_;
+  std::atomic<unsigned> barrier_count_;
+  std::atomic<unsigned> barrier_generation_;
+
+  void work_(const unsigned);
+  void run_job_(const unsigned);
+};
+
+//! \struct AutotuneOptions
+//!
+//! \brief How to autotune the sweeps of a simulation
+//!
+//! The cache is neither read nor written while cache_path is empty.
+struct AutotuneOptions {
+  AutotuneOptions();
+  std::string cache_path;
+  unsigned nsteps;      //!< timed steps of every candidate
+  unsigned max_threads; //!< most threads of a candidate
+  bool retune;          //!< time the candidates even if the cache has a hit
+};
+
+//! \struct AutotuneResult
+//!
+//! \brief Configuration chosen by the autotuner
+struct AutotuneResult {
+  SweepConfig config;
+  bool cached;      //!< taken from the cache without timing
+  bool stored;      //!< written to the cache
+  double seconds;   //!< time of a step of the configuration, 0 if cached
+  unsigned ntried;  //!< candidates timed
+};
+
+std::string default_autotune_cache_path();
+std::string cpu_model();
+std::vector<SweepConfig> sweep_candidates(const unsigned, const unsigned,
+                                          const unsigned);
+bool lookup_sweep_config(const std::string &, const std::string &,
+                         const unsigned, const unsigned, SweepConfig &);
+bool store_sweep_config(const std::string &, const std::string &,
+                        const unsigned, const unsigned, const SweepConfig &);
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // AUTOTUNE_HH
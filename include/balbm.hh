@@ -17,16 +17,36 @@
 // A copy of the GNU General Public License is at the root directory of
 // this program.  If not, see <http://www.gnu.org/licenses/>
 
+#include "autotune.hh"
 #include "balbm_config.hh"
 #include "callback.hh"
+#include "checkpoint.hh"
 #include "collision_manager.hh"
 #include "constitutive.hh"
+#include "delta_series.hh"
+#include "differential.hh"
 #include "equilibrium.hh"
+#include "field_writers.hh"
 #include "force.hh"
+#include "geometry.hh"
 #include "helpers.hh"
+#include "instrument.hh"
+#include "kernels.hh"
 #include "lattice.hh"
+#include "memory_budget.hh"
+#include "metrics.hh"
 #include "multiscale_map.hh"
 #include "node_desc.hh"
+#include "output.hh"
+#include "perf_counters.hh"
+#include "probe.hh"
+#include "render.hh"
+#include "roofline.hh"
+#include "shared_fields.hh"
 #include "simulate.hh"
+#include "source.hh"
+#include "statistics.hh"
+#include "trace.hh"
+#include "velocity_set.hh"
 
 #endif // BALBM_HH
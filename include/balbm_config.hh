@@ -17,10 +17,17 @@
 #ifndef BALBM_CONFIG_HH
 #define BALBM_CONFIG_HH
 
-// NOTE: for maximum performance define NDEBUG and do not define
+// NOTE: for maximum performance define BALBM_NO_ASSERT and do not define
 //       BALBM_CHECK_BOUNDS_STREAMING.
 
-//#define NDEBUG
+#include <cstdio>
+#include <cstdlib>
+
+//! Define this to compile out the assertions of libbalbm, which are also in
+//! inline functions of its headers; it must be the same for the library and
+//! every program using it, so it is not keyed on NDEBUG. Release builds
+//! define it, and the installed library exports it.
+//#define BALBM_NO_ASSERT
 
 //! Define this to use runtime bounds checking when streaming
 //#define BALBM_CHECK_BOUNDS_STREAMING
@@ -31,8 +38,44 @@
 //! Define this to allow armadillo to save to hdf5
 //#define ARMA_USE_HDF5
 
+//! Define this to allow compressed checkpoints (requires zlib, defined by the
+//! build when zlib is found)
+//#define BALBM_USE_ZLIB
+
+//! Define this to enable the HDF5 field writer (requires HDF5, defined by the
+//! build when HDF5 is found)
+//#define BALBM_USE_HDF5
+
+//! Define this to time the phases of every step, see instrument.hh
+//#define BALBM_INSTRUMENT
+
+//! Define this to also time macroscopic mapping and streaming and collision
+//! per node descriptor type, at the cost of two clock reads per node
+//#define BALBM_INSTRUMENT_NODES
+
 namespace balbm {
 // const static char *VERSION = "0.0.1";
+
+//! Report a failed assertion and abort
+//!
+//! \param condition Condition that failed
+//! \param file Source file of the assertion
+//! \param line Line of the assertion
+[[noreturn]] inline void assertion_failed(const char *condition,
+                                         const char *file, const int line) {
+  std::fprintf(stderr, "%s:%d: assertion failed: %s\n", file, line,
+               condition);
+  std::abort();
 }
+}
+
+//! Assert a condition unless BALBM_NO_ASSERT is defined
+#ifdef BALBM_NO_ASSERT
+#define BALBM_ASSERT(condition) static_cast<void>(0)
+#else
+#define BALBM_ASSERT(condition)                                              \
+  ((condition) ? static_cast<void>(0)                                        \
+               : ::balbm::assertion_failed(#condition, __FILE__, __LINE__))
+#endif
 
 #endif // BALBM_CONFIG_HH
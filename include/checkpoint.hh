@@ -0,0 +1,113 @@
+#ifndef CHECKPOINT_HH
+#define CHECKPOINT_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Checkpoint layout (little endian, native doubles):
+//
+//   [CheckpointHeader][pad to page] [section 0][pad to page] [section 1] ...
+//
+// Every section holds one field of the simulation in the same global
+// (i * nj + j) node order used in memory, so an uncompressed checkpoint is
+// restored by mapping the file and copying each section straight into its
+// buffer. The layout does not depend on how the domain was partitioned among
+// threads when it was written.
+
+#include "balbm_config.hh"
+#include "lattice_fwd.hh"
+#include <cstdint>
+#include <string>
+
+namespace balbm {
+
+namespace d2q9 {
+
+class FlowStatistics;
+
+//! Magic bytes at the start of every checkpoint
+constexpr char CHECKPOINT_MAGIC[8] = {'B', 'A', 'L', 'B', 'M', 'C', 'P', '\0'};
+
+//! Version of the checkpoint format, bumped on any change of the layout or of
+//! the names of node descriptor types hashed into the geometry fingerprint
+constexpr std::uint32_t CHECKPOINT_VERSION = 2;
+
+//! Alignment of sections in a checkpoint file
+constexpr std::uint64_t CHECKPOINT_ALIGN = 4096;
+
+//! \enum CheckpointSectionId
+//!
+//! \brief Fields stored in a checkpoint
+enum class CheckpointSectionId : std::uint32_t {
+  F,       //!< particle distributions, nk doubles per node
+  Rho,     //!< density, one double per node
+  U,       //!< velocity, two doubles per node
+  Omega,   //!< collision frequency, one double per node
+  Ns,      //!< solid fraction, one float per node, optional
+  NodeDesc,  //!< node descriptor fingerprint, one uint32 per node
+  StatsInfo, //!< number of samples and slots of running statistics, optional
+  Stats      //!< records of running statistics, NUM_SLOTS doubles per node
+};
+
+//! Maximum number of sections in a checkpoint
+constexpr unsigned CHECKPOINT_MAX_SECTIONS = 8;
+
+//! \struct CheckpointSection
+//!
+//! \brief Location of a field in a checkpoint file
+struct CheckpointSection {
+  std::uint32_t id;
+  std::uint32_t compressed;
+  std::uint64_t offset;       //!< from the start of the file
+  std::uint64_t bytes;        //!< size of the field in memory
+  std::uint64_t stored_bytes; //!< size of the field in the file
+};
+
+//! \struct CheckpointHeader
+//!
+//! \brief Fixed size header at the start of a checkpoint file
+struct CheckpointHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t nsections;
+  std::uint32_t ni;
+  std::uint32_t nj;
+  std::uint32_t nk;
+  std::uint32_t reserved;
+  std::uint64_t step;
+  CheckpointSection sections[CHECKPOINT_MAX_SECTIONS];
+};
+
+//! Whether checkpoints can be compressed in this build
+constexpr bool checkpoint_compression_available() {
+#ifdef BALBM_USE_ZLIB
+  return true;
+#else
+  return false;
+#endif
+}
+
+void save_checkpoint(const std::string &, const Lattice &,
+                     const IncompFlowMultiscaleMap &, const unsigned,
+                     const bool = false, const FlowStatistics * = nullptr);
+unsigned load_checkpoint(const std::string &, Lattice &,
+                         IncompFlowMultiscaleMap &, FlowStatistics * = nullptr);
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // CHECKPOINT_HH
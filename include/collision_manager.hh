@@ -21,16 +21,18 @@
 #include "constitutive.hh"
 #include "equilibrium.hh"
 #include "force.hh"
+#include "lattice_fwd.hh"
+#include "source.hh"
 #include <memory>
 
 namespace balbm {
 
 namespace d2q9 {
 
-class Lattice;
-// class AbstractIncompFlowEqFunct;
-// class AbstractConstitutiveEq;
-// class AbstractForce;
+class FlowStatistics;
+class Instrumentation;
+
+} // namespace d2q9
 
 // TODO: consider making better use of return value optimization
 // TODO: all customizability may come from composition.
@@ -58,27 +60,45 @@ private:
 //! \class IncompFlowCollisionManager
 //!
 //! \brief Collision manager for incompressible flow
-class IncompFlowCollisionManager {
+//!
+//! Flow statistics are only gathered on D2Q9 lattices, of the velocity with
+//! the half-force shift of the body force applied.
+template <typename VS> class IncompFlowCollisionManager {
 public:
-  IncompFlowCollisionManager(AbstractIncompFlowEqFunct *aef,
-                             AbstractConstitutiveEq *ace,
-                             AbstractForce *af = nullptr)
-      : pfeq_(aef), pconstiteq_(ace), pextforce_(af) {}
-  inline void collide(Lattice &lat, IncompFlowMultiscaleMap &mmap,
-                      const unsigned i, const unsigned j) const {
-    collide_(lat, mmap, i, j);
+  IncompFlowCollisionManager(AbstractIncompFlowEqFunct<VS> *aef,
+                             AbstractConstitutiveEq<VS> *ace,
+                             AbstractForce<VS> *af = nullptr,
+                             AbstractSourceTerm<VS> *ast = nullptr)
+      : pfeq_(aef), pconstiteq_(ace), pextforce_(af), psource_(ast),
+        pstats_(nullptr), pinstr_(nullptr) {}
+  inline void collide(Lattice<VS> &lat, IncompFlowMultiscaleMap<VS> &mmap,
+                      const Coords<VS> &x) const {
+    collide_(lat, mmap, x);
+  }
+  inline const AbstractForce<VS> *pforce() const noexcept {
+    return pextforce_.get();
+  }
+  inline void attach_statistics(d2q9::FlowStatistics *pstats) noexcept {
+    pstats_ = pstats;
+  }
+  inline void attach_instrumentation(d2q9::Instrumentation *pinstr) noexcept {
+    pinstr_ = pinstr;
   }
 
 private:
-  std::unique_ptr<AbstractIncompFlowEqFunct> pfeq_;
-  std::unique_ptr<AbstractConstitutiveEq> pconstiteq_;
-  std::unique_ptr<AbstractForce> pextforce_;
+  std::unique_ptr<AbstractIncompFlowEqFunct<VS>> pfeq_;
+  std::unique_ptr<AbstractConstitutiveEq<VS>> pconstiteq_;
+  std::unique_ptr<AbstractForce<VS>> pextforce_;
+  std::unique_ptr<AbstractSourceTerm<VS>> psource_;
+  d2q9::FlowStatistics *pstats_;
+  d2q9::Instrumentation *pinstr_;
 
-  void collide_(Lattice &, IncompFlowMultiscaleMap &, const unsigned,
-                const unsigned) const;
+  void collide_(Lattice<VS> &, IncompFlowMultiscaleMap<VS> &,
+                const Coords<VS> &) const;
 };
 
-} // namespace d2q9
+extern template class IncompFlowCollisionManager<D2Q9>;
+extern template class IncompFlowCollisionManager<D3Q19>;
 
 } // namespace balbm
 
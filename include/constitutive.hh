@@ -17,34 +17,29 @@
 // A copy of the GNU General Public License is at the root directory of
 // this program.  If not, see <http://www.gnu.org/licenses/>
 
+#include "lattice_fwd.hh"
 #include <armadillo>
 #include <limits>
 
 namespace balbm {
 
-namespace d2q9 {
-
-class Lattice;
-class IncompFlowMultiscaleMap;
-
 //! \class AbstractConstitutiveEq
 //!
 //! \brief Base class for constitutive equations for viscosity
 //!
 //! Maps particle distributions to macroscopic strain rate to viscosity
-class AbstractConstitutiveEq {
+template <typename VS> class AbstractConstitutiveEq {
 public:
   virtual ~AbstractConstitutiveEq() = 0;
-  inline double mu(const Lattice &lat, const IncompFlowMultiscaleMap &mmap,
-                   const arma::vec &fneq, const unsigned i,
-                   const unsigned j) const {
-    return mu_(lat, mmap, fneq, i, j);
+  inline double mu(const Lattice<VS> &lat,
+                   const IncompFlowMultiscaleMap<VS> &mmap,
+                   const arma::vec &fneq, const Coords<VS> &x) const {
+    return mu_(lat, mmap, fneq, x);
   }
 
 private:
-  virtual double mu_(const Lattice &, const IncompFlowMultiscaleMap &,
-                     const arma::vec &, const unsigned,
-                     const unsigned) const = 0;
+  virtual double mu_(const Lattice<VS> &, const IncompFlowMultiscaleMap<VS> &,
+                     const arma::vec &, const Coords<VS> &) const = 0;
 };
 
 //! \class NewtonianConstitutiveEq
@@ -52,17 +47,28 @@ private:
 //! \brief Class for constant viscosity
 //!
 //! Newtonian constitutive equation
-class NewtonianConstitutiveEq : public AbstractConstitutiveEq {
+template <typename VS>
+class NewtonianConstitutiveEq : public AbstractConstitutiveEq<VS> {
 public:
   ~NewtonianConstitutiveEq() {}
   NewtonianConstitutiveEq(const double mu) : cmu_(mu) {}
 
 private:
   const double cmu_;
-  double mu_(const Lattice &, const IncompFlowMultiscaleMap &,
-             const arma::vec &, const unsigned, const unsigned) const;
+  double mu_(const Lattice<VS> &, const IncompFlowMultiscaleMap<VS> &,
+             const arma::vec &, const Coords<VS> &) const;
 };
 
+extern template class AbstractConstitutiveEq<D2Q9>;
+extern template class NewtonianConstitutiveEq<D2Q9>;
+extern template class AbstractConstitutiveEq<D3Q19>;
+extern template class NewtonianConstitutiveEq<D3Q19>;
+
+namespace d2q9 {
+
+using AbstractConstitutiveEq = balbm::AbstractConstitutiveEq<D2Q9>;
+using NewtonianConstitutiveEq = balbm::NewtonianConstitutiveEq<D2Q9>;
+
 //! \class BinghamConstitutiveEq
 //!
 //! \brief Class for constant viscosity
@@ -83,11 +89,18 @@ private:
   const double m_;
   const double gamma_min_;
   double mu_(const Lattice &, const IncompFlowMultiscaleMap &,
-             const arma::vec &, const unsigned, const unsigned);
+             const arma::vec &, const Coords &);
 };
 
 } // namespace d2q9
 
+namespace d3q19 {
+
+using AbstractConstitutiveEq = balbm::AbstractConstitutiveEq<D3Q19>;
+using NewtonianConstitutiveEq = balbm::NewtonianConstitutiveEq<D3Q19>;
+
+} // namespace d3q19
+
 } // namespace balbm
 
 #endif // CONSTITUTIVE_HH
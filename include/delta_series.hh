@@ -0,0 +1,155 @@
+#ifndef DELTA_SERIES_HH
+#define DELTA_SERIES_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Delta series layout (native byte order):
+//
+//   [DeltaSeriesHeader] [DeltaFrameHeader][payload] [DeltaFrameHeader]...
+//
+// Every frame stores each of its fields encoded against the same field of
+// the previous frame, or against zero for keyframes, which start every
+// keyframe_interval frames. Lossless series store the XOR of the bit
+// patterns of each value, packed as the number of leading zero bytes (one
+// nibble per value) followed by the remaining bytes. Lossy series store the
+// difference quantized in steps of the tolerance as zigzag varints, so every
+// value is within half the tolerance of the original. Payloads are deflated
+// on top when balbm is built with zlib.
+//
+// Frames are located by scanning their headers, so a frame of any index is
+// decoded from the nearest keyframe before it and a series cut short by a
+// crash is readable up to its last complete frame.
+
+#include "balbm_config.hh"
+#include "output.hh"
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Magic bytes at the start of every delta series
+constexpr char DELTA_SERIES_MAGIC[8] = {'B', 'A', 'L', 'B',
+                                        'M', 'D', 'S', '\0'};
+
+//! Version of the delta series format, bumped on any change of the layout
+constexpr std::uint32_t DELTA_SERIES_VERSION = 1;
+
+//! Number of fields a delta series can hold: rho, u, omega and f
+constexpr unsigned DELTA_SERIES_NUM_FIELDS = 4;
+
+//! \struct DeltaSeriesHeader
+//!
+//! \brief Fixed size header at the start of a delta series file
+struct DeltaSeriesHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t fields; //!< OutputField bit flags
+  std::uint32_t ni;
+  std::uint32_t nj;
+  std::uint32_t nk;
+  std::uint32_t keyframe_interval;
+  double tolerance; //!< 0 for lossless series
+  double origin[2];
+  double spacing;
+};
+
+//! \struct DeltaFrameHeader
+//!
+//! \brief Header in front of the payload of every frame
+struct DeltaFrameHeader {
+  std::uint64_t step;
+  std::uint32_t keyframe;
+  std::uint32_t deflated;
+  std::uint64_t stored_bytes[DELTA_SERIES_NUM_FIELDS];  //!< in the file
+  std::uint64_t encoded_bytes[DELTA_SERIES_NUM_FIELDS]; //!< before deflate
+};
+
+//! \class DeltaSeriesWriter
+//!
+//! \brief Appends staged frames to a delta compressed time series
+//!
+//! Every frame of a series must have the fields and dimensions of the first
+//! one. Frames are appended in the order they are written, so pipelines with
+//! more than one writer thread may store steps out of order.
+class DeltaSeriesWriter : public AbstractFieldWriter {
+public:
+  ~DeltaSeriesWriter() {}
+  DeltaSeriesWriter(const std::string &, const double = 0.0,
+                    const unsigned = 32);
+  inline const std::string &path() const noexcept { return path_; }
+  unsigned num_frames() const;
+  std::uint64_t raw_bytes() const;
+  std::uint64_t stored_bytes() const;
+
+private:
+  std::string path_;
+  double tolerance_;
+  unsigned keyframe_interval_;
+  mutable std::mutex mutex_;
+  std::ofstream ofs_;
+  DeltaSeriesHeader header_;
+  unsigned nframes_;
+  std::uint64_t raw_bytes_;
+  std::uint64_t stored_bytes_;
+  bool rekey_;
+  std::vector<double> refs_[DELTA_SERIES_NUM_FIELDS];
+  std::vector<unsigned char> encoded_;
+  std::vector<unsigned char> payload_;
+  void write_(const FieldFrame &);
+};
+
+//! \class DeltaSeriesReader
+//!
+//! \brief Random access to the frames of a delta compressed time series
+//!
+//! The last frame read is kept, so reading frames in increasing order
+//! decodes every delta only once.
+class DeltaSeriesReader {
+public:
+  DeltaSeriesReader(const std::string &);
+  inline const DeltaSeriesHeader &header() const noexcept { return header_; }
+  inline unsigned num_frames() const noexcept { return index_.size(); }
+  unsigned step(const unsigned) const;
+  unsigned find(const unsigned) const;
+  void read(const unsigned, FieldFrame &);
+
+private:
+  struct Entry {
+    std::uint64_t offset; //!< of the payload
+    DeltaFrameHeader header;
+  };
+  std::string path_;
+  std::ifstream ifs_;
+  DeltaSeriesHeader header_;
+  std::vector<Entry> index_;
+  unsigned current_;
+  std::vector<double> values_[DELTA_SERIES_NUM_FIELDS];
+  std::vector<unsigned char> stored_;
+  std::vector<unsigned char> encoded_;
+  void decode_(const unsigned);
+};
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // DELTA_SERIES_HH
@@ -0,0 +1,133 @@
+#ifndef DIFFERENTIAL_HH
+#define DIFFERENTIAL_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Differential testing of execution modes. reference_step() is the frozen
+// reference: every node streams, then every node collides, one at a time in
+// lattice order through its node descriptor. It must not be optimized; new
+// layouts, sweeps and kernels are execution modes that a harness steps next
+// to it from the same random case, comparing populations after every step.
+
+#include "balbm_config.hh"
+#include "collision_manager.hh"
+#include "geometry.hh"
+#include "lattice.hh"
+#include "multiscale_map.hh"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! One step of an execution mode: stream, swap and collide
+using ExecutionMode =
+    std::function<void(Lattice &, IncompFlowMultiscaleMap &,
+                       const IncompFlowCollisionManager &)>;
+
+void reference_step(Lattice &, IncompFlowMultiscaleMap &,
+                    const IncompFlowCollisionManager &);
+void sweep_step(Lattice &, IncompFlowMultiscaleMap &,
+                const IncompFlowCollisionManager &);
+ExecutionMode bounds_mode(const std::vector<std::array<unsigned, 4>> &);
+ExecutionMode slab_mode(const unsigned);
+
+//! \struct DifferentialCase
+//!
+//! \brief Geometry, parameters and initial populations of a random case
+struct DifferentialCase {
+  DifferentialCase(const std::uint32_t);
+  std::uint32_t seed;
+  unsigned ni;
+  unsigned nj;
+  bool periodic_i;
+  bool periodic_j;
+  double solid_fraction; //!< fraction of the mask that is solid
+  double gray_fraction;  //!< fraction of fluid nodes with partial solids
+  double rho;
+  double mu;
+  double F[2];
+  bool he_luo;       //!< He and Luo equilibrium instead of the standard one
+  bool guo;          //!< Guo forcing instead of Sukop and Thorne forcing
+  double amplitude;  //!< relative perturbation of the initial populations
+};
+
+void write_case(std::ostream &, const DifferentialCase &);
+
+//! \struct DiffTolerance
+//!
+//! \brief Populations match if within max_ulps or within a relative tolerance
+struct DiffTolerance {
+  DiffTolerance(const std::uint64_t max_ulps = 0, const double rel = 0.0)
+      : max_ulps(max_ulps), rel(rel) {}
+  std::uint64_t max_ulps;
+  double rel;
+};
+
+//! \struct DiffReport
+//!
+//! \brief Outcome of a comparison, with the first population out of tolerance
+struct DiffReport {
+  bool passed;
+  unsigned steps;          //!< steps compared
+  unsigned step;           //!< step of the first difference
+  unsigned i;              //!< node of the first difference
+  unsigned j;
+  unsigned k;              //!< direction of the first difference
+  double reference;        //!< population of the reference
+  double candidate;        //!< population of the execution mode
+  std::uint64_t max_ulps;  //!< largest distance in ulps of any population
+};
+
+void write_report(std::ostream &, const DiffReport &);
+
+std::uint64_t ulp_distance(const double, const double) noexcept;
+
+//! \class DifferentialHarness
+//!
+//! \brief Steps execution modes next to the reference from one random case
+class DifferentialHarness {
+public:
+  DifferentialHarness(const DifferentialCase &);
+  inline const DifferentialCase &test_case() const noexcept { return case_; }
+  DiffReport compare(const ExecutionMode &, const unsigned,
+                     const DiffTolerance & = DiffTolerance()) const;
+
+private:
+  //! \struct State
+  //!
+  //! \brief Everything a step reads and writes
+  struct State {
+    State(const DifferentialCase &, const Geometry &);
+    Lattice lat;
+    IncompFlowMultiscaleMap mmap;
+    IncompFlowCollisionManager cman;
+  };
+  DifferentialCase case_;
+  std::unique_ptr<Geometry> spgeom_;
+};
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // DIFFERENTIAL_HH
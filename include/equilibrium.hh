@@ -17,14 +17,12 @@
 // A copy of the GNU General Public License is at the root directory of
 // this program.  If not, see <http://www.gnu.org/licenses/>
 
+#include "kernels.hh"
+#include "lattice_fwd.hh"
 #include <armadillo>
 
 namespace balbm {
 
-namespace d2q9 {
-
-class Lattice;
-
 /* TODO: does it make sense to have a base class for all equilibrium equations?
 //! \class AbstractEqFunct
 //!
@@ -44,26 +42,23 @@ private:
 };
 */
 
-// TODO: if we start implementing other lattices then "f" should be a function
-// template/overloaded?
-
 //! \class AbstractIncompFlowEqFunct
 //!
 //! \brief Base equilibrium distribution function for incompressible flow
 //!
 //! Defines functor for calculating a local equilibrium distribution function
 //! for simulating incompressible flow
-class AbstractIncompFlowEqFunct {
+template <typename VS> class AbstractIncompFlowEqFunct {
 public:
   virtual ~AbstractIncompFlowEqFunct() = 0;
-  inline double f(const Lattice &lat, const double rho, const arma::vec &u,
-                  const unsigned k) const {
+  inline double f(const Lattice<VS> &lat, const double rho,
+                  const arma::vec &u, const unsigned k) const {
     return f_(lat, rho, u, k);
   }
 
 private:
-  virtual double f_(const Lattice &lat, const double rho, const arma::vec &u,
-                    const unsigned k) const = 0;
+  virtual double f_(const Lattice<VS> &lat, const double rho,
+                    const arma::vec &u, const unsigned k) const = 0;
 };
 
 //! \class IncompFlowEqFunct
@@ -72,12 +67,13 @@ private:
 //!
 //! Defines functor for calculating a local equilibrium distribution function
 //! for simulating incompressible flow
-class IncompFlowEqFunct : public AbstractIncompFlowEqFunct {
+template <typename VS>
+class IncompFlowEqFunct : public AbstractIncompFlowEqFunct<VS> {
 public:
   ~IncompFlowEqFunct() {}
 
 private:
-  double f_(const Lattice &lat, const double rho, const arma::vec &u,
+  double f_(const Lattice<VS> &lat, const double rho, const arma::vec &u,
             const unsigned k) const;
 };
 
@@ -87,19 +83,41 @@ private:
 //!
 //! Defines functor for calculating a local He and Lou equilibrium distribution
 //! function for simulating incompressible flow. Used for numerical stability.
-class IncompFlowHLEqFunct : public AbstractIncompFlowEqFunct {
+template <typename VS>
+class IncompFlowHLEqFunct : public AbstractIncompFlowEqFunct<VS> {
 public:
   ~IncompFlowHLEqFunct() {}
-  IncompFlowHLEqFunct(unsigned rho_o) : rho_o_(rho_o) {}
+  IncompFlowHLEqFunct(const double rho_o) : rho_o_(rho_o) {}
 
 private:
   double rho_o_;
-  double f_(const Lattice &lat, const double rho, const arma::vec &u,
-            const unsigned k) const = 0;
+  double f_(const Lattice<VS> &lat, const double rho, const arma::vec &u,
+            const unsigned k) const;
 };
 
+extern template class AbstractIncompFlowEqFunct<D2Q9>;
+extern template class IncompFlowEqFunct<D2Q9>;
+extern template class IncompFlowHLEqFunct<D2Q9>;
+extern template class AbstractIncompFlowEqFunct<D3Q19>;
+extern template class IncompFlowEqFunct<D3Q19>;
+extern template class IncompFlowHLEqFunct<D3Q19>;
+
+namespace d2q9 {
+
+using AbstractIncompFlowEqFunct = balbm::AbstractIncompFlowEqFunct<D2Q9>;
+using IncompFlowEqFunct = balbm::IncompFlowEqFunct<D2Q9>;
+using IncompFlowHLEqFunct = balbm::IncompFlowHLEqFunct<D2Q9>;
+
 } // namespace d2q9
 
+namespace d3q19 {
+
+using AbstractIncompFlowEqFunct = balbm::AbstractIncompFlowEqFunct<D3Q19>;
+using IncompFlowEqFunct = balbm::IncompFlowEqFunct<D3Q19>;
+using IncompFlowHLEqFunct = balbm::IncompFlowHLEqFunct<D3Q19>;
+
+} // namespace d3q19
+
 } // namespace balbm
 
 #endif // EQUILIBRIUM_HH
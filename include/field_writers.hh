@@ -0,0 +1,101 @@
+#ifndef FIELD_WRITERS_HH
+#define FIELD_WRITERS_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm_config.hh"
+#include "output.hh"
+#include <mutex>
+#include <string>
+#include <vector>
+#ifdef BALBM_USE_HDF5
+#include <hdf5.h>
+#endif
+
+namespace balbm {
+
+namespace d2q9 {
+
+class FlowStatistics;
+
+//! \class VtkImageWriter
+//!
+//! \brief Writes staged fields as a VTK image data time series
+//!
+//! Every frame becomes `<prefix>_<step>.vti`, a VTK XML image data file with
+//! the arrays appended as raw binary, and `<prefix>.pvd` indexes the series.
+//! VTK orders points with x fastest, so fields are transposed from the
+//! lattice order on the writer thread; u is padded to three components so it
+//! is recognized as a vector. Origin and spacing place regions of interest
+//! and coarsened output at their lattice coordinates.
+class VtkImageWriter : public AbstractFieldWriter {
+public:
+  ~VtkImageWriter() {}
+  VtkImageWriter(const std::string &prefix) : prefix_(prefix) {}
+  inline const std::string &prefix() const noexcept { return prefix_; }
+
+private:
+  std::string prefix_;
+  std::mutex mutex_;
+  std::vector<unsigned> steps_;
+  void write_(const FieldFrame &);
+  void write_index_();
+};
+
+#ifdef BALBM_USE_HDF5
+//! \class Hdf5FieldWriter
+//!
+//! \brief Writes staged fields to one HDF5 file with an XDMF index
+//!
+//! Every frame becomes a group `/step_<step>` of `<prefix>.h5` holding
+//! chunked, shuffled and deflated datasets written from the staging buffers,
+//! e.g. rho has dimensions (ni, nj). u is padded to (ni, nj, 3) with a zero
+//! z-component, as XDMF vectors have three components.
+//! `<prefix>.xmf` indexes the macroscopic fields as a temporal collection.
+//! XDMF lists dimensions slowest first, so viewers show j along x and i
+//! along y. Calls into the HDF5 library are serialized among all writers, so
+//! any number of pipeline threads may share a writer.
+class Hdf5FieldWriter : public AbstractFieldWriter {
+public:
+  ~Hdf5FieldWriter();
+  Hdf5FieldWriter(const std::string &, const unsigned = 64,
+                  const unsigned = 1);
+  inline const std::string &prefix() const noexcept { return prefix_; }
+
+private:
+  std::string prefix_;
+  unsigned chunk_;
+  unsigned deflate_level_;
+  hid_t file_;
+  std::vector<unsigned> steps_;
+  unsigned fields_;
+  unsigned ni_;
+  unsigned nj_;
+  double origin_[2];
+  double spacing_;
+  void write_(const FieldFrame &);
+  void write_index_();
+};
+#endif
+
+void write_statistics(const std::string &, const FlowStatistics &);
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // FIELD_WRITERS_HH
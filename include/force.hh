@@ -18,40 +18,36 @@
 // this program.  If not, see <http://www.gnu.org/licenses/>
 
 #include "balbm_config.hh"
+#include "kernels.hh"
+#include "lattice_fwd.hh"
 #include <armadillo>
 #include <array>
 
 namespace balbm {
 
-namespace d2q9 {
-
-class Lattice;
-
 //! \class AbstractForce
 //!
 //! \brief Abstract base class for force implementations
 //!
 //! Provide polymorphic behavior for forces and force implementations
-class AbstractForce {
+template <typename VS> class AbstractForce {
 public:
+  using vec = arma::vec::fixed<VS::nd>;
   virtual ~AbstractForce() = 0;
-  AbstractForce(double *F) : F_(arma::vec::fixed<2>(F)) {}
-  inline arma::vec::fixed<2> u_trans(const Lattice &lat,
-                                     const arma::vec::fixed<2> &u) const {
+  AbstractForce(double *F) : F_(vec(F)) {}
+  inline vec u_trans(const Lattice<VS> &lat, const vec &u) const {
     return u_trans_(lat, u);
   }
-  inline double f_col(const Lattice &lat, const double omega,
-                      const arma::vec::fixed<2> &u, const unsigned k) const {
+  inline double f_col(const Lattice<VS> &lat, const double omega,
+                      const vec &u, const unsigned k) const {
     return f_col_(lat, omega, u, k);
   }
-  inline const arma::vec::fixed<2> &F() const { return F_; }
+  inline const vec &F() const { return F_; }
 
 private:
-  arma::vec::fixed<2> F_;
-  virtual arma::vec::fixed<2> u_trans_(const Lattice &,
-                                       const arma::vec::fixed<2> &) const = 0;
-  virtual double f_col_(const Lattice &, const double omega,
-                        const arma::vec::fixed<2> &,
+  vec F_;
+  virtual vec u_trans_(const Lattice<VS> &, const vec &) const = 0;
+  virtual double f_col_(const Lattice<VS> &, const double omega, const vec &,
                         const unsigned k) const = 0;
 };
 
@@ -61,15 +57,15 @@ private:
 //!
 //! One of the forcing implementations found in Lattice Boltzmann Method for
 //! Geoscientists and Engineers by Sukop and Thorne 2005
-class SukopThorneForce : public AbstractForce {
+template <typename VS> class SukopThorneForce : public AbstractForce<VS> {
 public:
+  using typename AbstractForce<VS>::vec;
   ~SukopThorneForce(){};
-  SukopThorneForce(double *F) : AbstractForce(F) {}
+  SukopThorneForce(double *F) : AbstractForce<VS>(F) {}
 
 private:
-  arma::vec::fixed<2> u_trans_(const Lattice &,
-                               const arma::vec::fixed<2> &) const;
-  double f_col_(const Lattice &, const double, const arma::vec::fixed<2> &,
+  vec u_trans_(const Lattice<VS> &, const vec &) const;
+  double f_col_(const Lattice<VS> &, const double, const vec &,
                 const unsigned) const;
 };
 
@@ -79,20 +75,41 @@ private:
 //!
 //! One of the forcing implementations found in Discrete lattice effects on the
 //! forcing termin the lattice Boltzmann method Guo et. al. 2002
-class GuoForce : public AbstractForce {
+template <typename VS> class GuoForce : public AbstractForce<VS> {
 public:
+  using typename AbstractForce<VS>::vec;
   ~GuoForce(){};
-  GuoForce(double *F) : AbstractForce(F) {}
+  GuoForce(double *F) : AbstractForce<VS>(F) {}
 
 private:
-  arma::vec::fixed<2> u_trans_(const Lattice &,
-                               const arma::vec::fixed<2> &) const;
-  double f_col_(const Lattice &, const double, const arma::vec::fixed<2> &,
+  vec u_trans_(const Lattice<VS> &, const vec &) const;
+  double f_col_(const Lattice<VS> &, const double, const vec &,
                 const unsigned) const;
 };
 
+extern template class AbstractForce<D2Q9>;
+extern template class SukopThorneForce<D2Q9>;
+extern template class GuoForce<D2Q9>;
+extern template class AbstractForce<D3Q19>;
+extern template class SukopThorneForce<D3Q19>;
+extern template class GuoForce<D3Q19>;
+
+namespace d2q9 {
+
+using AbstractForce = balbm::AbstractForce<D2Q9>;
+using SukopThorneForce = balbm::SukopThorneForce<D2Q9>;
+using GuoForce = balbm::GuoForce<D2Q9>;
+
 } // namespace d2q9
 
+namespace d3q19 {
+
+using AbstractForce = balbm::AbstractForce<D3Q19>;
+using SukopThorneForce = balbm::SukopThorneForce<D3Q19>;
+using GuoForce = balbm::GuoForce<D3Q19>;
+
+} // namespace d3q19
+
 } // namespace balbm
 
 #endif // FORCE_HH
@@ -0,0 +1,161 @@
+#ifndef GEOMETRY_HH
+#define GEOMETRY_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Geometry cache layout (native byte order):
+//
+//   [GeometryCacheHeader] [run] [run] ...
+//
+// Runs cover the nodes in lattice order, i * nj + j. Every run is the node
+// class (one byte), the solid links of directions 1 through 8 (one byte,
+// bit k - 1 for direction k) and the number of nodes as a varint.
+
+#include "balbm_config.hh"
+#include "lattice_fwd.hh"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Magic bytes at the start of every geometry cache
+constexpr char GEOMETRY_CACHE_MAGIC[8] = {'B', 'A', 'L', 'B',
+                                          'M', 'G', 'E', '\0'};
+
+//! Version of the geometry cache format, bumped on any change of the layout
+constexpr std::uint32_t GEOMETRY_CACHE_VERSION = 1;
+
+//! \enum NodeClass
+//!
+//! \brief Classes of nodes of a geometry and their node descriptors
+enum NodeClass : std::uint8_t {
+  NODE_CLASS_INACTIVE,           //!< solid, NodeInactive
+  NODE_CLASS_ACTIVE,             //!< fluid, NodeActive
+  NODE_CLASS_PERIODIC,           //!< fluid on a periodic edge, NodePeriodic
+  NODE_CLASS_NORTH_FACING_WALL,  //!< solid to the south
+  NODE_CLASS_SOUTH_FACING_WALL,  //!< solid to the north
+  NODE_CLASS_EAST_FACING_WALL,   //!< solid to the west
+  NODE_CLASS_WEST_FACING_WALL,   //!< solid to the east
+  NODE_CLASS_CORNER_EAST_NORTH,  //!< solid to the west and south
+  NODE_CLASS_CORNER_WEST_NORTH,  //!< solid to the east and south
+  NODE_CLASS_CORNER_WEST_SOUTH,  //!< solid to the east and north
+  NODE_CLASS_CORNER_EAST_SOUTH,  //!< solid to the west and north
+  NODE_CLASS_BOUNCE_BACK,        //!< any other solid links, NodeBounceBack
+  NUM_NODE_CLASSES
+};
+
+//! \class GeometryMask
+//!
+//! \brief Solid/fluid mask of a domain
+//!
+//! Masks are read from PGM or PNG images, where pixels darker than half of
+//! the maximum value are solid, x (i) is to the right and y (j) is up, or
+//! memory mapped from raw files of one byte per node in lattice order,
+//! where nonzero bytes are solid. Raw masks are mapped copy-on-write, so
+//! set_solid() never modifies the file. PNG masks require zlib.
+class GeometryMask {
+public:
+  GeometryMask(const unsigned, const unsigned);
+  GeometryMask(const std::string &);
+  GeometryMask(const std::string &, const unsigned, const unsigned);
+  GeometryMask(const GeometryMask &) = delete;
+  GeometryMask &operator=(const GeometryMask &) = delete;
+  ~GeometryMask();
+  inline unsigned num_i() const noexcept { return ni_; }
+  inline unsigned num_j() const noexcept { return nj_; }
+  inline bool solid(const unsigned i, const unsigned j) const noexcept {
+    return pmask_[std::size_t(i) * nj_ + j] != 0;
+  }
+  inline void set_solid(const unsigned i, const unsigned j,
+                        const bool solid = true) noexcept {
+    pmask_[std::size_t(i) * nj_ + j] = solid;
+  }
+  inline const std::uint8_t *pmask() const noexcept { return pmask_; }
+
+private:
+  unsigned ni_;
+  unsigned nj_;
+  std::vector<std::uint8_t> data_;
+  void *pmap_;
+  std::size_t map_bytes_;
+  std::uint8_t *pmask_;
+  void read_pgm_(const std::string &, const std::vector<char> &);
+  void read_png_(const std::string &, const std::vector<char> &);
+};
+
+//! \struct GeometryCacheHeader
+//!
+//! \brief Fixed size header at the start of a geometry cache file
+struct GeometryCacheHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t ni;
+  std::uint32_t nj;
+  std::uint32_t periodic; //!< bit 0 for i, bit 1 for j
+  std::uint64_t num_runs;
+};
+
+//! \class Geometry
+//!
+//! \brief Node classes of a domain, classified from a mask or a cache
+//!
+//! Solid nodes are inactive. A fluid node is classified by the set of its
+//! neighbors that are solid, its solid links, with halfway bounce-back in
+//! mind: a straight wall or a concave corner if the set is exactly that of
+//! the corresponding descriptor, NodeBounceBack for any other set, and
+//! active or periodic if there are none. Neighbors beyond an edge of the
+//! domain wrap around if the domain is periodic in that direction and are
+//! solid otherwise. apply() sets one shared descriptor per class, so the
+//! lattice constructs a handful of descriptors instead of one per node.
+class Geometry {
+public:
+  Geometry(const GeometryMask &, const bool = false, const bool = false,
+           const unsigned = 0);
+  Geometry(const std::string &);
+  inline unsigned num_i() const noexcept { return ni_; }
+  inline unsigned num_j() const noexcept { return nj_; }
+  inline bool periodic_i() const noexcept { return periodic_[0]; }
+  inline bool periodic_j() const noexcept { return periodic_[1]; }
+  inline NodeClass node_class(const unsigned i, const unsigned j) const {
+    return static_cast<NodeClass>(classes_[std::size_t(i) * nj_ + j]);
+  }
+  //! Solid links of a node, bit k set if the neighbor in direction k is solid
+  inline unsigned links(const unsigned i, const unsigned j) const {
+    return static_cast<unsigned>(links_[std::size_t(i) * nj_ + j]) << 1;
+  }
+  std::size_t count(const NodeClass) const;
+  void save(const std::string &) const;
+  void apply(Lattice &) const;
+
+private:
+  unsigned ni_;
+  unsigned nj_;
+  bool periodic_[2];
+  std::vector<std::uint8_t> classes_;
+  std::vector<std::uint8_t> links_;
+  void classify_(const GeometryMask &, const unsigned, const unsigned);
+};
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // GEOMETRY_HH
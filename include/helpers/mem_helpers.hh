@@ -27,6 +27,10 @@ public:
   }
   inline void *raw_ptr() { return static_cast<void *>(mem_.data()); }
   inline std::size_t capacity() const { return mem_.capacity(); }
+  inline bool owns(const void *p) const {
+    const char *pc = static_cast<const char *>(p);
+    return pc >= mem_.data() && pc < mem_.data() + allocated_;
+  }
   template <typename T, typename... Args> T *allocate(Args...);
 
 private:
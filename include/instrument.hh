@@ -0,0 +1,259 @@
+#ifndef INSTRUMENT_HH
+#define INSTRUMENT_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Phases of a step are timed when BALBM_INSTRUMENT is defined, at the cost
+// of two clock reads per phase. Phases inside the sweep, macroscopic
+// mapping and streaming and collision per node type, need two clock reads
+// per node and are only timed when BALBM_INSTRUMENT_NODES is defined too.
+// Without them every BALBM_TIME_* macro expands to an unevaluated no-op.
+//
+// Every thread accumulates into a slot of its own, so timers never contend;
+// a slot is only written by its thread and is read with relaxed atomics.
+//
+// Hardware events are counted per phase too, once count_hardware_events()
+// is called, but only for the calling thread: counters belong to a thread
+// and reading them costs a system call per event and phase.
+
+#include "balbm_config.hh"
+#include "perf_counters.hh"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <vector>
+
+#if defined(BALBM_INSTRUMENT_NODES) && !defined(BALBM_INSTRUMENT)
+#define BALBM_INSTRUMENT
+#endif
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! \enum Phase
+//!
+//! \brief Instrumented phases of a simulation
+enum Phase : unsigned {
+  PHASE_STEP,      //!< a whole time step
+  PHASE_STREAM,    //!< streaming sweep
+  PHASE_SWAP,      //!< swap of the particle distribution buffers
+  PHASE_COLLIDE,   //!< collision and boundary sweep
+  PHASE_MACRO,     //!< mapping to macroscopic variables, per node
+  PHASE_PROBES,    //!< recording probes
+  PHASE_CALLBACKS, //!< simulation callbacks
+  PHASE_STAGE,     //!< staging fields for output
+  PHASE_IO,        //!< writing output and checkpoints
+  NUM_PHASES
+};
+
+const char *phase_name(const Phase);
+
+//! \struct PhaseTotals
+//!
+//! \brief Accumulated calls and wall time
+struct PhaseTotals {
+  std::uint64_t calls;
+  double seconds;
+};
+
+//! \struct NodeTypeTotals
+//!
+//! \brief Accumulated streaming and collision of a node descriptor type
+struct NodeTypeTotals {
+  std::string name;
+  PhaseTotals stream;
+  PhaseTotals collide;
+};
+
+//! \class Instrumentation
+//!
+//! \brief Thread-safe accumulator of per-phase and per-node-type timings
+class Instrumentation {
+public:
+  //! Maximum number of distinct node descriptor types, more are dropped
+  static constexpr unsigned max_node_types = 32;
+
+  Instrumentation();
+  Instrumentation(const Instrumentation &) = delete;
+  Instrumentation &operator=(const Instrumentation &) = delete;
+  ~Instrumentation();
+  static constexpr bool enabled() {
+#ifdef BALBM_INSTRUMENT
+    return true;
+#else
+    return false;
+#endif
+  }
+  static constexpr bool nodes_enabled() {
+#ifdef BALBM_INSTRUMENT_NODES
+    return true;
+#else
+    return false;
+#endif
+  }
+  void add(const Phase, const std::uint64_t);
+  void add_node(const std::type_info &, const Phase, const std::uint64_t);
+  bool count_hardware_events();
+  inline bool counting_hardware() const noexcept {
+    return spperf_ != nullptr && hw_thread_ == std::this_thread::get_id();
+  }
+  inline const PerfCounters *perf_counters() const noexcept {
+    return spperf_.get();
+  }
+  HardwareCounts hardware_counts() const;
+  void add_hardware(const Phase, const HardwareCounts &);
+  PhaseTotals phase(const Phase) const;
+  HardwareCounts hardware(const Phase) const;
+  std::vector<NodeTypeTotals> node_types() const;
+  void reset();
+  void report(std::ostream &) const;
+
+private:
+  struct Counter {
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> nanoseconds{0};
+    inline void add(const std::uint64_t ns) noexcept {
+      // only the owning thread writes, no read-modify-write needed
+      calls.store(calls.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+      nanoseconds.store(nanoseconds.load(std::memory_order_relaxed) + ns,
+                        std::memory_order_relaxed);
+    }
+  };
+  struct NodeCounter {
+    std::atomic<const std::type_info *> ptype{nullptr};
+    Counter stream;
+    Counter collide;
+  };
+  struct Slot {
+    Counter phases[NUM_PHASES];
+    NodeCounter nodes[max_node_types];
+  };
+
+  std::uint64_t id_;
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Slot>> slots_;
+  std::unique_ptr<PerfCounters> spperf_;
+  std::thread::id hw_thread_;
+  std::atomic<std::uint64_t> hw_totals_[NUM_PHASES][NUM_HW_EVENTS];
+  Slot &slot_();
+};
+
+//! \class ScopedPhase
+//!
+//! \brief Adds the wall time and hardware events of its scope to a phase
+class ScopedPhase {
+public:
+  ScopedPhase(Instrumentation *pinstr, const Phase phase)
+      : pinstr_(pinstr), phase_(phase),
+        hw_(pinstr != nullptr && pinstr->counting_hardware()) {
+    if (hw_)
+      hw_start_ = pinstr_->hardware_counts();
+    start_ = std::chrono::steady_clock::now();
+  }
+  ScopedPhase(const ScopedPhase &) = delete;
+  ScopedPhase &operator=(const ScopedPhase &) = delete;
+  ~ScopedPhase() {
+    if (pinstr_ == nullptr)
+      return;
+    pinstr_->add(phase_, elapsed_ns(start_));
+    if (hw_)
+      pinstr_->add_hardware(phase_, hw_start_);
+  }
+  static inline std::uint64_t
+  elapsed_ns(const std::chrono::steady_clock::time_point &start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  }
+
+private:
+  Instrumentation *pinstr_;
+  Phase phase_;
+  bool hw_;
+  HardwareCounts hw_start_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+//! \class ScopedNodePhase
+//!
+//! \brief Adds the wall time of its scope to a phase of a node type
+class ScopedNodePhase {
+public:
+  ScopedNodePhase(Instrumentation *pinstr, const std::type_info &type,
+                  const Phase phase)
+      : pinstr_(pinstr), ptype_(&type), phase_(phase),
+        start_(std::chrono::steady_clock::now()) {}
+  ScopedNodePhase(const ScopedNodePhase &) = delete;
+  ScopedNodePhase &operator=(const ScopedNodePhase &) = delete;
+  ~ScopedNodePhase() {
+    if (pinstr_ != nullptr)
+      pinstr_->add_node(*ptype_, phase_, ScopedPhase::elapsed_ns(start_));
+  }
+
+private:
+  Instrumentation *pinstr_;
+  const std::type_info *ptype_;
+  Phase phase_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#define BALBM_CONCAT_(a, b) a##b
+#define BALBM_CONCAT(a, b) BALBM_CONCAT_(a, b)
+
+//! Time the rest of the enclosing scope as a phase
+#ifdef BALBM_INSTRUMENT
+#define BALBM_TIME_PHASE(pinstr, phase)                                      \
+  ::balbm::d2q9::ScopedPhase BALBM_CONCAT(balbm_scoped_phase_,              \
+                                          __LINE__)(pinstr, phase)
+#else
+#define BALBM_TIME_PHASE(pinstr, phase)                                      \
+  static_cast<void>(sizeof(pinstr))
+#endif
+
+//! Time the rest of the enclosing scope as a phase, once per node
+#ifdef BALBM_INSTRUMENT_NODES
+#define BALBM_TIME_NODE_PHASE(pinstr, phase)                                 \
+  ::balbm::d2q9::ScopedPhase BALBM_CONCAT(balbm_scoped_phase_,              \
+                                          __LINE__)(pinstr, phase)
+#else
+#define BALBM_TIME_NODE_PHASE(pinstr, phase)                                 \
+  static_cast<void>(sizeof(pinstr))
+#endif
+
+//! Time the rest of the enclosing scope as a phase of a node type
+#ifdef BALBM_INSTRUMENT_NODES
+#define BALBM_TIME_NODE_TYPE(pinstr, type, phase)                            \
+  ::balbm::d2q9::ScopedNodePhase BALBM_CONCAT(balbm_scoped_node_,           \
+                                              __LINE__)(pinstr, type, phase)
+#else
+#define BALBM_TIME_NODE_TYPE(pinstr, type, phase)                            \
+  static_cast<void>(sizeof(pinstr))
+#endif
+
+#endif // INSTRUMENT_HH
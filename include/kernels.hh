@@ -0,0 +1,116 @@
+#ifndef KERNELS_HH
+#define KERNELS_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Kernels templated on a compile-time velocity set descriptor. They are shared
+// by every lattice so that equilibrium and forcing are written exactly once.
+
+#include "velocity_set.hh"
+
+namespace balbm {
+
+//! Dot product of a lattice direction with a vector
+//!
+//! \param k Index of lattice direction
+//! \param v Vector with VS::nd components
+//! \return c_k . v
+template <typename VS> inline double cdot(const unsigned k, const double *v) {
+  double result = 0.0;
+  for (unsigned d = 0; d < VS::nd; ++d)
+    result += VS::c[k][d] * v[d];
+  return result;
+}
+
+//! Dot product of a vector with itself
+//!
+//! \param v Vector with VS::nd components
+//! \return v . v
+template <typename VS> inline double sqnorm(const double *v) {
+  double result = 0.0;
+  for (unsigned d = 0; d < VS::nd; ++d)
+    result += v[d] * v[d];
+  return result;
+}
+
+//! Equilibrium distribution function for incompressible flow
+//!
+//! \param rho Density at the lattice node
+//! \param u Macroscopic velocity vector
+//! \param k Index of lattice direction
+//! \return Equilibrium particle distribution
+template <typename VS>
+inline double incomp_feq(const double rho, const double *u, const unsigned k) {
+  const double ckdotu = cdot<VS>(k, u);
+  const double cssq = VS::cssq;
+
+  return rho * VS::w[k] *
+         (1.0 + ckdotu / cssq + 0.5 * (ckdotu * ckdotu) / (cssq * cssq) -
+          0.5 * sqnorm<VS>(u) / cssq);
+}
+
+//! He and Luo equilibrium distribution function for incompressible flow
+//!
+//! \param rho Density at the lattice node
+//! \param rho_o Reference density
+//! \param u Macroscopic velocity vector
+//! \param k Index of lattice direction
+//! \return Equilibrium particle distribution
+template <typename VS>
+inline double incomp_hl_feq(const double rho, const double rho_o,
+                            const double *u, const unsigned k) {
+  const double ckdotu = cdot<VS>(k, u);
+  const double cssq = VS::cssq;
+
+  return VS::w[k] *
+         (rho + rho_o * (ckdotu / cssq + 0.5 * (ckdotu * ckdotu) /
+                                             (cssq * cssq) -
+                         0.5 * sqnorm<VS>(u) / cssq));
+}
+
+//! Sukop and Thorne forcing term for a lattice direction
+//!
+//! \param F External force density
+//! \param k Index of lattice direction
+//! \return Value to add to post-collision particle distribution
+template <typename VS>
+inline double sukop_thorne_f_col(const double *F, const unsigned k) {
+  return VS::w[k] / VS::cssq * cdot<VS>(k, F);
+}
+
+//! Guo forcing term for a lattice direction
+//!
+//! \param omega Collision frequency
+//! \param u Macroscopic velocity vector
+//! \param F External force density
+//! \param k Index of lattice direction
+//! \return Value to add to post-collision particle distribution
+template <typename VS>
+inline double guo_f_col(const double omega, const double *u, const double *F,
+                        const unsigned k) {
+  const double ckdotu = cdot<VS>(k, u);
+  double result = 0.0;
+  for (unsigned d = 0; d < VS::nd; ++d)
+    result += ((VS::c[k][d] - u[d]) / VS::cssq +
+               ckdotu / (VS::cssq * VS::cssq) * VS::c[k][d]) *
+              F[d];
+  return (1.0 - 0.5 * omega) * VS::w[k] * result;
+}
+
+} // namespace balbm
+
+#endif // KERNELS_HH
@@ -17,49 +17,62 @@
 // A copy of the GNU General Public License is at the root directory of
 // this program.  If not, see <http://www.gnu.org/licenses/>
 
-// TODO: consider using a different data structure for 2D and 3D arrays
 // TODO: consider overloading [] for indexing???
 
 #include "balbm_config.hh"
 #include "helpers/mem_helpers.hh"
+#include "lattice_fwd.hh"
 #include "node_desc.hh"
+#include "velocity_set.hh"
 #include <algorithm>
 #include <array>
-#include <cassert>
 #include <cmath>
 #include <exception>
 //#include <iosfwd>
 #include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <vector>
 
 namespace balbm {
 
-namespace d2q9 {
-
 // TODO: "More code (ALWAYS) runs slower" -- John Lakos --
 
 //! \class Lattice
 //!
 //! \brief  lattice for the lattice Boltzmann method
-class Lattice {
+//!
+//! Holds the particle distributions and the node descriptor of every node of
+//! a lattice of the velocity set VS. Nodes are addressed by their
+//! coordinates, or by (i, j) on two dimensional lattices.
+template <typename VS> class Lattice {
 public:
+  using velocity_set = VS;
+  static constexpr unsigned max_shared_node_descs = 512;
+
   // constructors and assignment
   // TODO: make more constructors, initializers, and factories
-  Lattice() : ni_(0), nj_(0), spf_(nullptr), spftemp_(nullptr) {}
-  Lattice(const unsigned ni, const unsigned nj, const double rho = 1.0)
-      : ni_(ni), nj_(nj), spf_(new double[ni * nj * num_k()]),
-        spftemp_(new double[ni * nj * num_k()]), node_descs_(ni * nj),
-        mem_pool_(max_node_desc_size() * ni * nj) {
+  Lattice() : n_{}, spf_(nullptr), spftemp_(nullptr) {}
+  Lattice(const Coords<VS> &n, const double rho = 1.0)
+      : n_(n), spf_(new double[balbm::num_nodes<VS>(n) * num_k()]),
+        spftemp_(new double[balbm::num_nodes<VS>(n) * num_k()]),
+        node_descs_(balbm::num_nodes<VS>(n)),
+        mem_pool_(max_node_desc_size<VS>() * balbm::num_nodes<VS>(n)) {
     init_f_(rho);
   }
+  Lattice(const unsigned ni, const unsigned nj, const double rho = 1.0)
+      : Lattice(coords<VS>(ni, nj), rho) {}
   Lattice(const Lattice &);
   Lattice &operator=(const Lattice &);
   Lattice(Lattice &&);
   Lattice &operator=(Lattice &&);
   ~Lattice() {
     try {
+      // shared descriptors and those of lattices copied from are not owned
       for (auto &pnode_desc : node_descs_)
+        if (pnode_desc != nullptr && mem_pool_.owns(pnode_desc))
+          pnode_desc->~AbstractNodeDesc();
+      for (auto &pnode_desc : shared_descs_)
         pnode_desc->~AbstractNodeDesc();
     } catch (...) {
     }
@@ -71,86 +84,177 @@ public:
   static constexpr double dt() { return 1.0; }
   static constexpr double c() { return dx() / dt(); }
   static constexpr double cs() { return c() / sqrt(3.0); }
-  static constexpr double cssq() { return cs() * cs(); }
-  inline unsigned num_i() const { return ni_; }
-  inline unsigned num_j() const { return nj_; }
+  static constexpr double cssq() { return velocity_set::cssq; }
+  inline const Coords<VS> &num() const noexcept { return n_; }
+  inline unsigned num_i() const { return n_[0]; }
+  inline unsigned num_j() const { return n_[1]; }
   static constexpr unsigned num_k() { return nk_; }
-  inline const double *pf() const noexcept { return spf_.get(); }
-  inline double f(unsigned i, unsigned j, unsigned k) const noexcept {
-    assert(k < 9 && static_cast<int>(k) >= 0 &&
-           "index `k` out of bounds in Lattice::pc");
-    assert(in_bounds(i, j) && "out of bounds in Lattice::f");
-    return spf_[ni_ * (i * nj_ + j) + k];
+  inline std::size_t num_nodes() const noexcept {
+    return balbm::num_nodes<VS>(n_);
+  }
+  inline std::size_t node_index(const Coords<VS> &x) const noexcept {
+    return balbm::node_index<VS>(n_, x);
   }
+  inline const double *pf() const noexcept { return spf_.get(); }
+  inline double *pf() noexcept { return spf_.get(); }
   inline const double *pftemp() const noexcept { return spftemp_.get(); }
-  inline double ftemp(unsigned i, unsigned j, unsigned k) const noexcept {
-    assert(k < 9 && static_cast<int>(k) >= 0 &&
-           "index `k` out of bounds in Lattice::ftemp");
-    assert(in_bounds(i, j) && "out of bounds in Lattice::ftemp");
-    return spftemp_[ni_ * (i * nj_ + j) + k];
+  inline double *pftemp() noexcept { return spftemp_.get(); }
+  inline const double *pf(const Coords<VS> &x) const {
+    BALBM_ASSERT(in_bounds(x) && "out of bounds in Lattice::pf");
+    return &(spf_[node_index(x) * num_k()]);
   }
-  inline double *pf(const unsigned i, const unsigned j) {
-    assert(in_bounds(i, j) && "out of bounds in Lattice::pf");
-    return &(spf_[(i * nj_ + j) * num_k()]);
+  inline double *pf(const Coords<VS> &x) {
+    BALBM_ASSERT(in_bounds(x) && "out of bounds in Lattice::pf");
+    return &(spf_[node_index(x) * num_k()]);
   }
-  inline double &f(const unsigned i, const unsigned j, const unsigned k) {
-    assert(k < 9 && static_cast<int>(k) >= 0 &&
-           "index `k` out of bounds in Lattice::f");
-    assert(in_bounds(i, j) && "out of bounds in Lattice::f");
-    return *(pf(i, j) + k);
+  inline double *pft(const Coords<VS> &x) {
+    BALBM_ASSERT(in_bounds(x) && "out of bounds in Lattice::pft");
+    return &(spftemp_[node_index(x) * num_k()]);
   }
-  inline double *pft(const unsigned i, const unsigned j) {
-    assert(in_bounds(i, j) && "out of bounds in Lattice::pft");
-    return &(spftemp_[(i * nj_ + j) * num_k()]);
+  inline double f(const Coords<VS> &x, const unsigned k) const noexcept {
+    BALBM_ASSERT(k < nk_ && "index `k` out of bounds in Lattice::f");
+    BALBM_ASSERT(in_bounds(x) && "out of bounds in Lattice::f");
+    return spf_[node_index(x) * num_k() + k];
   }
-  inline double &ft(const unsigned i, const unsigned j, const unsigned k) {
-    assert(k < 9 && static_cast<int>(k) >= 0 &&
-           "index `k` out of bounds in Lattice::ft");
-    assert(in_bounds(i, j) && "out of bounds in Lattice::ft");
-    return *(pft(i, j) + k);
+  inline double &f(const Coords<VS> &x, const unsigned k) {
+    BALBM_ASSERT(k < nk_ && "index `k` out of bounds in Lattice::f");
+    return *(pf(x) + k);
+  }
+  inline double ftemp(const Coords<VS> &x, const unsigned k) const noexcept {
+    BALBM_ASSERT(k < nk_ && "index `k` out of bounds in Lattice::ftemp");
+    BALBM_ASSERT(in_bounds(x) && "out of bounds in Lattice::ftemp");
+    return spftemp_[node_index(x) * num_k() + k];
+  }
+  inline double &ft(const Coords<VS> &x, const unsigned k) {
+    BALBM_ASSERT(k < nk_ && "index `k` out of bounds in Lattice::ft");
+    return *(pft(x) + k);
   }
-  inline const std::vector<AbstractNodeDesc *> &node_descs() const noexcept {
+  inline const std::vector<AbstractNodeDesc<VS> *> &node_descs() const
+      noexcept {
     return node_descs_;
   }
-  inline const AbstractNodeDesc &node_desc(const unsigned i,
-                                           const unsigned j) const {
-    assert(in_bounds(i, j) && "out of bounds in Lattice::node_desc");
-    return *(node_descs_[nj_ * i + j]);
+  inline const AbstractNodeDesc<VS> &node_desc(const Coords<VS> &x) const {
+    BALBM_ASSERT(in_bounds(x) && "out of bounds in Lattice::node_desc");
+    return *(node_descs_[node_index(x)]);
   }
   template <typename Node, typename... Args>
-  inline void set_node_desc(const unsigned i, const unsigned j, Args... args) {
-#ifndef NDEBUG
-    assert(in_bounds(i, j) && "out of bounds in Lattice::set_node_desc");
-    AbstractNodeDesc *pnd = mem_pool_.allocate<Node>(args...);
-    assert(pnd != nullptr);
-    node_descs_[nj_ * i + j] = pnd;
+  inline void set_node_desc(const Coords<VS> &x, Args... args) {
+#ifndef BALBM_NO_ASSERT
+    BALBM_ASSERT(in_bounds(x) && "out of bounds in Lattice::set_node_desc");
+    AbstractNodeDesc<VS> *pnd = mem_pool_.allocate<Node>(args...);
+    BALBM_ASSERT(pnd != nullptr);
+    node_descs_[node_index(x)] = pnd;
 #else
-    node_descs_[nj_ * i + j] = mem_pool_.allocate<Node>(args...);
+    node_descs_[node_index(x)] = mem_pool_.allocate<Node>(args...);
 #endif
   }
-  inline const double *pc(const unsigned k) const noexcept {
-    assert(k <= 9 && static_cast<int>(k) >= 0 &&
-           "index `k` out of bounds in Lattice::pc");
-    return lat_vecs_[k];
+  // a shared descriptor is constructed once and may describe any number of
+  // nodes, which saves memory and construction time on large geometries
+  template <typename Node, typename... Args>
+  AbstractNodeDesc<VS> *make_shared_node_desc(Args... args) {
+    Node *pnd = shared_pool_.allocate<Node>(args...);
+    if (pnd == nullptr) {
+      std::ostringstream oss;
+      oss << "Lattice can not hold more than " << max_shared_node_descs
+          << " shared node descriptors.";
+      throw std::length_error(oss.str());
+    }
+    shared_descs_.push_back(pnd);
+    return pnd;
+  }
+  inline void set_shared_node_desc(const Coords<VS> &x,
+                                   AbstractNodeDesc<VS> *pnd) {
+    BALBM_ASSERT(in_bounds(x) &&
+                 "out of bounds in Lattice::set_shared_node_desc");
+    BALBM_ASSERT(shared_pool_.owns(pnd));
+    node_descs_[node_index(x)] = pnd;
   }
   inline double c(const unsigned k, const unsigned c) const noexcept {
-    assert(k <= 9 && static_cast<int>(k) >= 0 &&
-           "index `k` out of bounds in Lattice::c");
-    assert(c <= 2 && static_cast<int>(c) >= 0 &&
-           "index `c` out of bounds in Lattice::c");
-    return *(pc(k) + c);
+    BALBM_ASSERT(k < nk_ && "index `k` out of bounds in Lattice::c");
+    BALBM_ASSERT(c < VS::nd && "index `c` out of bounds in Lattice::c");
+    return velocity_set::c[k][c];
   }
   inline double w(const unsigned k) const noexcept {
-    assert(k <= 9 && static_cast<int>(k) >= 0 &&
-           "index `k` out of bounds in Lattice::w");
-    return w_[k];
+    BALBM_ASSERT(k < nk_ && "index `k` out of bounds in Lattice::w");
+    return velocity_set::w[k];
+  }
+  static constexpr unsigned opp(const unsigned k) noexcept {
+    return velocity_set::opp[k];
+  }
+
+  // (i, j) addressing of two dimensional lattices
+  inline const double *pf(const unsigned i, const unsigned j) const {
+    return pf(coords<VS>(i, j));
+  }
+  inline double *pf(const unsigned i, const unsigned j) {
+    return pf(coords<VS>(i, j));
+  }
+  inline double *pft(const unsigned i, const unsigned j) {
+    return pft(coords<VS>(i, j));
+  }
+  inline double f(unsigned i, unsigned j, unsigned k) const noexcept {
+    return f(coords<VS>(i, j), k);
+  }
+  inline double &f(const unsigned i, const unsigned j, const unsigned k) {
+    return f(coords<VS>(i, j), k);
+  }
+  inline double ftemp(unsigned i, unsigned j, unsigned k) const noexcept {
+    return ftemp(coords<VS>(i, j), k);
+  }
+  inline double &ft(const unsigned i, const unsigned j, const unsigned k) {
+    return ft(coords<VS>(i, j), k);
+  }
+  inline const AbstractNodeDesc<VS> &node_desc(const unsigned i,
+                                               const unsigned j) const {
+    return node_desc(coords<VS>(i, j));
+  }
+  template <typename Node, typename... Args>
+  inline void set_node_desc(const unsigned i, const unsigned j, Args... args) {
+    set_node_desc<Node>(coords<VS>(i, j), args...);
+  }
+  inline void set_shared_node_desc(const unsigned i, const unsigned j,
+                                   AbstractNodeDesc<VS> *pnd) {
+    set_shared_node_desc(coords<VS>(i, j), pnd);
+  }
+
+  // neighbors
+  inline unsigned i_next(const unsigned i, const unsigned k) const noexcept {
+    return i + velocity_set::c[k][0];
+  }
+  inline unsigned j_next(const unsigned j, const unsigned k) const noexcept {
+    return j + velocity_set::c[k][1];
+  }
+  inline unsigned i_next_periodic(const unsigned i, const unsigned k) const
+      noexcept {
+    return wrap_(i_next(i, k), n_[0]);
+  }
+  inline unsigned j_next_periodic(const unsigned j, const unsigned k) const
+      noexcept {
+    return wrap_(j_next(j, k), n_[1]);
+  }
+  inline Coords<VS> next(const Coords<VS> &x, const unsigned k) const
+      noexcept {
+    Coords<VS> result;
+    for (unsigned d = 0; d < VS::nd; ++d)
+      result[d] = x[d] + velocity_set::c[k][d];
+    return result;
+  }
+  inline Coords<VS> next_periodic(const Coords<VS> &x, const unsigned k) const
+      noexcept {
+    Coords<VS> result;
+    for (unsigned d = 0; d < VS::nd; ++d)
+      result[d] = wrap_(x[d] + velocity_set::c[k][d], n_[d]);
+    return result;
   }
 
   // mutators
   // stream
+  inline void stream(const Coords<VS> &x) {
+    BALBM_ASSERT(in_bounds(x) && "out of bounds in Lattice::stream");
+    node_desc(x).stream(*this, x);
+  }
   inline void stream(const unsigned i, const unsigned j) {
-    assert(in_bounds(i, j) && "out of bounds in Lattice::stream");
-    node_desc(i, j).stream(*this, i, j);
+    stream(coords<VS>(i, j));
   }
   void stream(const unsigned bi, const unsigned ei, const unsigned bj,
               const unsigned ej) {
@@ -158,57 +262,218 @@ public:
       for (unsigned j = bj; j <= ej; ++j)
         stream(i, j);
   }
-  inline void stream() { stream(0, ni_ - 1, 0, nj_ - 1); }
-  void stream(const std::vector<std::array<unsigned, 4>> &);
+  inline void stream() {
+    for_each_node_([this](const Coords<VS> &x) { stream(x); });
+  }
+  void stream(const std::vector<std::array<unsigned, 4>> &bounds) {
+    for (const auto &row : bounds)
+      stream(row[0], row[1], row[2], row[3]);
+  }
 
   // collide
-  inline void collide_and_bound(IncompFlowMultiscaleMap &mmap,
-                                const IncompFlowCollisionManager &cman,
+  inline void collide_and_bound(IncompFlowMultiscaleMap<VS> &mmap,
+                                const IncompFlowCollisionManager<VS> &cman,
+                                const Coords<VS> &x) {
+    BALBM_ASSERT(in_bounds(x) &&
+                 "out of bounds in Lattice::collide_and_bound");
+    node_desc(x).collide_and_bound(*this, mmap, cman, x);
+  }
+  inline void collide_and_bound(IncompFlowMultiscaleMap<VS> &mmap,
+                                const IncompFlowCollisionManager<VS> &cman,
                                 const unsigned i, const unsigned j) {
-    assert(in_bounds(i, j) && "out of bounds in Lattice::collide_and_bound");
-    node_desc(i, j).collide_and_bound(*this, mmap, cman, i, j);
+    collide_and_bound(mmap, cman, coords<VS>(i, j));
   }
-  void collide_and_bound(IncompFlowMultiscaleMap &mmap,
-                         const IncompFlowCollisionManager &cman,
+  void collide_and_bound(IncompFlowMultiscaleMap<VS> &mmap,
+                         const IncompFlowCollisionManager<VS> &cman,
                          const unsigned bi, const unsigned ei,
                          const unsigned bj, const unsigned ej) {
     for (unsigned i = bi; i <= ei; ++i)
       for (unsigned j = bj; j <= ej; ++j)
         collide_and_bound(mmap, cman, i, j);
   }
-  inline void collide_and_bound(IncompFlowMultiscaleMap &mmap,
-                                const IncompFlowCollisionManager &cman) {
-    collide_and_bound(mmap, cman, 0, ni_ - 1, 0, nj_ - 1);
+  inline void collide_and_bound(IncompFlowMultiscaleMap<VS> &mmap,
+                                const IncompFlowCollisionManager<VS> &cman) {
+    for_each_node_([&](const Coords<VS> &x) {
+      collide_and_bound(mmap, cman, x);
+    });
+  }
+  void collide_and_bound(IncompFlowMultiscaleMap<VS> &mmap,
+                         const IncompFlowCollisionManager<VS> &cman,
+                         const std::vector<std::array<unsigned, 4>> &bounds) {
+    for (const auto &row : bounds)
+      collide_and_bound(mmap, cman, row[0], row[1], row[2], row[3]);
   }
-  void collide_and_bound(IncompFlowMultiscaleMap &,
-                         const IncompFlowCollisionManager &,
-                         const std::vector<std::array<unsigned, 4>> &);
 
   inline void swap_f_ptrs() { spf_.swap(spftemp_); }
 
+  // heap memory held, in bytes
+  inline std::size_t population_bytes() const noexcept {
+    return ((spf_ != nullptr) + (spftemp_ != nullptr)) * num_nodes() *
+           num_k() * sizeof(double);
+  }
+  inline std::size_t node_desc_bytes() const noexcept {
+    return (node_descs_.capacity() + shared_descs_.capacity()) *
+           sizeof(AbstractNodeDesc<VS> *);
+  }
+  inline std::size_t node_pool_bytes() const noexcept {
+    return mem_pool_.capacity() + shared_pool_.capacity();
+  }
+
   // bounds checking
+  inline bool in_bounds(const Coords<VS> &x) const noexcept {
+    return balbm::in_bounds<VS>(n_, x);
+  }
   inline bool in_bounds(const int i, const int j) const noexcept {
-    return (i < static_cast<int>(ni_) && i >= 0 && j < static_cast<int>(nj_) &&
-            j >= 0);
+    return (i < static_cast<int>(num_i()) && i >= 0 &&
+            j < static_cast<int>(num_j()) && j >= 0);
+  }
+  bool check_bounds(const Coords<VS> &) const throw(std::out_of_range);
+  inline bool check_bounds(const unsigned i, const unsigned j) const
+      throw(std::out_of_range) {
+    return check_bounds(coords<VS>(i, j));
   }
-  bool check_bounds(const unsigned, const unsigned) const
-      throw(std::out_of_range);
 
 private:
-  static constexpr unsigned nk_ = 9;
-  static const double lat_vecs_[nk_][2];
-  static const double w_[nk_];
-  unsigned ni_;
-  unsigned nj_;
+  static constexpr unsigned nk_ = velocity_set::nk;
+  Coords<VS> n_;
   std::unique_ptr<double[]> spf_;
   std::unique_ptr<double[]> spftemp_;
-  std::vector<AbstractNodeDesc *> node_descs_;
+  std::vector<AbstractNodeDesc<VS> *> node_descs_;
   SimpleMemPool mem_pool_;
+  SimpleMemPool shared_pool_{max_node_desc_size<VS>() * max_shared_node_descs};
+  std::vector<AbstractNodeDesc<VS> *> shared_descs_;
 
   void init_f_(const double);
+  template <typename F> void for_each_node_(F &&);
+  static inline unsigned wrap_(const unsigned idx, const unsigned n) noexcept {
+    return (idx == n) ? 0 : ((idx == static_cast<unsigned>(-1)) ? n - 1 : idx);
+  }
 };
 
-} // namespace d2q9
+//! Copy constructor for  lattice
+//!
+//! \param lat Lattice to copy
+//! \return Copied lattice
+template <typename VS>
+Lattice<VS>::Lattice(const Lattice &lat)
+    : n_(lat.n_), spf_(new double[lat.num_nodes() * num_k()]),
+      spftemp_(new double[lat.num_nodes() * num_k()]),
+      node_descs_(lat.node_descs()) {
+  std::copy(&lat.spf_[0], &lat.spf_[num_nodes() * num_k() - 1], &spf_[0]);
+  std::copy(&lat.spftemp_[0], &lat.spftemp_[num_nodes() * num_k() - 1],
+            &spftemp_[0]);
+}
+
+//! Assignment for  lattice
+//!
+//! \param lat Lattice to assign
+//! \return Copied lattice
+template <typename VS> Lattice<VS> &Lattice<VS>::operator=(const Lattice &lat) {
+  if (this == &lat)
+    return *this;
+
+  if (lat.num_nodes() > num_nodes()) {
+    // TODO: consider writing an iterator for the lattice class
+    spf_.reset(new double[lat.num_nodes() * num_k()]);
+    spftemp_.reset(new double[lat.num_nodes() * num_k()]);
+  }
+
+  n_ = lat.n_;
+  std::copy(&lat.spf_[0], &lat.spf_[num_nodes() * num_k() - 1], &spf_[0]);
+  std::copy(&lat.spftemp_[0], &lat.spftemp_[num_nodes() * num_k() - 1],
+            &spftemp_[0]);
+
+  return *this;
+}
+
+//! Move constructor for  lattice
+//!
+//! \param lat Lattice to be moved
+//! \return Moved lattice
+template <typename VS>
+Lattice<VS>::Lattice(Lattice &&lat)
+    : n_(lat.n_), spf_(std::move(lat.spf_)),
+      spftemp_(std::move(lat.spftemp_)),
+      node_descs_(std::move(lat.node_descs_)),
+      mem_pool_(std::move(lat.mem_pool_)),
+      shared_pool_(std::move(lat.shared_pool_)),
+      shared_descs_(std::move(lat.shared_descs_)) {
+  lat.spf_.reset(nullptr);
+  lat.spftemp_.reset(nullptr);
+}
+
+//! Move assignment operator
+//!
+//! \param Lattice to be move assigned
+//! \return Moved lattice
+template <typename VS> Lattice<VS> &Lattice<VS>::operator=(Lattice &&lat) {
+  n_ = lat.n_;
+  spf_ = std::move(lat.spf_);
+  spftemp_ = std::move(lat.spftemp_);
+  node_descs_ = std::move(lat.node_descs_);
+  mem_pool_ = std::move(lat.mem_pool_);
+  shared_pool_ = std::move(lat.shared_pool_);
+  shared_descs_ = std::move(lat.shared_descs_);
+
+  lat.spf_.reset(nullptr);
+  lat.spftemp_.reset(nullptr);
+
+  return *this;
+}
+
+//! Perform bounds checking
+//!
+//! \param x Coordinates of the node
+//! \return true if in bounds, false if out of bounds
+//! \throw out_of_range
+template <typename VS>
+bool Lattice<VS>::check_bounds(const Coords<VS> &x) const
+    throw(std::out_of_range) {
+  bool is_in_bounds = in_bounds(x);
+  if (!is_in_bounds) {
+    std::ostringstream oss;
+    oss << "Ill-defined boundaries. Particles streamed out of bounds to "
+        << "node (";
+    for (unsigned d = 0; d < VS::nd; ++d)
+      oss << ((d == 0) ? "" : " ,") << x[d];
+    oss << "). Check boundary conditions.";
+    throw std::out_of_range(oss.str());
+  }
+
+  return is_in_bounds;
+}
+
+//! Initialize domain to equilibrium based on a reference density
+//!
+//! \param rho Reference density
+template <typename VS> void Lattice<VS>::init_f_(const double rho) {
+  const std::size_t n = num_nodes();
+
+  // should this loop be multithreaded/parallelized?
+  for (std::size_t idx = 0; idx < n; ++idx)
+    for_each_k<velocity_set>([&](const unsigned k) {
+      spf_[idx * nk_ + k] = velocity_set::w[k] * rho;
+      spftemp_[idx * nk_ + k] = velocity_set::w[k] * rho;
+    });
+}
+
+//! Call a functor with the coordinates of every node in lattice order
+//!
+//! \param f Functor taking the coordinates of a node
+template <typename VS>
+template <typename F>
+void Lattice<VS>::for_each_node_(F &&f) {
+  const std::size_t n = num_nodes();
+  Coords<VS> x{};
+  for (std::size_t idx = 0; idx < n; ++idx) {
+    f(x);
+    for (unsigned d = VS::nd; d-- > 0;) {
+      if (++x[d] < n_[d])
+        break;
+      x[d] = 0;
+    }
+  }
+}
 
 } // namespace balbm
 
@@ -0,0 +1,115 @@
+#ifndef LATTICE_FWD_HH
+#define LATTICE_FWD_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// The lattice, its multiscale maps, collision manager and node descriptors
+// are templated on a velocity set descriptor. The D2Q9 and D3Q19 instances
+// are named in namespaces d2q9 and d3q19, e.g. d2q9::Lattice is
+// Lattice<D2Q9>.
+
+#include "balbm_config.hh"
+#include "velocity_set.hh"
+#include <array>
+#include <cstddef>
+
+namespace balbm {
+
+//! Coordinates of a node, one index per dimension of a velocity set
+template <typename VS> using Coords = std::array<unsigned, VS::nd>;
+
+//! Coordinates of a node of a two dimensional lattice
+//!
+//! \param i Index in the x-direction
+//! \param j Index in the y-direction
+//! \return Coordinates
+template <typename VS>
+inline Coords<VS> coords(const unsigned i, const unsigned j) noexcept {
+  static_assert(VS::nd == 2, "(i, j) addresses nodes of 2D lattices only");
+  return Coords<VS>{{i, j}};
+}
+
+//! Number of nodes of a lattice
+//!
+//! \param n Number of nodes in each direction
+//! \return Product of the number of nodes in each direction
+template <typename VS>
+inline std::size_t num_nodes(const Coords<VS> &n) noexcept {
+  std::size_t result = 1;
+  for (unsigned d = 0; d < VS::nd; ++d)
+    result *= n[d];
+  return result;
+}
+
+//! Index of a node in lattice order, the last direction varying fastest
+//!
+//! \param n Number of nodes in each direction
+//! \param x Coordinates of the node
+//! \return Index of the node, e.g. i * nj + j in 2D
+template <typename VS>
+inline std::size_t node_index(const Coords<VS> &n,
+                              const Coords<VS> &x) noexcept {
+  std::size_t result = x[0];
+  for (unsigned d = 1; d < VS::nd; ++d)
+    result = result * n[d] + x[d];
+  return result;
+}
+
+//! Whether a node is inside a lattice
+//!
+//! \param n Number of nodes in each direction
+//! \param x Coordinates of the node
+//! \return Whether every coordinate is less than the number of nodes
+template <typename VS>
+inline bool in_bounds(const Coords<VS> &n, const Coords<VS> &x) noexcept {
+  for (unsigned d = 0; d < VS::nd; ++d)
+    if (x[d] >= n[d])
+      return false;
+  return true;
+}
+
+template <typename VS> class Lattice;
+template <typename VS> class AbstractMultiscaleMap;
+template <typename VS> class IncompFlowMultiscaleMap;
+template <typename VS> class IncompFlowCollisionManager;
+template <typename VS> class AbstractNodeDesc;
+
+namespace d2q9 {
+
+using Coords = balbm::Coords<D2Q9>;
+using Lattice = balbm::Lattice<D2Q9>;
+using AbstractMultiscaleMap = balbm::AbstractMultiscaleMap<D2Q9>;
+using IncompFlowMultiscaleMap = balbm::IncompFlowMultiscaleMap<D2Q9>;
+using IncompFlowCollisionManager = balbm::IncompFlowCollisionManager<D2Q9>;
+using AbstractNodeDesc = balbm::AbstractNodeDesc<D2Q9>;
+
+} // namespace d2q9
+
+namespace d3q19 {
+
+using Coords = balbm::Coords<D3Q19>;
+using Lattice = balbm::Lattice<D3Q19>;
+using AbstractMultiscaleMap = balbm::AbstractMultiscaleMap<D3Q19>;
+using IncompFlowMultiscaleMap = balbm::IncompFlowMultiscaleMap<D3Q19>;
+using IncompFlowCollisionManager = balbm::IncompFlowCollisionManager<D3Q19>;
+using AbstractNodeDesc = balbm::AbstractNodeDesc<D3Q19>;
+
+} // namespace d3q19
+
+} // namespace balbm
+
+#endif // LATTICE_FWD_HH
@@ -0,0 +1,93 @@
+#ifndef MEMORY_BUDGET_HH
+#define MEMORY_BUDGET_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Memory is planned from the same sizes the constructors allocate, so a plan
+// of a configuration matches the footprint accounted from a simulation built
+// with it. Only heap storage that grows with the domain is counted; objects
+// of fixed size, the stacks of threads and the allocator's overhead are not.
+
+#include "balbm_config.hh"
+#include "output.hh"
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+namespace balbm {
+
+namespace d2q9 {
+
+class IncompFlowSimulation;
+
+//! Subsystems holding memory
+enum MemoryComponent : unsigned {
+  MEMORY_POPULATIONS,     //!< particle distributions and their copy
+  MEMORY_NODE_DESCS,      //!< node descriptor pointers
+  MEMORY_NODE_POOL,       //!< pools node descriptors are constructed in
+  MEMORY_MULTISCALE_MAP,  //!< density, velocity and collision frequency
+  MEMORY_SOLID_FRACTIONS, //!< gray lattice solid fractions
+  MEMORY_STATISTICS,      //!< running flow statistics
+  MEMORY_OUTPUT,          //!< staging frames of an output pipeline
+  NUM_MEMORY_COMPONENTS
+};
+
+const char *memory_component_name(const MemoryComponent);
+
+//! \struct MemoryConfig
+//!
+//! \brief Domain and the optional subsystems of a simulation
+//!
+//! No output is planned while output_fields is 0.
+struct MemoryConfig {
+  MemoryConfig(const unsigned ni = 0, const unsigned nj = 0)
+      : ni(ni), nj(nj), solid_fractions(false), statistics(false),
+        output_fields(0), output_buffers(2) {}
+  unsigned ni;
+  unsigned nj;
+  bool solid_fractions;
+  bool statistics;
+  unsigned output_fields; //!< OutputField bit flags
+  unsigned output_buffers;
+  OutputRegion output_region;
+};
+
+//! \struct MemoryFootprint
+//!
+//! \brief Bytes held by each subsystem
+struct MemoryFootprint {
+  std::size_t bytes[NUM_MEMORY_COMPONENTS];
+  std::size_t total() const noexcept;
+};
+
+MemoryFootprint plan_memory(const MemoryConfig &);
+
+MemoryFootprint memory_footprint(const IncompFlowSimulation &,
+                                 const AsyncOutputPipeline * = nullptr);
+
+MemoryConfig largest_domain(const MemoryConfig &, const std::size_t);
+
+void write_memory_report(std::ostream &, const MemoryFootprint &,
+                         const MemoryFootprint * = nullptr);
+
+std::size_t parse_bytes(const std::string &);
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // MEMORY_BUDGET_HH
@@ -0,0 +1,146 @@
+#ifndef METRICS_HH
+#define METRICS_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// The solver publishes a sample of its progress from a callback into a
+// seqlock of atomic words: the sequence is odd while a sample is written and
+// readers retry when a write overlapped their read. Publishing never waits
+// for a reader, so a slow or stuck scraper cannot hold up the time loop.
+// A metrics server answers HTTP requests from its own thread with the
+// latest sample in the Prometheus text format, e.g.
+//
+//   curl http://127.0.0.1:9100/metrics
+//   curl --unix-socket /tmp/balbm.sock http://localhost/metrics
+
+#include "balbm_config.hh"
+#include "callback.hh"
+#include "instrument.hh"
+#include "memory_budget.hh"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace balbm {
+
+namespace d2q9 {
+
+class IncompFlowSimulation;
+
+//! \struct MetricsSample
+//!
+//! \brief Progress of a simulation at one time step; NaN where unknown
+struct MetricsSample {
+  double samples;        //!< number of samples published so far
+  double step;           //!< time step
+  double target_step;    //!< last time step of the run, 0 if unknown
+  double nodes;          //!< number of lattice nodes
+  double uptime_seconds; //!< wall time since the publisher was created
+  double mlups;          //!< lattice updates per second since the last sample
+  double eta_seconds;    //!< remaining wall time at the current rate
+  double residual;       //!< relative change of velocity since last sample
+  double resident_bytes; //!< resident memory of the process
+  double phase_seconds[NUM_PHASES];
+  double phase_calls[NUM_PHASES];
+  double memory_bytes[NUM_MEMORY_COMPONENTS]; //!< held by the simulation
+};
+
+//! \class MetricsPublisher
+//!
+//! \brief Publishes samples of a simulation for other threads to read
+class MetricsPublisher {
+public:
+  MetricsPublisher(const unsigned = 0);
+  MetricsPublisher(const MetricsPublisher &) = delete;
+  MetricsPublisher &operator=(const MetricsPublisher &) = delete;
+  inline void set_target_step(const unsigned target_step) noexcept {
+    target_step_ = target_step;
+  }
+  void publish(const IncompFlowSimulation &, const unsigned);
+  MetricsSample sample() const;
+  void write_prometheus(std::ostream &) const;
+
+private:
+  static constexpr std::size_t nwords =
+      (sizeof(MetricsSample) + sizeof(std::uint64_t) - 1) /
+      sizeof(std::uint64_t);
+
+  std::atomic<std::uint64_t> sequence_;
+  std::atomic<std::uint64_t> words_[nwords];
+
+  // state of the publishing thread
+  unsigned target_step_;
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point last_time_;
+  unsigned last_step_;
+  double samples_;
+  std::vector<double> last_u_;
+};
+
+//! \class MetricsServer
+//!
+//! \brief Serves the samples of a publisher over HTTP from a background
+//!        thread, on a localhost TCP port or a Unix domain socket
+class MetricsServer {
+public:
+  MetricsServer(const MetricsPublisher &, const std::string &);
+  MetricsServer(const MetricsServer &) = delete;
+  MetricsServer &operator=(const MetricsServer &) = delete;
+  ~MetricsServer();
+  inline unsigned port() const noexcept { return port_; }
+  inline const std::string &socket_path() const noexcept { return path_; }
+  inline unsigned requests() const noexcept {
+    return requests_.load(std::memory_order_relaxed);
+  }
+
+private:
+  void serve_();
+  void respond_(const int) const;
+  const MetricsPublisher *ppublisher_;
+  std::string path_;
+  unsigned port_;
+  int listen_fd_;
+  int wake_fds_[2];
+  std::atomic<unsigned> requests_;
+  std::thread thread_;
+};
+
+//! \class MetricsCallback
+//!
+//! \brief Publishes metrics of an incompressible flow simulation every
+//!        `stride` time steps
+class MetricsCallback : public AbstractSimCallback {
+public:
+  ~MetricsCallback() {}
+  MetricsCallback(MetricsPublisher &publisher, const unsigned stride)
+      : ppublisher_(&publisher), stride_(stride) {}
+
+private:
+  MetricsPublisher *ppublisher_;
+  unsigned stride_;
+  void f_(AbstractSimulation &) const;
+};
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // METRICS_HH
@@ -18,12 +18,13 @@
 // this program.  If not, see <http://www.gnu.org/licenses/>
 
 #include "lattice.hh"
+#include <algorithm>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
 
 namespace balbm {
 
-namespace d2q9 {
-
 //! Convert visocisty to relaxation time
 //!
 //! \param mu Kinematic viscosity
@@ -49,28 +50,46 @@ inline double mu_to_omega(const double mu, const double cssq, const double dt) {
 //! \brief Base class for map from mesoscale to macroscale
 //!
 //! Maps particle distributions to macroscopic variables of interest
-class AbstractMultiscaleMap {
+template <typename VS> class AbstractMultiscaleMap {
 public:
+  AbstractMultiscaleMap(const Coords<VS> &n)
+      : n_(n), sprho_(new double[balbm::num_nodes<VS>(n)]) {}
   AbstractMultiscaleMap(const unsigned ni, const unsigned nj)
-      : ni_(ni), nj_(nj), sprho_(new double[ni * nj]) {}
+      : AbstractMultiscaleMap(coords<VS>(ni, nj)) {}
   virtual ~AbstractMultiscaleMap() = 0;
-  inline double num_i() const noexcept { return ni_; }
-  inline double num_j() const noexcept { return nj_; }
+  inline const Coords<VS> &num() const noexcept { return n_; }
+  inline double num_i() const noexcept { return n_[0]; }
+  inline double num_j() const noexcept { return n_[1]; }
+  inline std::size_t num_nodes() const noexcept {
+    return balbm::num_nodes<VS>(n_);
+  }
+  inline std::size_t node_index(const Coords<VS> &x) const noexcept {
+    return balbm::node_index<VS>(n_, x);
+  }
+  inline double rho(const Coords<VS> &x) const {
+    return sprho_[node_index(x)];
+  }
   inline double rho(const unsigned i, const unsigned j) const {
-    return sprho_[i * num_j() + j];
+    return rho(coords<VS>(i, j));
+  }
+  inline const double *prho() const noexcept { return sprho_.get(); }
+  inline double *prho() noexcept { return sprho_.get(); }
+  inline void map_to_macro(const Lattice<VS> &lat) { map_to_macro_(lat); }
+  inline void map_to_macro(const Lattice<VS> &lat, const Coords<VS> &x) {
+    map_to_macro_(lat, x);
+  }
+  inline void map_to_macro(const Lattice<VS> &lat, const unsigned i,
+                           const unsigned j) {
+    map_to_macro_(lat, coords<VS>(i, j));
   }
-  inline void map_to_macro(const Lattice &lat) { map_to_macro_(lat); }
 
 protected:
-  inline double &rho_(const unsigned i, const unsigned j) {
-    return sprho_[i * num_j() + j];
-  }
-  virtual void map_to_macro_(const Lattice &);
-  virtual void map_to_macro_(const Lattice &, const unsigned, const unsigned);
+  inline double &rho_(const Coords<VS> &x) { return sprho_[node_index(x)]; }
+  virtual void map_to_macro_(const Lattice<VS> &);
+  virtual void map_to_macro_(const Lattice<VS> &, const Coords<VS> &);
 
 private:
-  unsigned ni_;
-  unsigned nj_;
+  Coords<VS> n_;
   std::unique_ptr<double[]> sprho_;
 };
 
@@ -79,10 +98,12 @@ private:
 //! \brief Maps particle distributions to local densities
 //!
 //! Concrete class for density-based multiscale map
-class DensityMultiscaleMap : public AbstractMultiscaleMap {
+template <typename VS>
+class DensityMultiscaleMap : public AbstractMultiscaleMap<VS> {
 public:
+  DensityMultiscaleMap(const Coords<VS> &n) : AbstractMultiscaleMap<VS>(n) {}
   DensityMultiscaleMap(const unsigned ni, const unsigned nj)
-      : AbstractMultiscaleMap(ni, nj) {}
+      : AbstractMultiscaleMap<VS>(ni, nj) {}
   ~DensityMultiscaleMap() {}
 };
 
@@ -91,41 +112,212 @@ public:
 //! \brief Maps particle distributions to local macroscopic flow variables
 //!
 //! Concrete class for incompressible flow multiscale map. Maps particle
-//! distributions to local macroscopic density, flow, and collision frequency
-class IncompFlowMultiscaleMap : public AbstractMultiscaleMap {
+//! distributions to local macroscopic density, flow, and collision frequency.
+//! Optionally carries a solid fraction per node for gray lattice (partial
+//! bounce-back) porous media, stored in single precision and only allocated
+//! once a nonzero solid fraction is set.
+template <typename VS>
+class IncompFlowMultiscaleMap : public AbstractMultiscaleMap<VS> {
 public:
-  IncompFlowMultiscaleMap(const unsigned ni, const unsigned nj,
-                          const double omega)
-      : AbstractMultiscaleMap(ni, nj), spu_(new double[ni * nj * 2]),
-        spomega_(new double[ni * nj]) {
+  using AbstractMultiscaleMap<VS>::num;
+  using AbstractMultiscaleMap<VS>::num_nodes;
+  using AbstractMultiscaleMap<VS>::node_index;
+
+  IncompFlowMultiscaleMap(const Coords<VS> &n, const double omega)
+      : AbstractMultiscaleMap<VS>(n),
+        spu_(new double[balbm::num_nodes<VS>(n) * nd_]),
+        spomega_(new double[balbm::num_nodes<VS>(n)]) {
     init_(omega);
   }
+  IncompFlowMultiscaleMap(const unsigned ni, const unsigned nj,
+                          const double omega)
+      : IncompFlowMultiscaleMap(coords<VS>(ni, nj), omega) {}
   ~IncompFlowMultiscaleMap() {}
+  inline double u(const Coords<VS> &x, const unsigned c) const {
+    return spu_[nd_ * node_index(x) + c];
+  }
+  inline const double *pu(const Coords<VS> &x) const {
+    return &spu_[nd_ * node_index(x)];
+  }
+  inline double &omega(const Coords<VS> &x) {
+    return spomega_[node_index(x)];
+  }
+  inline double omega(const Coords<VS> &x) const {
+    return spomega_[node_index(x)];
+  }
   inline double u(const unsigned i, const unsigned j, const unsigned c) const {
-    return spu_[2 * (i * num_j() + j) + c];
+    return u(coords<VS>(i, j), c);
   }
   inline const double *pu(const unsigned i, const unsigned j) const {
-    return &spu_[2 * (i * num_j() + j)];
+    return pu(coords<VS>(i, j));
   }
   inline double &omega(const unsigned i, const unsigned j) {
-    return spomega_[i * num_j() + j];
+    return omega(coords<VS>(i, j));
   }
   inline double omega(const unsigned i, const unsigned j) const {
-    return spomega_[i * num_j() + j];
+    return omega(coords<VS>(i, j));
+  }
+  inline const double *pu() const noexcept { return spu_.get(); }
+  inline double *pu() noexcept { return spu_.get(); }
+  inline const double *pomega() const noexcept { return spomega_.get(); }
+  inline double *pomega() noexcept { return spomega_.get(); }
+  inline const float *pns() const noexcept { return spns_.get(); }
+  float *pns();
+  inline bool has_solid_fractions() const noexcept { return spns_ != nullptr; }
+  inline double solid_fraction(const Coords<VS> &x) const {
+    return (spns_ != nullptr) ? spns_[node_index(x)] : 0.0;
+  }
+  inline double solid_fraction(const unsigned i, const unsigned j) const {
+    return solid_fraction(coords<VS>(i, j));
+  }
+  void set_solid_fraction(const Coords<VS> &, const double);
+  inline void set_solid_fraction(const unsigned i, const unsigned j,
+                                 const double ns) {
+    set_solid_fraction(coords<VS>(i, j), ns);
   }
 
 private:
-  inline double &u_(const unsigned i, const unsigned j, const unsigned c) {
-    return spu_[2 * (i * num_j() + j) + c];
+  static constexpr unsigned nd_ = VS::nd;
+  inline double &u_(const Coords<VS> &x, const unsigned c) {
+    return spu_[nd_ * node_index(x) + c];
   }
-  void map_to_macro_(const Lattice &, const unsigned, const unsigned);
+  void map_to_macro_(const Lattice<VS> &, const Coords<VS> &);
   void init_(const double);
   std::unique_ptr<double[]> spu_;
   std::unique_ptr<double[]> spomega_;
+  std::unique_ptr<float[]> spns_;
 };
 
+//! Virtual destructor for base class
+template <typename VS> AbstractMultiscaleMap<VS>::~AbstractMultiscaleMap() {}
+
+//! Map particle distribution functions to density
+//!
+//! \param lat Lattice
+template <typename VS>
+void AbstractMultiscaleMap<VS>::map_to_macro_(const Lattice<VS> &lat) {
+  const std::size_t n = num_nodes();
+  Coords<VS> x{};
+  for (std::size_t idx = 0; idx < n; ++idx) {
+    map_to_macro_(lat, x);
+    for (unsigned d = VS::nd; d-- > 0;) {
+      if (++x[d] < n_[d])
+        break;
+      x[d] = 0;
+    }
+  }
+}
+
+//! Map particle distribution functions to density
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS>
+void AbstractMultiscaleMap<VS>::map_to_macro_(const Lattice<VS> &lat,
+                                              const Coords<VS> &x) {
+  const double *f = lat.pf(x);
+  double rho = 0.;
+  for_each_k<VS>([&](const unsigned k) { rho += f[k]; });
+  rho_(x) = rho;
+}
+
+//! Map particle distribution functions to incompressible flow macroscopic
+//! variables
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS>
+void IncompFlowMultiscaleMap<VS>::map_to_macro_(const Lattice<VS> &lat,
+                                                const Coords<VS> &x) {
+  const double *f = lat.pf(x);
+  double rho = 0.;
+  double u[nd_] = {};
+  for_each_k<VS>([&](const unsigned k) {
+    rho += f[k];
+    for (unsigned d = 0; d < nd_; ++d)
+      u[d] += f[k] * VS::c[k][d];
+  });
+  this->rho_(x) = rho;
+  for (unsigned d = 0; d < nd_; ++d)
+    u_(x, d) = u[d] / rho;
+}
+
+//! Set the solid fraction of a node for partial bounce-back
+//!
+//! \param x Coordinates of the node
+//! \param ns Solid fraction, 0 for pure fluid and 1 for full bounce-back
+//! \throw out_of_range
+template <typename VS>
+void IncompFlowMultiscaleMap<VS>::set_solid_fraction(const Coords<VS> &x,
+                                                     const double ns) {
+  const bool in_lattice = balbm::in_bounds<VS>(num(), x);
+  if (!in_lattice || ns < 0.0 || ns > 1.0) {
+    std::ostringstream oss;
+    if (in_lattice)
+      oss << "Solid fraction " << ns << " at node (";
+    else
+      oss << "Node (";
+    for (unsigned d = 0; d < nd_; ++d)
+      oss << ((d == 0) ? "" : ", ") << x[d];
+    if (in_lattice) {
+      oss << ") is not in [0, 1].";
+    } else {
+      oss << ") is not in the ";
+      for (unsigned d = 0; d < nd_; ++d)
+        oss << ((d == 0) ? "" : " x ") << num()[d];
+      oss << " lattice.";
+    }
+    throw std::out_of_range(oss.str());
+  }
+
+  if (spns_ == nullptr && ns == 0.0)
+    return;
+
+  pns();
+  spns_[node_index(x)] = static_cast<float>(ns);
+}
+
+//! Solid fractions of all nodes, allocated and zeroed on first access
+//!
+//! \return Pointer to the solid fraction of the first node
+template <typename VS> float *IncompFlowMultiscaleMap<VS>::pns() {
+  if (spns_ == nullptr) {
+    const std::size_t n = num_nodes();
+    spns_.reset(new float[n]);
+    std::fill(&spns_[0], &spns_[0] + n, 0.0f);
+  }
+
+  return spns_.get();
+}
+
+//! Initialize values in the multiscale map
+//!
+//! \param omega Initial collision frequency
+template <typename VS>
+void IncompFlowMultiscaleMap<VS>::init_(const double omega) {
+  const std::size_t n = num_nodes();
+
+  std::fill(this->prho(), this->prho() + n, 1.0);
+  std::fill(&spu_[0], &spu_[0] + n * nd_, 0.0);
+  std::fill(&spomega_[0], &spomega_[0] + n, omega);
+}
+
+namespace d2q9 {
+
+using balbm::mu_to_relax;
+using balbm::mu_to_omega;
+using DensityMultiscaleMap = balbm::DensityMultiscaleMap<D2Q9>;
+
 } // namespace d2q9
 
+namespace d3q19 {
+
+using balbm::mu_to_relax;
+using balbm::mu_to_omega;
+using DensityMultiscaleMap = balbm::DensityMultiscaleMap<D3Q19>;
+
+} // namespace d3q19
+
 } // namespace balbm
 
 #endif // MULTISCALE_MAP_HH
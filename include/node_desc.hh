@@ -22,17 +22,12 @@
 //    AND because this only requires one vtable lookup instead of two
 
 #include "balbm_config.hh"
+#include "lattice_fwd.hh"
 #include <algorithm>
 #include <memory>
 
 namespace balbm {
 
-namespace d2q9 {
-
-class Lattice;
-class IncompFlowMultiscaleMap;
-class IncompFlowCollisionManager;
-
 //! \class AbstractNodeDesc
 //!
 //! \brief Abstract base class for  node descriptors
@@ -40,54 +35,51 @@ class IncompFlowCollisionManager;
 //! Provide polymorphic behavior for each node in the lattice based on its
 //! physical "status" as a node, e.g. change behavior of streaming and collision
 //! steps in order to simulate appropriate physics and boundary conditions
-class AbstractNodeDesc {
+template <typename VS> class AbstractNodeDesc {
 public:
-  void stream(Lattice &, const unsigned, const unsigned) const;
-  inline void collide_and_bound(Lattice &, IncompFlowMultiscaleMap &,
-                                const IncompFlowCollisionManager &,
-                                const unsigned, const unsigned) const;
+  void stream(Lattice<VS> &, const Coords<VS> &) const;
+  inline void collide_and_bound(Lattice<VS> &, IncompFlowMultiscaleMap<VS> &,
+                                const IncompFlowCollisionManager<VS> &,
+                                const Coords<VS> &) const;
   virtual ~AbstractNodeDesc() = 0;
 
 private:
-  virtual void stream_(Lattice &, const unsigned, const unsigned) const
-      noexcept = 0;
-  virtual void stream_with_bcheck_(Lattice &, const unsigned,
-                                   const unsigned) const = 0;
-  virtual void collide_and_bound_(Lattice &, IncompFlowMultiscaleMap &,
-                                  const IncompFlowCollisionManager &,
-                                  const unsigned, const unsigned) const = 0;
+  virtual void stream_(Lattice<VS> &, const Coords<VS> &) const noexcept = 0;
+  virtual void stream_with_bcheck_(Lattice<VS> &,
+                                   const Coords<VS> &) const = 0;
+  virtual void collide_and_bound_(Lattice<VS> &,
+                                  IncompFlowMultiscaleMap<VS> &,
+                                  const IncompFlowCollisionManager<VS> &,
+                                  const Coords<VS> &) const = 0;
 };
 
-//! D2Q9 base class collide and bound
+//! Base class collide and bound
 //!
 //! \param lat Lattice
 //! \param mmap Incompressible flow multiscale map
 //! \param cman Collision manager
-//! \param i Index of node in the y-direction
-//! \param j Index of node in the x-direction
-inline void
-AbstractNodeDesc::collide_and_bound(Lattice &lat, IncompFlowMultiscaleMap &mmap,
-                                    const IncompFlowCollisionManager &cman,
-                                    const unsigned i, const unsigned j) const {
-  collide_and_bound_(lat, mmap, cman, i, j);
+//! \param x Coordinates of the node
+template <typename VS>
+inline void AbstractNodeDesc<VS>::collide_and_bound(
+    Lattice<VS> &lat, IncompFlowMultiscaleMap<VS> &mmap,
+    const IncompFlowCollisionManager<VS> &cman, const Coords<VS> &x) const {
+  collide_and_bound_(lat, mmap, cman, x);
 }
 
 //! \class NodeInactive
 //!
 //! \brief Inactive node //!
 //! Represents an inactive node in the domain
-class NodeInactive : public AbstractNodeDesc {
+template <typename VS> class NodeInactive : public AbstractNodeDesc<VS> {
 public:
   ~NodeInactive() {}
 
 private:
-  virtual void stream_(Lattice &, const unsigned, const unsigned) const
-      noexcept {}
-  virtual void stream_with_bcheck_(Lattice &, const unsigned,
-                                   const unsigned) const {}
-  void collide_and_bound_(Lattice &, IncompFlowMultiscaleMap &,
-                          const IncompFlowCollisionManager &, const unsigned,
-                          const unsigned) const {}
+  virtual void stream_(Lattice<VS> &, const Coords<VS> &) const noexcept {}
+  virtual void stream_with_bcheck_(Lattice<VS> &, const Coords<VS> &) const {}
+  void collide_and_bound_(Lattice<VS> &, IncompFlowMultiscaleMap<VS> &,
+                          const IncompFlowCollisionManager<VS> &,
+                          const Coords<VS> &) const {}
 };
 
 //! \class AbstractNodeActive
@@ -96,18 +88,16 @@ private:
 //!
 //! Represents an active node in the domain where streaming and collision
 //! occur
-class AbstractNodeActive : public AbstractNodeDesc {
+template <typename VS> class AbstractNodeActive : public AbstractNodeDesc<VS> {
 public:
   virtual ~AbstractNodeActive() = 0;
 
 protected:
-  virtual void stream_(Lattice &, const unsigned, const unsigned) const
-      noexcept;
-  virtual void stream_with_bcheck_(Lattice &, const unsigned,
-                                   const unsigned) const;
-  virtual void collide_and_bound_(Lattice &, IncompFlowMultiscaleMap &,
-                                  const IncompFlowCollisionManager &,
-                                  const unsigned, const unsigned) const;
+  virtual void stream_(Lattice<VS> &, const Coords<VS> &) const noexcept;
+  virtual void stream_with_bcheck_(Lattice<VS> &, const Coords<VS> &) const;
+  virtual void collide_and_bound_(Lattice<VS> &, IncompFlowMultiscaleMap<VS> &,
+                                  const IncompFlowCollisionManager<VS> &,
+                                  const Coords<VS> &) const;
 };
 
 //! \class NodeActive
@@ -115,109 +105,361 @@ protected:
 //! \brief Concrete active node
 //!
 //! Concrete class of an active node
-class NodeActive : public AbstractNodeActive {
+template <typename VS> class NodeActive : public AbstractNodeActive<VS> {
 public:
   ~NodeActive() {}
 };
 
-//! \class NodeWestFacingWall
+//! \struct EastFacing
+//!
+//! \brief Boundary whose inward unit normal points east, i.e. on the west edge
+struct EastFacing {
+  static constexpr int nx = 1;
+  static constexpr int ny = 0;
+  static constexpr int nz = 0;
+};
+
+//! \struct NorthFacing
+//!
+//! \brief Boundary whose inward unit normal points north, i.e. on the south
+//!        edge
+struct NorthFacing {
+  static constexpr int nx = 0;
+  static constexpr int ny = 1;
+  static constexpr int nz = 0;
+};
+
+//! \struct WestFacing
+//!
+//! \brief Boundary whose inward unit normal points west, i.e. on the east edge
+struct WestFacing {
+  static constexpr int nx = -1;
+  static constexpr int ny = 0;
+  static constexpr int nz = 0;
+};
+
+//! \struct SouthFacing
+//!
+//! \brief Boundary whose inward unit normal points south, i.e. on the north
+//!        edge
+struct SouthFacing {
+  static constexpr int nx = 0;
+  static constexpr int ny = -1;
+  static constexpr int nz = 0;
+};
+
+//! \struct UpFacing
+//!
+//! \brief Boundary whose inward unit normal points up the z-axis, i.e. on the
+//!        bottom face of a 3D lattice
+struct UpFacing {
+  static constexpr int nx = 0;
+  static constexpr int ny = 0;
+  static constexpr int nz = 1;
+};
+
+//! \struct DownFacing
 //!
-//! \brief West facing wall
+//! \brief Boundary whose inward unit normal points down the z-axis, i.e. on
+//!        the top face of a 3D lattice
+struct DownFacing {
+  static constexpr int nx = 0;
+  static constexpr int ny = 0;
+  static constexpr int nz = -1;
+};
+
+//! \class NodeWall
 //!
-//! Represents a solid, west facing wall
-class NodeWestFacingWall : public AbstractNodeDesc {
+//! \brief Wall facing along one of the lattice axes
+//!
+//! Represents a fluid node adjacent to a solid wall, e.g.
+//! NodeWall<D2Q9, WestFacing> for a wall east of the node. The no slip
+//! condition is enforced with halfway bounce-back while streaming.
+template <typename VS, typename Facing>
+class NodeWall : public AbstractNodeActive<VS> {
 public:
-  ~NodeWestFacingWall() {}
+  ~NodeWall() {}
 
 private:
-  void stream_(Lattice &, const unsigned, const unsigned) const noexcept;
-  void stream_with_bcheck_(Lattice &, const unsigned, const unsigned) const;
-  void collide_and_bound_(Lattice &, IncompFlowMultiscaleMap &,
-                          const IncompFlowCollisionManager &, const unsigned,
-                          const unsigned) const;
+  void stream_(Lattice<VS> &, const Coords<VS> &) const noexcept;
+  void stream_with_bcheck_(Lattice<VS> &, const Coords<VS> &) const;
 };
 
-//! \class NodeSouthFacingWall
+//! \class Periodic boundary condition
 //!
-//! \brief South facing wall
+//! \brief Implements a periodic boundary condition
 //!
-//! Represents a solid, south facing wall
-class NodeSouthFacingWall : public AbstractNodeDesc {
+//! Active node on the edge of the domain. Particle distributions that would
+//! leave the domain are streamed to the opposite edge.
+template <typename VS> class NodePeriodic : public AbstractNodeActive<VS> {
 public:
-  ~NodeSouthFacingWall() {}
+  ~NodePeriodic() {}
 
 private:
-  void stream_(Lattice &, const unsigned, const unsigned) const noexcept;
-  void stream_with_bcheck_(Lattice &, const unsigned, const unsigned) const;
-  void collide_and_bound_(Lattice &, IncompFlowMultiscaleMap &,
-                          const IncompFlowCollisionManager &, const unsigned,
-                          const unsigned) const;
+  void stream_(Lattice<VS> &, const Coords<VS> &) const noexcept;
+  void stream_with_bcheck_(Lattice<VS> &, const Coords<VS> &) const;
 };
 
-//! \class NodeEastFacingWall
+//! \class NodeZouHeVelocity
 //!
-//! \brief East facing wall
+//! \brief Zou and He velocity boundary condition
 //!
-//! Represents a solid, east facing wall
-class NodeEastFacingWall : public AbstractNodeDesc {
+//! Active node on an open boundary with a prescribed velocity. Particle
+//! distributions entering the domain are reconstructed before the collision
+//! using the method of Zou and He 1997. Facing is one of EastFacing,
+//! NorthFacing, WestFacing, or SouthFacing. Only for 2D lattices.
+template <typename VS, typename Facing>
+class NodeZouHeVelocity : public AbstractNodeActive<VS> {
 public:
-  ~NodeEastFacingWall() {}
+  ~NodeZouHeVelocity() {}
+  NodeZouHeVelocity(const double ux, const double uy) : u_{ux, uy} {
+    static_assert(VS::nd == 2, "Zou and He boundaries are 2D only");
+  }
 
 private:
-  void stream_(Lattice &, const unsigned, const unsigned) const noexcept;
-  void stream_with_bcheck_(Lattice &, const unsigned, const unsigned) const;
-  void collide_and_bound_(Lattice &, IncompFlowMultiscaleMap &,
-                          const IncompFlowCollisionManager &, const unsigned,
-                          const unsigned) const;
+  void stream_(Lattice<VS> &, const Coords<VS> &) const noexcept;
+  void stream_with_bcheck_(Lattice<VS> &, const Coords<VS> &) const;
+  void collide_and_bound_(Lattice<VS> &, IncompFlowMultiscaleMap<VS> &,
+                          const IncompFlowCollisionManager<VS> &,
+                          const Coords<VS> &) const;
+  double u_[2];
 };
 
-//! \class NodeNorthFacingWall
+//! \class NodeZouHePressure
 //!
-//! \brief North facing wall
+//! \brief Zou and He pressure boundary condition
 //!
-//! Represents a solid, North facing wall
-class NodeNorthFacingWall : public AbstractNodeDesc {
+//! Active node on an open boundary with a prescribed density (pressure) and
+//! zero tangential velocity. Particle distributions entering the domain are
+//! reconstructed before the collision using the method of Zou and He 1997.
+//! Only for 2D lattices.
+template <typename VS, typename Facing>
+class NodeZouHePressure : public AbstractNodeActive<VS> {
 public:
-  ~NodeNorthFacingWall() {}
+  ~NodeZouHePressure() {}
+  NodeZouHePressure(const double rho) : rho_(rho) {
+    static_assert(VS::nd == 2, "Zou and He boundaries are 2D only");
+  }
 
 private:
-  void stream_(Lattice &, const unsigned, const unsigned) const noexcept;
-  void stream_with_bcheck_(Lattice &, const unsigned, const unsigned) const;
-  void collide_and_bound_(Lattice &, IncompFlowMultiscaleMap &,
-                          const IncompFlowCollisionManager &, const unsigned,
-                          const unsigned) const;
+  void stream_(Lattice<VS> &, const Coords<VS> &) const noexcept;
+  void stream_with_bcheck_(Lattice<VS> &, const Coords<VS> &) const;
+  void collide_and_bound_(Lattice<VS> &, IncompFlowMultiscaleMap<VS> &,
+                          const IncompFlowCollisionManager<VS> &,
+                          const Coords<VS> &) const;
+  double rho_;
 };
 
-//! \class Periodic boundary condition
+//! \class NodeMovingWall
 //!
-//! \brief Implements a periodic boundary condition
-class NodePeriodic : public AbstractNodeActive {
+//! \brief Moving wall
+//!
+//! Represents a fluid node adjacent to a solid wall moving tangentially with a
+//! prescribed velocity, e.g. the lid of a lid-driven cavity. Enforced with
+//! halfway bounce-back plus the momentum correction of Ladd 1994. Only for
+//! 2D lattices.
+template <typename VS, typename Facing>
+class NodeMovingWall : public AbstractNodeActive<VS> {
 public:
-  ~NodePeriodic() {}
-  NodePeriodic(const unsigned, const unsigned, const unsigned *,
-               const unsigned);
+  ~NodeMovingWall() {}
+  NodeMovingWall(const double ux, const double uy) : u_{ux, uy} {
+    static_assert(VS::nd == 2, "moving walls are 2D only");
+  }
 
 private:
-  void collide_and_bound_(Lattice &, IncompFlowMultiscaleMap &,
-                          const IncompFlowCollisionManager &, const unsigned,
-                          const unsigned) const;
-  unsigned i_next_;
-  unsigned j_next_;
-  std::unique_ptr<unsigned[]> ks_;
-  unsigned nk_;
+  void stream_(Lattice<VS> &, const Coords<VS> &) const noexcept;
+  void stream_with_bcheck_(Lattice<VS> &, const Coords<VS> &) const;
+  double u_[2];
 };
 
+//! \class NodeCornerWall
+//!
+//! \brief Concave corner between two walls
+//!
+//! Represents a fluid node in a concave corner bounded by two solid walls,
+//! e.g. NodeCornerWall<D2Q9, EastFacing, NorthFacing> in the south west
+//! corner of a cavity. The no slip condition is enforced with halfway
+//! bounce-back.
+template <typename VS, typename Facing1, typename Facing2>
+class NodeCornerWall : public AbstractNodeActive<VS> {
+public:
+  ~NodeCornerWall() {}
+
+private:
+  void stream_(Lattice<VS> &, const Coords<VS> &) const noexcept;
+  void stream_with_bcheck_(Lattice<VS> &, const Coords<VS> &) const;
+};
+
+//! \class NodeFreeSlip
+//!
+//! \brief Free slip wall or symmetry plane
+//!
+//! Represents a fluid node adjacent to a frictionless wall or a plane of
+//! mirror symmetry. Particle distributions crossing the plane are specularly
+//! reflected halfway between this node and its mirror image, so that only
+//! the normal component of their velocity is reversed.
+template <typename VS, typename Facing>
+class NodeFreeSlip : public AbstractNodeActive<VS> {
+public:
+  ~NodeFreeSlip() {}
+
+private:
+  void stream_(Lattice<VS> &, const Coords<VS> &) const noexcept;
+  void stream_with_bcheck_(Lattice<VS> &, const Coords<VS> &) const;
+};
+
+//! \class NodeBounceBack
+//!
+//! \brief Fluid node with solid neighbors in an arbitrary set of directions
+//!
+//! Particle distributions streaming towards a solid neighbor are reflected
+//! with halfway bounce-back, all others are streamed periodically. Covers
+//! convex corners, gaps one node wide and the irregular boundaries of e.g.
+//! porous media, where none of the oriented wall descriptors apply.
+template <typename VS> class NodeBounceBack : public AbstractNodeActive<VS> {
+  static_assert(VS::nk <= 32, "links of a node must fit in an unsigned");
+
+public:
+  ~NodeBounceBack() {}
+  //! \param links Bit k set if the neighbor in direction k is solid
+  NodeBounceBack(const unsigned links) : links_(links) {}
+  inline unsigned links() const noexcept { return links_; }
+
+private:
+  void stream_(Lattice<VS> &, const Coords<VS> &) const noexcept;
+  void stream_with_bcheck_(Lattice<VS> &, const Coords<VS> &) const;
+  unsigned links_;
+};
+
+extern template class AbstractNodeDesc<D2Q9>;
+extern template class NodeInactive<D2Q9>;
+extern template class AbstractNodeActive<D2Q9>;
+extern template class NodeActive<D2Q9>;
+extern template class NodePeriodic<D2Q9>;
+extern template class NodeBounceBack<D2Q9>;
+extern template class NodeWall<D2Q9, EastFacing>;
+extern template class NodeWall<D2Q9, NorthFacing>;
+extern template class NodeWall<D2Q9, WestFacing>;
+extern template class NodeWall<D2Q9, SouthFacing>;
+extern template class NodeZouHeVelocity<D2Q9, EastFacing>;
+extern template class NodeZouHeVelocity<D2Q9, NorthFacing>;
+extern template class NodeZouHeVelocity<D2Q9, WestFacing>;
+extern template class NodeZouHeVelocity<D2Q9, SouthFacing>;
+extern template class NodeZouHePressure<D2Q9, EastFacing>;
+extern template class NodeZouHePressure<D2Q9, NorthFacing>;
+extern template class NodeZouHePressure<D2Q9, WestFacing>;
+extern template class NodeZouHePressure<D2Q9, SouthFacing>;
+extern template class NodeMovingWall<D2Q9, EastFacing>;
+extern template class NodeMovingWall<D2Q9, NorthFacing>;
+extern template class NodeMovingWall<D2Q9, WestFacing>;
+extern template class NodeMovingWall<D2Q9, SouthFacing>;
+extern template class NodeFreeSlip<D2Q9, EastFacing>;
+extern template class NodeFreeSlip<D2Q9, NorthFacing>;
+extern template class NodeFreeSlip<D2Q9, WestFacing>;
+extern template class NodeFreeSlip<D2Q9, SouthFacing>;
+extern template class NodeCornerWall<D2Q9, EastFacing, NorthFacing>;
+extern template class NodeCornerWall<D2Q9, WestFacing, NorthFacing>;
+extern template class NodeCornerWall<D2Q9, WestFacing, SouthFacing>;
+extern template class NodeCornerWall<D2Q9, EastFacing, SouthFacing>;
+
+extern template class AbstractNodeDesc<D3Q19>;
+extern template class NodeInactive<D3Q19>;
+extern template class AbstractNodeActive<D3Q19>;
+extern template class NodeActive<D3Q19>;
+extern template class NodePeriodic<D3Q19>;
+extern template class NodeBounceBack<D3Q19>;
+extern template class NodeWall<D3Q19, EastFacing>;
+extern template class NodeWall<D3Q19, NorthFacing>;
+extern template class NodeWall<D3Q19, WestFacing>;
+extern template class NodeWall<D3Q19, SouthFacing>;
+extern template class NodeWall<D3Q19, UpFacing>;
+extern template class NodeWall<D3Q19, DownFacing>;
+extern template class NodeFreeSlip<D3Q19, EastFacing>;
+extern template class NodeFreeSlip<D3Q19, NorthFacing>;
+extern template class NodeFreeSlip<D3Q19, WestFacing>;
+extern template class NodeFreeSlip<D3Q19, SouthFacing>;
+extern template class NodeFreeSlip<D3Q19, UpFacing>;
+extern template class NodeFreeSlip<D3Q19, DownFacing>;
+
 //! Constant expression for maximum node descriptor size
 //!
 //! \return Maximum node descriptor size
+template <typename VS> constexpr std::size_t max_node_desc_size() {
+  return std::max({sizeof(NodeActive<VS>), sizeof(NodeWall<VS, EastFacing>),
+                   sizeof(NodePeriodic<VS>),
+                   sizeof(NodeZouHeVelocity<VS, EastFacing>),
+                   sizeof(NodeZouHePressure<VS, EastFacing>),
+                   sizeof(NodeMovingWall<VS, EastFacing>),
+                   sizeof(NodeCornerWall<VS, EastFacing, NorthFacing>),
+                   sizeof(NodeFreeSlip<VS, EastFacing>),
+                   sizeof(NodeBounceBack<VS>)});
+}
+
+namespace d2q9 {
+
+using balbm::EastFacing;
+using balbm::NorthFacing;
+using balbm::WestFacing;
+using balbm::SouthFacing;
+
+using NodeInactive = balbm::NodeInactive<D2Q9>;
+using AbstractNodeActive = balbm::AbstractNodeActive<D2Q9>;
+using NodeActive = balbm::NodeActive<D2Q9>;
+using NodeWestFacingWall = NodeWall<D2Q9, WestFacing>;
+using NodeSouthFacingWall = NodeWall<D2Q9, SouthFacing>;
+using NodeEastFacingWall = NodeWall<D2Q9, EastFacing>;
+using NodeNorthFacingWall = NodeWall<D2Q9, NorthFacing>;
+using NodePeriodic = balbm::NodePeriodic<D2Q9>;
+using NodeBounceBack = balbm::NodeBounceBack<D2Q9>;
+template <typename Facing>
+using NodeZouHeVelocity = balbm::NodeZouHeVelocity<D2Q9, Facing>;
+template <typename Facing>
+using NodeZouHePressure = balbm::NodeZouHePressure<D2Q9, Facing>;
+template <typename Facing>
+using NodeMovingWall = balbm::NodeMovingWall<D2Q9, Facing>;
+template <typename Facing1, typename Facing2>
+using NodeCornerWall = balbm::NodeCornerWall<D2Q9, Facing1, Facing2>;
+template <typename Facing>
+using NodeFreeSlip = balbm::NodeFreeSlip<D2Q9, Facing>;
+
+//! \typedef NodeAxis
+//!
+//! \brief Axis of symmetry of an axisymmetric flow
+//!
+//! The axis lies halfway below the row of NodeAxis nodes, where radial
+//! velocity and radial gradients vanish, i.e. a symmetry plane. See
+//! AxisymmetricSourceTerm.
+using NodeAxis = NodeFreeSlip<NorthFacing>;
+
+//! Constant expression for maximum node descriptor size
+//!
+//! \return Maximum size of a D2Q9 node descriptor
 constexpr std::size_t max_node_desc_size() {
-  return std::max({sizeof(NodeActive), sizeof(NodeWestFacingWall),
-                   sizeof(NodeSouthFacingWall), sizeof(NodeEastFacingWall),
-                   sizeof(NodeNorthFacingWall), sizeof(NodePeriodic)});
+  return balbm::max_node_desc_size<D2Q9>();
 }
 
 } // namespace d2q9
 
+namespace d3q19 {
+
+using balbm::EastFacing;
+using balbm::NorthFacing;
+using balbm::WestFacing;
+using balbm::SouthFacing;
+using balbm::UpFacing;
+using balbm::DownFacing;
+
+using NodeInactive = balbm::NodeInactive<D3Q19>;
+using AbstractNodeActive = balbm::AbstractNodeActive<D3Q19>;
+using NodeActive = balbm::NodeActive<D3Q19>;
+template <typename Facing> using NodeWall = balbm::NodeWall<D3Q19, Facing>;
+using NodePeriodic = balbm::NodePeriodic<D3Q19>;
+using NodeBounceBack = balbm::NodeBounceBack<D3Q19>;
+template <typename Facing>
+using NodeFreeSlip = balbm::NodeFreeSlip<D3Q19, Facing>;
+
+} // namespace d3q19
+
 } // namespace balbm
 
 #endif // NODE_DESC_HH
@@ -0,0 +1,187 @@
+#ifndef OUTPUT_HH
+#define OUTPUT_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Q: why not write output directly from a callback?
+// A: the time loop would stall for the whole write. Here the solver only
+//    copies the requested fields into a recycled staging frame; formatting
+//    and I/O happen on background writer threads.
+
+#include "balbm_config.hh"
+#include "lattice_fwd.hh"
+#include "callback.hh"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace balbm {
+
+namespace d2q9 {
+
+class Instrumentation;
+class TraceRecorder;
+
+//! Macroscopic fields that can be output, combined as bit flags
+enum OutputField : unsigned {
+  OUTPUT_RHO = 1u << 0,
+  OUTPUT_U = 1u << 1,
+  OUTPUT_OMEGA = 1u << 2,
+  OUTPUT_F = 1u << 3
+};
+
+//! \struct OutputRegion
+//!
+//! \brief Rectangular region of the lattice to output, optionally coarsened
+//!
+//! The region starts at node (i0, j0) and spans ni by nj nodes, where 0 means
+//! up to the edge of the lattice. With factor > 1 every factor-th node is
+//! output, or, if average is set, the mean of each factor by factor block;
+//! nodes of incomplete blocks at the far edges are dropped.
+struct OutputRegion {
+  OutputRegion(const unsigned i0 = 0, const unsigned j0 = 0,
+               const unsigned ni = 0, const unsigned nj = 0,
+               const unsigned factor = 1, const bool average = false)
+      : i0(i0), j0(j0), ni(ni), nj(nj), factor(factor), average(average) {}
+  unsigned i0;
+  unsigned j0;
+  unsigned ni;
+  unsigned nj;
+  unsigned factor;
+  bool average;
+};
+
+//! \struct FieldFrame
+//!
+//! \brief Copy of macroscopic fields at one time step, staged for output
+//!
+//! Fields are stored in the node order of the multiscale map, i.e. output
+//! node (i, j) is at i * nj + j, u holds both components of each node and f
+//! holds the nk particle distributions of each node. Fields that were not
+//! requested are left empty. Output node (i, j) lies at lattice coordinates
+//! (origin[0] + i * spacing, origin[1] + j * spacing).
+struct FieldFrame {
+  unsigned step;
+  unsigned fields;
+  unsigned ni;
+  unsigned nj;
+  unsigned nk;
+  double origin[2];
+  double spacing;
+  std::vector<double> rho;
+  std::vector<double> u;
+  std::vector<double> omega;
+  std::vector<double> f;
+
+  void stage(const Lattice &, const IncompFlowMultiscaleMap &, const unsigned,
+             const unsigned, const OutputRegion & = OutputRegion());
+};
+
+//! \class AbstractFieldWriter
+//!
+//! \brief Base class for writers of staged macroscopic fields
+//!
+//! Writers are called from background threads. If an output pipeline runs
+//! more than one writer thread, write_ must be safe to call concurrently.
+class AbstractFieldWriter {
+public:
+  virtual ~AbstractFieldWriter() = 0;
+  inline void write(const FieldFrame &frame) { write_(frame); }
+
+private:
+  virtual void write_(const FieldFrame &) = 0;
+};
+
+//! \class AsyncOutputPipeline
+//!
+//! \brief Hands staged fields to background writer threads
+//!
+//! A fixed number of frames circulates between the solver and the writers.
+//! Only the requested region of the lattice is staged, so output volume
+//! scales with the region and its coarsening.
+//! submit() copies fields into a free frame and queues it; once the writers
+//! fall behind and no frame is free, submit() blocks until one is returned.
+//! Errors thrown by the writer are rethrown by the next submit() or flush().
+class AsyncOutputPipeline {
+public:
+  AsyncOutputPipeline(AbstractFieldWriter *,
+                      const unsigned = OUTPUT_RHO | OUTPUT_U,
+                      const unsigned = 2, const unsigned = 1,
+                      const OutputRegion & = OutputRegion());
+  AsyncOutputPipeline(const AsyncOutputPipeline &) = delete;
+  AsyncOutputPipeline &operator=(const AsyncOutputPipeline &) = delete;
+  ~AsyncOutputPipeline();
+  inline unsigned fields() const noexcept { return fields_; }
+  inline const OutputRegion &region() const noexcept { return region_; }
+  inline unsigned num_buffers() const noexcept { return frames_.size(); }
+  unsigned frames_written() const;
+  unsigned stalls() const;
+  std::size_t heap_bytes() const;
+  void attach_instrumentation(Instrumentation *);
+  void attach_trace(TraceRecorder *);
+  void submit(const Lattice &, const IncompFlowMultiscaleMap &,
+              const unsigned);
+  void flush();
+
+private:
+  void worker_();
+  void rethrow_();
+  std::unique_ptr<AbstractFieldWriter> spwriter_;
+  unsigned fields_;
+  OutputRegion region_;
+  std::vector<std::unique_ptr<FieldFrame>> frames_;
+  std::vector<FieldFrame *> free_;
+  std::deque<FieldFrame *> queue_;
+  mutable std::mutex mutex_;
+  std::condition_variable free_cv_;
+  std::condition_variable queue_cv_;
+  std::condition_variable idle_cv_;
+  unsigned busy_;
+  unsigned frames_written_;
+  unsigned stalls_;
+  Instrumentation *pinstr_;
+  TraceRecorder *ptrace_;
+  bool stop_;
+  std::exception_ptr error_;
+  std::vector<std::thread> threads_;
+};
+
+//! \class OutputCallback
+//!
+//! \brief Submits the fields of an incompressible flow simulation to an
+//!        output pipeline every `stride` time steps
+class OutputCallback : public AbstractSimCallback {
+public:
+  ~OutputCallback() {}
+  OutputCallback(AsyncOutputPipeline &pipeline, const unsigned stride)
+      : ppipeline_(&pipeline), stride_(stride) {}
+
+private:
+  AsyncOutputPipeline *ppipeline_;
+  unsigned stride_;
+  void f_(AbstractSimulation &) const;
+};
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // OUTPUT_HH
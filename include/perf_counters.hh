@@ -0,0 +1,84 @@
+#ifndef PERF_COUNTERS_HH
+#define PERF_COUNTERS_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Q: why open every event on its own instead of as a group?
+// A: virtual machines and older kernels often lack some events, last level
+//    cache events in particular; a group fails as a whole, single events
+//    let the rest be counted.
+
+#include "balbm_config.hh"
+#include <cstdint>
+#include <string>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! \enum HardwareEvent
+//!
+//! \brief Hardware events counted for the calling thread, in user space
+enum HardwareEvent : unsigned {
+  HW_CYCLES,         //!< core cycles
+  HW_INSTRUCTIONS,   //!< retired instructions
+  HW_LLC_REFERENCES, //!< last level cache references
+  HW_LLC_MISSES,     //!< last level cache misses, each moves a cache line
+  NUM_HW_EVENTS
+};
+
+const char *hardware_event_name(const HardwareEvent);
+
+//! \struct HardwareCounts
+//!
+//! \brief Counts of every hardware event, zero when it is not counted
+struct HardwareCounts {
+  std::uint64_t values[NUM_HW_EVENTS];
+};
+
+//! \class PerfCounters
+//!
+//! \brief Hardware event counters of the thread that constructs them
+//!
+//! Counters that cannot be opened, for lack of permission or support, are
+//! left out and read as zero; construction never fails.
+class PerfCounters {
+public:
+  //! Bytes moved from memory by a last level cache miss
+  static constexpr unsigned cache_line_bytes = 64;
+
+  PerfCounters();
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+  ~PerfCounters();
+  inline bool available(const HardwareEvent event) const noexcept {
+    return fds_[event] >= 0;
+  }
+  bool available() const noexcept;
+  inline const std::string &reason() const noexcept { return reason_; }
+  HardwareCounts read() const;
+
+private:
+  int fds_[NUM_HW_EVENTS];
+  std::string reason_;
+};
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // PERF_COUNTERS_HH
@@ -0,0 +1,193 @@
+#ifndef PROBE_HH
+#define PROBE_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Q: why sample the multiscale map instead of the particle distributions?
+// A: the collision sweep already computes the moments of every node into the
+//    multiscale map, so a probe only touches its own handful of nodes and
+//    never pays for another pass over the lattice.
+// Q: why is the force passed along with the multiscale map?
+// A: under a body force the map holds the velocity before the half-force
+//    shift of the force, e.g. u + dt F / 2 for GuoForce. Probes sample the
+//    shifted velocity, the one the collision uses, or they would be biased.
+
+#include "balbm_config.hh"
+#include "force.hh"
+#include "lattice_fwd.hh"
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! \class AbstractProbe
+//!
+//! \brief Base class for probes of macroscopic variables
+//!
+//! Every sample of a probe is a record of width() values.
+class AbstractProbe {
+public:
+  virtual ~AbstractProbe() = 0;
+  AbstractProbe(const std::string &name) : name_(name) {}
+  inline const std::string &name() const noexcept { return name_; }
+  inline unsigned width() const { return width_(); }
+  inline void sample(const Lattice &lat, const IncompFlowMultiscaleMap &mmap,
+                     const AbstractForce *pforce, double *record) const {
+    sample_(lat, mmap, pforce, record);
+  }
+  inline bool fits(const unsigned ni, const unsigned nj) const {
+    return fits_(ni, nj);
+  }
+
+protected:
+  static AbstractForce::vec velocity(const Lattice &,
+                                     const IncompFlowMultiscaleMap &,
+                                     const AbstractForce *, const unsigned,
+                                     const unsigned);
+
+private:
+  std::string name_;
+  virtual unsigned width_() const = 0;
+  virtual void sample_(const Lattice &, const IncompFlowMultiscaleMap &,
+                       const AbstractForce *, double *) const = 0;
+  virtual bool fits_(const unsigned, const unsigned) const = 0;
+};
+
+//! \class PointProbe
+//!
+//! \brief Records rho, ux and uy of a single node
+class PointProbe : public AbstractProbe {
+public:
+  ~PointProbe() {}
+  PointProbe(const std::string &name, const unsigned i, const unsigned j)
+      : AbstractProbe(name), i_(i), j_(j) {}
+
+private:
+  unsigned i_;
+  unsigned j_;
+  unsigned width_() const { return 3; }
+  void sample_(const Lattice &, const IncompFlowMultiscaleMap &,
+               const AbstractForce *, double *) const;
+  bool fits_(const unsigned ni, const unsigned nj) const {
+    return i_ < ni && j_ < nj;
+  }
+};
+
+//! \class LineProbe
+//!
+//! \brief Records rho, ux and uy of each node on a line between two nodes
+//!
+//! Nodes are those closest to the line, one per step along its longer
+//! extent, stored from the first end to the second.
+class LineProbe : public AbstractProbe {
+public:
+  ~LineProbe() {}
+  LineProbe(const std::string &, const unsigned, const unsigned,
+            const unsigned, const unsigned);
+  inline unsigned num_nodes() const noexcept { return is_.size(); }
+
+private:
+  std::vector<unsigned> is_;
+  std::vector<unsigned> js_;
+  unsigned width_() const { return 3 * is_.size(); }
+  void sample_(const Lattice &, const IncompFlowMultiscaleMap &,
+               const AbstractForce *, double *) const;
+  bool fits_(const unsigned, const unsigned) const;
+};
+
+//! \class FlowRateProbe
+//!
+//! \brief Records the flow rate through, and mean density over, a section
+//!
+//! The section is a row or column of nodes between two nodes. Through a
+//! column (constant i) the flow rate is the sum of ux, through a row
+//! (constant j) it is the sum of uy. The mean density gives the mean
+//! pressure cssq * rho, e.g. to monitor pressure drops between sections.
+class FlowRateProbe : public AbstractProbe {
+public:
+  ~FlowRateProbe() {}
+  FlowRateProbe(const std::string &, const unsigned, const unsigned,
+                const unsigned, const unsigned);
+
+private:
+  unsigned i0_;
+  unsigned j0_;
+  unsigned i1_;
+  unsigned j1_;
+  unsigned c_;
+  unsigned width_() const { return 2; }
+  void sample_(const Lattice &, const IncompFlowMultiscaleMap &,
+               const AbstractForce *, double *) const;
+  bool fits_(const unsigned ni, const unsigned nj) const {
+    return i1_ < ni && j1_ < nj;
+  }
+};
+
+//! \class ProbeRecorder
+//!
+//! \brief Samples probes into preallocated ring buffers
+//!
+//! Each probe keeps its latest `capacity` samples in memory. Every `block`
+//! samples the ones not yet on disk are appended to `<prefix>_<name>.dat`
+//! as raw doubles, one record of 1 + width values (time step first) per
+//! sample, so sampling itself never allocates or formats.
+class ProbeRecorder {
+public:
+  ProbeRecorder(const std::string &, const unsigned = 4096,
+                const unsigned = 1024);
+  ProbeRecorder(const ProbeRecorder &) = delete;
+  ProbeRecorder &operator=(const ProbeRecorder &) = delete;
+  ~ProbeRecorder();
+  unsigned add(AbstractProbe *);
+  inline unsigned num_probes() const noexcept { return channels_.size(); }
+  inline const AbstractProbe &probe(const unsigned p) const {
+    return *(channels_[p].spprobe);
+  }
+  inline unsigned num_samples(const unsigned p) const {
+    return channels_[p].count;
+  }
+  const double *sample(const unsigned, const unsigned) const;
+  void record(const Lattice &, const IncompFlowMultiscaleMap &,
+              const AbstractForce *, const unsigned);
+  void flush();
+
+private:
+  struct Channel {
+    std::unique_ptr<AbstractProbe> spprobe;
+    unsigned stride;
+    std::vector<double> ring;
+    unsigned head;
+    unsigned count;
+    unsigned unflushed;
+    std::ofstream ofs;
+  };
+  std::string prefix_;
+  unsigned capacity_;
+  unsigned block_;
+  std::vector<Channel> channels_;
+  void flush_(Channel &);
+};
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // PROBE_HH
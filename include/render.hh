@@ -0,0 +1,75 @@
+#ifndef RENDER_HH
+#define RENDER_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm_config.hh"
+#include "output.hh"
+#include <string>
+#include <vector>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Scalar fields that can be rendered
+enum class RenderQuantity { Speed, Vorticity, Density };
+
+//! Colormaps for rendering scalar fields
+enum class Colormap { Gray, Viridis, CoolWarm };
+
+//! Image file formats
+enum class ImageFormat { PPM, PNG };
+
+void colormap_rgb(const Colormap, const double, unsigned char *);
+
+//! \class ImageRenderer
+//!
+//! \brief Renders a scalar field of staged frames to image files
+//!
+//! Runs as the writer of an output pipeline, so rendering happens on a
+//! background thread from the staged snapshot. Every frame becomes
+//! `<prefix>_<step>.ppm` or `.png` with x (i) to the right and y (j) up.
+//! Values are mapped linearly from [vmin, vmax] onto the colormap; if
+//! vmin == vmax the range of each frame is used. The pipeline must stage
+//! the fields the quantity is derived from: u for speed and vorticity, rho
+//! for density. PNG output requires zlib.
+class ImageRenderer : public AbstractFieldWriter {
+public:
+  ~ImageRenderer() {}
+  ImageRenderer(const std::string &, const RenderQuantity,
+                const Colormap = Colormap::Viridis, const double = 0.0,
+                const double = 0.0, const ImageFormat = ImageFormat::PPM,
+                const unsigned = 1);
+  static unsigned required_fields(const RenderQuantity);
+
+private:
+  std::string prefix_;
+  RenderQuantity quantity_;
+  Colormap cmap_;
+  double vmin_;
+  double vmax_;
+  ImageFormat format_;
+  unsigned scale_;
+  void write_(const FieldFrame &);
+};
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // RENDER_HH
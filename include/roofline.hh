@@ -0,0 +1,78 @@
+#ifndef ROOFLINE_HH
+#define ROOFLINE_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Q: where do the flops and bytes of a kernel come from?
+// A: flops are counted from the source of the kernels, as portable
+//    floating point counters do not exist. Bytes are counted the same way,
+//    unless last level cache misses are counted; then the bytes they move
+//    are reported next to the model.
+
+#include "balbm_config.hh"
+#include "instrument.hh"
+#include <cstddef>
+#include <iosfwd>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Bytes moved per node by streaming: read and write every distribution
+constexpr double stream_bytes_per_node = 2 * 9 * sizeof(double);
+
+//! Bytes moved per node by a collision: distributions in and out, density,
+//! velocity and relaxation frequency out, solid fraction in
+constexpr double collide_bytes_per_node = (2 * 9 + 5) * sizeof(double);
+
+//! Flops per node of a BGK collision with the incompressible equilibrium,
+//! without forcing or source terms
+constexpr double collide_flops_per_node = 270.0;
+
+//! \struct MachineCeilings
+//!
+//! \brief Measured memory bandwidth and scalar floating point throughput
+struct MachineCeilings {
+  double bytes_per_second;
+  double flops_per_second;
+};
+
+MachineCeilings measure_machine_ceilings(const std::size_t = 1u << 22,
+                                         const unsigned = 5);
+
+//! \struct RooflinePoint
+//!
+//! \brief Placement of a kernel on the roofline of a machine
+struct RooflinePoint {
+  double bytes_per_second;
+  double flops_per_second;
+  double intensity;                   //!< flops per byte
+  double attainable_flops_per_second; //!< roof at the intensity
+  bool memory_bound;                  //!< left of the ridge point
+};
+
+RooflinePoint place_on_roofline(const MachineCeilings &, const double,
+                                const double, const double);
+
+void roofline_report(std::ostream &, const Instrumentation &,
+                     const MachineCeilings &, const std::size_t);
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // ROOFLINE_HH
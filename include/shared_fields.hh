@@ -0,0 +1,193 @@
+#ifndef SHARED_FIELDS_HH
+#define SHARED_FIELDS_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Shared field segment layout (native byte order):
+//
+//   [SharedFieldsHeader] [rho] [u] [omega] [f] [boundary nodes] [boundary f]
+//
+// Every array starts on a cache line and is in the node order of the
+// multiscale map. Arrays of fields that are not published are empty. The
+// sequence counter of the header is a seqlock: it is odd while the publisher
+// copies fields into the segment and is incremented to the next even value
+// when a consistent set of fields is in place, so readers can use the
+// arrays in place and detect whether a publish overlapped their read. A
+// sequence of 0 means nothing has been published yet.
+
+#include "balbm_config.hh"
+#include "lattice_fwd.hh"
+#include "callback.hh"
+#include "output.hh"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace balbm {
+
+namespace d2q9 {
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "shared fields need lock free 64 bit atomics");
+
+//! Magic bytes at the start of every shared field segment
+constexpr char SHARED_FIELDS_MAGIC[8] = {'B', 'A', 'L', 'B',
+                                         'M', 'S', 'H', '\0'};
+
+//! Version of the shared field layout, bumped on any change of the layout
+constexpr std::uint32_t SHARED_FIELDS_VERSION = 1;
+
+//! \enum SharedArray
+//!
+//! \brief Arrays of a shared field segment
+enum SharedArray : unsigned {
+  SHARED_RHO,      //!< density, one double per node
+  SHARED_U,        //!< velocity, two doubles per node
+  SHARED_OMEGA,    //!< collision frequency, one double per node
+  SHARED_F,        //!< particle distributions, nk doubles per node
+  SHARED_BNODES,   //!< node indices i * nj + j of boundaries, one uint32 each
+  SHARED_BF,       //!< particle distributions of boundary nodes, nk each
+  SHARED_NUM_ARRAYS
+};
+
+//! \struct SharedFieldsHeader
+//!
+//! \brief Header at the start of a shared field segment
+struct SharedFieldsHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t fields; //!< OutputField bit flags
+  std::uint32_t ni;
+  std::uint32_t nj;
+  std::uint32_t nk;
+  std::uint32_t num_boundary_nodes;
+  std::atomic<std::uint64_t> sequence;
+  std::uint64_t step;
+  std::uint64_t offsets[SHARED_NUM_ARRAYS]; //!< from the start of the segment
+  std::uint64_t bytes[SHARED_NUM_ARRAYS];
+};
+
+//! \class SharedFieldPublisher
+//!
+//! \brief Publishes fields of a simulation in a named shared memory segment
+//!
+//! The segment is created, or replaced, on construction and unlinked on
+//! destruction; processes that still map it keep their mapping. Boundary
+//! populations are those of nodes with a descriptor other than NodeActive,
+//! NodePeriodic or NodeInactive, e.g. walls and velocity or pressure
+//! boundaries, as of construction.
+class SharedFieldPublisher {
+public:
+  SharedFieldPublisher(const std::string &, const Lattice &,
+                       const unsigned = OUTPUT_RHO | OUTPUT_U,
+                       const bool = false);
+  SharedFieldPublisher(const SharedFieldPublisher &) = delete;
+  SharedFieldPublisher &operator=(const SharedFieldPublisher &) = delete;
+  ~SharedFieldPublisher();
+  inline const std::string &name() const noexcept { return name_; }
+  inline std::uint64_t sequence() const noexcept {
+    return pheader_->sequence.load(std::memory_order_relaxed);
+  }
+  void publish(const Lattice &, const IncompFlowMultiscaleMap &,
+               const unsigned);
+
+private:
+  std::string name_;
+  std::size_t bytes_;
+  char *pseg_;
+  SharedFieldsHeader *pheader_;
+  std::vector<std::uint32_t> bnodes_;
+};
+
+//! \class SharedFieldReader
+//!
+//! \brief Maps a shared field segment read-only
+//!
+//! Arrays are used in place:
+//!
+//!   do {
+//!     seq = reader.begin_read();
+//!     ... read reader.rho(), reader.u(), ...
+//!   } while (!reader.end_read(seq));
+//!
+//! or copied consistently into a frame with snapshot(). The reader is built
+//! as its own library, balbm_shm_reader, which needs only this header.
+class SharedFieldReader {
+public:
+  SharedFieldReader(const std::string &);
+  SharedFieldReader(const SharedFieldReader &) = delete;
+  SharedFieldReader &operator=(const SharedFieldReader &) = delete;
+  ~SharedFieldReader();
+  inline const SharedFieldsHeader &header() const noexcept {
+    return *pheader_;
+  }
+  inline unsigned num_i() const noexcept { return pheader_->ni; }
+  inline unsigned num_j() const noexcept { return pheader_->nj; }
+  inline unsigned num_k() const noexcept { return pheader_->nk; }
+  inline unsigned num_boundary_nodes() const noexcept {
+    return pheader_->num_boundary_nodes;
+  }
+  inline std::uint64_t sequence() const noexcept {
+    return pheader_->sequence.load(std::memory_order_acquire);
+  }
+  inline unsigned step() const noexcept {
+    return static_cast<unsigned>(pheader_->step);
+  }
+  inline const double *rho() const noexcept { return array(SHARED_RHO); }
+  inline const double *u() const noexcept { return array(SHARED_U); }
+  inline const double *omega() const noexcept { return array(SHARED_OMEGA); }
+  inline const double *f() const noexcept { return array(SHARED_F); }
+  inline const std::uint32_t *boundary_nodes() const noexcept {
+    const char *p = pseg_ + pheader_->offsets[SHARED_BNODES];
+    return reinterpret_cast<const std::uint32_t *>(p);
+  }
+  inline const double *boundary_f() const noexcept { return array(SHARED_BF); }
+  std::uint64_t begin_read() const;
+  bool end_read(const std::uint64_t) const;
+  std::uint64_t snapshot(FieldFrame &, std::vector<double> * = nullptr) const;
+
+private:
+  std::size_t bytes_;
+  const char *pseg_;
+  const SharedFieldsHeader *pheader_;
+  inline const double *array(const SharedArray a) const noexcept {
+    return reinterpret_cast<const double *>(pseg_ + pheader_->offsets[a]);
+  }
+};
+
+//! \class SharedFieldCallback
+//!
+//! \brief Publishes the fields of an incompressible flow simulation every
+//!        `stride` time steps
+class SharedFieldCallback : public AbstractSimCallback {
+public:
+  ~SharedFieldCallback() {}
+  SharedFieldCallback(SharedFieldPublisher &publisher, const unsigned stride)
+      : ppublisher_(&publisher), stride_(stride) {}
+
+private:
+  SharedFieldPublisher *ppublisher_;
+  unsigned stride_;
+  void f_(AbstractSimulation &) const;
+};
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // SHARED_FIELDS_HH
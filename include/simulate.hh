@@ -17,11 +17,19 @@
 // A copy of the GNU General Public License is at the root directory of
 // this program.  If not, see <http://www.gnu.org/licenses/>
 
+#include "autotune.hh"
 #include "callback.hh"
+#include "checkpoint.hh"
 #include "collision_manager.hh"
+#include "geometry.hh"
+#include "instrument.hh"
 #include "lattice.hh"
 #include "multiscale_map.hh"
+#include "probe.hh"
+#include "statistics.hh"
+#include "trace.hh"
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace balbm {
@@ -52,26 +60,77 @@ private:
 //! \class IncompFlowSimulation
 //!
 //! \brief Incompressible flow lattice Boltzmann method simulation
+//!
+//! Probes attached with attach_probes() are recorded after every collision
+//! sweep. The simulation does not own the probe recorder.
+//! Phases of every step are timed into instrumentation() when the build
+//! defines BALBM_INSTRUMENT, and recorded by a trace recorder attached with
+//! attach_trace(), which the simulation does not own either.
+//! Sweeps are split into tiles and threads by set_sweep_config(), or by the
+//! fastest configuration autotune() finds, and run on a pool of workers the
+//! simulation owns; builds that define BALBM_INSTRUMENT_NODES always sweep
+//! node by node on one thread. Probes and callbacks run on the calling thread
+//! while the workers wait.
 class IncompFlowSimulation : public AbstractSimulation {
 public:
   ~IncompFlowSimulation() {}
   IncompFlowSimulation(const unsigned, const unsigned, const double,
                        const double, AbstractIncompFlowEqFunct *,
                        AbstractConstitutiveEq *, AbstractForce *,
-                       std::vector<AbstractSimCallback *> *);
+                       std::vector<AbstractSimCallback *> * = nullptr,
+                       AbstractSourceTerm * = nullptr);
+  inline const Lattice &lattice() const { return lat_; }
   inline const IncompFlowMultiscaleMap &multiscale_map() const { return mmap_; }
+  inline void set_solid_fraction(unsigned i, unsigned j, double ns) {
+    mmap_.set_solid_fraction(i, j, ns);
+  }
   template <typename Node, typename... Args>
   inline void set_node_desc(unsigned i, unsigned j, Args... args) {
     lat_.set_node_desc<Node>(i, j, args...);
   }
+  inline void set_geometry(const Geometry &geom) { geom.apply(lat_); }
+  inline void checkpoint(const std::string &path,
+                         const bool compress = false) const {
+    BALBM_TIME_PHASE(&instr_, PHASE_IO);
+    ScopedTrace trace(ptrace_, PHASE_IO, step_);
+    save_checkpoint(path, lat_, mmap_, step_, compress, pstats_);
+  }
+  inline void restart(const std::string &path) {
+    BALBM_TIME_PHASE(&instr_, PHASE_IO);
+    ScopedTrace trace(ptrace_, PHASE_IO, step_);
+    step_ = load_checkpoint(path, lat_, mmap_, pstats_);
+  }
+  inline Instrumentation &instrumentation() noexcept { return instr_; }
+  inline const Instrumentation &instrumentation() const noexcept {
+    return instr_;
+  }
+  inline void attach_probes(ProbeRecorder *pprobes) noexcept {
+    pprobes_ = pprobes;
+  }
+  inline void attach_trace(TraceRecorder *ptrace) noexcept {
+    ptrace_ = ptrace;
+  }
+  void attach_statistics(FlowStatistics *);
+  inline const FlowStatistics *statistics() const noexcept { return pstats_; }
+  void set_sweep_config(const SweepConfig &);
+  inline const SweepConfig &sweep_config() const noexcept { return sweep_; }
+  AutotuneResult autotune(const AutotuneOptions & = AutotuneOptions());
 
 private:
   unsigned simulate_(const unsigned);
-  unsigned simulate_();
+  void run_steps_(SweepPool &, const SweepTiles &, const unsigned,
+                  const bool);
   Lattice lat_;
   IncompFlowMultiscaleMap mmap_;
   IncompFlowCollisionManager cman_;
   std::unique_ptr<std::vector<AbstractSimCallback *>> spscbs_;
+  ProbeRecorder *pprobes_;
+  FlowStatistics *pstats_;
+  mutable Instrumentation instr_;
+  TraceRecorder *ptrace_;
+  SweepConfig sweep_;
+  SweepTiles tiles_;
+  std::unique_ptr<SweepPool> sppool_;
 };
 
 } // namespace d2q9
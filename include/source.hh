@@ -0,0 +1,88 @@
+#ifndef SOURCE_HH
+#define SOURCE_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm_config.hh"
+#include "lattice_fwd.hh"
+#include <armadillo>
+
+namespace balbm {
+
+//! \class AbstractSourceTerm
+//!
+//! \brief Abstract base class for position dependent source terms
+//!
+//! Unlike external forces, source terms may depend on the location of the
+//! node and on the non-equilibrium particle distributions. Values for every
+//! lattice direction are computed at once and added to the particle
+//! distributions after the collision.
+template <typename VS> class AbstractSourceTerm {
+public:
+  using vec = arma::vec::fixed<VS::nd>;
+  virtual ~AbstractSourceTerm() = 0;
+  inline void f_col(const Lattice<VS> &lat, const arma::vec &fneq,
+                    const double omega, const double rho, const vec &u,
+                    const Coords<VS> &x, double *fcol) const {
+    f_col_(lat, fneq, omega, rho, u, x, fcol);
+  }
+
+private:
+  virtual void f_col_(const Lattice<VS> &, const arma::vec &, const double,
+                      const double, const vec &, const Coords<VS> &,
+                      double *) const = 0;
+};
+
+extern template class AbstractSourceTerm<D2Q9>;
+extern template class AbstractSourceTerm<D3Q19>;
+
+namespace d2q9 {
+
+using AbstractSourceTerm = balbm::AbstractSourceTerm<D2Q9>;
+
+//! \class AxisymmetricSourceTerm
+//!
+//! \brief Source terms for axisymmetric flow
+//!
+//! Turns the D2Q9 lattice into a meridional plane of an axisymmetric flow
+//! following Zhou 2008. The x-direction (i) is axial and the y-direction (j)
+//! is radial. Velocity gradients in the viscous terms are recovered locally
+//! from the non-equilibrium particle distributions. The axis lies halfway
+//! below the row j = 0 by default, where it should be bounded with NodeAxis.
+class AxisymmetricSourceTerm : public AbstractSourceTerm {
+public:
+  ~AxisymmetricSourceTerm() {}
+  AxisymmetricSourceTerm(const double j_axis = -0.5) : j_axis_(j_axis) {}
+  inline double r(const unsigned j) const { return j - j_axis_; }
+
+private:
+  double j_axis_;
+  void f_col_(const Lattice &, const arma::vec &, const double, const double,
+              const vec &, const Coords &, double *) const;
+};
+
+} // namespace d2q9
+
+namespace d3q19 {
+
+using AbstractSourceTerm = balbm::AbstractSourceTerm<D3Q19>;
+
+} // namespace d3q19
+
+} // namespace balbm
+
+#endif // SOURCE_HH
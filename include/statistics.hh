@@ -0,0 +1,169 @@
+#ifndef STATISTICS_HH
+#define STATISTICS_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Q: why accumulate during collision instead of in a callback?
+// A: the collision of a node has just computed its density and velocity and
+//    still holds them in cache; a callback would pay for another sweep over
+//    the whole multiscale map every sampled step.
+
+#include "balbm_config.hh"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! \class FlowStatistics
+//!
+//! \brief Running statistics of density and velocity at every node
+//!
+//! Mean, variance (Welford's algorithm), minimum, maximum and the Reynolds
+//! stresses <u_a' u_b'> of rho, ux and uy, sampled every interval steps from
+//! the start step on. Every node keeps its statistics in one contiguous
+//! record, so the update from the collision sweep touches a single cache
+//! line or two. Nodes that never collide, e.g. walls, keep zeros. Under a
+//! body force the velocity is the one the collision uses, with the
+//! half-force shift of the force applied, as sampled by probes.
+class FlowStatistics {
+public:
+  //! Slots of the record of a node
+  enum Slot : unsigned {
+    MEAN_RHO,
+    MEAN_UX,
+    MEAN_UY,
+    M2_RHO, //!< sum of squared deviations from the mean
+    M2_UX,
+    M2_UY,
+    C2_UXUY, //!< sum of products of deviations of ux and uy
+    MIN_RHO,
+    MIN_UX,
+    MIN_UY,
+    MAX_RHO,
+    MAX_UX,
+    MAX_UY,
+    NUM_SLOTS
+  };
+
+  FlowStatistics(const unsigned, const unsigned, const unsigned = 0,
+                 const unsigned = 1);
+  inline unsigned num_i() const noexcept { return ni_; }
+  inline unsigned num_j() const noexcept { return nj_; }
+  inline unsigned start() const noexcept { return start_; }
+  inline unsigned interval() const noexcept { return interval_; }
+  inline unsigned num_samples() const noexcept { return nsamples_; }
+  inline bool sampling() const noexcept { return sampling_; }
+  void begin_step(const unsigned);
+  void reset();
+
+  //! Add a sample of a node to its statistics
+  //!
+  //! \param i Index in x-direction
+  //! \param j Index in y-direction
+  //! \param rho Density
+  //! \param ux Velocity in x-direction
+  //! \param uy Velocity in y-direction
+  inline void accumulate(const unsigned i, const unsigned j, const double rho,
+                         const double ux, const double uy) noexcept {
+    BALBM_ASSERT(i < ni_ && j < nj_ && "out of bounds in FlowStatistics");
+    double *r = &data_[(std::size_t(i) * nj_ + j) * NUM_SLOTS];
+    const double x[3] = {rho, ux, uy};
+    if (nsamples_ == 1)
+      for (unsigned c = 0; c < 3; ++c) {
+        r[MIN_RHO + c] = x[c];
+        r[MAX_RHO + c] = x[c];
+      }
+    else
+      for (unsigned c = 0; c < 3; ++c) {
+        r[MIN_RHO + c] = std::min(r[MIN_RHO + c], x[c]);
+        r[MAX_RHO + c] = std::max(r[MAX_RHO + c], x[c]);
+      }
+    const double dux = ux - r[MEAN_UX];
+    for (unsigned c = 0; c < 3; ++c) {
+      const double d = x[c] - r[MEAN_RHO + c];
+      r[MEAN_RHO + c] += d * inv_nsamples_;
+      r[M2_RHO + c] += d * (x[c] - r[MEAN_RHO + c]);
+    }
+    r[C2_UXUY] += dux * (uy - r[MEAN_UY]);
+  }
+
+  inline double mean_rho(const unsigned i, const unsigned j) const {
+    return record(i, j)[MEAN_RHO];
+  }
+  inline double mean_u(const unsigned i, const unsigned j,
+                       const unsigned c) const {
+    return record(i, j)[MEAN_UX + c];
+  }
+  inline double var_rho(const unsigned i, const unsigned j) const {
+    return (nsamples_ > 0) ? record(i, j)[M2_RHO] / nsamples_ : 0.0;
+  }
+  inline double var_u(const unsigned i, const unsigned j,
+                      const unsigned c) const {
+    return (nsamples_ > 0) ? record(i, j)[M2_UX + c] / nsamples_ : 0.0;
+  }
+  inline double rms_u(const unsigned i, const unsigned j,
+                      const unsigned c) const {
+    return std::sqrt(var_u(i, j, c));
+  }
+  double reynolds_stress(const unsigned, const unsigned, const unsigned,
+                         const unsigned) const;
+  inline double min_rho(const unsigned i, const unsigned j) const {
+    return record(i, j)[MIN_RHO];
+  }
+  inline double max_rho(const unsigned i, const unsigned j) const {
+    return record(i, j)[MAX_RHO];
+  }
+  inline double min_u(const unsigned i, const unsigned j,
+                      const unsigned c) const {
+    return record(i, j)[MIN_UX + c];
+  }
+  inline double max_u(const unsigned i, const unsigned j,
+                      const unsigned c) const {
+    return record(i, j)[MAX_UX + c];
+  }
+
+  // raw records, for checkpoints
+  inline const double *record(const unsigned i, const unsigned j) const {
+    BALBM_ASSERT(i < ni_ && j < nj_ && "out of bounds in FlowStatistics");
+    return &data_[(std::size_t(i) * nj_ + j) * NUM_SLOTS];
+  }
+  inline const double *pdata() const noexcept { return data_.data(); }
+  inline double *pdata() noexcept { return data_.data(); }
+  inline std::size_t heap_bytes() const noexcept {
+    return data_.capacity() * sizeof(double);
+  }
+  void set_num_samples(const unsigned);
+
+private:
+  unsigned ni_;
+  unsigned nj_;
+  unsigned start_;
+  unsigned interval_;
+  unsigned nsamples_;
+  double inv_nsamples_;
+  bool sampling_;
+  std::vector<double> data_;
+};
+
+} // namespace d2q9
+
+} // namespace balbm
+
+#endif // STATISTICS_HH
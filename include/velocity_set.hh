@@ -0,0 +1,90 @@
+#ifndef VELOCITY_SET_HH
+#define VELOCITY_SET_HH
+
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Velocity sets are described entirely at compile time so that kernels
+// templated on them see integer offsets, weights and opposite directions as
+// constants and can be fully unrolled by the compiler.
+
+#include "balbm_config.hh"
+#include <utility>
+
+namespace balbm {
+
+//! \struct D2Q9
+//!
+//! \brief Compile-time descriptor of the D2Q9 velocity set
+struct D2Q9 {
+  static constexpr unsigned nd = 2;
+  static constexpr unsigned nk = 9;
+  static constexpr int c[nk][nd] = {{0, 0},  {1, 0},   {0, 1},
+                                    {-1, 0}, {0, -1},  {1, 1},
+                                    {-1, 1}, {-1, -1}, {1, -1}};
+  static constexpr double w[nk] = {4. / 9.,  1. / 9.,  1. / 9.,
+                                   1. / 9.,  1. / 9.,  1. / 36.,
+                                   1. / 36., 1. / 36., 1. / 36.};
+  static constexpr unsigned opp[nk] = {0, 3, 4, 1, 2, 7, 8, 5, 6};
+  static constexpr double cssq = 1.0 / 3.0;
+};
+
+//! \struct D3Q19
+//!
+//! \brief Compile-time descriptor of the D3Q19 velocity set
+//!
+//! Directions are ordered such that each odd direction is followed by its
+//! opposite
+struct D3Q19 {
+  static constexpr unsigned nd = 3;
+  static constexpr unsigned nk = 19;
+  static constexpr int c[nk][nd] = {
+      {0, 0, 0},   {1, 0, 0},  {-1, 0, 0}, {0, 1, 0},   {0, -1, 0},
+      {0, 0, 1},   {0, 0, -1}, {1, 1, 0},  {-1, -1, 0}, {1, -1, 0},
+      {-1, 1, 0},  {1, 0, 1},  {-1, 0, -1}, {1, 0, -1}, {-1, 0, 1},
+      {0, 1, 1},   {0, -1, -1}, {0, 1, -1}, {0, -1, 1}};
+  static constexpr double w[nk] = {
+      1. / 3.,  1. / 18., 1. / 18., 1. / 18., 1. / 18., 1. / 18., 1. / 18.,
+      1. / 36., 1. / 36., 1. / 36., 1. / 36., 1. / 36., 1. / 36., 1. / 36.,
+      1. / 36., 1. / 36., 1. / 36., 1. / 36., 1. / 36.};
+  static constexpr unsigned opp[nk] = {0,  2,  1,  4,  3,  6,  5,
+                                       8,  7,  10, 9,  12, 11, 14,
+                                       13, 16, 15, 18, 17};
+  static constexpr double cssq = 1.0 / 3.0;
+};
+
+namespace detail {
+
+//! Expand a functor over a compile-time sequence of directions
+template <typename F, unsigned... Ks>
+inline void unroll_(F &&f, std::integer_sequence<unsigned, Ks...>) {
+  using expand = int[];
+  (void)expand{0, ((void)f(Ks), 0)...};
+}
+
+} // namespace detail
+
+//! Call a functor once for each direction of a velocity set, fully unrolled
+//!
+//! \param f Functor taking the index of a lattice direction
+template <typename VS, typename F> inline void for_each_k(F &&f) {
+  detail::unroll_(std::forward<F>(f),
+                  std::make_integer_sequence<unsigned, VS::nk>());
+}
+
+} // namespace balbm
+
+#endif // VELOCITY_SET_HH
@@ -0,0 +1,320 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "autotune.hh"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Tiles of a sweep in lattice order
+//!
+//! \param ni Number of nodes in the i-direction
+//! \param nj Number of nodes in the j-direction
+//! \param config Sweep configuration
+//! \return First and last i, first and last j of each tile
+//! \throw invalid_argument
+SweepTiles sweep_tiles(const unsigned ni, const unsigned nj,
+                       const SweepConfig &config) {
+  if (config.nthreads == 0)
+    throw std::invalid_argument("A sweep needs at least one thread.");
+  const unsigned ti = (config.tile_i != 0)
+                          ? config.tile_i
+                          : (ni + config.nthreads - 1) / config.nthreads;
+  const unsigned tj = (config.tile_j != 0) ? config.tile_j : nj;
+  SweepTiles tiles;
+  for (unsigned bi = 0; bi < ni; bi += ti)
+    for (unsigned bj = 0; bj < nj; bj += tj)
+      tiles.push_back({{bi, std::min(bi + ti, ni) - 1, bj,
+                        std::min(bj + tj, nj) - 1}});
+  return tiles;
+}
+
+//! Start the workers of a pool
+//!
+//! \param nthreads Number of threads, the calling thread of run() included
+//! \throw invalid_argument
+SweepPool::SweepPool(const unsigned nthreads)
+    : nthreads_(nthreads), pjob_(nullptr), generation_(0), nrunning_(0),
+      stop_(false), running_(false), errors_(nthreads), failed_(false),
+      barrier_count_(0), barrier_generation_(0) {
+  if (nthreads == 0)
+    throw std::invalid_argument("A sweep pool needs at least one thread.");
+  for (unsigned t = 1; t < nthreads; ++t)
+    workers_.emplace_back(&SweepPool::work_, this, t);
+}
+
+//! Stop and join the workers
+SweepPool::~SweepPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (auto &worker : workers_)
+    worker.join();
+}
+
+//! Run a job on every thread of the pool and wait for all of them
+//!
+//! \param job Function of the index of the thread
+//! \throw logic_error if called from inside a job of the same pool
+void SweepPool::run(const Job &job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_)
+      throw std::logic_error("A sweep pool cannot run a job from inside one "
+                             "of its jobs.");
+    running_ = true;
+    pjob_ = &job;
+    nrunning_ = nthreads_ - 1;
+    ++generation_;
+    failed_.store(false, std::memory_order_relaxed);
+    barrier_count_.store(0, std::memory_order_relaxed);
+    std::fill(errors_.begin(), errors_.end(), nullptr);
+  }
+  start_.notify_all();
+  run_job_(0);
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return nrunning_ == 0; });
+    pjob_ = nullptr;
+    running_ = false;
+  }
+  for (const auto &error : errors_)
+    if (error)
+      std::rethrow_exception(error);
+}
+
+//! Wait until every thread of the running job arrives
+//!
+//! \return Whether the job is to go on, false once a thread of it threw
+bool SweepPool::barrier() {
+  if (nthreads_ == 1)
+    return !failed_.load(std::memory_order_acquire);
+  const unsigned generation =
+      barrier_generation_.load(std::memory_order_acquire);
+  if (barrier_count_.fetch_add(1, std::memory_order_acq_rel) + 1 ==
+      nthreads_) {
+    barrier_count_.store(0, std::memory_order_relaxed);
+    barrier_generation_.fetch_add(1, std::memory_order_release);
+  } else {
+    while (barrier_generation_.load(std::memory_order_acquire) ==
+               generation &&
+           !failed_.load(std::memory_order_acquire))
+      std::this_thread::yield();
+  }
+  return !failed_.load(std::memory_order_acquire);
+}
+
+//! Loop of a worker: sleep until a job starts, run it, report back
+//!
+//! \param t Index of the worker
+void SweepPool::work_(const unsigned t) {
+  unsigned generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock,
+                  [&]() { return stop_ || generation_ != generation; });
+      if (stop_)
+        return;
+      generation = generation_;
+    }
+    run_job_(t);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --nrunning_;
+    }
+    done_.notify_one();
+  }
+}
+
+//! Run the current job on a thread, keeping its exception for run()
+//!
+//! \param t Index of the thread
+void SweepPool::run_job_(const unsigned t) {
+  try {
+    (*pjob_)(t);
+  } catch (...) {
+    errors_[t] = std::current_exception();
+    failed_.store(true, std::memory_order_release);
+  }
+}
+
+//! Default options: cache at the default path, 4 timed steps per candidate
+//! and up to as many threads as the hardware runs concurrently
+AutotuneOptions::AutotuneOptions()
+    : cache_path(default_autotune_cache_path()), nsteps(4),
+      max_threads(std::max(1u, std::thread::hardware_concurrency())),
+      retune(false) {}
+
+//! Path of the autotuning cache: $BALBM_AUTOTUNE_CACHE if set, else
+//! balbm_autotune in $XDG_CACHE_HOME or in $HOME/.cache
+//!
+//! \return Path, empty if none of the variables is set
+std::string default_autotune_cache_path() {
+  if (const char *path = std::getenv("BALBM_AUTOTUNE_CACHE"))
+    return path;
+  if (const char *dir = std::getenv("XDG_CACHE_HOME"))
+    return std::string(dir) + "/balbm_autotune";
+  if (const char *home = std::getenv("HOME"))
+    return std::string(home) + "/.cache/balbm_autotune";
+  return std::string();
+}
+
+//! Model name of the CPU, from /proc/cpuinfo
+//!
+//! \return Model name, "unknown" if it cannot be read
+std::string cpu_model() {
+  std::ifstream ifs("/proc/cpuinfo");
+  for (std::string line; std::getline(ifs, line);) {
+    const auto colon = line.find(':');
+    if (colon == std::string::npos)
+      continue;
+    std::string key = line.substr(0, colon);
+    key.erase(key.find_last_not_of(" \t") + 1);
+    if (key != "model name" && key != "Hardware" && key != "cpu model")
+      continue;
+    const auto begin = line.find_first_not_of(" \t", colon + 1);
+    if (begin != std::string::npos)
+      return line.substr(begin);
+  }
+  return "unknown";
+}
+
+//! Candidate configurations of a domain: whole, column and square tiles on
+//! 1, 2, 4, ... and max_threads threads
+//!
+//! \param ni Number of nodes in the i-direction
+//! \param nj Number of nodes in the j-direction
+//! \param max_threads Most threads of a candidate
+//! \return Candidates, the whole-lattice sweep on one thread first
+std::vector<SweepConfig> sweep_candidates(const unsigned ni, const unsigned nj,
+                                          const unsigned max_threads) {
+  static const unsigned tile_is[] = {0, 8, 32};
+  static const unsigned tile_js[] = {0, 32, 128};
+  std::vector<unsigned> nthreads;
+  for (unsigned n = 1; n < max_threads && n < ni; n *= 2)
+    nthreads.push_back(n);
+  nthreads.push_back(std::max(1u, std::min(max_threads, ni)));
+
+  std::vector<SweepConfig> candidates;
+  for (const unsigned n : nthreads)
+    for (const unsigned ti : tile_is)
+      for (const unsigned tj : tile_js) {
+        const SweepConfig c(ti, tj, n);
+        if (ti < ni && tj < nj &&
+            std::find(candidates.cbegin(), candidates.cend(), c) ==
+                candidates.cend())
+          candidates.push_back(c);
+      }
+  return candidates;
+}
+
+//! Parse an entry of the cache, "ni nj tile_i tile_j nthreads cpu model"
+//!
+//! \param line Line of the cache
+//! \param ni Number of nodes in the i-direction
+//! \param nj Number of nodes in the j-direction
+//! \param config Configuration
+//! \param cpu CPU model
+//! \return Whether the line is an entry
+static bool parse_entry(const std::string &line, unsigned &ni, unsigned &nj,
+                        SweepConfig &config, std::string &cpu) {
+  std::istringstream iss(line);
+  return (iss >> ni >> nj >> config.tile_i >> config.tile_j >>
+          config.nthreads) &&
+         config.nthreads != 0 && std::getline(iss >> std::ws, cpu);
+}
+
+//! Read the configuration of a CPU and domain from the cache; lines that are
+//! not entries are skipped
+//!
+//! \param path Path of the cache
+//! \param cpu CPU model
+//! \param ni Number of nodes in the i-direction
+//! \param nj Number of nodes in the j-direction
+//! \param config Configuration, set on a hit
+//! \return Whether the cache has the configuration
+bool lookup_sweep_config(const std::string &path, const std::string &cpu,
+                         const unsigned ni, const unsigned nj,
+                         SweepConfig &config) {
+  std::ifstream ifs(path);
+  for (std::string line; std::getline(ifs, line);) {
+    unsigned li, lj;
+    SweepConfig c;
+    std::string lcpu;
+    if (parse_entry(line, li, lj, c, lcpu) && li == ni && lj == nj &&
+        lcpu == cpu) {
+      config = c;
+      return true;
+    }
+  }
+  return false;
+}
+
+//! Write the configuration of a CPU and domain to the cache, replacing any
+//! previous one; the cache is written to a temporary file renamed over it
+//!
+//! \param path Path of the cache
+//! \param cpu CPU model
+//! \param ni Number of nodes in the i-direction
+//! \param nj Number of nodes in the j-direction
+//! \param config Configuration
+//! \return Whether the cache was written
+bool store_sweep_config(const std::string &path, const std::string &cpu,
+                        const unsigned ni, const unsigned nj,
+                        const SweepConfig &config) {
+  std::vector<std::string> lines;
+  {
+    std::ifstream ifs(path);
+    for (std::string line; std::getline(ifs, line);) {
+      unsigned li, lj;
+      SweepConfig c;
+      std::string lcpu;
+      if (!parse_entry(line, li, lj, c, lcpu) || li != ni || lj != nj ||
+          lcpu != cpu)
+        lines.push_back(line);
+    }
+  }
+  std::ostringstream entry;
+  entry << ni << ' ' << nj << ' ' << config.tile_i << ' ' << config.tile_j
+        << ' ' << config.nthreads << ' ' << cpu;
+  lines.push_back(entry.str());
+
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream ofs(tmp_path);
+    for (const auto &line : lines)
+      ofs << line << '\n';
+    if (!ofs.flush())
+      return false;
+  }
+  return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+} // namespace d2q9
+
+} // namespace balbm
@@ -0,0 +1,599 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "checkpoint.hh"
+#include "lattice.hh"
+#include "multiscale_map.hh"
+#include "statistics.hh"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <typeinfo>
+#include <unistd.h>
+#include <vector>
+#ifdef BALBM_USE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Largest amount of data handed to a single system or zlib call
+static const std::size_t IO_CHUNK = std::size_t(1) << 26;
+
+//! Throw a runtime error describing the last failed system call
+//!
+//! \param what Description of the operation that failed
+//! \param path Path of the checkpoint
+//! \throw runtime_error
+static void throw_errno(const char *what, const std::string &path) {
+  std::ostringstream oss;
+  oss << "Checkpoint " << path << ": " << what << " failed, "
+      << std::strerror(errno) << '.';
+  throw std::runtime_error(oss.str());
+}
+
+//! Throw a runtime error for a malformed or incompatible checkpoint
+//!
+//! \param what Description of the problem
+//! \param path Path of the checkpoint
+//! \throw runtime_error
+static void throw_bad(const std::string &what, const std::string &path) {
+  std::ostringstream oss;
+  oss << "Checkpoint " << path << ": " << what;
+  throw std::runtime_error(oss.str());
+}
+
+//! Round an offset up to the alignment of checkpoint sections
+static inline std::uint64_t align_up(const std::uint64_t offset) {
+  return (offset + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+}
+
+//! Fingerprint of the dynamic type of a node descriptor
+//!
+//! Node descriptors are code rather than data, so a checkpoint only records
+//! which type sits at each node (FNV-1a hash of its type name) and restart
+//! requires the same geometry to have been set up beforehand.
+//!
+//! \param pnd Node descriptor, may be nullptr
+//! \return Fingerprint, 0 for an unset node
+static std::uint32_t node_fingerprint(const AbstractNodeDesc *pnd) {
+  if (pnd == nullptr)
+    return 0;
+
+  std::uint32_t hash = 2166136261u;
+  for (const char *c = typeid(*pnd).name(); *c != '\0'; ++c) {
+    hash ^= static_cast<unsigned char>(*c);
+    hash *= 16777619u;
+  }
+  return (hash == 0) ? 1 : hash;
+}
+
+//! \class FileHandle
+//!
+//! \brief Owns a file descriptor and closes it on scope exit
+class FileHandle {
+public:
+  explicit FileHandle(const int fd) : fd_(fd) {}
+  FileHandle(const FileHandle &) = delete;
+  FileHandle &operator=(const FileHandle &) = delete;
+  ~FileHandle() {
+    if (fd_ >= 0)
+      close(fd_);
+  }
+  inline int fd() const noexcept { return fd_; }
+  inline int release() noexcept {
+    const int fd = fd_;
+    fd_ = -1;
+    return fd;
+  }
+
+private:
+  int fd_;
+};
+
+//! \class FileMapping
+//!
+//! \brief Read-only memory mapping of a whole file
+class FileMapping {
+public:
+  FileMapping(const int fd, const std::size_t bytes)
+      : bytes_(bytes),
+        p_(mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0)) {}
+  FileMapping(const FileMapping &) = delete;
+  FileMapping &operator=(const FileMapping &) = delete;
+  ~FileMapping() {
+    if (p_ != MAP_FAILED)
+      munmap(p_, bytes_);
+  }
+  inline bool valid() const noexcept { return p_ != MAP_FAILED; }
+  inline const char *data() const noexcept {
+    return static_cast<const char *>(p_);
+  }
+
+private:
+  std::size_t bytes_;
+  void *p_;
+};
+
+//! Write a buffer in large chunks, retrying short writes
+//!
+//! \param fd File descriptor
+//! \param p Data to write
+//! \param bytes Size of the data
+//! \param path Path of the checkpoint, for error messages
+static void write_all(const int fd, const void *p, std::size_t bytes,
+                      const std::string &path) {
+  const char *pc = static_cast<const char *>(p);
+  while (bytes > 0) {
+    const ssize_t n = write(fd, pc, std::min(bytes, IO_CHUNK));
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      throw_errno("write", path);
+    }
+    pc += n;
+    bytes -= static_cast<std::size_t>(n);
+  }
+}
+
+//! Write a buffer at an offset, retrying short writes
+//!
+//! \param fd File descriptor
+//! \param p Data to write
+//! \param bytes Size of the data
+//! \param offset Offset in the file to write the data at
+//! \param path Path of the checkpoint, for error messages
+static void pwrite_all(const int fd, const void *p, std::size_t bytes,
+                       off_t offset, const std::string &path) {
+  const char *pc = static_cast<const char *>(p);
+  while (bytes > 0) {
+    const ssize_t n = pwrite(fd, pc, std::min(bytes, IO_CHUNK), offset);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      throw_errno("pwrite", path);
+    }
+    pc += n;
+    bytes -= static_cast<std::size_t>(n);
+    offset += n;
+  }
+}
+
+//! Flush the directory entry of a file, so that a rename survives a crash
+//!
+//! \param path Path of the checkpoint
+static void sync_parent_dir(const std::string &path) {
+  const auto slash = path.rfind('/');
+  std::string dir = ".";
+  if (slash != std::string::npos)
+    dir = path.substr(0, std::max<std::size_t>(slash, 1));
+  FileHandle dir_file(open(dir.c_str(), O_RDONLY | O_DIRECTORY));
+  if (dir_file.fd() < 0)
+    throw_errno("open of the directory", path);
+  if (fsync(dir_file.fd()) != 0)
+    throw_errno("fsync of the directory", path);
+  if (close(dir_file.release()) != 0)
+    throw_errno("close of the directory", path);
+}
+
+//! Pad the file with zeros up to an offset
+//!
+//! \param fd File descriptor
+//! \param from Current offset
+//! \param to Offset to pad to
+//! \param path Path of the checkpoint, for error messages
+static void pad_to(const int fd, const std::uint64_t from,
+                   const std::uint64_t to, const std::string &path) {
+  static const char zeros[CHECKPOINT_ALIGN] = {};
+  write_all(fd, zeros, static_cast<std::size_t>(to - from), path);
+}
+
+#ifdef BALBM_USE_ZLIB
+//! Deflate a buffer to a file in chunks
+//!
+//! \param fd File descriptor
+//! \param p Data to compress
+//! \param bytes Size of the data
+//! \param path Path of the checkpoint, for error messages
+//! \return Number of compressed bytes written
+static std::uint64_t deflate_all(const int fd, const void *p,
+                                 const std::size_t bytes,
+                                 const std::string &path) {
+  z_stream zs;
+  std::memset(&zs, 0, sizeof(zs));
+  if (deflateInit(&zs, Z_BEST_SPEED) != Z_OK)
+    throw_bad("deflateInit failed.", path);
+
+  std::vector<unsigned char> out(IO_CHUNK / 16);
+  const unsigned char *pin = static_cast<const unsigned char *>(p);
+  std::size_t left = bytes;
+  std::uint64_t stored = 0;
+  int flush;
+  do {
+    const std::size_t nin = std::min(left, IO_CHUNK);
+    zs.next_in = const_cast<unsigned char *>(pin);
+    zs.avail_in = static_cast<uInt>(nin);
+    pin += nin;
+    left -= nin;
+    flush = (left == 0) ? Z_FINISH : Z_NO_FLUSH;
+    do {
+      zs.next_out = out.data();
+      zs.avail_out = static_cast<uInt>(out.size());
+      deflate(&zs, flush);
+      const std::size_t nout = out.size() - zs.avail_out;
+      try {
+        write_all(fd, out.data(), nout, path);
+      } catch (...) {
+        deflateEnd(&zs);
+        throw;
+      }
+      stored += nout;
+    } while (zs.avail_out == 0);
+  } while (flush != Z_FINISH);
+
+  deflateEnd(&zs);
+  return stored;
+}
+
+//! Inflate a section of a checkpoint into a buffer
+//!
+//! \param pin Compressed data
+//! \param nin Size of the compressed data
+//! \param p Destination
+//! \param bytes Expected size of the decompressed data
+//! \param path Path of the checkpoint, for error messages
+static void inflate_all(const char *pin, std::uint64_t nin, void *p,
+                        std::uint64_t bytes, const std::string &path) {
+  z_stream zs;
+  std::memset(&zs, 0, sizeof(zs));
+  if (inflateInit(&zs) != Z_OK)
+    throw_bad("inflateInit failed.", path);
+
+  unsigned char *pout = static_cast<unsigned char *>(p);
+  int ret;
+  for (;;) {
+    if (zs.avail_in == 0 && nin > 0) {
+      const std::size_t n = static_cast<std::size_t>(
+          std::min(nin, static_cast<std::uint64_t>(IO_CHUNK)));
+      zs.next_in = reinterpret_cast<unsigned char *>(const_cast<char *>(pin));
+      zs.avail_in = static_cast<uInt>(n);
+      pin += n;
+      nin -= n;
+    }
+    if (zs.avail_out == 0 && bytes > 0) {
+      const std::size_t n = static_cast<std::size_t>(
+          std::min(bytes, static_cast<std::uint64_t>(IO_CHUNK)));
+      zs.next_out = pout;
+      zs.avail_out = static_cast<uInt>(n);
+      pout += n;
+      bytes -= n;
+    }
+    ret = inflate(&zs, Z_NO_FLUSH);
+    const bool can_refill = (zs.avail_in == 0 && nin > 0) ||
+                            (zs.avail_out == 0 && bytes > 0);
+    if (ret == Z_STREAM_END || !(ret == Z_OK || ret == Z_BUF_ERROR) ||
+        (ret == Z_BUF_ERROR && !can_refill))
+      break;
+  }
+
+  const bool ok = (ret == Z_STREAM_END && zs.avail_out == 0 && bytes == 0);
+  inflateEnd(&zs);
+  if (!ok)
+    throw_bad("compressed section is corrupt.", path);
+}
+#endif
+
+//! Write a checkpoint of the full state of a simulation
+//!
+//! The checkpoint is written to a temporary file next to `path` which is then
+//! renamed over `path`, so an interrupted write never destroys the previous
+//! checkpoint. The file and then its directory are synced, so once this
+//! returns the new checkpoint survives a crash.
+//!
+//! \param path Path of the checkpoint file
+//! \param lat Lattice
+//! \param mmap Multiscale map
+//! \param step Time step of the simulation
+//! \param compress Compress the sections with zlib
+//! \param pstats Running statistics to checkpoint as well, optional
+//! \throw runtime_error
+void save_checkpoint(const std::string &path, const Lattice &lat,
+                     const IncompFlowMultiscaleMap &mmap, const unsigned step,
+                     const bool compress, const FlowStatistics *pstats) {
+  if (compress && !checkpoint_compression_available())
+    throw_bad("compression requested but balbm was built without zlib.",
+              path);
+
+  const std::uint64_t n = std::uint64_t(lat.num_i()) * lat.num_j();
+  std::vector<std::uint32_t> fingerprints(n);
+  std::transform(lat.node_descs().cbegin(), lat.node_descs().cend(),
+                 fingerprints.begin(), node_fingerprint);
+
+  struct Field {
+    CheckpointSectionId id;
+    const void *p;
+    std::uint64_t bytes;
+  };
+  std::vector<Field> fields = {
+      {CheckpointSectionId::F, lat.pf(), n * lat.num_k() * sizeof(double)},
+      {CheckpointSectionId::Rho, mmap.prho(), n * sizeof(double)},
+      {CheckpointSectionId::U, mmap.pu(), 2 * n * sizeof(double)},
+      {CheckpointSectionId::Omega, mmap.pomega(), n * sizeof(double)},
+      {CheckpointSectionId::NodeDesc, fingerprints.data(),
+       n * sizeof(std::uint32_t)}};
+  if (mmap.has_solid_fractions())
+    fields.push_back({CheckpointSectionId::Ns, mmap.pns(), n * sizeof(float)});
+  const std::uint64_t stats_info[] = {
+      (pstats != nullptr) ? pstats->num_samples() : 0u,
+      FlowStatistics::NUM_SLOTS};
+  if (pstats != nullptr) {
+    if (pstats->num_i() != lat.num_i() || pstats->num_j() != lat.num_j())
+      throw_bad("running statistics do not match the lattice.", path);
+    fields.push_back(
+        {CheckpointSectionId::StatsInfo, stats_info, sizeof(stats_info)});
+    fields.push_back({CheckpointSectionId::Stats, pstats->pdata(),
+                      n * FlowStatistics::NUM_SLOTS * sizeof(double)});
+  }
+
+  CheckpointHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::copy(CHECKPOINT_MAGIC, CHECKPOINT_MAGIC + 8, header.magic);
+  header.version = CHECKPOINT_VERSION;
+  header.nsections = static_cast<std::uint32_t>(fields.size());
+  header.ni = lat.num_i();
+  header.nj = lat.num_j();
+  header.nk = lat.num_k();
+  header.step = step;
+
+  const std::string tmp_path = path + ".tmp";
+  FileHandle file(open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+  if (file.fd() < 0)
+    throw_errno("open", tmp_path);
+
+  // the header is written last, once the sizes of the sections are known
+  std::uint64_t offset = align_up(sizeof(CheckpointHeader));
+  pad_to(file.fd(), 0, offset, tmp_path);
+  for (unsigned s = 0; s < fields.size(); ++s) {
+    CheckpointSection &section = header.sections[s];
+    section.id = static_cast<std::uint32_t>(fields[s].id);
+    section.compressed = compress ? 1 : 0;
+    section.offset = offset;
+    section.bytes = fields[s].bytes;
+#ifdef BALBM_USE_ZLIB
+    if (compress)
+      section.stored_bytes = deflate_all(
+          file.fd(), fields[s].p, static_cast<std::size_t>(fields[s].bytes),
+          tmp_path);
+    else
+#endif
+    {
+      write_all(file.fd(), fields[s].p,
+                static_cast<std::size_t>(fields[s].bytes), tmp_path);
+      section.stored_bytes = fields[s].bytes;
+    }
+    const std::uint64_t end = offset + section.stored_bytes;
+    offset = align_up(end);
+    pad_to(file.fd(), end, offset, tmp_path);
+  }
+
+  pwrite_all(file.fd(), &header, sizeof(header), 0, tmp_path);
+  if (fsync(file.fd()) != 0)
+    throw_errno("fsync", tmp_path);
+  if (close(file.release()) != 0)
+    throw_errno("close", tmp_path);
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+    throw_errno("rename", path);
+  sync_parent_dir(path);
+}
+
+//! Restore the full state of a simulation from a checkpoint
+//!
+//! The lattice must have the dimensions of the checkpointed lattice and the
+//! same node descriptors must already be set at every node. Every section is
+//! checked before any state is overwritten, so the lattice, multiscale map
+//! and statistics are unchanged when the checkpoint is refused. Compressed
+//! sections are inflated into scratch memory of their full size first.
+//!
+//! \param path Path of the checkpoint file
+//! \param lat Lattice
+//! \param mmap Multiscale map
+//! \param pstats Running statistics to restore, reset if the checkpoint has
+//!               none, optional
+//! \return Time step of the simulation when the checkpoint was written
+//! \throw runtime_error
+unsigned load_checkpoint(const std::string &path, Lattice &lat,
+                         IncompFlowMultiscaleMap &mmap,
+                         FlowStatistics *pstats) {
+  FileHandle file(open(path.c_str(), O_RDONLY));
+  if (file.fd() < 0)
+    throw_errno("open", path);
+
+  struct stat st;
+  if (fstat(file.fd(), &st) != 0)
+    throw_errno("fstat", path);
+  const std::uint64_t file_bytes = static_cast<std::uint64_t>(st.st_size);
+  if (file_bytes < sizeof(CheckpointHeader))
+    throw_bad("file is too small to be a checkpoint.", path);
+
+  FileMapping mapping(file.fd(), static_cast<std::size_t>(file_bytes));
+  if (!mapping.valid())
+    throw_errno("mmap", path);
+  madvise(const_cast<char *>(mapping.data()),
+          static_cast<std::size_t>(file_bytes), MADV_SEQUENTIAL);
+
+  CheckpointHeader header;
+  std::memcpy(&header, mapping.data(), sizeof(header));
+  if (!std::equal(CHECKPOINT_MAGIC, CHECKPOINT_MAGIC + 8, header.magic))
+    throw_bad("not a balbm checkpoint.", path);
+  if (header.version != CHECKPOINT_VERSION) {
+    std::ostringstream oss;
+    oss << "format version " << header.version << " is not supported, "
+        << "expected version " << CHECKPOINT_VERSION << '.';
+    throw_bad(oss.str(), path);
+  }
+  if (header.ni != lat.num_i() || header.nj != lat.num_j() ||
+      header.nk != lat.num_k()) {
+    std::ostringstream oss;
+    oss << "lattice is " << header.ni << " x " << header.nj << " x "
+        << header.nk << " but the simulation is " << lat.num_i() << " x "
+        << lat.num_j() << " x " << lat.num_k() << '.';
+    throw_bad(oss.str(), path);
+  }
+  if (header.nsections > CHECKPOINT_MAX_SECTIONS)
+    throw_bad("too many sections.", path);
+
+  const std::uint64_t n = std::uint64_t(lat.num_i()) * lat.num_j();
+  std::vector<std::uint32_t> fingerprints(n);
+  const CheckpointSection *pns_section = nullptr;
+  const CheckpointSection *pstats_info_section = nullptr;
+  const CheckpointSection *pstats_section = nullptr;
+  struct Field {
+    CheckpointSectionId id;
+    void *p;
+    std::uint64_t bytes;
+    const CheckpointSection *psection;
+  };
+  Field fields[] = {
+      {CheckpointSectionId::NodeDesc, fingerprints.data(),
+       n * sizeof(std::uint32_t), nullptr},
+      {CheckpointSectionId::F, lat.pf(), n * lat.num_k() * sizeof(double),
+       nullptr},
+      {CheckpointSectionId::Rho, mmap.prho(), n * sizeof(double), nullptr},
+      {CheckpointSectionId::U, mmap.pu(), 2 * n * sizeof(double), nullptr},
+      {CheckpointSectionId::Omega, mmap.pomega(), n * sizeof(double),
+       nullptr}};
+
+  for (unsigned s = 0; s < header.nsections; ++s) {
+    const CheckpointSection &section = header.sections[s];
+    if (section.offset > file_bytes ||
+        section.stored_bytes > file_bytes - section.offset)
+      throw_bad("file is truncated.", path);
+    if (section.compressed && !checkpoint_compression_available())
+      throw_bad("file is compressed but balbm was built without zlib.", path);
+    if (section.id == static_cast<std::uint32_t>(CheckpointSectionId::Ns)) {
+      if (section.bytes != n * sizeof(float))
+        throw_bad("solid fraction section has the wrong size.", path);
+      pns_section = &section;
+    }
+    if (section.id ==
+        static_cast<std::uint32_t>(CheckpointSectionId::StatsInfo)) {
+      if (section.bytes != 2 * sizeof(std::uint64_t))
+        throw_bad("statistics info section has the wrong size.", path);
+      pstats_info_section = &section;
+    }
+    if (section.id == static_cast<std::uint32_t>(CheckpointSectionId::Stats))
+      pstats_section = &section;
+    for (auto &field : fields)
+      if (section.id == static_cast<std::uint32_t>(field.id)) {
+        if (section.bytes != field.bytes)
+          throw_bad("section has the wrong size.", path);
+        field.psection = &section;
+      }
+  }
+  for (const auto &field : fields)
+    if (field.psection == nullptr)
+      throw_bad("required section is missing.", path);
+  if (pstats != nullptr && pstats_section != nullptr) {
+    if (pstats_info_section == nullptr)
+      throw_bad("statistics info section is missing.", path);
+    if (pstats->num_i() != lat.num_i() || pstats->num_j() != lat.num_j())
+      throw_bad("running statistics do not match the lattice.", path);
+    if (pstats_section->bytes !=
+        n * FlowStatistics::NUM_SLOTS * sizeof(double))
+      throw_bad("statistics section has the wrong size.", path);
+  }
+
+  // every section is checked, and compressed ones are inflated into scratch
+  // buffers, before any state is overwritten; only copies that cannot fail
+  // touch the simulation
+  std::vector<std::unique_ptr<char[]>> scratch;
+  const auto stage = [&](const CheckpointSection &section) -> const char * {
+    const char *pin = mapping.data() + section.offset;
+#ifdef BALBM_USE_ZLIB
+    if (section.compressed) {
+      scratch.emplace_back(new char[section.bytes]);
+      inflate_all(pin, section.stored_bytes, scratch.back().get(),
+                  section.bytes, path);
+      return scratch.back().get();
+    }
+#endif
+    if (section.stored_bytes != section.bytes)
+      throw_bad("section has the wrong size.", path);
+    return pin;
+  };
+
+  // check the geometry first, it is the most likely mismatch
+  std::memcpy(fingerprints.data(), stage(*fields[0].psection),
+              static_cast<std::size_t>(fields[0].bytes));
+  for (unsigned idx = 0; idx < n; ++idx)
+    if (fingerprints[idx] != node_fingerprint(lat.node_descs()[idx])) {
+      std::ostringstream oss;
+      oss << "node (" << idx / lat.num_j() << ", " << idx % lat.num_j()
+          << ") has a different node descriptor than when the checkpoint "
+          << "was written. Set up the same geometry before restarting.";
+      throw_bad(oss.str(), path);
+    }
+  std::uint64_t stats_info[2] = {0, FlowStatistics::NUM_SLOTS};
+  const char *pstats_in = nullptr;
+  if (pstats != nullptr && pstats_section != nullptr) {
+    std::memcpy(stats_info, stage(*pstats_info_section), sizeof(stats_info));
+    if (stats_info[1] != FlowStatistics::NUM_SLOTS)
+      throw_bad("statistics records have a different layout.", path);
+    pstats_in = stage(*pstats_section);
+  }
+
+  constexpr unsigned nfields = sizeof(fields) / sizeof(fields[0]);
+  const char *pins[nfields];
+  for (unsigned f = 1; f < nfields; ++f)
+    pins[f] = stage(*fields[f].psection);
+  const char *pns_in = nullptr;
+  if (pns_section != nullptr) {
+    pns_in = stage(*pns_section);
+    mmap.pns(); // the only allocation, made before any copy
+  }
+
+  for (unsigned f = 1; f < nfields; ++f)
+    std::memcpy(fields[f].p, pins[f],
+                static_cast<std::size_t>(fields[f].bytes));
+  if (pns_in != nullptr)
+    std::memcpy(mmap.pns(), pns_in,
+                static_cast<std::size_t>(pns_section->bytes));
+  else if (mmap.has_solid_fractions())
+    std::fill(mmap.pns(), mmap.pns() + n, 0.0f);
+  if (pstats != nullptr) {
+    if (pstats_in != nullptr) {
+      std::memcpy(pstats->pdata(), pstats_in,
+                  static_cast<std::size_t>(pstats_section->bytes));
+      pstats->set_num_samples(static_cast<unsigned>(stats_info[0]));
+    } else
+      pstats->reset();
+  }
+
+  return static_cast<unsigned>(header.step);
+}
+
+} // namespace d2q9
+
+} // namespace balbm
@@ -15,51 +15,96 @@
 // this program.  If not, see <http://www.gnu.org/licenses/>
 
 #include "collision_manager.hh"
+#include "instrument.hh"
 #include "lattice.hh"
 #include "multiscale_map.hh"
+#include "statistics.hh"
 #include <armadillo>
+#include <array>
+#include <cstddef>
 
 namespace balbm {
 
-namespace d2q9 {
+namespace {
+
+//! Accumulate flow statistics of a node, which are only gathered in 2D
+template <std::size_t nd>
+inline void accumulate_stats(d2q9::FlowStatistics &,
+                             const std::array<unsigned, nd> &, const double,
+                             const double *) {}
+
+//! Accumulate flow statistics of a node of a D2Q9 lattice
+//!
+//! \param stats Flow statistics
+//! \param x Coordinates of the node
+//! \param rho Density
+//! \param u Macroscopic velocity
+inline void accumulate_stats(d2q9::FlowStatistics &stats,
+                             const Coords<D2Q9> &x, const double rho,
+                             const double *u) {
+  stats.accumulate(x[0], x[1], rho, u[0], u[1]);
+}
+
+} // namespace
 
 //! Incompressible flow collision
 //!
 //! \param lat Lattice
 //! \param mmap Multiscale map
-//! \param i Index in x-direction
-//! \param j Index in y-direction
-void IncompFlowCollisionManager::collide_(Lattice &lat,
-                                          IncompFlowMultiscaleMap &mmap,
-                                          const unsigned i,
-                                          const unsigned j) const {
-  const auto rhoij = mmap.rho(i, j);
-  auto uij = arma::vec::fixed<2>(mmap.pu(i, j));
+//! \param x Coordinates of the node
+template <typename VS>
+void IncompFlowCollisionManager<VS>::collide_(
+    Lattice<VS> &lat, IncompFlowMultiscaleMap<VS> &mmap,
+    const Coords<VS> &x) const {
+  {
+    BALBM_TIME_NODE_PHASE(pinstr_, d2q9::PHASE_MACRO);
+    mmap.map_to_macro(lat, x);
+  }
+  const auto rhox = mmap.rho(x);
+  auto ux = arma::vec::fixed<VS::nd>(mmap.pu(x));
   if (pextforce_ != nullptr)
-    uij = pextforce_->u_trans(lat, uij);
+    ux = pextforce_->u_trans(lat, ux);
+  if (pstats_ != nullptr && pstats_->sampling())
+    accumulate_stats(*pstats_, x, rhox, ux.memptr());
 
-  const unsigned nk = lat.num_k();
-  arma::vec feq(nk);
-  arma::vec fneq(nk);
+  constexpr unsigned nk = VS::nk;
+  double *f = lat.pf(x);
+  double feq[nk];
+  double fneq_mem[nk];
   for (unsigned k = 0; k < nk; ++k) {
-    feq(k) = pfeq_->f(lat, rhoij, uij, k);
-    fneq(k) = lat.f(i, j, k) - feq(k);
+    feq[k] = pfeq_->f(lat, rhox, ux, k);
+    fneq_mem[k] = f[k] - feq[k];
   }
+  const arma::vec fneq(fneq_mem, nk, false, true);
 
-  const auto mu = pconstiteq_->mu(lat, mmap, fneq, i, j);
+  const auto mu = pconstiteq_->mu(lat, mmap, fneq, x);
   const auto omega = mu_to_omega(mu, lat.cssq(), lat.dt());
 
+  double fcol[nk];
+  if (psource_ != nullptr)
+    psource_->f_col(lat, fneq, omega, rhox, ux, x, fcol);
+  else
+    for (unsigned k = 0; k < nk; ++k)
+      fcol[k] = 0.0;
+
   if (pextforce_ != nullptr)
     for (unsigned k = 0; k < nk; ++k)
-      lat.f(i, j, k) = omega * feq(k) + (1.0 - omega) * lat.f(i, j, k) +
-                       pextforce_->f_col(lat, omega, uij, k);
+      f[k] = omega * feq[k] + (1.0 - omega) * f[k] +
+             pextforce_->f_col(lat, omega, ux, k) + fcol[k];
   else
     for (unsigned k = 0; k < nk; ++k)
-      lat.f(i, j, k) = omega * feq(k) + (1.0 - omega) * lat.f(i, j, k);
+      f[k] = omega * feq[k] + (1.0 - omega) * f[k] + fcol[k];
+
+  // partial bounce-back of sub-resolution solids (Walsh et. al. 2009)
+  const double ns = mmap.solid_fraction(x);
+  if (ns > 0.0)
+    for (unsigned k = 0; k < nk; ++k)
+      f[k] = (1.0 - ns) * f[k] + ns * (feq[VS::opp[k]] + fneq_mem[VS::opp[k]]);
 
-  mmap.omega(i, j) = omega;
+  mmap.omega(x) = omega;
 }
 
-} // namespace d2q9
+template class IncompFlowCollisionManager<D2Q9>;
+template class IncompFlowCollisionManager<D3Q19>;
 
 } // namespace balbm
@@ -22,26 +22,27 @@
 
 namespace balbm {
 
-namespace d2q9 {
-
 //! Virtual destructor definition
-AbstractConstitutiveEq::~AbstractConstitutiveEq() {}
+template <typename VS> AbstractConstitutiveEq<VS>::~AbstractConstitutiveEq() {}
 
 //! Constitutive equation for a Newtonian fluid
 //!
 //! \param Lattice
 //! \param Multiscale map of macroscopic variables
 //! \param Non-equilibrium particle distribution
-//! \param Index in x-direction
-//! \param Index in y-direction
+//! \param Coordinates of the node
 //! \return Kinematic viscosity
-double NewtonianConstitutiveEq::mu_(const Lattice &,
-                                    const IncompFlowMultiscaleMap &,
-                                    const arma::vec &, const unsigned,
-                                    const unsigned) const {
+template <typename VS>
+double NewtonianConstitutiveEq<VS>::mu_(const Lattice<VS> &,
+                                        const IncompFlowMultiscaleMap<VS> &,
+                                        const arma::vec &,
+                                        const Coords<VS> &) const {
   return cmu_;
 }
 
-} // d2q9
+template class AbstractConstitutiveEq<D2Q9>;
+template class NewtonianConstitutiveEq<D2Q9>;
+template class AbstractConstitutiveEq<D3Q19>;
+template class NewtonianConstitutiveEq<D3Q19>;
 
 } // balbm
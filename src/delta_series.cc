@@ -0,0 +1,454 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "delta_series.hh"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#ifdef BALBM_USE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Output field flags in the order fields are stored in a frame
+static const unsigned FIELD_FLAGS[DELTA_SERIES_NUM_FIELDS] = {
+    OUTPUT_RHO, OUTPUT_U, OUTPUT_OMEGA, OUTPUT_F};
+
+//! Number of values of a field per node
+//!
+//! \param f Index of the field
+//! \param nk Number of particle distributions per node
+static unsigned components(const unsigned f, const unsigned nk) {
+  const unsigned nc[DELTA_SERIES_NUM_FIELDS] = {1, 2, 1, nk};
+  return nc[f];
+}
+
+//! Throw on a malformed delta series
+//!
+//! \param what Description of the problem
+//! \param path Path of the series
+static void throw_bad(const std::string &what, const std::string &path) {
+  std::ostringstream oss;
+  oss << "Delta series " << path << ": " << what;
+  throw std::runtime_error(oss.str());
+}
+
+//! Encode values as the XOR of their bit patterns with a reference
+//!
+//! \param x Values
+//! \param ref Reference values
+//! \param n Number of values
+//! \param out Encoded bytes, appended
+static void encode_xor(const double *x, const double *ref, const std::size_t n,
+                       std::vector<unsigned char> &out) {
+  const std::size_t nibbles = out.size();
+  out.resize(nibbles + (n + 1) / 2, 0);
+  for (std::size_t idx = 0; idx < n; ++idx) {
+    std::uint64_t a, b;
+    std::memcpy(&a, x + idx, sizeof(a));
+    std::memcpy(&b, ref + idx, sizeof(b));
+    const std::uint64_t bits = a ^ b;
+    unsigned lz = 0;
+    while (lz < 8 && ((bits >> (56 - 8 * lz)) & 0xff) == 0)
+      ++lz;
+    out[nibbles + idx / 2] |= static_cast<unsigned char>(lz << (4 * (idx % 2)));
+    for (int shift = 8 * (7 - static_cast<int>(lz)); shift >= 0; shift -= 8)
+      out.push_back(static_cast<unsigned char>(bits >> shift));
+  }
+}
+
+//! Decode values encoded by encode_xor
+//!
+//! \param in Encoded bytes
+//! \param nin Number of encoded bytes
+//! \param x Reference values on entry, decoded values on return
+//! \param n Number of values
+//! \return false if the encoded bytes are malformed
+static bool decode_xor(const unsigned char *in, const std::size_t nin,
+                       double *x, const std::size_t n) {
+  const std::size_t nnibbles = (n + 1) / 2;
+  if (nin < nnibbles)
+    return false;
+  const unsigned char *pbytes = in + nnibbles;
+  const unsigned char *end = in + nin;
+  for (std::size_t idx = 0; idx < n; ++idx) {
+    const unsigned lz = (in[idx / 2] >> (4 * (idx % 2))) & 0xf;
+    if (lz > 8 || end - pbytes < static_cast<std::ptrdiff_t>(8 - lz))
+      return false;
+    std::uint64_t bits = 0;
+    for (unsigned b = lz; b < 8; ++b)
+      bits = (bits << 8) | *pbytes++;
+    std::uint64_t a;
+    std::memcpy(&a, x + idx, sizeof(a));
+    a ^= bits;
+    std::memcpy(x + idx, &a, sizeof(a));
+  }
+  return pbytes == end;
+}
+
+//! Value reconstructed from a reference and a quantized difference
+static inline double dequantize(const double ref, const std::int64_t q,
+                                const double quantum) {
+  return ref + static_cast<double>(q) * quantum;
+}
+
+//! Encode the differences of values from a reference, quantized
+//!
+//! \param x Values
+//! \param ref Reference values on entry, reconstructed values on return
+//! \param n Number of values
+//! \param quantum Quantization step
+//! \param out Encoded bytes, appended
+//! \throw invalid_argument
+static void encode_quantized(const double *x, double *ref, const std::size_t n,
+                             const double quantum,
+                             std::vector<unsigned char> &out) {
+  for (std::size_t idx = 0; idx < n; ++idx) {
+    const double d = (x[idx] - ref[idx]) / quantum;
+    if (!(std::fabs(d) < 4.0e18))
+      throw std::invalid_argument("Value is not finite or too large for the "
+                                  "tolerance of the delta series.");
+    const std::int64_t q = std::llround(d);
+    ref[idx] = dequantize(ref[idx], q, quantum);
+    std::uint64_t z = (static_cast<std::uint64_t>(q) << 1) ^
+                      static_cast<std::uint64_t>(q >> 63);
+    while (z >= 0x80) {
+      out.push_back(static_cast<unsigned char>(z | 0x80));
+      z >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(z));
+  }
+}
+
+//! Decode values encoded by encode_quantized
+//!
+//! \param in Encoded bytes
+//! \param nin Number of encoded bytes
+//! \param x Reference values on entry, decoded values on return
+//! \param n Number of values
+//! \param quantum Quantization step
+//! \return false if the encoded bytes are malformed
+static bool decode_quantized(const unsigned char *in, const std::size_t nin,
+                             double *x, const std::size_t n,
+                             const double quantum) {
+  const unsigned char *end = in + nin;
+  for (std::size_t idx = 0; idx < n; ++idx) {
+    std::uint64_t z = 0;
+    for (unsigned shift = 0;; shift += 7) {
+      if (in == end || shift > 63)
+        return false;
+      z |= static_cast<std::uint64_t>(*in & 0x7f) << shift;
+      if ((*in++ & 0x80) == 0)
+        break;
+    }
+    const std::int64_t q = static_cast<std::int64_t>(z >> 1) ^
+                           -static_cast<std::int64_t>(z & 1);
+    x[idx] = dequantize(x[idx], q, quantum);
+  }
+  return in == end;
+}
+
+//! Constructor for a delta series writer
+//!
+//! \param path Path of the series file
+//! \param tolerance Maximum error of stored values, 0 for lossless
+//! \param keyframe_interval Number of frames between keyframes
+//! \throw invalid_argument, runtime_error
+DeltaSeriesWriter::DeltaSeriesWriter(const std::string &path,
+                                     const double tolerance,
+                                     const unsigned keyframe_interval)
+    : path_(path), tolerance_(tolerance),
+      keyframe_interval_(std::max(keyframe_interval, 1u)), nframes_(0),
+      raw_bytes_(0), stored_bytes_(0), rekey_(false) {
+  if (!(tolerance >= 0.0))
+    throw std::invalid_argument("Tolerance of a delta series must not be "
+                                "negative.");
+  std::memset(&header_, 0, sizeof(header_));
+  ofs_.open(path, std::ios::binary | std::ios::trunc);
+  if (!ofs_)
+    throw std::runtime_error("Unable to open " + path + '.');
+}
+
+//! Number of frames written
+unsigned DeltaSeriesWriter::num_frames() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return nframes_;
+}
+
+//! Size of the fields of every frame written, uncompressed
+std::uint64_t DeltaSeriesWriter::raw_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return raw_bytes_;
+}
+
+//! Size of the series file
+std::uint64_t DeltaSeriesWriter::stored_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stored_bytes_;
+}
+
+//! Append a frame to the series
+//!
+//! \param frame Staged fields
+//! \throw invalid_argument, runtime_error
+void DeltaSeriesWriter::write_(const FieldFrame &frame) {
+  const std::vector<double> *srcs[DELTA_SERIES_NUM_FIELDS] = {
+      &frame.rho, &frame.u, &frame.omega, &frame.f};
+  const std::size_t n = std::size_t(frame.ni) * frame.nj;
+  for (unsigned f = 0; f < DELTA_SERIES_NUM_FIELDS; ++f)
+    if ((frame.fields & FIELD_FLAGS[f]) &&
+        srcs[f]->size() != n * components(f, frame.nk))
+      throw std::invalid_argument("Frame has a field of the wrong size.");
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (nframes_ == 0) {
+    std::copy(DELTA_SERIES_MAGIC, DELTA_SERIES_MAGIC + 8, header_.magic);
+    header_.version = DELTA_SERIES_VERSION;
+    header_.fields = frame.fields & (OUTPUT_RHO | OUTPUT_U | OUTPUT_OMEGA |
+                                     OUTPUT_F);
+    header_.ni = frame.ni;
+    header_.nj = frame.nj;
+    header_.nk = frame.nk;
+    header_.keyframe_interval = keyframe_interval_;
+    header_.tolerance = tolerance_;
+    header_.origin[0] = frame.origin[0];
+    header_.origin[1] = frame.origin[1];
+    header_.spacing = frame.spacing;
+    ofs_.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+    stored_bytes_ += sizeof(header_);
+  } else if ((frame.fields & header_.fields) != header_.fields ||
+             frame.ni != header_.ni || frame.nj != header_.nj ||
+             frame.nk != header_.nk) {
+    std::ostringstream oss;
+    oss << "Frame of step " << frame.step << " does not have the fields and "
+        << "dimensions of delta series " << path_ << '.';
+    throw std::invalid_argument(oss.str());
+  }
+
+  DeltaFrameHeader fheader;
+  std::memset(&fheader, 0, sizeof(fheader));
+  fheader.step = frame.step;
+  fheader.keyframe = (rekey_ || nframes_ % keyframe_interval_ == 0) ? 1 : 0;
+#ifdef BALBM_USE_ZLIB
+  fheader.deflated = 1;
+#endif
+  // references are left half updated if encoding fails
+  rekey_ = true;
+  payload_.clear();
+  for (unsigned f = 0; f < DELTA_SERIES_NUM_FIELDS; ++f) {
+    if (!(header_.fields & FIELD_FLAGS[f]))
+      continue;
+    const std::size_t nf = n * components(f, frame.nk);
+    std::vector<double> &ref = refs_[f];
+    if (fheader.keyframe)
+      ref.assign(nf, 0.0);
+    encoded_.clear();
+    if (tolerance_ > 0.0)
+      encode_quantized(srcs[f]->data(), ref.data(), nf, tolerance_, encoded_);
+    else {
+      encode_xor(srcs[f]->data(), ref.data(), nf, encoded_);
+      std::copy(srcs[f]->cbegin(), srcs[f]->cend(), ref.begin());
+    }
+    fheader.encoded_bytes[f] = encoded_.size();
+    raw_bytes_ += nf * sizeof(double);
+
+#ifdef BALBM_USE_ZLIB
+    const std::size_t offset = payload_.size();
+    uLongf zbytes = compressBound(encoded_.size());
+    payload_.resize(offset + zbytes);
+    if (compress2(&payload_[offset], &zbytes, encoded_.data(),
+                  encoded_.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+      throw_bad("compression failed.", path_);
+    payload_.resize(offset + zbytes);
+    fheader.stored_bytes[f] = zbytes;
+#else
+    payload_.insert(payload_.end(), encoded_.cbegin(), encoded_.cend());
+    fheader.stored_bytes[f] = encoded_.size();
+#endif
+  }
+
+  ofs_.write(reinterpret_cast<const char *>(&fheader), sizeof(fheader));
+  ofs_.write(reinterpret_cast<const char *>(payload_.data()), payload_.size());
+  ofs_.flush();
+  if (!ofs_)
+    throw std::runtime_error("Unable to write " + path_ + '.');
+  stored_bytes_ += sizeof(fheader) + payload_.size();
+  ++nframes_;
+  rekey_ = false;
+}
+
+//! Constructor for a delta series reader, indexing every complete frame
+//!
+//! \param path Path of the series file
+//! \throw runtime_error
+DeltaSeriesReader::DeltaSeriesReader(const std::string &path)
+    : path_(path), ifs_(path, std::ios::binary), current_(UINT_MAX) {
+  if (!ifs_)
+    throw std::runtime_error("Unable to open " + path + '.');
+  ifs_.seekg(0, std::ios::end);
+  const std::uint64_t file_bytes = static_cast<std::uint64_t>(ifs_.tellg());
+  ifs_.seekg(0);
+
+  ifs_.read(reinterpret_cast<char *>(&header_), sizeof(header_));
+  if (ifs_.gcount() != sizeof(header_) ||
+      !std::equal(DELTA_SERIES_MAGIC, DELTA_SERIES_MAGIC + 8, header_.magic))
+    throw_bad("not a balbm delta series.", path);
+  if (header_.version != DELTA_SERIES_VERSION) {
+    std::ostringstream oss;
+    oss << "format version " << header_.version << " is not supported, "
+        << "expected version " << DELTA_SERIES_VERSION << '.';
+    throw_bad(oss.str(), path);
+  }
+
+  std::uint64_t offset = sizeof(header_);
+  for (;;) {
+    Entry entry;
+    ifs_.read(reinterpret_cast<char *>(&entry.header), sizeof(entry.header));
+    if (ifs_.gcount() != sizeof(entry.header))
+      break;
+    entry.offset = offset + sizeof(entry.header);
+    std::uint64_t bytes = 0;
+    for (unsigned f = 0; f < DELTA_SERIES_NUM_FIELDS; ++f)
+      bytes += entry.header.stored_bytes[f];
+    if (bytes > file_bytes - entry.offset)
+      break; // cut short while being written
+    if (index_.empty() && !entry.header.keyframe)
+      throw_bad("first frame is not a keyframe.", path);
+    index_.push_back(entry);
+    offset = entry.offset + bytes;
+    ifs_.seekg(static_cast<std::streamoff>(offset));
+  }
+  ifs_.clear();
+}
+
+//! Time step of a frame
+//!
+//! \param n Index of the frame
+//! \return Time step
+//! \throw out_of_range
+unsigned DeltaSeriesReader::step(const unsigned n) const {
+  return static_cast<unsigned>(index_.at(n).header.step);
+}
+
+//! Index of the frame of a time step
+//!
+//! \param step Time step
+//! \return Index of the frame
+//! \throw out_of_range
+unsigned DeltaSeriesReader::find(const unsigned step) const {
+  for (unsigned n = 0; n < index_.size(); ++n)
+    if (index_[n].header.step == step)
+      return n;
+  std::ostringstream oss;
+  oss << "Delta series " << path_ << " has no frame of step " << step << '.';
+  throw std::out_of_range(oss.str());
+}
+
+//! Read a frame, decoding it from the nearest keyframe before it
+//!
+//! \param n Index of the frame
+//! \param frame Frame to fill
+//! \throw out_of_range, runtime_error
+void DeltaSeriesReader::read(const unsigned n, FieldFrame &frame) {
+  if (n >= index_.size()) {
+    std::ostringstream oss;
+    oss << "Delta series " << path_ << " has " << index_.size()
+        << " frames, frame " << n << " does not exist.";
+    throw std::out_of_range(oss.str());
+  }
+
+  unsigned keyframe = n;
+  while (!index_[keyframe].header.keyframe)
+    --keyframe;
+  const bool resume = (current_ != UINT_MAX && current_ >= keyframe &&
+                       current_ <= n);
+  for (unsigned m = resume ? current_ + 1 : keyframe; m <= n; ++m)
+    decode_(m);
+
+  frame.step = step(n);
+  frame.fields = header_.fields;
+  frame.ni = header_.ni;
+  frame.nj = header_.nj;
+  frame.nk = header_.nk;
+  frame.origin[0] = header_.origin[0];
+  frame.origin[1] = header_.origin[1];
+  frame.spacing = header_.spacing;
+  std::vector<double> *dsts[DELTA_SERIES_NUM_FIELDS] = {
+      &frame.rho, &frame.u, &frame.omega, &frame.f};
+  for (unsigned f = 0; f < DELTA_SERIES_NUM_FIELDS; ++f)
+    if (header_.fields & FIELD_FLAGS[f])
+      *dsts[f] = values_[f];
+    else
+      dsts[f]->clear();
+}
+
+//! Decode a frame on top of the frame before it
+//!
+//! \param m Index of the frame
+//! \throw runtime_error
+void DeltaSeriesReader::decode_(const unsigned m) {
+  const Entry &entry = index_[m];
+  const std::size_t n = std::size_t(header_.ni) * header_.nj;
+  current_ = UINT_MAX;
+  ifs_.seekg(static_cast<std::streamoff>(entry.offset));
+  for (unsigned f = 0; f < DELTA_SERIES_NUM_FIELDS; ++f) {
+    if (!(header_.fields & FIELD_FLAGS[f]))
+      continue;
+    const std::size_t nf = n * components(f, header_.nk);
+    if (entry.header.keyframe)
+      values_[f].assign(nf, 0.0);
+
+    stored_.resize(entry.header.stored_bytes[f]);
+    ifs_.read(reinterpret_cast<char *>(stored_.data()), stored_.size());
+    if (static_cast<std::size_t>(ifs_.gcount()) != stored_.size())
+      throw_bad("unable to read frame.", path_);
+    const std::vector<unsigned char> *pencoded = &stored_;
+    if (entry.header.deflated) {
+#ifdef BALBM_USE_ZLIB
+      encoded_.resize(entry.header.encoded_bytes[f]);
+      uLongf nencoded = encoded_.size();
+      if (uncompress(encoded_.data(), &nencoded, stored_.data(),
+                     stored_.size()) != Z_OK ||
+          nencoded != encoded_.size())
+        throw_bad("compressed frame is corrupt.", path_);
+      pencoded = &encoded_;
+#else
+      throw_bad("frames are compressed but balbm was built without zlib.",
+                path_);
+#endif
+    }
+
+    const bool ok =
+        (header_.tolerance > 0.0)
+            ? decode_quantized(pencoded->data(), pencoded->size(),
+                               values_[f].data(), nf, header_.tolerance)
+            : decode_xor(pencoded->data(), pencoded->size(),
+                         values_[f].data(), nf);
+    if (!ok)
+      throw_bad("frame is corrupt.", path_);
+  }
+  current_ = m;
+}
+
+} // namespace d2q9
+
+} // namespace balbm
@@ -0,0 +1,273 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "differential.hh"
+#include "constitutive.hh"
+#include "equilibrium.hh"
+#include "force.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Frozen reference step, node by node in lattice order
+//!
+//! \param lat Lattice
+//! \param mmap Multiscale map
+//! \param cman Collision manager
+void reference_step(Lattice &lat, IncompFlowMultiscaleMap &mmap,
+                    const IncompFlowCollisionManager &cman) {
+  for (unsigned i = 0; i < lat.num_i(); ++i)
+    for (unsigned j = 0; j < lat.num_j(); ++j)
+      lat.stream(i, j);
+  lat.swap_f_ptrs();
+  for (unsigned i = 0; i < lat.num_i(); ++i)
+    for (unsigned j = 0; j < lat.num_j(); ++j)
+      lat.collide_and_bound(mmap, cman, i, j);
+}
+
+//! Step of IncompFlowSimulation: whole lattice sweeps
+//!
+//! \param lat Lattice
+//! \param mmap Multiscale map
+//! \param cman Collision manager
+void sweep_step(Lattice &lat, IncompFlowMultiscaleMap &mmap,
+                const IncompFlowCollisionManager &cman) {
+  lat.stream();
+  lat.swap_f_ptrs();
+  lat.collide_and_bound(mmap, cman);
+}
+
+//! Step that sweeps a list of rectangles, e.g. the runs of a geometry
+//!
+//! \param bounds First and last i, first and last j of each rectangle,
+//!               covering the lattice once
+//! \return Execution mode
+ExecutionMode bounds_mode(const std::vector<std::array<unsigned, 4>> &bounds) {
+  return [bounds](Lattice &lat, IncompFlowMultiscaleMap &mmap,
+                  const IncompFlowCollisionManager &cman) {
+    lat.stream(bounds);
+    lat.swap_f_ptrs();
+    lat.collide_and_bound(mmap, cman, bounds);
+  };
+}
+
+//! Step that streams and collides slabs of columns on concurrent threads,
+//! joining the threads between streaming and collision
+//!
+//! \param nthreads Number of threads
+//! \return Execution mode
+//! \throw invalid_argument
+ExecutionMode slab_mode(const unsigned nthreads) {
+  if (nthreads == 0)
+    throw std::invalid_argument("A slab execution mode needs at least one "
+                                "thread.");
+  return [nthreads](Lattice &lat, IncompFlowMultiscaleMap &mmap,
+                    const IncompFlowCollisionManager &cman) {
+    const unsigned ni = lat.num_i(), nj = lat.num_j();
+    const auto sweep = [&](const std::function<void(unsigned, unsigned)> &f) {
+      std::vector<std::thread> threads;
+      for (unsigned t = 0; t < nthreads; ++t) {
+        const unsigned bi = ni * t / nthreads, ei = ni * (t + 1) / nthreads;
+        if (bi < ei)
+          threads.emplace_back(f, bi, ei - 1);
+      }
+      for (auto &thread : threads)
+        thread.join();
+    };
+    sweep([&](const unsigned bi, const unsigned ei) {
+      lat.stream(bi, ei, 0, nj - 1);
+    });
+    lat.swap_f_ptrs();
+    sweep([&](const unsigned bi, const unsigned ei) {
+      lat.collide_and_bound(mmap, cman, bi, ei, 0, nj - 1);
+    });
+  };
+}
+
+//! Constructor for a random case
+//!
+//! \param seed Seed the case is drawn from
+DifferentialCase::DifferentialCase(const std::uint32_t seed) : seed(seed) {
+  std::mt19937 gen(seed);
+  const auto uniform = [&](const double lo, const double hi) {
+    return std::uniform_real_distribution<double>(lo, hi)(gen);
+  };
+  const auto coin = [&]() { return std::bernoulli_distribution(0.5)(gen); };
+  ni = std::uniform_int_distribution<unsigned>(6, 40)(gen);
+  nj = std::uniform_int_distribution<unsigned>(6, 40)(gen);
+  periodic_i = coin();
+  periodic_j = coin();
+  solid_fraction = uniform(0.0, 0.3);
+  gray_fraction = coin() ? uniform(0.0, 0.2) : 0.0;
+  rho = uniform(0.8, 1.2);
+  mu = uniform(0.02, 0.5);
+  F[0] = uniform(-1e-4, 1e-4);
+  F[1] = uniform(-1e-4, 1e-4);
+  he_luo = coin();
+  guo = coin();
+  amplitude = uniform(0.0, 0.05);
+}
+
+//! Write a case, to reproduce a failure
+//!
+//! \param os Output stream
+//! \param c Case
+void write_case(std::ostream &os, const DifferentialCase &c) {
+  os << "case " << c.seed << ": " << c.ni << " x " << c.nj << " nodes"
+     << (c.periodic_i ? ", periodic in i" : "")
+     << (c.periodic_j ? ", periodic in j" : "") << ", solid "
+     << c.solid_fraction << ", gray " << c.gray_fraction << ", rho " << c.rho
+     << ", mu " << c.mu << ", F (" << c.F[0] << ", " << c.F[1] << "), "
+     << (c.he_luo ? "He-Luo" : "standard") << " equilibrium, "
+     << (c.guo ? "Guo" : "Sukop-Thorne") << " forcing, amplitude "
+     << c.amplitude;
+}
+
+//! Write the outcome of a comparison
+//!
+//! \param os Output stream
+//! \param r Report
+void write_report(std::ostream &os, const DiffReport &r) {
+  if (r.passed) {
+    os << (r.max_ulps == 0 ? "identical" : "within tolerance") << " over "
+       << r.steps << " steps, at most " << r.max_ulps << " ulps apart";
+    return;
+  }
+  const auto precision = os.precision(17);
+  os << "first difference at step " << r.step << ", node (" << r.i << ", "
+     << r.j << "), direction " << r.k << ": reference " << r.reference
+     << ", candidate " << r.candidate << " ("
+     << ulp_distance(r.reference, r.candidate) << " ulps apart)";
+  os.precision(precision);
+}
+
+//! Distance of two doubles in units in the last place
+//!
+//! \param a A double
+//! \param b Another double
+//! \return Number of representable doubles between a and b, the maximum if
+//!         either is NaN
+std::uint64_t ulp_distance(const double a, const double b) noexcept {
+  if (a == b)
+    return 0;
+  if (std::isnan(a) || std::isnan(b))
+    return std::numeric_limits<std::uint64_t>::max();
+  const auto key = [](const double x) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    // ordered like the doubles they represent, with both zeros at 2^63
+    const std::uint64_t sign = std::uint64_t(1) << 63;
+    return (bits & sign) ? sign - (bits & ~sign) : sign + bits;
+  };
+  const std::uint64_t ka = key(a), kb = key(b);
+  return (ka > kb) ? ka - kb : kb - ka;
+}
+
+//! Build the state of a case
+//!
+//! \param c Case
+//! \param geom Geometry of the case
+DifferentialHarness::State::State(const DifferentialCase &c,
+                                  const Geometry &geom)
+    : lat(c.ni, c.nj, c.rho),
+      mmap(c.ni, c.nj, mu_to_omega(c.mu, Lattice::cssq(), Lattice::dt())),
+      cman(c.he_luo ? static_cast<AbstractIncompFlowEqFunct *>(
+                          new IncompFlowHLEqFunct(c.rho))
+                    : new IncompFlowEqFunct(),
+           new NewtonianConstitutiveEq(c.mu),
+           c.guo ? static_cast<AbstractForce *>(
+                       new GuoForce(const_cast<double *>(c.F)))
+                 : new SukopThorneForce(const_cast<double *>(c.F))) {
+  geom.apply(lat);
+  std::mt19937 gen(c.seed ^ 0x9e3779b9u);
+  std::uniform_real_distribution<double> noise(-c.amplitude, c.amplitude);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  for (unsigned i = 0; i < c.ni; ++i)
+    for (unsigned j = 0; j < c.nj; ++j) {
+      for (unsigned k = 0; k < lat.num_k(); ++k)
+        lat.f(i, j, k) = lat.w(k) * c.rho * (1.0 + noise(gen));
+      if (unit(gen) < c.gray_fraction)
+        mmap.set_solid_fraction(i, j, unit(gen));
+    }
+}
+
+//! Constructor
+//!
+//! \param c Case to compare execution modes on
+DifferentialHarness::DifferentialHarness(const DifferentialCase &c)
+    : case_(c) {
+  GeometryMask mask(c.ni, c.nj);
+  std::mt19937 gen(c.seed + 1);
+  std::bernoulli_distribution solid(c.solid_fraction);
+  for (unsigned i = 0; i < c.ni; ++i)
+    for (unsigned j = 0; j < c.nj; ++j)
+      mask.set_solid(i, j, solid(gen));
+  spgeom_.reset(new Geometry(mask, c.periodic_i, c.periodic_j, 1));
+}
+
+//! Step an execution mode next to the reference and compare populations
+//!
+//! Stops at the end of the first step with a population out of tolerance.
+//!
+//! \param mode Execution mode
+//! \param nsteps Number of steps
+//! \param tol Tolerance
+//! \return Report of the comparison
+DiffReport DifferentialHarness::compare(const ExecutionMode &mode,
+                                        const unsigned nsteps,
+                                        const DiffTolerance &tol) const {
+  State ref(case_, *spgeom_), cand(case_, *spgeom_);
+  DiffReport report = {true, 0, 0, 0, 0, 0, 0.0, 0.0, 0};
+  const unsigned nj = case_.nj, nk = Lattice::num_k();
+  const std::size_t n = std::size_t(case_.ni) * nj * nk;
+
+  for (unsigned step = 1; step <= nsteps && report.passed; ++step) {
+    reference_step(ref.lat, ref.mmap, ref.cman);
+    mode(cand.lat, cand.mmap, cand.cman);
+    ++report.steps;
+
+    const double *pref = ref.lat.pf(), *pcand = cand.lat.pf();
+    for (std::size_t idx = 0; idx < n; ++idx) {
+      const double a = pref[idx], b = pcand[idx];
+      const std::uint64_t ulps = ulp_distance(a, b);
+      report.max_ulps = std::max(report.max_ulps, ulps);
+      if (!report.passed || ulps <= tol.max_ulps ||
+          std::abs(a - b) <= tol.rel * std::max(std::abs(a), std::abs(b)))
+        continue;
+      report.passed = false;
+      report.step = step;
+      report.i = idx / (std::size_t(nj) * nk);
+      report.j = (idx / nk) % nj;
+      report.k = idx % nk;
+      report.reference = a;
+      report.candidate = b;
+    }
+  }
+  return report;
+}
+
+} // namespace d2q9
+
+} // namespace balbm
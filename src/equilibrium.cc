@@ -13,16 +13,16 @@
 //
 // A copy of the GNU General Public License is at the root directory of
 
+#include "equilibrium.hh"
 #include "equilibrium.hh"
 #include "lattice.hh"
 #include <armadillo>
 
 namespace balbm {
 
-namespace d2q9 {
-
 //! Virtual destructor definition
-AbstractIncompFlowEqFunct::~AbstractIncompFlowEqFunct() {}
+template <typename VS>
+AbstractIncompFlowEqFunct<VS>::~AbstractIncompFlowEqFunct() {}
 
 //! Equilibrium distribution function for incompressible flow
 //!
@@ -31,35 +31,31 @@ AbstractIncompFlowEqFunct::~AbstractIncompFlowEqFunct() {}
 //! \param u Macroscopic velocity vector
 //! \param k Index of lattice direction
 //! \return Equilibrium particle distribution
-double IncompFlowEqFunct::f_(const Lattice &lat, const double rho,
-                             const arma::vec &u, const unsigned k) const {
-  const arma::vec ck(const_cast<double *>(lat.pc(k)), 2, false, true);
-  const double ckdotu = arma::dot(ck, u);
-  const double cssq = lat.cssq();
-
-  return rho * lat.w(k) *
-         (1.0 + ckdotu / cssq + 0.5 * (ckdotu * ckdotu) / (cssq * cssq) -
-          0.5 * dot(u, u) / cssq);
+template <typename VS>
+double IncompFlowEqFunct<VS>::f_(const Lattice<VS> &, const double rho,
+                                 const arma::vec &u, const unsigned k) const {
+  return incomp_feq<VS>(rho, u.memptr(), k);
 }
 
-//! Equilibrium distribution function for incompressible flow
+//! He and Luo equilibrium distribution function for incompressible flow
 //!
 //! \param lat Lattice
 //! \param rho Density at the lattice node
 //! \param u Macroscopic velocity vector
 //! \param k Index of lattice direction
 //! \return Equilibrium particle distribution
-double IncompFlowHLEqFunct::f_(const Lattice &lat, const double rho,
-                               const arma::vec &u, const unsigned k) const {
-  const arma::vec ck(const_cast<double *>(lat.pc(k)), 2, false, true);
-  const double ckdotu = arma::dot(ck, u);
-  const double cssq = lat.cssq();
-
-  return (lat.w(k) * (rho + rho_o_ +
-                      (ckdotu / cssq + 0.5 * (ckdotu * ckdotu) / (cssq * cssq) -
-                       0.5 * dot(u, u) / cssq)));
+template <typename VS>
+double IncompFlowHLEqFunct<VS>::f_(const Lattice<VS> &, const double rho,
+                                   const arma::vec &u,
+                                   const unsigned k) const {
+  return incomp_hl_feq<VS>(rho, rho_o_, u.memptr(), k);
 }
 
-} // namespace d2q9
+template class AbstractIncompFlowEqFunct<D2Q9>;
+template class IncompFlowEqFunct<D2Q9>;
+template class IncompFlowHLEqFunct<D2Q9>;
+template class AbstractIncompFlowEqFunct<D3Q19>;
+template class IncompFlowEqFunct<D3Q19>;
+template class IncompFlowHLEqFunct<D3Q19>;
 
 } // namespace balbm
@@ -0,0 +1,417 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "field_writers.hh"
+#include "statistics.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Name of the file of one time step of a series
+//!
+//! \param prefix Prefix of the series
+//! \param step Time step
+//! \param ext File extension
+//! \return Name of the file
+static std::string step_file_name(const std::string &prefix,
+                                  const unsigned step, const char *ext) {
+  std::ostringstream oss;
+  oss << prefix << '_' << std::setfill('0') << std::setw(8) << step << ext;
+  return oss.str();
+}
+
+//! Strip the directories from a path
+static std::string base_name(const std::string &path) {
+  const std::size_t slash = path.find_last_of('/');
+  return (slash == std::string::npos) ? path : path.substr(slash + 1);
+}
+
+//! Replace a file with new contents, never leaving a partial file behind
+//!
+//! \param path Path of the file
+//! \param contents New contents of the file
+//! \throw runtime_error
+static void replace_file(const std::string &path,
+                         const std::string &contents) {
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream ofs(tmp_path, std::ios::binary | std::ios::trunc);
+    ofs << contents;
+    if (!ofs)
+      throw std::runtime_error("Unable to write " + tmp_path + '.');
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+    throw std::runtime_error("Unable to replace " + path + '.');
+}
+
+//! Whether this machine stores numbers little endian
+static bool is_little_endian() {
+  const std::uint16_t one = 1;
+  return *reinterpret_cast<const unsigned char *>(&one) == 1;
+}
+
+//! Transpose a field from lattice order (j fastest) to VTK order (i fastest)
+//!
+//! \param src Field in lattice order, one record of stride values per node
+//! \param ni Number of nodes in the x-direction
+//! \param nj Number of nodes in the y-direction
+//! \param stride Number of values per node in src
+//! \param ncsrc Number of components per node taken from src
+//! \param ncdst Number of components per node in dst, extra ones are zeroed
+//! \param dst Destination
+static void transpose_to_vtk(const double *src, const unsigned ni,
+                             const unsigned nj, const unsigned stride,
+                             const unsigned ncsrc, const unsigned ncdst,
+                             std::vector<double> &dst) {
+  dst.assign(std::size_t(ni) * nj * ncdst, 0.0);
+  for (unsigned i = 0; i < ni; ++i)
+    for (unsigned j = 0; j < nj; ++j) {
+      const double *p = src + (std::size_t(i) * nj + j) * stride;
+      std::copy(p, p + ncsrc, &dst[(std::size_t(j) * ni + i) * ncdst]);
+    }
+}
+
+//! \struct VtiArray
+//!
+//! \brief Field written to a VTK image data file
+struct VtiArray {
+  const char *name;
+  const double *psrc; //!< field in lattice order
+  unsigned stride;    //!< values per node in psrc
+  unsigned ncsrc;     //!< components per node taken from psrc
+  unsigned ncdst;     //!< components per node in the file
+};
+
+//! Write fields as VTK image data with appended raw arrays
+//!
+//! \param path Path of the .vti file
+//! \param ni Number of nodes in the x-direction
+//! \param nj Number of nodes in the y-direction
+//! \param origin Coordinates of node (0, 0)
+//! \param spacing Distance between nodes
+//! \param arrays Fields to write
+//! \param active Scalars and Vectors attributes of the point data
+//! \throw runtime_error
+static void write_vti(const std::string &path, const unsigned ni,
+                      const unsigned nj, const double *origin,
+                      const double spacing, const std::vector<VtiArray> &arrays,
+                      const char *active) {
+  const std::size_t n = std::size_t(ni) * nj;
+  std::ostringstream header;
+  header << "<?xml version=\"1.0\"?>\n"
+         << "<VTKFile type=\"ImageData\" version=\"1.0\" byte_order=\""
+         << (is_little_endian() ? "LittleEndian" : "BigEndian")
+         << "\" header_type=\"UInt64\">\n";
+  std::ostringstream extent;
+  extent << "0 " << ni - 1 << " 0 " << nj - 1 << " 0 0";
+  header << "  <ImageData WholeExtent=\"" << extent.str() << "\" Origin=\""
+         << origin[0] << ' ' << origin[1] << " 0\" Spacing=\"" << spacing
+         << ' ' << spacing << " 1\">\n"
+         << "    <Piece Extent=\"" << extent.str() << "\">\n"
+         << "      <PointData " << active << ">\n";
+  std::uint64_t offset = 0;
+  for (const auto &array : arrays) {
+    header << "        <DataArray type=\"Float64\" Name=\"" << array.name
+           << "\" NumberOfComponents=\"" << array.ncdst
+           << "\" format=\"appended\" offset=\"" << offset << "\"/>\n";
+    offset += sizeof(std::uint64_t) + n * array.ncdst * sizeof(double);
+  }
+  header << "      </PointData>\n"
+         << "      <CellData>\n"
+         << "      </CellData>\n"
+         << "    </Piece>\n"
+         << "  </ImageData>\n"
+         << "  <AppendedData encoding=\"raw\">\n"
+         << "   _";
+
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  ofs << header.str();
+  std::vector<double> buffer;
+  for (const auto &array : arrays) {
+    transpose_to_vtk(array.psrc, ni, nj, array.stride, array.ncsrc,
+                     array.ncdst, buffer);
+    const std::uint64_t bytes = buffer.size() * sizeof(double);
+    ofs.write(reinterpret_cast<const char *>(&bytes), sizeof(bytes));
+    ofs.write(reinterpret_cast<const char *>(buffer.data()), bytes);
+  }
+  ofs << "\n  </AppendedData>\n"
+      << "</VTKFile>\n";
+  ofs.close();
+  if (!ofs)
+    throw std::runtime_error("Unable to write " + path + '.');
+}
+
+//! Write a frame as VTK image data and update the series index
+//!
+//! \param frame Staged fields
+void VtkImageWriter::write_(const FieldFrame &frame) {
+  std::vector<VtiArray> arrays;
+  if (!frame.rho.empty())
+    arrays.push_back({"rho", frame.rho.data(), 1, 1, 1});
+  if (!frame.u.empty())
+    arrays.push_back({"u", frame.u.data(), 2, 2, 3});
+  if (!frame.omega.empty())
+    arrays.push_back({"omega", frame.omega.data(), 1, 1, 1});
+  if (!frame.f.empty())
+    arrays.push_back({"f", frame.f.data(), frame.nk, frame.nk, frame.nk});
+  write_vti(step_file_name(prefix_, frame.step, ".vti"), frame.ni, frame.nj,
+            frame.origin, frame.spacing, arrays,
+            "Scalars=\"rho\" Vectors=\"u\"");
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  steps_.insert(std::upper_bound(steps_.begin(), steps_.end(), frame.step),
+                frame.step);
+  write_index_();
+}
+
+//! Rewrite the ParaView data collection indexing the series
+void VtkImageWriter::write_index_() {
+  std::ostringstream oss;
+  oss << "<?xml version=\"1.0\"?>\n"
+      << "<VTKFile type=\"Collection\" version=\"1.0\">\n"
+      << "  <Collection>\n";
+  for (const auto step : steps_)
+    oss << "    <DataSet timestep=\"" << step << "\" file=\""
+        << base_name(step_file_name(prefix_, step, ".vti")) << "\"/>\n";
+  oss << "  </Collection>\n"
+      << "</VTKFile>\n";
+  replace_file(prefix_ + ".pvd", oss.str());
+}
+
+//! Write the running statistics of every node as VTK image data
+//!
+//! Writes the mean, root mean square fluctuation, minimum and maximum of rho
+//! and u and the Reynolds stresses <ux' ux'>, <uy' uy'> and <ux' uy'>.
+//!
+//! \param path Path of the .vti file
+//! \param stats Running statistics
+//! \throw runtime_error
+void write_statistics(const std::string &path, const FlowStatistics &stats) {
+  const unsigned ni = stats.num_i();
+  const unsigned nj = stats.num_j();
+  const std::size_t n = std::size_t(ni) * nj;
+  std::vector<double> rms(3 * n);
+  std::vector<double> stress(3 * n);
+  for (unsigned i = 0; i < ni; ++i)
+    for (unsigned j = 0; j < nj; ++j) {
+      const std::size_t idx = std::size_t(i) * nj + j;
+      rms[3 * idx] = std::sqrt(stats.var_rho(i, j));
+      rms[3 * idx + 1] = stats.rms_u(i, j, 0);
+      rms[3 * idx + 2] = stats.rms_u(i, j, 1);
+      stress[3 * idx] = stats.reynolds_stress(i, j, 0, 0);
+      stress[3 * idx + 1] = stats.reynolds_stress(i, j, 1, 1);
+      stress[3 * idx + 2] = stats.reynolds_stress(i, j, 0, 1);
+    }
+
+  const unsigned ns = FlowStatistics::NUM_SLOTS;
+  const double *p = stats.pdata();
+  const std::vector<VtiArray> arrays = {
+      {"mean_rho", p + FlowStatistics::MEAN_RHO, ns, 1, 1},
+      {"mean_u", p + FlowStatistics::MEAN_UX, ns, 2, 3},
+      {"rms_rho", rms.data(), 3, 1, 1},
+      {"rms_u", rms.data() + 1, 3, 2, 3},
+      {"reynolds_stress", stress.data(), 3, 3, 3},
+      {"min_rho", p + FlowStatistics::MIN_RHO, ns, 1, 1},
+      {"max_rho", p + FlowStatistics::MAX_RHO, ns, 1, 1},
+      {"min_u", p + FlowStatistics::MIN_UX, ns, 2, 3},
+      {"max_u", p + FlowStatistics::MAX_UX, ns, 2, 3}};
+  const double origin[] = {0.0, 0.0};
+  write_vti(path, ni, nj, origin, 1.0, arrays,
+            "Scalars=\"mean_rho\" Vectors=\"mean_u\"");
+}
+
+#ifdef BALBM_USE_HDF5
+//! Serializes calls into the HDF5 library, which is not thread safe
+static std::mutex hdf5_mutex;
+
+//! Constructor for an HDF5 field writer
+//!
+//! \param prefix Prefix of the .h5 and .xmf files
+//! \param chunk Edge length of dataset chunks in nodes
+//! \param deflate_level Compression level 0-9, 0 for no compression
+//! \throw runtime_error
+Hdf5FieldWriter::Hdf5FieldWriter(const std::string &prefix,
+                                 const unsigned chunk,
+                                 const unsigned deflate_level)
+    : prefix_(prefix), chunk_(std::max(chunk, 1u)),
+      deflate_level_(std::min(deflate_level, 9u)), fields_(0), ni_(0),
+      nj_(0), origin_{0.0, 0.0}, spacing_(1.0) {
+  std::lock_guard<std::mutex> lock(hdf5_mutex);
+  file_ = H5Fcreate((prefix_ + ".h5").c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
+                    H5P_DEFAULT);
+  if (file_ < 0)
+    throw std::runtime_error("Unable to create " + prefix_ + ".h5.");
+}
+
+//! Destructor, closes the HDF5 file
+Hdf5FieldWriter::~Hdf5FieldWriter() {
+  std::lock_guard<std::mutex> lock(hdf5_mutex);
+  H5Fclose(file_);
+}
+
+//! Write one field of a frame as a chunked, compressed dataset
+//!
+//! \param group HDF5 group
+//! \param name Name of the dataset
+//! \param data Field in lattice order
+//! \param ni Number of nodes in the x-direction
+//! \param nj Number of nodes in the y-direction
+//! \param nc Number of components per node
+//! \param chunk Edge length of chunks in nodes
+//! \param deflate_level Compression level, 0 for no compression
+//! \return true on success
+static bool write_dataset(const hid_t group, const char *name,
+                          const double *data, const unsigned ni,
+                          const unsigned nj, const unsigned nc,
+                          const unsigned chunk, const unsigned deflate_level) {
+  const int rank = (nc == 1) ? 2 : 3;
+  const hsize_t dims[] = {ni, nj, nc};
+  const hsize_t chunks[] = {std::min(ni, chunk), std::min(nj, chunk), nc};
+
+  const hid_t space = H5Screate_simple(rank, dims, nullptr);
+  const hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
+  H5Pset_chunk(plist, rank, chunks);
+  if (deflate_level > 0) {
+    H5Pset_shuffle(plist);
+    H5Pset_deflate(plist, deflate_level);
+  }
+  const hid_t dset = H5Dcreate2(group, name, H5T_IEEE_F64LE, space,
+                                H5P_DEFAULT, plist, H5P_DEFAULT);
+  const bool ok = dset >= 0 && H5Dwrite(dset, H5T_NATIVE_DOUBLE, H5S_ALL,
+                                        H5S_ALL, H5P_DEFAULT, data) >= 0;
+  if (dset >= 0)
+    H5Dclose(dset);
+  H5Pclose(plist);
+  H5Sclose(space);
+  return ok;
+}
+
+//! Write a frame to the HDF5 file and update the XDMF index
+//!
+//! \param frame Staged fields
+void Hdf5FieldWriter::write_(const FieldFrame &frame) {
+  std::lock_guard<std::mutex> lock(hdf5_mutex);
+
+  std::ostringstream name;
+  name << "step_" << frame.step;
+  const hid_t group = H5Gcreate2(file_, name.str().c_str(), H5P_DEFAULT,
+                                 H5P_DEFAULT, H5P_DEFAULT);
+  if (group < 0)
+    throw std::runtime_error("Unable to create group " + name.str() + " in " +
+                             prefix_ + ".h5.");
+
+  // XDMF vectors have three components, so u gets a zero z-component
+  std::vector<double> u;
+  if (!frame.u.empty()) {
+    u.assign(frame.u.size() / 2 * 3, 0.0);
+    for (std::size_t idx = 0; idx < frame.u.size() / 2; ++idx) {
+      u[3 * idx] = frame.u[2 * idx];
+      u[3 * idx + 1] = frame.u[2 * idx + 1];
+    }
+  }
+
+  struct Dataset {
+    const char *name;
+    const std::vector<double> *pdata;
+    unsigned nc;
+  };
+  const Dataset datasets[] = {{"rho", &frame.rho, 1},
+                              {"u", &u, 3},
+                              {"omega", &frame.omega, 1},
+                              {"f", &frame.f, frame.nk}};
+  bool ok = true;
+  for (const auto &dataset : datasets)
+    if (!dataset.pdata->empty())
+      ok = ok && write_dataset(group, dataset.name, dataset.pdata->data(),
+                               frame.ni, frame.nj, dataset.nc, chunk_,
+                               deflate_level_);
+  H5Gclose(group);
+  if (!ok)
+    throw std::runtime_error("Unable to write " + name.str() + " to " +
+                             prefix_ + ".h5.");
+  H5Fflush(file_, H5F_SCOPE_GLOBAL);
+
+  fields_ = frame.fields;
+  ni_ = frame.ni;
+  nj_ = frame.nj;
+  origin_[0] = frame.origin[0];
+  origin_[1] = frame.origin[1];
+  spacing_ = frame.spacing;
+  steps_.insert(std::upper_bound(steps_.begin(), steps_.end(), frame.step),
+                frame.step);
+  write_index_();
+}
+
+//! Rewrite the XDMF file indexing the macroscopic fields of the series
+void Hdf5FieldWriter::write_index_() {
+  const std::string h5 = base_name(prefix_) + ".h5";
+  std::ostringstream dims;
+  dims << ni_ << ' ' << nj_;
+
+  std::ostringstream oss;
+  oss << "<?xml version=\"1.0\" ?>\n"
+      << "<Xdmf Version=\"3.0\">\n"
+      << "  <Domain>\n"
+      << "    <Grid Name=\"series\" GridType=\"Collection\" "
+      << "CollectionType=\"Temporal\">\n";
+  for (const auto step : steps_) {
+    oss << "      <Grid Name=\"step_" << step << "\" GridType=\"Uniform\">\n"
+        << "        <Time Value=\"" << step << "\"/>\n"
+        << "        <Topology TopologyType=\"2DCoRectMesh\" Dimensions=\""
+        << dims.str() << "\"/>\n"
+        << "        <Geometry GeometryType=\"ORIGIN_DXDY\">\n"
+        << "          <DataItem Format=\"XML\" Dimensions=\"2\">"
+        << origin_[0] << ' ' << origin_[1] << "</DataItem>\n"
+        << "          <DataItem Format=\"XML\" Dimensions=\"2\">"
+        << spacing_ << ' ' << spacing_ << "</DataItem>\n"
+        << "        </Geometry>\n";
+    const auto attribute = [&](const char *name, const char *type,
+                               const char *extra_dim) {
+      oss << "        <Attribute Name=\"" << name << "\" AttributeType=\""
+          << type << "\" Center=\"Node\">\n"
+          << "          <DataItem Format=\"HDF\" NumberType=\"Float\" "
+          << "Precision=\"8\" Dimensions=\"" << dims.str() << extra_dim
+          << "\">" << h5 << ":/step_" << step << '/' << name
+          << "</DataItem>\n"
+          << "        </Attribute>\n";
+    };
+    if (fields_ & OUTPUT_RHO)
+      attribute("rho", "Scalar", "");
+    if (fields_ & OUTPUT_U)
+      attribute("u", "Vector", " 3");
+    if (fields_ & OUTPUT_OMEGA)
+      attribute("omega", "Scalar", "");
+    oss << "      </Grid>\n";
+  }
+  oss << "    </Grid>\n"
+      << "  </Domain>\n"
+      << "</Xdmf>\n";
+  replace_file(prefix_ + ".xmf", oss.str());
+}
+#endif
+
+} // namespace d2q9
+
+} // namespace balbm
@@ -20,19 +20,17 @@
 
 namespace balbm {
 
-namespace d2q9 {
-
 //! Virtual destructor for AbstractForce base class
-AbstractForce::~AbstractForce() {}
+template <typename VS> AbstractForce<VS>::~AbstractForce() {}
 
 //! Transforms macroscopic velocity vector to simulate external forces
 //!
 //! \param lat Lattice
 //! \param u Macroscopic velocity vector
 //! \return Transformed velocity vector
-arma::vec::fixed<2>
-SukopThorneForce::u_trans_(const Lattice &,
-                           const arma::vec::fixed<2> &u) const {
+template <typename VS>
+typename SukopThorneForce<VS>::vec
+SukopThorneForce<VS>::u_trans_(const Lattice<VS> &, const vec &u) const {
   return u;
 }
 
@@ -42,11 +40,10 @@ SukopThorneForce::u_trans_(const Lattice &,
 //! \param omega Collision frequency
 //! \param u Macroscopic velocity vector
 //! \param k Index of lattice direction
-double SukopThorneForce::f_col_(const Lattice &lat, const double,
-                                const arma::vec::fixed<2> &,
-                                const unsigned k) const {
-  const arma::vec ck(const_cast<double *>(lat.pc(k)), 2, false, true);
-  return lat.w(k) * lat.dt() / lat.cssq() * arma::dot(F(), ck);
+template <typename VS>
+double SukopThorneForce<VS>::f_col_(const Lattice<VS> &lat, const double,
+                                    const vec &, const unsigned k) const {
+  return lat.dt() * sukop_thorne_f_col<VS>(this->F().memptr(), k);
 }
 
 //! Transforms macroscopic velocity vector to simulate external forces
@@ -54,9 +51,10 @@ double SukopThorneForce::f_col_(const Lattice &lat, const double,
 //! \param lat Lattice
 //! \param u Macroscopic velocity vector
 //! \return Transformed velocity vector
-arma::vec::fixed<2> GuoForce::u_trans_(const Lattice &lat,
-                                       const arma::vec::fixed<2> &u) const {
-  return u + (lat.dt() / 2.0 * F());
+template <typename VS>
+typename GuoForce<VS>::vec GuoForce<VS>::u_trans_(const Lattice<VS> &lat,
+                                                  const vec &u) const {
+  return u + (lat.dt() / 2.0 * this->F());
 }
 
 //! Value to add to particle distributions to simulate effect of external forces
@@ -65,15 +63,17 @@ arma::vec::fixed<2> GuoForce::u_trans_(const Lattice &lat,
 //! \param omega Collision frequency
 //! \param u Macroscopic velocity vector
 //! \param k Index of lattice direction
-double GuoForce::f_col_(const Lattice &lat, const double omega,
-                        const arma::vec::fixed<2> &u, const unsigned k) const {
-  const arma::vec ck(const_cast<double *>(lat.pc(k)), 2, false, true);
-  return ((1 - 0.5 * omega) * lat.w(k) *
-          arma::dot((ck - u) / (lat.cssq()) -
-                        arma::dot(ck, u) / (lat.cssq() * lat.cssq()) * ck,
-                    F()));
+template <typename VS>
+double GuoForce<VS>::f_col_(const Lattice<VS> &, const double omega,
+                            const vec &u, const unsigned k) const {
+  return guo_f_col<VS>(omega, u.memptr(), this->F().memptr(), k);
 }
 
-} // namespace d2q9
+template class AbstractForce<D2Q9>;
+template class SukopThorneForce<D2Q9>;
+template class GuoForce<D2Q9>;
+template class AbstractForce<D3Q19>;
+template class SukopThorneForce<D3Q19>;
+template class GuoForce<D3Q19>;
 
 } // namespace balbm
@@ -0,0 +1,593 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "geometry.hh"
+#include "lattice.hh"
+#include "node_desc.hh"
+#include "velocity_set.hh"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#ifdef BALBM_USE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Throw on a mask or geometry cache that can not be read
+//!
+//! \param what Description of the problem
+//! \param path Path of the file
+static void throw_bad(const std::string &what, const std::string &path) {
+  std::ostringstream oss;
+  oss << "Geometry " << path << ": " << what;
+  throw std::runtime_error(oss.str());
+}
+
+//! Constructor for a mask with every node fluid
+//!
+//! \param ni Number of nodes in the x-direction
+//! \param nj Number of nodes in the y-direction
+GeometryMask::GeometryMask(const unsigned ni, const unsigned nj)
+    : ni_(ni), nj_(nj), data_(std::size_t(ni) * nj, 0), pmap_(nullptr),
+      map_bytes_(0), pmask_(data_.data()) {}
+
+//! Constructor for a mask read from a PGM or PNG image
+//!
+//! \param path Path of the image
+//! \throw runtime_error
+GeometryMask::GeometryMask(const std::string &path)
+    : ni_(0), nj_(0), pmap_(nullptr), map_bytes_(0), pmask_(nullptr) {
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs)
+    throw std::runtime_error("Unable to open " + path + '.');
+  const std::vector<char> bytes((std::istreambuf_iterator<char>(ifs)),
+                                std::istreambuf_iterator<char>());
+  if (bytes.size() >= 2 && bytes[0] == 'P' &&
+      (bytes[1] == '2' || bytes[1] == '5'))
+    read_pgm_(path, bytes);
+  else if (bytes.size() >= 8 &&
+           std::equal(bytes.begin(), bytes.begin() + 8, "\x89PNG\r\n\x1a\n"))
+    read_png_(path, bytes);
+  else
+    throw_bad("not a PGM or PNG image.", path);
+  pmask_ = data_.data();
+}
+
+//! Constructor for a mask memory mapped from a raw file
+//!
+//! \param path Path of a file of ni * nj bytes in lattice order
+//! \param ni Number of nodes in the x-direction
+//! \param nj Number of nodes in the y-direction
+//! \throw runtime_error
+GeometryMask::GeometryMask(const std::string &path, const unsigned ni,
+                           const unsigned nj)
+    : ni_(ni), nj_(nj), pmap_(nullptr), map_bytes_(std::size_t(ni) * nj),
+      pmask_(nullptr) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Unable to open " + path + '.');
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) !=
+                                 map_bytes_) {
+    close(fd);
+    std::ostringstream oss;
+    oss << "raw mask is not " << ni << " x " << nj << " bytes.";
+    throw_bad(oss.str(), path);
+  }
+  if (map_bytes_ > 0) {
+    pmap_ = mmap(nullptr, map_bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                 0);
+    if (pmap_ == MAP_FAILED) {
+      const int err = errno;
+      close(fd);
+      throw_bad(std::string("mmap failed, ") + std::strerror(err) + '.', path);
+    }
+    madvise(pmap_, map_bytes_, MADV_SEQUENTIAL);
+  }
+  close(fd);
+  pmask_ = static_cast<std::uint8_t *>(pmap_);
+}
+
+//! Destructor, unmaps a raw mask
+GeometryMask::~GeometryMask() {
+  if (pmap_ != nullptr)
+    munmap(pmap_, map_bytes_);
+}
+
+//! Read a binary (P5) or plain (P2) PGM image
+//!
+//! \param path Path of the image
+//! \param bytes Contents of the image file
+//! \throw runtime_error
+void GeometryMask::read_pgm_(const std::string &path,
+                             const std::vector<char> &bytes) {
+  std::size_t pos = 2;
+  const auto at = [&](const std::size_t q) {
+    return static_cast<unsigned char>(bytes[q]);
+  };
+  const auto next_token = [&]() {
+    for (;;) {
+      while (pos < bytes.size() && std::isspace(at(pos)))
+        ++pos;
+      if (pos < bytes.size() && bytes[pos] == '#')
+        while (pos < bytes.size() && bytes[pos] != '\n')
+          ++pos;
+      else
+        break;
+    }
+    unsigned long value = 0;
+    const std::size_t start = pos;
+    while (pos < bytes.size() && std::isdigit(at(pos)))
+      value = 10 * value + (at(pos++) - '0');
+    if (pos == start || value > UINT32_MAX)
+      throw_bad("malformed PGM header.", path);
+    return static_cast<unsigned>(value);
+  };
+  const bool plain = bytes[1] == '2';
+  const unsigned width = next_token();
+  const unsigned height = next_token();
+  const unsigned maxval = next_token();
+  if (maxval == 0 || maxval > 65535)
+    throw_bad("PGM maximum value is out of range.", path);
+  ++pos; // single whitespace before the raster
+
+  ni_ = width;
+  nj_ = height;
+  data_.assign(std::size_t(width) * height, 0);
+  const unsigned sample_bytes = (maxval > 255) ? 2 : 1;
+  if (!plain && bytes.size() - std::min(pos, bytes.size()) <
+                    std::size_t(width) * height * sample_bytes)
+    throw_bad("PGM raster is truncated.", path);
+  for (unsigned r = 0; r < height; ++r)
+    for (unsigned x = 0; x < width; ++x) {
+      unsigned value;
+      if (plain) {
+        value = next_token();
+      } else {
+        value = (sample_bytes == 2) ? (at(pos) << 8 | at(pos + 1)) : at(pos);
+        pos += sample_bytes;
+      }
+      data_[std::size_t(x) * nj_ + (height - 1 - r)] = 2 * value < maxval;
+    }
+}
+
+//! Read a PNG image, any color type, bit depth and filter, not interlaced
+//!
+//! \param path Path of the image
+//! \param bytes Contents of the image file
+//! \throw runtime_error
+#ifdef BALBM_USE_ZLIB
+void GeometryMask::read_png_(const std::string &path,
+                             const std::vector<char> &bytes) {
+  const auto *p = reinterpret_cast<const unsigned char *>(bytes.data());
+  const auto be32 = [](const unsigned char *q) {
+    return std::uint32_t(q[0]) << 24 | std::uint32_t(q[1]) << 16 |
+           std::uint32_t(q[2]) << 8 | std::uint32_t(q[3]);
+  };
+
+  unsigned width = 0, height = 0, depth = 0, color = 0;
+  std::vector<unsigned char> palette, zdata;
+  for (std::size_t pos = 8;;) {
+    if (bytes.size() - pos < 12)
+      throw_bad("PNG image is truncated.", path);
+    const std::uint32_t length = be32(p + pos);
+    if (bytes.size() - pos - 12 < length)
+      throw_bad("PNG image is truncated.", path);
+    const std::string type(&bytes[pos + 4], 4);
+    const unsigned char *data = p + pos + 8;
+    if (type == "IHDR" && length >= 13) {
+      width = be32(data);
+      height = be32(data + 4);
+      depth = data[8];
+      color = data[9];
+      if (data[12] != 0)
+        throw_bad("interlaced PNG images are not supported.", path);
+    } else if (type == "PLTE") {
+      palette.assign(data, data + length);
+    } else if (type == "IDAT") {
+      zdata.insert(zdata.end(), data, data + length);
+    } else if (type == "IEND") {
+      break;
+    }
+    pos += 12 + length;
+  }
+
+  unsigned channels;
+  switch (color) {
+  case 0: // gray
+  case 3: // palette
+    channels = 1;
+    break;
+  case 2: // RGB
+    channels = 3;
+    break;
+  case 4: // gray and alpha
+    channels = 2;
+    break;
+  case 6: // RGBA
+    channels = 4;
+    break;
+  default:
+    throw_bad("PNG color type is not supported.", path);
+  }
+  if (width == 0 || height == 0 || (depth != 1 && depth != 2 && depth != 4 &&
+                                    depth != 8 && depth != 16))
+    throw_bad("PNG header is not valid.", path);
+
+  // every scanline is preceded by its filter type
+  const std::size_t bits = std::size_t(channels) * depth;
+  const std::size_t bpp = std::max<std::size_t>(1, bits / 8);
+  const std::size_t row_bytes = (bits * width + 7) / 8;
+  std::vector<unsigned char> raw(height * (row_bytes + 1));
+  uLongf raw_bytes = raw.size();
+  if (uncompress(raw.data(), &raw_bytes, zdata.data(), zdata.size()) != Z_OK ||
+      raw_bytes != raw.size())
+    throw_bad("PNG image data is corrupt.", path);
+
+  std::vector<unsigned char> prev(row_bytes, 0), row(row_bytes);
+  ni_ = width;
+  nj_ = height;
+  data_.assign(std::size_t(width) * height, 0);
+  for (unsigned r = 0; r < height; ++r) {
+    const unsigned char *in = &raw[r * (row_bytes + 1)];
+    const unsigned filter = *in++;
+    for (std::size_t b = 0; b < row_bytes; ++b) {
+      const int a = (b >= bpp) ? row[b - bpp] : 0;
+      const int up = prev[b];
+      const int c = (b >= bpp) ? prev[b - bpp] : 0;
+      int predictor;
+      switch (filter) {
+      case 0:
+        predictor = 0;
+        break;
+      case 1:
+        predictor = a;
+        break;
+      case 2:
+        predictor = up;
+        break;
+      case 3:
+        predictor = (a + up) / 2;
+        break;
+      case 4: {
+        const int pa = std::abs(up - c);
+        const int pb = std::abs(a - c);
+        const int pc = std::abs(a + up - 2 * c);
+        predictor = (pa <= pb && pa <= pc) ? a : ((pb <= pc) ? up : c);
+        break;
+      }
+      default:
+        throw_bad("PNG filter type is not valid.", path);
+      }
+      row[b] = static_cast<unsigned char>(in[b] + predictor);
+    }
+
+    // gray level of every pixel, scaled to [0, 255]
+    const auto sample = [&](const unsigned x, const unsigned ch) {
+      const std::size_t bit = (std::size_t(x) * channels + ch) * depth;
+      if (depth >= 8) // high byte of 16 bit samples
+        return unsigned(row[bit / 8]);
+      const unsigned shift = 8 - depth - bit % 8;
+      const unsigned v = (row[bit / 8] >> shift) & ((1u << depth) - 1);
+      return (color == 3) ? v : v * 255 / ((1u << depth) - 1);
+    };
+    for (unsigned x = 0; x < width; ++x) {
+      unsigned gray;
+      if (color == 3) {
+        const std::size_t idx = 3 * std::size_t(sample(x, 0));
+        if (idx + 2 >= palette.size())
+          throw_bad("PNG palette index is out of range.", path);
+        gray = (palette[idx] + palette[idx + 1] + palette[idx + 2]) / 3;
+      } else if (channels >= 3) {
+        gray = (sample(x, 0) + sample(x, 1) + sample(x, 2)) / 3;
+      } else {
+        gray = sample(x, 0);
+      }
+      data_[std::size_t(x) * nj_ + (height - 1 - r)] = gray < 128;
+    }
+    prev.swap(row);
+  }
+}
+#else
+void GeometryMask::read_png_(const std::string &path,
+                             const std::vector<char> &) {
+  throw_bad("PNG masks require balbm to be built with zlib.", path);
+}
+#endif
+
+//! Solid links of a wall facing a direction
+//!
+//! \param nx x-component of the wall normal
+//! \param ny y-component of the wall normal
+//! \return Bit k set for every direction k pointing into the wall
+static unsigned facing_links(const int nx, const int ny) {
+  unsigned links = 0;
+  for (unsigned k = 1; k < D2Q9::nk; ++k)
+    if (D2Q9::c[k][0] * nx + D2Q9::c[k][1] * ny < 0)
+      links |= 1u << k;
+  return links;
+}
+
+//! Constructor for a geometry classified from a mask
+//!
+//! \param mask Solid/fluid mask
+//! \param periodic_i Whether the domain is periodic in the x-direction
+//! \param periodic_j Whether the domain is periodic in the y-direction
+//! \param nthreads Number of threads, 0 for one per hardware thread
+Geometry::Geometry(const GeometryMask &mask, const bool periodic_i,
+                   const bool periodic_j, const unsigned nthreads)
+    : ni_(mask.num_i()), nj_(mask.num_j()), periodic_{periodic_i, periodic_j},
+      classes_(std::size_t(ni_) * nj_), links_(std::size_t(ni_) * nj_) {
+  unsigned nt = (nthreads > 0) ? nthreads : std::thread::hardware_concurrency();
+  nt = std::max(1u, std::min(nt, ni_));
+
+  // slabs of whole columns are independent of each other
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < nt; ++t)
+    threads.emplace_back(&Geometry::classify_, this, std::cref(mask),
+                         unsigned(std::uint64_t(ni_) * t / nt),
+                         unsigned(std::uint64_t(ni_) * (t + 1) / nt));
+  classify_(mask, 0, ni_ / nt);
+  for (auto &thread : threads)
+    thread.join();
+}
+
+//! Classify the nodes of a slab of the domain
+//!
+//! \param mask Solid/fluid mask
+//! \param bi First index in the x-direction
+//! \param ei One past the last index in the x-direction
+void Geometry::classify_(const GeometryMask &mask, const unsigned bi,
+                         const unsigned ei) {
+  static const unsigned WALLS[][2] = {
+      {NODE_CLASS_NORTH_FACING_WALL, facing_links(0, 1)},
+      {NODE_CLASS_SOUTH_FACING_WALL, facing_links(0, -1)},
+      {NODE_CLASS_EAST_FACING_WALL, facing_links(1, 0)},
+      {NODE_CLASS_WEST_FACING_WALL, facing_links(-1, 0)},
+      {NODE_CLASS_CORNER_EAST_NORTH, facing_links(1, 0) | facing_links(0, 1)},
+      {NODE_CLASS_CORNER_WEST_NORTH, facing_links(-1, 0) | facing_links(0, 1)},
+      {NODE_CLASS_CORNER_WEST_SOUTH,
+       facing_links(-1, 0) | facing_links(0, -1)},
+      {NODE_CLASS_CORNER_EAST_SOUTH,
+       facing_links(1, 0) | facing_links(0, -1)}};
+
+  for (unsigned i = bi; i < ei; ++i)
+    for (unsigned j = 0; j < nj_; ++j) {
+      const std::size_t idx = std::size_t(i) * nj_ + j;
+      if (mask.solid(i, j)) {
+        classes_[idx] = NODE_CLASS_INACTIVE;
+        links_[idx] = 0;
+        continue;
+      }
+
+      unsigned links = 0;
+      bool wraps = false;
+      for (unsigned k = 1; k < D2Q9::nk; ++k) {
+        long in = long(i) + D2Q9::c[k][0];
+        long jn = long(j) + D2Q9::c[k][1];
+        bool beyond = false;
+        if (in < 0 || in >= long(ni_)) {
+          beyond = !periodic_[0];
+          in = (in < 0) ? ni_ - 1 : 0;
+          wraps = true;
+        }
+        if (jn < 0 || jn >= long(nj_)) {
+          beyond = beyond || !periodic_[1];
+          jn = (jn < 0) ? nj_ - 1 : 0;
+          wraps = true;
+        }
+        if (beyond || mask.solid(in, jn))
+          links |= 1u << k;
+      }
+
+      NodeClass node_class;
+      if (links == 0) {
+        node_class = wraps ? NODE_CLASS_PERIODIC : NODE_CLASS_ACTIVE;
+      } else {
+        node_class = NODE_CLASS_BOUNCE_BACK;
+        for (const auto &wall : WALLS)
+          if (links == wall[1])
+            node_class = static_cast<NodeClass>(wall[0]);
+      }
+      classes_[idx] = node_class;
+      links_[idx] = static_cast<std::uint8_t>(links >> 1);
+    }
+}
+
+//! Constructor for a geometry loaded from a cache file
+//!
+//! \param path Path of the cache file
+//! \throw runtime_error
+Geometry::Geometry(const std::string &path) {
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs)
+    throw std::runtime_error("Unable to open " + path + '.');
+  GeometryCacheHeader header;
+  ifs.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (ifs.gcount() != sizeof(header) ||
+      !std::equal(GEOMETRY_CACHE_MAGIC, GEOMETRY_CACHE_MAGIC + 8,
+                  header.magic))
+    throw_bad("not a balbm geometry cache.", path);
+  if (header.version != GEOMETRY_CACHE_VERSION) {
+    std::ostringstream oss;
+    oss << "format version " << header.version << " is not supported, "
+        << "expected version " << GEOMETRY_CACHE_VERSION << '.';
+    throw_bad(oss.str(), path);
+  }
+  ni_ = header.ni;
+  nj_ = header.nj;
+  periodic_[0] = header.periodic & 1;
+  periodic_[1] = header.periodic & 2;
+  const std::size_t n = std::size_t(ni_) * nj_;
+  classes_.resize(n);
+  links_.resize(n);
+
+  const std::vector<char> runs((std::istreambuf_iterator<char>(ifs)),
+                               std::istreambuf_iterator<char>());
+  const auto *in = reinterpret_cast<const unsigned char *>(runs.data());
+  const auto *end = in + runs.size();
+  std::size_t idx = 0;
+  for (std::uint64_t r = 0; r < header.num_runs; ++r) {
+    if (end - in < 3)
+      throw_bad("cache is truncated.", path);
+    const std::uint8_t node_class = *in++;
+    const std::uint8_t links = *in++;
+    std::uint64_t length = 0;
+    for (unsigned shift = 0;; shift += 7) {
+      if (in == end || shift > 63)
+        throw_bad("cache is truncated.", path);
+      length |= std::uint64_t(*in & 0x7f) << shift;
+      if (!(*in++ & 0x80))
+        break;
+    }
+    if (node_class >= NUM_NODE_CLASSES || length > n - idx)
+      throw_bad("cache is corrupt.", path);
+    std::fill_n(&classes_[idx], length, node_class);
+    std::fill_n(&links_[idx], length, links);
+    idx += length;
+  }
+  if (idx != n)
+    throw_bad("cache does not cover the domain.", path);
+}
+
+//! Number of nodes of a class
+//!
+//! \param node_class Node class
+//! \return Number of nodes
+std::size_t Geometry::count(const NodeClass node_class) const {
+  return std::count(classes_.cbegin(), classes_.cend(), node_class);
+}
+
+//! Save the node classes to a run length encoded cache file
+//!
+//! \param path Path of the cache file
+//! \throw runtime_error
+void Geometry::save(const std::string &path) const {
+  std::vector<unsigned char> runs;
+  std::uint64_t num_runs = 0;
+  const std::size_t n = classes_.size();
+  for (std::size_t idx = 0; idx < n;) {
+    std::size_t end = idx + 1;
+    while (end < n && classes_[end] == classes_[idx] &&
+           links_[end] == links_[idx])
+      ++end;
+    runs.push_back(classes_[idx]);
+    runs.push_back(links_[idx]);
+    for (std::uint64_t length = end - idx;; length >>= 7) {
+      if (length < 0x80) {
+        runs.push_back(static_cast<unsigned char>(length));
+        break;
+      }
+      runs.push_back(static_cast<unsigned char>(length | 0x80));
+    }
+    ++num_runs;
+    idx = end;
+  }
+
+  GeometryCacheHeader header;
+  std::copy(GEOMETRY_CACHE_MAGIC, GEOMETRY_CACHE_MAGIC + 8, header.magic);
+  header.version = GEOMETRY_CACHE_VERSION;
+  header.ni = ni_;
+  header.nj = nj_;
+  header.periodic = (periodic_[0] ? 1 : 0) | (periodic_[1] ? 2 : 0);
+  header.num_runs = num_runs;
+
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  ofs.write(reinterpret_cast<const char *>(runs.data()), runs.size());
+  if (!ofs)
+    throw std::runtime_error("Unable to write " + path + '.');
+}
+
+//! Set the node descriptors of a lattice
+//!
+//! \param lat Lattice of the same dimensions as the geometry
+//! \throw invalid_argument
+void Geometry::apply(Lattice &lat) const {
+  if (lat.num_i() != ni_ || lat.num_j() != nj_) {
+    std::ostringstream oss;
+    oss << "Geometry of " << ni_ << " x " << nj_ << " nodes does not fit a "
+        << "lattice of " << lat.num_i() << " x " << lat.num_j() << " nodes.";
+    throw std::invalid_argument(oss.str());
+  }
+
+  AbstractNodeDesc *pnds[NUM_NODE_CLASSES] = {};
+  AbstractNodeDesc *pbounce[256] = {};
+  const auto node_desc = [&](const std::size_t idx) {
+    AbstractNodeDesc *&pnd = pnds[classes_[idx]];
+    if (pnd != nullptr)
+      return pnd;
+    switch (classes_[idx]) {
+    case NODE_CLASS_INACTIVE:
+      return pnd = lat.make_shared_node_desc<NodeInactive>();
+    case NODE_CLASS_ACTIVE:
+      return pnd = lat.make_shared_node_desc<NodeActive>();
+    case NODE_CLASS_PERIODIC:
+      return pnd = lat.make_shared_node_desc<NodePeriodic>();
+    case NODE_CLASS_NORTH_FACING_WALL:
+      return pnd = lat.make_shared_node_desc<NodeNorthFacingWall>();
+    case NODE_CLASS_SOUTH_FACING_WALL:
+      return pnd = lat.make_shared_node_desc<NodeSouthFacingWall>();
+    case NODE_CLASS_EAST_FACING_WALL:
+      return pnd = lat.make_shared_node_desc<NodeEastFacingWall>();
+    case NODE_CLASS_WEST_FACING_WALL:
+      return pnd = lat.make_shared_node_desc<NodeWestFacingWall>();
+    case NODE_CLASS_CORNER_EAST_NORTH:
+      return pnd = lat.make_shared_node_desc<
+                 NodeCornerWall<EastFacing, NorthFacing>>();
+    case NODE_CLASS_CORNER_WEST_NORTH:
+      return pnd = lat.make_shared_node_desc<
+                 NodeCornerWall<WestFacing, NorthFacing>>();
+    case NODE_CLASS_CORNER_WEST_SOUTH:
+      return pnd = lat.make_shared_node_desc<
+                 NodeCornerWall<WestFacing, SouthFacing>>();
+    case NODE_CLASS_CORNER_EAST_SOUTH:
+      return pnd = lat.make_shared_node_desc<
+                 NodeCornerWall<EastFacing, SouthFacing>>();
+    default: {
+      // one descriptor per distinct set of solid links
+      AbstractNodeDesc *&pbb = pbounce[links_[idx]];
+      if (pbb == nullptr)
+        pbb = lat.make_shared_node_desc<NodeBounceBack>(
+            static_cast<unsigned>(links_[idx]) << 1);
+      return pbb;
+    }
+    }
+  };
+
+  for (unsigned i = 0; i < ni_; ++i)
+    for (unsigned j = 0; j < nj_; ++j)
+      lat.set_shared_node_desc(i, j, node_desc(std::size_t(i) * nj_ + j));
+}
+
+} // namespace d2q9
+
+} // namespace balbm
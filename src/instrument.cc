@@ -0,0 +1,267 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "instrument.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <ostream>
+#include <utility>
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Name of a phase
+//!
+//! \param phase Phase
+//! \return Name of the phase
+const char *phase_name(const Phase phase) {
+  static const char *names[NUM_PHASES] = {
+      "step",   "stream",    "swap",  "collide", "macro",
+      "probes", "callbacks", "stage", "io"};
+  return (phase < NUM_PHASES) ? names[phase] : "unknown";
+}
+
+//! Readable name of a type
+//!
+//! \param type Type
+//! \return Demangled name where the compiler supports it
+static std::string type_name(const std::type_info &type) {
+#ifdef __GNUG__
+  int status = 0;
+  char *pname = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+  if (status == 0 && pname != nullptr) {
+    std::string name(pname);
+    std::free(pname);
+    return name;
+  }
+#endif
+  return type.name();
+}
+
+//! Identifies instrumentations in the slot caches of threads; never reused,
+//! unlike addresses
+static std::atomic<std::uint64_t> next_id(1);
+
+//! Constructor
+Instrumentation::Instrumentation() : id_(next_id.fetch_add(1)) {
+  for (auto &totals : hw_totals_)
+    for (auto &total : totals)
+      total.store(0, std::memory_order_relaxed);
+}
+
+//! Destructor
+Instrumentation::~Instrumentation() {}
+
+//! Slot of the calling thread, created on first use
+//!
+//! \return Slot
+Instrumentation::Slot &Instrumentation::slot_() {
+  // threads usually time a single instrumentation, the cache stays tiny
+  thread_local std::vector<std::pair<std::uint64_t, Slot *>> cache;
+  for (const auto &entry : cache)
+    if (entry.first == id_)
+      return *entry.second;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  slots_.emplace_back(new Slot());
+  cache.emplace_back(id_, slots_.back().get());
+  return *slots_.back();
+}
+
+//! Add the wall time of a call to a phase
+//!
+//! \param phase Phase
+//! \param ns Wall time in nanoseconds
+void Instrumentation::add(const Phase phase, const std::uint64_t ns) {
+  slot_().phases[phase].add(ns);
+}
+
+//! Add the wall time of a call to a phase of a node type
+//!
+//! \param type Type of the node descriptor
+//! \param phase PHASE_STREAM or PHASE_COLLIDE
+//! \param ns Wall time in nanoseconds
+void Instrumentation::add_node(const std::type_info &type, const Phase phase,
+                               const std::uint64_t ns) {
+  Slot &slot = slot_();
+  for (auto &node : slot.nodes) {
+    const std::type_info *ptype = node.ptype.load(std::memory_order_relaxed);
+    if (ptype == nullptr) {
+      node.ptype.store(&type, std::memory_order_release);
+      ptype = &type;
+    }
+    if (*ptype == type) {
+      (phase == PHASE_STREAM ? node.stream : node.collide).add(ns);
+      return;
+    }
+  }
+}
+
+//! Count hardware events of the phases timed by the calling thread
+//!
+//! Phases timed by other threads are not counted. Call before any phase is
+//! timed.
+//!
+//! \return Whether any hardware event can be counted; if not, see
+//!         perf_counters()->reason()
+bool Instrumentation::count_hardware_events() {
+  spperf_.reset(new PerfCounters());
+  hw_thread_ = std::this_thread::get_id();
+  return spperf_->available();
+}
+
+//! Current reading of the hardware counters
+//!
+//! \return Counts, zero if no counter is open
+HardwareCounts Instrumentation::hardware_counts() const {
+  return (spperf_ != nullptr) ? spperf_->read() : HardwareCounts{};
+}
+
+//! Add the hardware events counted since a reading to a phase
+//!
+//! \param phase Phase
+//! \param start Reading at the start of the phase
+void Instrumentation::add_hardware(const Phase phase,
+                                   const HardwareCounts &start) {
+  const HardwareCounts end = hardware_counts();
+  for (unsigned e = 0; e < NUM_HW_EVENTS; ++e) {
+    auto &total = hw_totals_[phase][e];
+    // only the counting thread writes, no read-modify-write needed
+    total.store(total.load(std::memory_order_relaxed) + end.values[e] -
+                    start.values[e],
+                std::memory_order_relaxed);
+  }
+}
+
+//! Hardware events counted during a phase
+//!
+//! \param phase Phase
+//! \return Counts, zero for events that are not counted
+HardwareCounts Instrumentation::hardware(const Phase phase) const {
+  HardwareCounts counts;
+  for (unsigned e = 0; e < NUM_HW_EVENTS; ++e)
+    counts.values[e] = hw_totals_[phase][e].load(std::memory_order_relaxed);
+  return counts;
+}
+
+//! Calls and wall time of a phase, summed over every thread
+//!
+//! \param phase Phase
+//! \return Totals
+PhaseTotals Instrumentation::phase(const Phase phase) const {
+  PhaseTotals totals{0, 0.0};
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &spslot : slots_) {
+    const Counter &counter = spslot->phases[phase];
+    totals.calls += counter.calls.load(std::memory_order_relaxed);
+    totals.seconds +=
+        1e-9 * counter.nanoseconds.load(std::memory_order_relaxed);
+  }
+  return totals;
+}
+
+//! Streaming and collision totals of every node type, summed over threads
+//!
+//! \return Totals, in order of first appearance
+std::vector<NodeTypeTotals> Instrumentation::node_types() const {
+  std::vector<NodeTypeTotals> totals;
+  std::vector<const std::type_info *> types;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &spslot : slots_)
+    for (const auto &node : spslot->nodes) {
+      const std::type_info *ptype = node.ptype.load(std::memory_order_acquire);
+      if (ptype == nullptr)
+        break;
+      auto it = std::find_if(types.cbegin(), types.cend(),
+                             [&](const std::type_info *p) {
+                               return *p == *ptype;
+                             });
+      const std::size_t idx = it - types.cbegin();
+      if (it == types.cend()) {
+        types.push_back(ptype);
+        totals.push_back({type_name(*ptype), {0, 0.0}, {0, 0.0}});
+      }
+      const auto add = [](PhaseTotals &t, const Counter &counter) {
+        t.calls += counter.calls.load(std::memory_order_relaxed);
+        t.seconds += 1e-9 * counter.nanoseconds.load(std::memory_order_relaxed);
+      };
+      add(totals[idx].stream, node.stream);
+      add(totals[idx].collide, node.collide);
+    }
+  return totals;
+}
+
+//! Zero every total, while no phase is being timed
+void Instrumentation::reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &spslot : slots_) {
+    for (auto &counter : spslot->phases) {
+      counter.calls.store(0, std::memory_order_relaxed);
+      counter.nanoseconds.store(0, std::memory_order_relaxed);
+    }
+    for (auto &node : spslot->nodes)
+      for (Counter *pcounter : {&node.stream, &node.collide}) {
+        pcounter->calls.store(0, std::memory_order_relaxed);
+        pcounter->nanoseconds.store(0, std::memory_order_relaxed);
+      }
+  }
+  for (auto &totals : hw_totals_)
+    for (auto &total : totals)
+      total.store(0, std::memory_order_relaxed);
+}
+
+//! Print a table of the totals
+//!
+//! \param os Output stream
+void Instrumentation::report(std::ostream &os) const {
+  if (!enabled()) {
+    os << "instrumentation is disabled, define BALBM_INSTRUMENT\n";
+    return;
+  }
+  const auto row = [&](const std::string &name, const PhaseTotals &t) {
+    os << std::left << std::setw(40) << name << std::right << std::setw(14)
+       << t.calls << std::setw(14) << std::fixed << std::setprecision(6)
+       << t.seconds << " s" << std::setw(12) << std::setprecision(1)
+       << ((t.calls > 0) ? 1e9 * t.seconds / t.calls : 0.0) << " ns/call\n";
+  };
+  for (unsigned p = 0; p < NUM_PHASES; ++p) {
+    const PhaseTotals t = phase(static_cast<Phase>(p));
+    if (t.calls > 0)
+      row(phase_name(static_cast<Phase>(p)), t);
+    if (t.calls == 0 || spperf_ == nullptr)
+      continue;
+    const HardwareCounts hw = hardware(static_cast<Phase>(p));
+    for (unsigned e = 0; e < NUM_HW_EVENTS; ++e)
+      if (spperf_->available(static_cast<HardwareEvent>(e)))
+        os << "  " << std::left << std::setw(38)
+           << hardware_event_name(static_cast<HardwareEvent>(e))
+           << std::right << std::setw(14) << hw.values[e] << '\n';
+  }
+  for (const auto &node : node_types()) {
+    row("stream " + node.name, node.stream);
+    row("collide " + node.name, node.collide);
+  }
+}
+
+} // namespace d2q9
+
+} // namespace balbm
@@ -0,0 +1,299 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "memory_budget.hh"
+#include "lattice.hh"
+#include "multiscale_map.hh"
+#include "simulate.hh"
+#include "statistics.hh"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Largest number of nodes along a side that largest_domain() considers
+static const double max_side = 1 << 24;
+
+//! Name of a memory component
+//!
+//! \param c Component
+//! \return Name
+const char *memory_component_name(const MemoryComponent c) {
+  switch (c) {
+  case MEMORY_POPULATIONS:
+    return "populations";
+  case MEMORY_NODE_DESCS:
+    return "node_descs";
+  case MEMORY_NODE_POOL:
+    return "node_pool";
+  case MEMORY_MULTISCALE_MAP:
+    return "multiscale_map";
+  case MEMORY_SOLID_FRACTIONS:
+    return "solid_fractions";
+  case MEMORY_STATISTICS:
+    return "statistics";
+  case MEMORY_OUTPUT:
+    return "output";
+  default:
+    return "unknown";
+  }
+}
+
+//! Sum of the bytes of every component
+//!
+//! \return Bytes
+std::size_t MemoryFootprint::total() const noexcept {
+  std::size_t sum = 0;
+  for (unsigned c = 0; c < NUM_MEMORY_COMPONENTS; ++c)
+    sum += bytes[c];
+  return sum;
+}
+
+//! Bytes of a staging frame, sized the way FieldFrame::stage() sizes it
+//!
+//! \param ni Number of nodes of the lattice in the x-direction
+//! \param nj Number of nodes of the lattice in the y-direction
+//! \param fields Fields as OutputField bit flags
+//! \param region Region of the lattice to output
+//! \return Bytes, 0 for regions starting outside of the lattice
+static std::size_t frame_bytes(const unsigned ni, const unsigned nj,
+                               const unsigned fields,
+                               const OutputRegion &region) {
+  if (region.i0 >= ni || region.j0 >= nj)
+    return 0;
+  const unsigned rni =
+      (region.ni == 0) ? ni - region.i0 : std::min(region.ni, ni - region.i0);
+  const unsigned rnj =
+      (region.nj == 0) ? nj - region.j0 : std::min(region.nj, nj - region.j0);
+  const unsigned b = std::max(region.factor, 1u);
+  const std::size_t nodes =
+      region.average ? std::size_t(rni / b) * (rnj / b)
+                     : std::size_t((rni + b - 1) / b) * ((rnj + b - 1) / b);
+
+  unsigned per_node = 0;
+  if (fields & OUTPUT_RHO)
+    per_node += 1;
+  if (fields & OUTPUT_U)
+    per_node += 2;
+  if (fields & OUTPUT_OMEGA)
+    per_node += 1;
+  if (fields & OUTPUT_F)
+    per_node += Lattice::num_k();
+  return nodes * per_node * sizeof(double);
+}
+
+//! Predict the memory a configuration will hold, before allocating it
+//!
+//! Output frames are counted at their size after the first output step.
+//!
+//! \param config Configuration
+//! \return Planned bytes of each component
+MemoryFootprint plan_memory(const MemoryConfig &config) {
+  const std::size_t nodes = std::size_t(config.ni) * config.nj;
+  MemoryFootprint plan;
+  plan.bytes[MEMORY_POPULATIONS] =
+      2 * nodes * Lattice::num_k() * sizeof(double);
+  plan.bytes[MEMORY_NODE_DESCS] = nodes * sizeof(AbstractNodeDesc *);
+  plan.bytes[MEMORY_NODE_POOL] =
+      (nodes + Lattice::max_shared_node_descs) * max_node_desc_size();
+  plan.bytes[MEMORY_MULTISCALE_MAP] = 4 * nodes * sizeof(double);
+  plan.bytes[MEMORY_SOLID_FRACTIONS] =
+      config.solid_fractions ? nodes * sizeof(float) : 0;
+  plan.bytes[MEMORY_STATISTICS] =
+      config.statistics ? nodes * FlowStatistics::NUM_SLOTS * sizeof(double)
+                        : 0;
+  plan.bytes[MEMORY_OUTPUT] =
+      (config.output_fields == 0)
+          ? 0
+          : config.output_buffers * frame_bytes(config.ni, config.nj,
+                                                config.output_fields,
+                                                config.output_region);
+  return plan;
+}
+
+//! Account the memory a simulation holds
+//!
+//! Call from the thread that runs the simulation.
+//!
+//! \param sim Simulation
+//! \param ppipeline Output pipeline of the simulation, if any
+//! \return Bytes held by each component
+MemoryFootprint memory_footprint(const IncompFlowSimulation &sim,
+                                 const AsyncOutputPipeline *ppipeline) {
+  const Lattice &lat = sim.lattice();
+  const IncompFlowMultiscaleMap &mmap = sim.multiscale_map();
+  const std::size_t nodes =
+      std::size_t(mmap.num_i()) * std::size_t(mmap.num_j());
+  MemoryFootprint footprint;
+  footprint.bytes[MEMORY_POPULATIONS] = lat.population_bytes();
+  footprint.bytes[MEMORY_NODE_DESCS] = lat.node_desc_bytes();
+  footprint.bytes[MEMORY_NODE_POOL] = lat.node_pool_bytes();
+  footprint.bytes[MEMORY_MULTISCALE_MAP] = 4 * nodes * sizeof(double);
+  footprint.bytes[MEMORY_SOLID_FRACTIONS] =
+      mmap.has_solid_fractions() ? nodes * sizeof(float) : 0;
+  footprint.bytes[MEMORY_STATISTICS] =
+      (sim.statistics() != nullptr) ? sim.statistics()->heap_bytes() : 0;
+  footprint.bytes[MEMORY_OUTPUT] =
+      (ppipeline != nullptr) ? ppipeline->heap_bytes() : 0;
+  return footprint;
+}
+
+//! Configuration scaled by a factor, keeping the aspect ratio of the domain
+//!
+//! \param config Configuration
+//! \param s Scale factor
+//! \return Scaled configuration
+static MemoryConfig scaled(const MemoryConfig &config, const double s) {
+  MemoryConfig result(config);
+  result.ni = static_cast<unsigned>(std::floor(config.ni * s + 1e-9));
+  result.nj = static_cast<unsigned>(std::floor(config.nj * s + 1e-9));
+  return result;
+}
+
+//! Largest domain that fits in a memory budget
+//!
+//! The domain keeps the aspect ratio and the subsystems of the
+//! configuration; output regions of fixed size keep their size.
+//!
+//! \param config Configuration
+//! \param budget Budget in bytes
+//! \return Configuration with the largest domain that fits
+//! \throw invalid_argument
+//! \throw length_error
+MemoryConfig largest_domain(const MemoryConfig &config,
+                            const std::size_t budget) {
+  if (config.ni == 0 || config.nj == 0)
+    throw std::invalid_argument("The domain of a configuration to scale can "
+                                "not be empty.");
+  const auto fits = [&](const double s) {
+    return plan_memory(scaled(config, s)).total() <= budget;
+  };
+
+  double lo = 1.0 / std::min(config.ni, config.nj);
+  if (!fits(lo)) {
+    std::ostringstream oss;
+    oss << "A budget of " << budget << " bytes does not fit the smallest "
+        << "domain of the configuration.";
+    throw std::length_error(oss.str());
+  }
+  const double max_scale = max_side / std::max(config.ni, config.nj);
+  double hi = lo;
+  while (hi < max_scale && fits(hi))
+    hi = std::min(2 * hi, max_scale);
+  if (fits(hi))
+    return scaled(config, hi);
+  for (unsigned iter = 0; iter < 64; ++iter) {
+    const double mid = 0.5 * (lo + hi);
+    if (fits(mid))
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return scaled(config, lo);
+}
+
+//! Write a number of bytes in binary units
+//!
+//! \param os Output stream
+//! \param bytes Bytes
+static void write_bytes(std::ostream &os, const std::size_t bytes) {
+  static const char *units[] = {"B", "KiB", "MiB", "GiB", "TiB", "PiB"};
+  double value = bytes;
+  unsigned u = 0;
+  while (value >= 1024.0 && u + 1 < sizeof(units) / sizeof(units[0])) {
+    value /= 1024.0;
+    ++u;
+  }
+  std::ostringstream oss;
+  if (u == 0)
+    oss << bytes << ' ' << units[u];
+  else
+    oss << std::fixed << std::setprecision(2) << value << ' ' << units[u];
+  os << std::setw(12) << oss.str();
+}
+
+//! Write a table of bytes by component
+//!
+//! \param os Output stream
+//! \param plan Planned, or accounted, bytes
+//! \param pactual Accounted bytes to compare with the plan, if any
+void write_memory_report(std::ostream &os, const MemoryFootprint &plan,
+                         const MemoryFootprint *pactual) {
+  const auto flags = os.flags();
+  os << std::left << std::setw(16) << "component" << std::right
+     << std::setw(12) << (pactual != nullptr ? "planned" : "bytes");
+  if (pactual != nullptr)
+    os << std::setw(12) << "accounted";
+  os << '\n';
+  const auto row = [&](const char *name, const std::size_t planned,
+                       const std::size_t accounted) {
+    os << std::left << std::setw(16) << name << std::right;
+    write_bytes(os, planned);
+    if (pactual != nullptr)
+      write_bytes(os, accounted);
+    os << '\n';
+  };
+  for (unsigned c = 0; c < NUM_MEMORY_COMPONENTS; ++c)
+    row(memory_component_name(static_cast<MemoryComponent>(c)), plan.bytes[c],
+        (pactual != nullptr) ? pactual->bytes[c] : 0);
+  row("total", plan.total(), (pactual != nullptr) ? pactual->total() : 0);
+  os.flags(flags);
+}
+
+//! Parse a number of bytes with an optional binary suffix, e.g. 512M or 8GiB
+//!
+//! \param s String
+//! \return Bytes
+//! \throw invalid_argument
+std::size_t parse_bytes(const std::string &s) {
+  std::size_t pos = 0;
+  double value = -1.0;
+  try {
+    value = std::stod(s, &pos);
+  } catch (std::exception &) {
+  }
+  std::string suffix = s.substr(std::min(pos, s.size()));
+  for (auto &ch : suffix)
+    ch = std::toupper(static_cast<unsigned char>(ch));
+  if (suffix.size() > 1 && suffix.compare(suffix.size() - 2, 2, "IB") == 0)
+    suffix.resize(suffix.size() - 2);
+  else if (!suffix.empty() && suffix.back() == 'B')
+    suffix.pop_back();
+
+  const std::string prefixes = "KMGTP";
+  double scale = 1.0;
+  if (suffix.size() == 1 && prefixes.find(suffix[0]) != std::string::npos)
+    scale = std::pow(1024.0, prefixes.find(suffix[0]) + 1);
+  else if (!suffix.empty())
+    value = -1.0;
+  if (!(value >= 0.0) || !std::isfinite(value * scale)) {
+    std::ostringstream oss;
+    oss << "Unable to read \"" << s << "\" as a number of bytes.";
+    throw std::invalid_argument(oss.str());
+  }
+  return static_cast<std::size_t>(value * scale);
+}
+
+} // namespace d2q9
+
+} // namespace balbm
@@ -0,0 +1,423 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "metrics.hh"
+#include "multiscale_map.hh"
+#include "simulate.hh"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Throw after a failed system call of a metrics server
+//!
+//! \param what Name of the system call
+//! \param address Address of the server
+static void throw_errno(const char *what, const std::string &address) {
+  std::ostringstream oss;
+  oss << "Metrics server " << address << ": " << what << " failed, "
+      << std::strerror(errno) << '.';
+  throw std::runtime_error(oss.str());
+}
+
+//! Resident memory of the process
+//!
+//! \return Bytes, NaN where unknown
+static double resident_bytes() {
+#ifdef __linux__
+  std::ifstream statm("/proc/self/statm");
+  double size, resident;
+  if (statm >> size >> resident)
+    return resident * sysconf(_SC_PAGESIZE);
+#endif
+  return std::numeric_limits<double>::quiet_NaN();
+}
+
+//! Constructor
+//!
+//! \param target_step Last time step of the run, 0 if unknown
+MetricsPublisher::MetricsPublisher(const unsigned target_step)
+    : sequence_(0), target_step_(target_step),
+      start_(std::chrono::steady_clock::now()), last_time_(start_),
+      last_step_(0), samples_(0.0) {
+  for (auto &word : words_)
+    word.store(0, std::memory_order_relaxed);
+}
+
+//! Publish a sample of a simulation, from the thread running it
+//!
+//! Copies the velocity field to compute the residual of the next sample.
+//!
+//! \param sim Incompressible flow simulation
+//! \param step Time step of the sample
+void MetricsPublisher::publish(const IncompFlowSimulation &sim,
+                               const unsigned step) {
+  constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+  const auto now = std::chrono::steady_clock::now();
+  const auto &mmap = sim.multiscale_map();
+  const std::size_t nodes = std::size_t(mmap.num_i()) * mmap.num_j();
+
+  MetricsSample s;
+  samples_ += 1.0;
+  s.samples = samples_;
+  s.step = step;
+  s.target_step = target_step_;
+  s.nodes = nodes;
+  s.uptime_seconds = std::chrono::duration<double>(now - start_).count();
+  s.mlups = nan;
+  s.eta_seconds = nan;
+  const double interval =
+      std::chrono::duration<double>(now - last_time_).count();
+  if (samples_ > 1.0 && step > last_step_ && interval > 0.0) {
+    const double steps_per_second = (step - last_step_) / interval;
+    s.mlups = nodes * steps_per_second * 1e-6;
+    if (target_step_ > 0)
+      s.eta_seconds =
+          (target_step_ > step) ? (target_step_ - step) / steps_per_second
+                                : 0.0;
+  }
+
+  const double *pu = mmap.pu();
+  s.residual = nan;
+  if (last_u_.size() == 2 * nodes) {
+    double dusq = 0.0, usq = 0.0;
+    for (std::size_t n = 0; n < 2 * nodes; ++n) {
+      const double du = pu[n] - last_u_[n];
+      dusq += du * du;
+      usq += pu[n] * pu[n];
+    }
+    s.residual = (usq > 0.0) ? std::sqrt(dusq / usq) : std::sqrt(dusq);
+  }
+  last_u_.assign(pu, pu + 2 * nodes);
+  last_time_ = now;
+  last_step_ = step;
+
+  s.resident_bytes = resident_bytes();
+  const MemoryFootprint footprint = memory_footprint(sim);
+  for (unsigned c = 0; c < NUM_MEMORY_COMPONENTS; ++c)
+    s.memory_bytes[c] = footprint.bytes[c];
+  const Instrumentation &instr = sim.instrumentation();
+  for (unsigned p = 0; p < NUM_PHASES; ++p) {
+    const PhaseTotals t = instr.enabled() ? instr.phase(static_cast<Phase>(p))
+                                          : PhaseTotals{0, 0.0};
+    s.phase_seconds[p] = t.seconds;
+    s.phase_calls[p] = t.calls;
+  }
+
+  std::uint64_t words[nwords] = {};
+  std::memcpy(words, &s, sizeof(s));
+  const std::uint64_t seq = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (std::size_t w = 0; w < nwords; ++w)
+    words_[w].store(words[w], std::memory_order_relaxed);
+  sequence_.store(seq + 2, std::memory_order_release);
+}
+
+//! Latest published sample, from any thread
+//!
+//! \return Sample, with zero samples if nothing was published yet
+MetricsSample MetricsPublisher::sample() const {
+  std::uint64_t words[nwords];
+  for (;;) {
+    const std::uint64_t seq = sequence_.load(std::memory_order_acquire);
+    if (seq % 2 != 0) {
+      std::this_thread::yield();
+      continue;
+    }
+    for (std::size_t w = 0; w < nwords; ++w)
+      words[w] = words_[w].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) == seq)
+      break;
+  }
+  MetricsSample s;
+  std::memcpy(&s, words, sizeof(s));
+  return s;
+}
+
+//! Write the latest sample in the Prometheus text exposition format
+//!
+//! \param os Output stream
+void MetricsPublisher::write_prometheus(std::ostream &os) const {
+  const MetricsSample s = sample();
+  const auto flags = os.flags();
+  const auto precision = os.precision();
+  os.precision(15);
+  const auto metric = [&](const char *name, const char *type,
+                          const char *help, const double value) {
+    os << "# HELP balbm_" << name << ' ' << help << "\n# TYPE balbm_" << name
+       << ' ' << type << "\nbalbm_" << name << ' ';
+    if (std::isnan(value))
+      os << "NaN";
+    else
+      os << value;
+    os << '\n';
+  };
+  metric("samples_total", "counter", "Samples published by the solver.",
+         s.samples);
+  if (s.samples > 0.0) {
+    metric("step", "gauge", "Time step of the latest sample.", s.step);
+    if (s.target_step > 0.0)
+      metric("target_step", "gauge", "Last time step of the run.",
+             s.target_step);
+    metric("nodes", "gauge", "Number of lattice nodes.", s.nodes);
+    metric("uptime_seconds", "gauge", "Wall time since the run started.",
+           s.uptime_seconds);
+    metric("mlups", "gauge",
+           "Million lattice updates per second since the previous sample.",
+           s.mlups);
+    if (s.target_step > 0.0)
+      metric("eta_seconds", "gauge",
+             "Remaining wall time at the current rate.", s.eta_seconds);
+    metric("residual", "gauge",
+           "Relative L2 change of velocity since the previous sample.",
+           s.residual);
+    metric("resident_bytes", "gauge", "Resident memory of the process.",
+           s.resident_bytes);
+    os << "# HELP balbm_memory_bytes Heap memory held by each subsystem of "
+          "the simulation.\n# TYPE balbm_memory_bytes gauge\n";
+    for (unsigned c = 0; c < NUM_MEMORY_COMPONENTS; ++c)
+      os << "balbm_memory_bytes{component=\""
+         << memory_component_name(static_cast<MemoryComponent>(c)) << "\"} "
+         << s.memory_bytes[c] << '\n';
+  }
+  if (Instrumentation::enabled() && s.samples > 0.0) {
+    os << "# HELP balbm_phase_seconds_total Wall time spent in each phase "
+          "of the step loop.\n# TYPE balbm_phase_seconds_total counter\n";
+    for (unsigned p = 0; p < NUM_PHASES; ++p)
+      os << "balbm_phase_seconds_total{phase=\""
+         << phase_name(static_cast<Phase>(p)) << "\"} " << s.phase_seconds[p]
+         << '\n';
+    os << "# HELP balbm_phase_calls_total Calls of each phase of the step "
+          "loop.\n# TYPE balbm_phase_calls_total counter\n";
+    for (unsigned p = 0; p < NUM_PHASES; ++p)
+      os << "balbm_phase_calls_total{phase=\""
+         << phase_name(static_cast<Phase>(p)) << "\"} " << s.phase_calls[p]
+         << '\n';
+  }
+  os.flags(flags);
+  os.precision(precision);
+}
+
+//! Start serving metrics
+//!
+//! The address is either "unix:PATH" for a Unix domain socket, or "PORT",
+//! "127.0.0.1:PORT" or "localhost:PORT" for a TCP port that only accepts
+//! connections from this host; port 0 picks a free port.
+//!
+//! \param publisher Publisher of the samples, must outlive the server
+//! \param address Address to listen on
+//! \throw invalid_argument
+//! \throw runtime_error
+MetricsServer::MetricsServer(const MetricsPublisher &publisher,
+                             const std::string &address)
+    : ppublisher_(&publisher), port_(0), listen_fd_(-1), wake_fds_{-1, -1},
+      requests_(0) {
+  if (address.compare(0, 5, "unix:") == 0) {
+    path_ = address.substr(5);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path_.empty() || path_.size() >= sizeof(addr.sun_path))
+      throw std::invalid_argument("Metrics socket path " + path_ +
+                                  " is empty or too long.");
+    std::strcpy(addr.sun_path, path_.c_str());
+    // a socket left behind by a previous run would make bind fail
+    struct stat st;
+    if (lstat(path_.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+      unlink(path_.c_str());
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd_ < 0)
+      throw_errno("socket", address);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) <
+        0) {
+      close(listen_fd_);
+      throw_errno("bind", address);
+    }
+  } else {
+    const std::size_t colon = address.rfind(':');
+    const std::string host =
+        (colon == std::string::npos) ? "127.0.0.1" : address.substr(0, colon);
+    const std::string port =
+        (colon == std::string::npos) ? address : address.substr(colon + 1);
+    if (host != "127.0.0.1" && host != "localhost")
+      throw std::invalid_argument("Metrics are only served to localhost, "
+                                  "not " + host + '.');
+    unsigned long nport = 65536;
+    try {
+      std::size_t end;
+      nport = std::stoul(port, &end);
+      if (end != port.size())
+        nport = 65536;
+    } catch (std::exception &) {
+    }
+    if (nport > 65535)
+      throw std::invalid_argument("Invalid metrics port " + port + '.');
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(static_cast<std::uint16_t>(nport));
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd_ < 0)
+      throw_errno("socket", address);
+    const int yes = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    socklen_t len = sizeof(addr);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) <
+            0 ||
+        getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &len) <
+            0) {
+      const int err = errno;
+      close(listen_fd_);
+      errno = err;
+      throw_errno("bind", address);
+    }
+    port_ = ntohs(addr.sin_port);
+  }
+
+  const bool listening = listen(listen_fd_, 16) == 0;
+  if (!listening || pipe(wake_fds_) < 0) {
+    const int err = errno;
+    close(listen_fd_);
+    if (!path_.empty())
+      unlink(path_.c_str());
+    errno = err;
+    throw_errno(listening ? "pipe" : "listen", address);
+  }
+  thread_ = std::thread(&MetricsServer::serve_, this);
+}
+
+//! Stop serving and remove the Unix domain socket
+MetricsServer::~MetricsServer() {
+  const char stop = 0;
+  while (write(wake_fds_[1], &stop, 1) < 0 && errno == EINTR)
+    ;
+  thread_.join();
+  close(wake_fds_[0]);
+  close(wake_fds_[1]);
+  close(listen_fd_);
+  if (!path_.empty())
+    unlink(path_.c_str());
+}
+
+//! Server thread, answers one connection at a time until destruction
+void MetricsServer::serve_() {
+  pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {wake_fds_[0], POLLIN, 0}};
+  for (;;) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    if (fds[1].revents != 0)
+      return;
+    if ((fds[0].revents & POLLIN) == 0)
+      continue;
+    const int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0)
+      continue;
+    respond_(fd);
+    close(fd);
+    requests_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+//! Answer an HTTP request on a connection
+//!
+//! \param fd Connection
+void MetricsServer::respond_(const int fd) const {
+  // a client that never sends a request must not stall the server
+  timeval timeout = {1, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  std::string request;
+  char buf[1024];
+  while (request.find("\r\n\r\n") == std::string::npos &&
+         request.size() < 8192) {
+    const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0)
+      break;
+    request.append(buf, n);
+  }
+
+  std::string status = "200 OK", body;
+  const std::string line = request.substr(0, request.find("\r\n"));
+  std::istringstream iss(line);
+  std::string method, target;
+  iss >> method >> target;
+  if (method != "GET" && method != "HEAD") {
+    status = "405 Method Not Allowed";
+    body = "only GET is supported\n";
+  } else if (target != "/metrics" && target != "/") {
+    status = "404 Not Found";
+    body = "metrics are served at /metrics\n";
+  } else {
+    std::ostringstream oss;
+    ppublisher_->write_prometheus(oss);
+    body = oss.str();
+  }
+
+  std::ostringstream response;
+  response << "HTTP/1.1 " << status
+           << "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8"
+           << "\r\nContent-Length: " << body.size()
+           << "\r\nConnection: close\r\n\r\n";
+  if (method != "HEAD")
+    response << body;
+  const std::string out = response.str();
+  for (std::size_t sent = 0; sent < out.size();) {
+    const ssize_t n =
+        send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0)
+      break;
+    sent += n;
+  }
+}
+
+//! Publish metrics of the simulation every `stride` time steps
+//!
+//! \param sim Incompressible flow simulation
+void MetricsCallback::f_(AbstractSimulation &sim) const {
+  // callbacks run before the step counter is incremented
+  const unsigned step = sim.step() + 1;
+  if (step % stride_ != 0)
+    return;
+
+  ppublisher_->publish(dynamic_cast<const IncompFlowSimulation &>(sim), step);
+}
+
+} // namespace d2q9
+
+} // namespace balbm
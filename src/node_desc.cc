@@ -15,76 +15,98 @@
 // this program.  If not, see <http://www.gnu.org/licenses/>
 
 #include "collision_manager.hh"
+#include "kernels.hh"
 #include "lattice.hh"
 #include "node_desc.hh"
-#include <cassert>
+#include "velocity_set.hh"
 
 namespace balbm {
 
-namespace d2q9 {
-
 //! Virtual destructor definition
-AbstractNodeDesc::~AbstractNodeDesc() {}
+template <typename VS> AbstractNodeDesc<VS>::~AbstractNodeDesc() {}
 
-//! D2Q9 base class streaming
+//! Base class streaming
 //!
-//! \param lat D2Q9 lattice
-//! \param i y-coord of node
-//! \param j x-coord of node
-void AbstractNodeDesc::stream(Lattice &lat, const unsigned i,
-                              const unsigned j) const {
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS>
+void AbstractNodeDesc<VS>::stream(Lattice<VS> &lat,
+                                  const Coords<VS> &x) const {
 #ifdef BALBM_CHECK_BOUNDS_STREAMING
-  stream_with_bcheck_(lat, i, j);
+  stream_with_bcheck_(lat, x);
 #else
-  stream_(lat, i, j);
+  stream_(lat, x);
 #endif
 }
 
 //! Virtual destructor definition
-AbstractNodeActive::~AbstractNodeActive() {}
-
-//! D2Q9 streaming for a typical active node
-//!
-//! \param lat D2Q9 lattice
-//! \param i y-coord of node
-//! \param j x-coord of node
-//! \TODO should we do bounds checking here?
-//! \TODO should we unroll this loop?
-//! \TODO should this be multithreaded?
-void AbstractNodeActive::stream_(Lattice &lat, const unsigned i,
-                                 const unsigned j) const noexcept {
-  const unsigned nk = lat.num_k();
-  unsigned i_next, j_next;
+template <typename VS> AbstractNodeActive<VS>::~AbstractNodeActive() {}
 
-  for (unsigned k = 0; k < nk; ++k) {
-    i_next = i + lat.c(k, 0);
-    j_next = j + lat.c(k, 1);
-    assert(lat.in_bounds(i_next, j_next));
+//! Stream a lattice direction to its periodically wrapped neighbor
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+//! \param k Index of lattice direction
+template <typename VS>
+inline static void stream_periodic_k(Lattice<VS> &lat, const Coords<VS> &x,
+                                     const unsigned k) {
+  lat.ft(lat.next_periodic(x, k), k) = lat.f(x, k);
+}
 
-    lat.ft(i_next, j_next, k) = lat.f(i, j, k);
-  }
+//! Reflect a lattice direction back into its own node (halfway bounce-back)
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+//! \param k Index of lattice direction
+template <typename VS>
+inline static void bounce_back_k(Lattice<VS> &lat, const Coords<VS> &x,
+                                 const unsigned k) {
+  lat.ft(x, VS::opp[k]) = lat.f(x, k);
+}
+
+//! Stream a lattice direction to its periodically wrapped neighbor with
+//! bounds checking
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+//! \param k Index of lattice direction
+template <typename VS>
+inline static void stream_periodic_k_with_bcheck(Lattice<VS> &lat,
+                                                 const Coords<VS> &x,
+                                                 const unsigned k) {
+  const Coords<VS> x_next = lat.next_periodic(x, k);
+  lat.check_bounds(x_next);
+  lat.ft(x_next, k) = lat.f(x, k);
 }
 
-//! D2Q9 streaming for a typical active node with bounds checking
+//! Streaming for a typical active node
 //!
-//! \param lat D2Q9 lattice
-//! \param i y-coord of node
-//! \param j x-coord of node
-//! \TODO should we do bounds checking here?
-//! \TODO should we unroll this loop?
-//! \TODO should this be multithreaded?
-void AbstractNodeActive::stream_with_bcheck_(Lattice &lat, const unsigned i,
-                                             const unsigned j) const {
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS>
+void AbstractNodeActive<VS>::stream_(Lattice<VS> &lat,
+                                     const Coords<VS> &x) const noexcept {
+  for_each_k<VS>([&](const unsigned k) {
+    BALBM_ASSERT(lat.in_bounds(lat.next(x, k)));
+    lat.ft(lat.next(x, k), k) = lat.f(x, k);
+  });
+}
+
+//! Streaming for a typical active node with bounds checking
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS>
+void AbstractNodeActive<VS>::stream_with_bcheck_(Lattice<VS> &lat,
+                                                 const Coords<VS> &x) const {
   const unsigned nk = lat.num_k();
-  unsigned i_next, j_next;
 
   for (unsigned k = 0; k < nk; ++k) {
-    i_next = i + lat.c(k, 0);
-    j_next = j + lat.c(k, 1);
+    const Coords<VS> x_next = lat.next(x, k);
 
-    lat.check_bounds(i_next, j_next);
+    lat.check_bounds(x_next);
 
-    lat.ft(i_next, j_next, k) = lat.f(i, j, k);
+    lat.ft(x_next, k) = lat.f(x, k);
   }
 }
 
@@ -93,322 +115,459 @@ void AbstractNodeActive::stream_with_bcheck_(Lattice &lat, const unsigned i,
 //! \param lat Lattice
 //! \param cman Collision manager
 //! \param mmap Multiscale map
-//! \param i Index in the x-direction
-//! \param j Index in the y-direction
-void AbstractNodeActive::collide_and_bound_(
-    Lattice &lat, IncompFlowMultiscaleMap &mmap,
-    const IncompFlowCollisionManager &cman, const unsigned i,
-    const unsigned j) const {
-  cman.collide(lat, mmap, i, j);
-}
-
-//! D2Q9 streaming for a west facing node
-//!
-//! \param lat D2Q9 lattice
-//! \param i y-coord of node
-//! \param j x-coord of node
-void NodeWestFacingWall::stream_(Lattice &lat, const unsigned i,
-                                 const unsigned j) const noexcept {
-#ifndef NDEBUG
-  const static unsigned stream_directions[] = {2, 3, 4, 6, 7};
-  const static unsigned n =
-      sizeof(stream_directions) / sizeof(stream_directions[0]);
-  unsigned k, i_next, j_next;
-
-  for (unsigned idx = 0; idx < n; ++idx) {
-    k = stream_directions[idx];
-    i_next = i + lat.c(k, 0);
-    j_next = j + lat.c(k, 1);
-    assert(lat.in_bounds(i_next, j_next));
-  }
-#endif
+//! \param x Coordinates of the node
+template <typename VS>
+void AbstractNodeActive<VS>::collide_and_bound_(
+    Lattice<VS> &lat, IncompFlowMultiscaleMap<VS> &mmap,
+    const IncompFlowCollisionManager<VS> &cman, const Coords<VS> &x) const {
+  cman.collide(lat, mmap, x);
+}
 
-  lat.ft(i + lat.c(2, 0), j + lat.c(2, 1), 2) = lat.f(i, j, 2);
-  lat.ft(i + lat.c(3, 0), j + lat.c(3, 1), 3) = lat.f(i, j, 3);
-  lat.ft(i + lat.c(4, 0), j + lat.c(4, 1), 4) = lat.f(i, j, 4);
-  lat.ft(i + lat.c(6, 0), j + lat.c(6, 1), 6) = lat.f(i, j, 6);
-  lat.ft(i + lat.c(7, 0), j + lat.c(7, 1), 7) = lat.f(i, j, 7);
+//! Component of the inward unit normal of a boundary
+//!
+//! \param d Index of the direction
+//! \return d-th component of the inward unit normal
+template <typename Facing>
+inline static constexpr int facing_n(const unsigned d) {
+  return (d == 0) ? Facing::nx : ((d == 1) ? Facing::ny : Facing::nz);
 }
 
-//! D2Q9 streaming for a west facing node with bounds checking
+//! Normal component of a lattice direction with respect to a boundary
 //!
-//! \param lat D2Q9 lattice
-//! \param i y-coord of node
-//! \param j x-coord of node
-void NodeWestFacingWall::stream_with_bcheck_(Lattice &lat, const unsigned i,
-                                             const unsigned j) const {
-  const static unsigned stream_directions[] = {2, 3, 4, 6, 7};
-  const static unsigned n =
-      sizeof(stream_directions) / sizeof(stream_directions[0]);
-  unsigned k, i_next, j_next;
+//! \param k Index of lattice direction
+//! \return c_k . n where n is the inward unit normal of the boundary
+template <typename VS, typename Facing>
+inline static constexpr int cdotn(const unsigned k) {
+  int result = 0;
+  for (unsigned d = 0; d < VS::nd; ++d)
+    result += VS::c[k][d] * facing_n<Facing>(d);
+  return result;
+}
 
-  for (unsigned idx = 0; idx < n; ++idx) {
-    k = stream_directions[idx];
-    i_next = i + lat.c(k, 0);
-    j_next = j + lat.c(k, 1);
+//! Tangential component of a lattice direction with respect to a boundary
+//! of a 2D lattice
+//!
+//! \param k Index of lattice direction
+//! \return c_k . t where t is the unit tangent of the boundary
+template <typename VS, typename Facing>
+inline static constexpr int cdott(const unsigned k) {
+  return -VS::c[k][0] * Facing::ny + VS::c[k][1] * Facing::nx;
+}
 
-    lat.check_bounds(i_next, j_next);
-    lat.ft(i_next, j_next, k) = lat.f(i, j, k);
+//! Lattice direction mirrored across a boundary
+//!
+//! \param k Index of lattice direction
+//! \return Index of the direction with the normal component of c_k reversed
+template <typename VS, typename Facing>
+inline static constexpr unsigned mirror(const unsigned k) {
+  unsigned result = k;
+  for (unsigned kk = 0; kk < VS::nk; ++kk) {
+    bool is_mirror = true;
+    for (unsigned d = 0; d < VS::nd; ++d)
+      is_mirror = is_mirror &&
+                  (VS::c[kk][d] == VS::c[k][d] - 2 * cdotn<VS, Facing>(k) *
+                                                     facing_n<Facing>(d));
+    if (is_mirror)
+      result = kk;
   }
+  return result;
 }
 
-//! Forward collision call to collision manager then enforce no slip BC
+//! Specularly reflect a lattice direction off a boundary halfway between a
+//! node and its neighbor
 //!
 //! \param lat Lattice
-//! \param cman Collision manager
-//! \param mmap Multiscale map
-//! \param i Index in the x-direction
-//! \param j Index in the y-direction
-void NodeWestFacingWall::collide_and_bound_(
-    Lattice &lat, IncompFlowMultiscaleMap &mmap,
-    const IncompFlowCollisionManager &cman, const unsigned i,
-    const unsigned j) const {
-  cman.collide(lat, mmap, i, j);
-  lat.f(i, j, 3) = lat.f(i, j, 1);
-  lat.f(i, j, 6) = lat.f(i, j, 8);
-  lat.f(i, j, 7) = lat.f(i, j, 5);
-}
-
-//! D2Q9 streaming for a south facing node
-//!
-//! \param lat D2Q9 lattice
-//! \param i y-coord of node
-//! \param j x-coord of node
-void NodeSouthFacingWall::stream_(Lattice &lat, const unsigned i,
-                                  const unsigned j) const noexcept {
-#ifndef NDEBUG
-  const static unsigned stream_directions[] = {1, 3, 4, 7, 8};
-  const static unsigned n =
-      sizeof(stream_directions) / sizeof(stream_directions[0]);
-  unsigned k, i_next, j_next;
-
-  for (unsigned idx = 0; idx < n; ++idx) {
-    k = stream_directions[idx];
-    i_next = i + lat.c(k, 0);
-    j_next = j + lat.c(k, 1);
-    assert(lat.in_bounds(i_next, j_next));
-  }
-#endif
+//! \param x Coordinates of the node
+//! \param k Index of lattice direction
+template <typename VS, typename Facing>
+inline static void reflect_k(Lattice<VS> &lat, const Coords<VS> &x,
+                             const unsigned k) {
+  const Coords<VS> x_periodic = lat.next_periodic(x, k);
+  Coords<VS> x_next;
+  for (unsigned d = 0; d < VS::nd; ++d)
+    x_next[d] = (facing_n<Facing>(d) == 0) ? x_periodic[d] : x[d];
+  lat.ft(x_next, mirror<VS, Facing>(k)) = lat.f(x, k);
+}
 
-  lat.ft(i + lat.c(1, 0), j + lat.c(1, 1), 1) = lat.f(i, j, 1);
-  lat.ft(i + lat.c(3, 0), j + lat.c(3, 1), 3) = lat.f(i, j, 3);
-  lat.ft(i + lat.c(4, 0), j + lat.c(4, 1), 4) = lat.f(i, j, 4);
-  lat.ft(i + lat.c(7, 0), j + lat.c(7, 1), 7) = lat.f(i, j, 7);
-  lat.ft(i + lat.c(8, 0), j + lat.c(8, 1), 8) = lat.f(i, j, 8);
+//! Streaming for a node on an open boundary
+//!
+//! Particle distributions leaving the domain through the boundary are dropped
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS, typename Facing>
+inline static void stream_open(Lattice<VS> &lat, const Coords<VS> &x) {
+  for_each_k<VS>([&](const unsigned k) {
+    if (cdotn<VS, Facing>(k) >= 0)
+      stream_periodic_k(lat, x, k);
+  });
 }
 
-//! D2Q9 streaming for a south facing node with bounds checking
+//! Streaming for a node on an open boundary with bounds checking
 //!
-//! \param lat D2Q9 lattice
-//! \param i y-coord of node
-//! \param j x-coord of node
-void NodeSouthFacingWall::stream_with_bcheck_(Lattice &lat, const unsigned i,
-                                              const unsigned j) const {
-  const static unsigned stream_directions[] = {1, 3, 4, 7, 8};
-  const static unsigned n =
-      sizeof(stream_directions) / sizeof(stream_directions[0]);
-  unsigned k, i_next, j_next;
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS, typename Facing>
+inline static void stream_open_with_bcheck(Lattice<VS> &lat,
+                                           const Coords<VS> &x) {
+  const unsigned nk = lat.num_k();
+  for (unsigned k = 0; k < nk; ++k)
+    if (cdotn<VS, Facing>(k) >= 0)
+      stream_periodic_k_with_bcheck(lat, x, k);
+}
 
-  for (unsigned idx = 0; idx < n; ++idx) {
-    k = stream_directions[idx];
-    i_next = i + lat.c(k, 0);
-    j_next = j + lat.c(k, 1);
+//! Sum of known particle distributions used to close the Zou and He system
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+//! \return Sum of tangential plus twice the sum of outgoing distributions
+template <typename VS, typename Facing>
+inline static double zou_he_known_sum(const Lattice<VS> &lat,
+                                      const Coords<VS> &x) {
+  double result = 0.0;
+  for_each_k<VS>([&](const unsigned k) {
+    if (cdotn<VS, Facing>(k) == 0)
+      result += lat.f(x, k);
+    else if (cdotn<VS, Facing>(k) < 0)
+      result += 2.0 * lat.f(x, k);
+  });
+  return result;
+}
 
-    lat.check_bounds(i_next, j_next);
-    lat.ft(i_next, j_next, k) = lat.f(i, j, k);
-  }
+//! Reconstruct particle distributions entering the domain (Zou and He 1997)
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+//! \param rho Density at the boundary
+//! \param u Velocity at the boundary
+template <typename VS, typename Facing>
+inline static void zou_he_reconstruct(Lattice<VS> &lat, const Coords<VS> &x,
+                                      const double rho, const double *u) {
+  const double ut = -u[0] * Facing::ny + u[1] * Facing::nx;
+
+  double nt = 0.0;
+  for_each_k<VS>([&](const unsigned k) {
+    if (cdotn<VS, Facing>(k) == 0)
+      nt += cdott<VS, Facing>(k) * lat.f(x, k);
+  });
+  nt = 0.5 * nt - rho * ut / 3.0;
+
+  for_each_k<VS>([&](const unsigned k) {
+    if (cdotn<VS, Facing>(k) > 0)
+      lat.f(x, k) = lat.f(x, VS::opp[k]) +
+                    2.0 * VS::w[k] / VS::cssq * rho * cdot<VS>(k, u) -
+                    cdott<VS, Facing>(k) * nt;
+  });
 }
 
-//! Forward collision call to collision manager then enforce no slip BC
+//! Streaming for a wall node
 //!
 //! \param lat Lattice
-//! \param cman Collision manager
-//! \param mmap Multiscale map
-//! \param i Index in the x-direction
-//! \param j Index in the y-direction
-void NodeSouthFacingWall::collide_and_bound_(
-    Lattice &lat, IncompFlowMultiscaleMap &mmap,
-    const IncompFlowCollisionManager &cman, const unsigned i,
-    const unsigned j) const {
-  cman.collide(lat, mmap, i, j);
-  lat.f(i, j, 4) = lat.f(i, j, 2);
-  lat.f(i, j, 7) = lat.f(i, j, 5);
-  lat.f(i, j, 8) = lat.f(i, j, 6);
-}
-
-//! D2Q9 streaming for a east facing node
-//!
-//! \param lat D2Q9 lattice
-//! \param i y-coord of node
-//! \param j x-coord of node
-void NodeEastFacingWall::stream_(Lattice &lat, const unsigned i,
-                                 const unsigned j) const noexcept {
-#ifndef NDEBUG
-  const static unsigned stream_directions[] = {1, 2, 4, 5, 8};
-  const static unsigned n =
-      sizeof(stream_directions) / sizeof(stream_directions[0]);
-  unsigned k, i_next, j_next;
-
-  for (unsigned idx = 0; idx < n; ++idx) {
-    k = stream_directions[idx];
-    i_next = i + lat.c(k, 0);
-    j_next = j + lat.c(k, 1);
-    assert(lat.in_bounds(i_next, j_next));
-  }
-#endif
+//! \param x Coordinates of the node
+template <typename VS, typename Facing>
+void NodeWall<VS, Facing>::stream_(Lattice<VS> &lat,
+                                   const Coords<VS> &x) const noexcept {
+  for_each_k<VS>([&](const unsigned k) {
+    if (cdotn<VS, Facing>(k) < 0)
+      bounce_back_k(lat, x, k);
+    else
+      stream_periodic_k(lat, x, k);
+  });
+}
+
+//! Streaming for a wall node with bounds checking
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS, typename Facing>
+void NodeWall<VS, Facing>::stream_with_bcheck_(Lattice<VS> &lat,
+                                               const Coords<VS> &x) const {
+  const unsigned nk = lat.num_k();
+  for (unsigned k = 0; k < nk; ++k)
+    if (cdotn<VS, Facing>(k) < 0)
+      bounce_back_k(lat, x, k);
+    else
+      stream_periodic_k_with_bcheck(lat, x, k);
+}
+
+//! Streaming for a periodic node
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS>
+void NodePeriodic<VS>::stream_(Lattice<VS> &lat, const Coords<VS> &x) const
+    noexcept {
+  for_each_k<VS>([&](const unsigned k) { stream_periodic_k(lat, x, k); });
+}
 
-  lat.ft(i + lat.c(1, 0), j + lat.c(1, 1), 1) = lat.f(i, j, 1);
-  lat.ft(i + lat.c(2, 0), j + lat.c(2, 1), 2) = lat.f(i, j, 2);
-  lat.ft(i + lat.c(4, 0), j + lat.c(4, 1), 4) = lat.f(i, j, 4);
-  lat.ft(i + lat.c(5, 0), j + lat.c(5, 1), 5) = lat.f(i, j, 5);
-  lat.ft(i + lat.c(8, 0), j + lat.c(8, 1), 8) = lat.f(i, j, 8);
+//! Streaming for a periodic node with bounds checking
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS>
+void NodePeriodic<VS>::stream_with_bcheck_(Lattice<VS> &lat,
+                                           const Coords<VS> &x) const {
+  const unsigned nk = lat.num_k();
+  for (unsigned k = 0; k < nk; ++k)
+    stream_periodic_k_with_bcheck(lat, x, k);
 }
 
-//! D2Q9 streaming for a east facing node with bounds checking
+//! Streaming for a Zou and He velocity boundary node
 //!
-//! \param lat D2Q9 lattice
-//! \param i y-coord of node
-//! \param j x-coord of node
-void NodeEastFacingWall::stream_with_bcheck_(Lattice &lat, const unsigned i,
-                                             const unsigned j) const {
-  const static unsigned stream_directions[] = {1, 2, 4, 5, 8};
-  const static unsigned n =
-      sizeof(stream_directions) / sizeof(stream_directions[0]);
-  unsigned k, i_next, j_next;
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS, typename Facing>
+void NodeZouHeVelocity<VS, Facing>::stream_(Lattice<VS> &lat,
+                                            const Coords<VS> &x) const
+    noexcept {
+  stream_open<VS, Facing>(lat, x);
+}
 
-  for (unsigned idx = 0; idx < n; ++idx) {
-    k = stream_directions[idx];
-    i_next = i + lat.c(k, 0);
-    j_next = j + lat.c(k, 1);
+//! Streaming for a Zou and He velocity boundary node with bounds checking
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS, typename Facing>
+void NodeZouHeVelocity<VS, Facing>::stream_with_bcheck_(
+    Lattice<VS> &lat, const Coords<VS> &x) const {
+  stream_open_with_bcheck<VS, Facing>(lat, x);
+}
 
-    lat.check_bounds(i_next, j_next);
-    lat.ft(i_next, j_next, k) = lat.f(i, j, k);
-  }
+//! Reconstruct unknown particle distributions from the prescribed velocity
+//! then forward collision call to collision manager
+//!
+//! \param lat Lattice
+//! \param cman Collision manager
+//! \param mmap Multiscale map
+//! \param x Coordinates of the node
+template <typename VS, typename Facing>
+void NodeZouHeVelocity<VS, Facing>::collide_and_bound_(
+    Lattice<VS> &lat, IncompFlowMultiscaleMap<VS> &mmap,
+    const IncompFlowCollisionManager<VS> &cman, const Coords<VS> &x) const {
+  const double un = u_[0] * Facing::nx + u_[1] * Facing::ny;
+  const double rho = zou_he_known_sum<VS, Facing>(lat, x) / (1.0 - un);
+  zou_he_reconstruct<VS, Facing>(lat, x, rho, u_);
+  cman.collide(lat, mmap, x);
+}
+
+//! Streaming for a Zou and He pressure boundary node
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS, typename Facing>
+void NodeZouHePressure<VS, Facing>::stream_(Lattice<VS> &lat,
+                                            const Coords<VS> &x) const
+    noexcept {
+  stream_open<VS, Facing>(lat, x);
+}
+
+//! Streaming for a Zou and He pressure boundary node with bounds checking
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS, typename Facing>
+void NodeZouHePressure<VS, Facing>::stream_with_bcheck_(
+    Lattice<VS> &lat, const Coords<VS> &x) const {
+  stream_open_with_bcheck<VS, Facing>(lat, x);
 }
 
-//! Forward collision call to collision manager then enforce no slip BC
+//! Reconstruct unknown particle distributions from the prescribed density
+//! then forward collision call to collision manager
 //!
 //! \param lat Lattice
 //! \param cman Collision manager
 //! \param mmap Multiscale map
-//! \param i Index in the x-direction
-//! \param j Index in the y-direction
-void NodeEastFacingWall::collide_and_bound_(
-    Lattice &lat, IncompFlowMultiscaleMap &mmap,
-    const IncompFlowCollisionManager &cman, const unsigned i,
-    const unsigned j) const {
-  cman.collide(lat, mmap, i, j);
-  lat.f(i, j, 1) = lat.f(i, j, 3);
-  lat.f(i, j, 5) = lat.f(i, j, 7);
-  lat.f(i, j, 8) = lat.f(i, j, 6);
-}
-
-// TODO: prob micro-opt, BUT what-if we skip all 0 for streaming???
-
-//! D2Q9 streaming for a north facing node
-//!
-//! \param lat D2Q9 lattice
-//! \param i x-coord of node
-//! \param j y-coord of node
-void NodeNorthFacingWall::stream_(Lattice &lat, const unsigned i,
-                                  const unsigned j) const noexcept {
-#ifndef NDEBUG
-  const static unsigned stream_directions[] = {1, 2, 3, 5, 6};
-  const static unsigned n =
-      sizeof(stream_directions) / sizeof(stream_directions[0]);
-  unsigned k, i_next, j_next;
-
-  for (unsigned idx = 0; idx < n; ++idx) {
-    k = stream_directions[idx];
-    i_next = i + lat.c(k, 0);
-    j_next = j + lat.c(k, 1);
-    assert(lat.in_bounds(i_next, j_next));
-  }
-#endif
+//! \param x Coordinates of the node
+template <typename VS, typename Facing>
+void NodeZouHePressure<VS, Facing>::collide_and_bound_(
+    Lattice<VS> &lat, IncompFlowMultiscaleMap<VS> &mmap,
+    const IncompFlowCollisionManager<VS> &cman, const Coords<VS> &x) const {
+  const double un = 1.0 - zou_he_known_sum<VS, Facing>(lat, x) / rho_;
+  const double u[] = {un * Facing::nx, un * Facing::ny};
+  zou_he_reconstruct<VS, Facing>(lat, x, rho_, u);
+  cman.collide(lat, mmap, x);
+}
+
+//! Streaming for a moving wall node
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS, typename Facing>
+void NodeMovingWall<VS, Facing>::stream_(Lattice<VS> &lat,
+                                         const Coords<VS> &x) const noexcept {
+  double rho = 0.0;
+  for_each_k<VS>([&](const unsigned k) { rho += lat.f(x, k); });
+
+  for_each_k<VS>([&](const unsigned k) {
+    if (cdotn<VS, Facing>(k) < 0)
+      lat.ft(x, VS::opp[k]) =
+          lat.f(x, k) - 2.0 * VS::w[k] / VS::cssq * rho * cdot<VS>(k, u_);
+    else
+      stream_periodic_k(lat, x, k);
+  });
+}
 
-  lat.ft(i + lat.c(1, 0), j + lat.c(1, 1), 1) = lat.f(i, j, 1);
-  lat.ft(i + lat.c(2, 0), j + lat.c(2, 1), 2) = lat.f(i, j, 2);
-  lat.ft(i + lat.c(3, 0), j + lat.c(3, 1), 3) = lat.f(i, j, 3);
-  lat.ft(i + lat.c(5, 0), j + lat.c(5, 1), 5) = lat.f(i, j, 5);
-  lat.ft(i + lat.c(6, 0), j + lat.c(6, 1), 6) = lat.f(i, j, 6);
+//! Streaming for a moving wall node with bounds checking
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS, typename Facing>
+void NodeMovingWall<VS, Facing>::stream_with_bcheck_(
+    Lattice<VS> &lat, const Coords<VS> &x) const {
+  const unsigned nk = lat.num_k();
+  double rho = 0.0;
+  for (unsigned k = 0; k < nk; ++k)
+    rho += lat.f(x, k);
+
+  for (unsigned k = 0; k < nk; ++k)
+    if (cdotn<VS, Facing>(k) < 0)
+      lat.ft(x, VS::opp[k]) =
+          lat.f(x, k) - 2.0 * VS::w[k] / VS::cssq * rho * cdot<VS>(k, u_);
+    else
+      stream_periodic_k_with_bcheck(lat, x, k);
 }
 
-//! D2Q9 streaming for a north facing node with bounds checking
+//! Streaming for a free slip node
 //!
-//! \param lat D2Q9 lattice
-//! \param i x-coord of node
-//! \param j y-coord of node
-void NodeNorthFacingWall::stream_with_bcheck_(Lattice &lat, const unsigned i,
-                                              const unsigned j) const {
-  const static unsigned stream_directions[] = {1, 2, 3, 5, 6};
-  const static unsigned n =
-      sizeof(stream_directions) / sizeof(stream_directions[0]);
-  unsigned k, i_next, j_next;
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS, typename Facing>
+void NodeFreeSlip<VS, Facing>::stream_(Lattice<VS> &lat,
+                                       const Coords<VS> &x) const noexcept {
+  for_each_k<VS>([&](const unsigned k) {
+    if (cdotn<VS, Facing>(k) < 0)
+      reflect_k<VS, Facing>(lat, x, k);
+    else
+      stream_periodic_k(lat, x, k);
+  });
+}
 
-  for (unsigned idx = 0; idx < n; ++idx) {
-    k = stream_directions[idx];
-    i_next = i + lat.c(k, 0);
-    j_next = j + lat.c(k, 1);
+//! Streaming for a free slip node with bounds checking
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS, typename Facing>
+void NodeFreeSlip<VS, Facing>::stream_with_bcheck_(
+    Lattice<VS> &lat, const Coords<VS> &x) const {
+  const unsigned nk = lat.num_k();
+  for (unsigned k = 0; k < nk; ++k)
+    if (cdotn<VS, Facing>(k) < 0)
+      reflect_k<VS, Facing>(lat, x, k);
+    else
+      stream_periodic_k_with_bcheck(lat, x, k);
+}
 
-    lat.check_bounds(i_next, j_next);
-    lat.ft(i_next, j_next, k) = lat.f(i, j, k);
-  }
+//! Streaming for a concave corner node
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS, typename Facing1, typename Facing2>
+void NodeCornerWall<VS, Facing1, Facing2>::stream_(Lattice<VS> &lat,
+                                                   const Coords<VS> &x) const
+    noexcept {
+  for_each_k<VS>([&](const unsigned k) {
+    if (cdotn<VS, Facing1>(k) < 0 || cdotn<VS, Facing2>(k) < 0)
+      bounce_back_k(lat, x, k);
+    else
+      stream_periodic_k(lat, x, k);
+  });
 }
 
-//! Forward collision call to collision manager then enforce no slip BC
+//! Streaming for a concave corner node with bounds checking
 //!
 //! \param lat Lattice
-//! \param cman Collision manager
-//! \param mmap Multiscale map
-//! \param i Index in the x-direction
-//! \param j Index in the y-direction
-void NodeNorthFacingWall::collide_and_bound_(
-    Lattice &lat, IncompFlowMultiscaleMap &mmap,
-    const IncompFlowCollisionManager &cman, const unsigned i,
-    const unsigned j) const {
-  cman.collide(lat, mmap, i, j);
-  lat.f(i, j, 2) = lat.f(i, j, 4);
-  lat.f(i, j, 5) = lat.f(i, j, 7);
-  lat.f(i, j, 6) = lat.f(i, j, 8);
-}
-
-//! Constructor for periodic boundary condition node
-//!
-//! \param i_next Index in x-direction of node to copy particle distributions to
-//! \param j_next Index in y-direction of node to copy particle distributions to
-//! \param ks Array of indexes for lattice directions to be copied
-//! \param nk Number of elements in ks
-//! \return Periodic boundary condition node descriptor
-NodePeriodic::NodePeriodic(const unsigned i_next, const unsigned j_next,
-                           const unsigned *ks, const unsigned nk)
-    : i_next_(i_next), j_next_(j_next),
-      ks_(std::unique_ptr<unsigned[]>(new unsigned[nk])), nk_(nk) {
-  assert(static_cast<int>(nk) >= 0 &&
-         nk <= 9); // TODO: consider turning this into a throw
-  for (unsigned k = 0; k < nk; ++k) {
-    assert(ks[k] < 9 && static_cast<int>(ks[k]) >= 0);
-    ks_[k] = ks[k];
-  }
+//! \param x Coordinates of the node
+template <typename VS, typename Facing1, typename Facing2>
+void NodeCornerWall<VS, Facing1, Facing2>::stream_with_bcheck_(
+    Lattice<VS> &lat, const Coords<VS> &x) const {
+  const unsigned nk = lat.num_k();
+  for (unsigned k = 0; k < nk; ++k)
+    if (cdotn<VS, Facing1>(k) < 0 || cdotn<VS, Facing2>(k) < 0)
+      bounce_back_k(lat, x, k);
+    else
+      stream_periodic_k_with_bcheck(lat, x, k);
 }
 
-//! Forward collision call to collision manager then enforce periodic BC
+//! Streaming for a node with solid neighbors in arbitrary directions
 //!
 //! \param lat Lattice
-//! \param cman Collision manager
-//! \param mmap Multiscale map
-//! \param i Index in the x-direction
-//! \param j Index in the y-direction
-void NodePeriodic::collide_and_bound_(Lattice &lat,
-                                      IncompFlowMultiscaleMap &mmap,
-                                      const IncompFlowCollisionManager &cman,
-                                      const unsigned i,
-                                      const unsigned j) const {
-  cman.collide(lat, mmap, i, j);
-  assert(lat.in_bounds(i_next_, j_next_)); // TODO: throw?
-  for (unsigned k = 0; k < nk_; ++k)
-    lat.f(i_next_, j_next_, k) = lat.f(i, j, k);
-}
-
-} // namespace d2q9
+//! \param x Coordinates of the node
+template <typename VS>
+void NodeBounceBack<VS>::stream_(Lattice<VS> &lat, const Coords<VS> &x) const
+    noexcept {
+  for_each_k<VS>([&](const unsigned k) {
+    if (links_ & (1u << k))
+      bounce_back_k(lat, x, k);
+    else
+      stream_periodic_k(lat, x, k);
+  });
+}
+
+//! Streaming for a node with solid neighbors in arbitrary directions with
+//! bounds checking
+//!
+//! \param lat Lattice
+//! \param x Coordinates of the node
+template <typename VS>
+void NodeBounceBack<VS>::stream_with_bcheck_(Lattice<VS> &lat,
+                                             const Coords<VS> &x) const {
+  const unsigned nk = lat.num_k();
+  for (unsigned k = 0; k < nk; ++k)
+    if (links_ & (1u << k))
+      bounce_back_k(lat, x, k);
+    else
+      stream_periodic_k_with_bcheck(lat, x, k);
+}
+
+// explicit instantiations for each velocity set and boundary orientation
+template class AbstractNodeDesc<D2Q9>;
+template class NodeInactive<D2Q9>;
+template class AbstractNodeActive<D2Q9>;
+template class NodeActive<D2Q9>;
+template class NodePeriodic<D2Q9>;
+template class NodeBounceBack<D2Q9>;
+template class NodeWall<D2Q9, EastFacing>;
+template class NodeWall<D2Q9, NorthFacing>;
+template class NodeWall<D2Q9, WestFacing>;
+template class NodeWall<D2Q9, SouthFacing>;
+template class NodeZouHeVelocity<D2Q9, EastFacing>;
+template class NodeZouHeVelocity<D2Q9, NorthFacing>;
+template class NodeZouHeVelocity<D2Q9, WestFacing>;
+template class NodeZouHeVelocity<D2Q9, SouthFacing>;
+template class NodeZouHePressure<D2Q9, EastFacing>;
+template class NodeZouHePressure<D2Q9, NorthFacing>;
+template class NodeZouHePressure<D2Q9, WestFacing>;
+template class NodeZouHePressure<D2Q9, SouthFacing>;
+template class NodeMovingWall<D2Q9, EastFacing>;
+template class NodeMovingWall<D2Q9, NorthFacing>;
+template class NodeMovingWall<D2Q9, WestFacing>;
+template class NodeMovingWall<D2Q9, SouthFacing>;
+template class NodeFreeSlip<D2Q9, EastFacing>;
+template class NodeFreeSlip<D2Q9, NorthFacing>;
+template class NodeFreeSlip<D2Q9, WestFacing>;
+template class NodeFreeSlip<D2Q9, SouthFacing>;
+template class NodeCornerWall<D2Q9, EastFacing, NorthFacing>;
+template class NodeCornerWall<D2Q9, WestFacing, NorthFacing>;
+template class NodeCornerWall<D2Q9, WestFacing, SouthFacing>;
+template class NodeCornerWall<D2Q9, EastFacing, SouthFacing>;
+
+template class AbstractNodeDesc<D3Q19>;
+template class NodeInactive<D3Q19>;
+template class AbstractNodeActive<D3Q19>;
+template class NodeActive<D3Q19>;
+template class NodePeriodic<D3Q19>;
+template class NodeBounceBack<D3Q19>;
+template class NodeWall<D3Q19, EastFacing>;
+template class NodeWall<D3Q19, NorthFacing>;
+template class NodeWall<D3Q19, WestFacing>;
+template class NodeWall<D3Q19, SouthFacing>;
+template class NodeWall<D3Q19, UpFacing>;
+template class NodeWall<D3Q19, DownFacing>;
+template class NodeFreeSlip<D3Q19, EastFacing>;
+template class NodeFreeSlip<D3Q19, NorthFacing>;
+template class NodeFreeSlip<D3Q19, WestFacing>;
+template class NodeFreeSlip<D3Q19, SouthFacing>;
+template class NodeFreeSlip<D3Q19, UpFacing>;
+template class NodeFreeSlip<D3Q19, DownFacing>;
 
 } // namespace balbm
@@ -0,0 +1,329 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "instrument.hh"
+#include "lattice.hh"
+#include "multiscale_map.hh"
+#include "output.hh"
+#include "simulate.hh"
+#include "trace.hh"
+#include <algorithm>
+#include <stdexcept>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Copy a region of a field into a buffer, optionally coarsened
+//!
+//! \param src Field in lattice order with nc components per node
+//! \param nj_lat Number of nodes of the lattice in the y-direction
+//! \param nc Number of components per node
+//! \param region Region with ni and nj resolved
+//! \param ni Number of output nodes in the x-direction
+//! \param nj Number of output nodes in the y-direction
+//! \param dst Destination, reused between calls
+static void extract(const double *src, const unsigned nj_lat,
+                    const unsigned nc, const OutputRegion &region,
+                    const unsigned ni, const unsigned nj,
+                    std::vector<double> &dst) {
+  const unsigned b = region.factor;
+  dst.resize(std::size_t(ni) * nj * nc);
+  double *pdst = dst.data();
+
+  for (unsigned i = 0; i < ni; ++i) {
+    if (b == 1) {
+      // contiguous rows, one copy per row of the region
+      const double *prow = src + (std::size_t(region.i0 + i) * nj_lat +
+                                  region.j0) * nc;
+      pdst = std::copy(prow, prow + std::size_t(nj) * nc, pdst);
+    } else if (!region.average) {
+      const double *prow = src + (std::size_t(region.i0 + i * b) * nj_lat +
+                                  region.j0) * nc;
+      for (unsigned j = 0; j < nj; ++j, prow += b * nc)
+        pdst = std::copy(prow, prow + nc, pdst);
+    } else {
+      std::fill(pdst, pdst + std::size_t(nj) * nc, 0.0);
+      for (unsigned bi = 0; bi < b; ++bi) {
+        const double *prow = src + (std::size_t(region.i0 + i * b + bi) *
+                                        nj_lat + region.j0) * nc;
+        for (unsigned j = 0; j < nj; ++j)
+          for (unsigned bj = 0; bj < b; ++bj, prow += nc)
+            for (unsigned c = 0; c < nc; ++c)
+              pdst[j * nc + c] += prow[c];
+      }
+      const double scale = 1.0 / (b * b);
+      for (unsigned idx = 0; idx < nj * nc; ++idx)
+        pdst[idx] *= scale;
+      pdst += std::size_t(nj) * nc;
+    }
+  }
+}
+
+//! Copy requested fields of a lattice and multiscale map into the frame
+//!
+//! Storage is reused from previous frames, so after the first output step
+//! staging is a plain copy without allocation.
+//!
+//! \param lat Lattice
+//! \param mmap Multiscale map
+//! \param step Time step of the fields
+//! \param fields Fields to copy as OutputField bit flags
+//! \param region Region of the lattice to copy
+//! \throw out_of_range
+void FieldFrame::stage(const Lattice &lat, const IncompFlowMultiscaleMap &mmap,
+                       const unsigned step, const unsigned fields,
+                       const OutputRegion &region) {
+  OutputRegion r(region);
+  if (r.i0 >= lat.num_i() || r.j0 >= lat.num_j())
+    throw std::out_of_range("Output region starts outside of the lattice.");
+  r.ni = (r.ni == 0) ? lat.num_i() - r.i0 : std::min(r.ni, lat.num_i() - r.i0);
+  r.nj = (r.nj == 0) ? lat.num_j() - r.j0 : std::min(r.nj, lat.num_j() - r.j0);
+  r.factor = std::max(r.factor, 1u);
+
+  this->step = step;
+  this->fields = fields;
+  if (r.average) {
+    ni = r.ni / r.factor;
+    nj = r.nj / r.factor;
+    origin[0] = r.i0 + 0.5 * (r.factor - 1);
+    origin[1] = r.j0 + 0.5 * (r.factor - 1);
+  } else {
+    ni = (r.ni + r.factor - 1) / r.factor;
+    nj = (r.nj + r.factor - 1) / r.factor;
+    origin[0] = r.i0;
+    origin[1] = r.j0;
+  }
+  spacing = r.factor;
+  nk = lat.num_k();
+
+  const unsigned nj_lat = lat.num_j();
+  if (fields & OUTPUT_RHO)
+    extract(mmap.prho(), nj_lat, 1, r, ni, nj, rho);
+  if (fields & OUTPUT_U)
+    extract(mmap.pu(), nj_lat, 2, r, ni, nj, u);
+  if (fields & OUTPUT_OMEGA)
+    extract(mmap.pomega(), nj_lat, 1, r, ni, nj, omega);
+  if (fields & OUTPUT_F)
+    extract(lat.pf(), nj_lat, nk, r, ni, nj, f);
+}
+
+//! Virtual destructor for AbstractFieldWriter base class
+AbstractFieldWriter::~AbstractFieldWriter() {}
+
+//! Constructor for an asynchronous output pipeline
+//!
+//! \param pwriter Writer of staged fields, owned by the pipeline
+//! \param fields Fields to output as OutputField bit flags
+//! \param nbuffers Number of staging frames, two for double buffering
+//! \param nthreads Number of writer threads
+//! \param region Region of the lattice to output
+AsyncOutputPipeline::AsyncOutputPipeline(AbstractFieldWriter *pwriter,
+                                         const unsigned fields,
+                                         const unsigned nbuffers,
+                                         const unsigned nthreads,
+                                         const OutputRegion &region)
+    : spwriter_(pwriter), fields_(fields), region_(region), busy_(0),
+      frames_written_(0), stalls_(0), pinstr_(nullptr), ptrace_(nullptr),
+      stop_(false) {
+  if (nbuffers == 0 || nthreads == 0)
+    throw std::invalid_argument("An output pipeline needs at least one "
+                                "staging buffer and one writer thread.");
+
+  for (unsigned b = 0; b < nbuffers; ++b) {
+    frames_.emplace_back(new FieldFrame());
+    free_.push_back(frames_.back().get());
+  }
+  for (unsigned t = 0; t < nthreads; ++t)
+    threads_.emplace_back(&AsyncOutputPipeline::worker_, this);
+}
+
+//! Write all queued frames and stop the writer threads
+AsyncOutputPipeline::~AsyncOutputPipeline() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  queue_cv_.notify_all();
+  for (auto &thread : threads_)
+    thread.join();
+}
+
+//! Number of frames handed to the writer so far
+unsigned AsyncOutputPipeline::frames_written() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return frames_written_;
+}
+
+//! Heap memory held by the staging frames
+//!
+//! Frames grow to the size of the region on their first use. Call from the
+//! thread that submits, as staging resizes frames outside of the lock.
+//!
+//! \return Bytes
+std::size_t AsyncOutputPipeline::heap_bytes() const {
+  std::size_t bytes = 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &spframe : frames_)
+    bytes += (spframe->rho.capacity() + spframe->u.capacity() +
+              spframe->omega.capacity() + spframe->f.capacity()) *
+             sizeof(double);
+  return bytes;
+}
+
+//! Number of times submit() had to wait for a free staging frame
+unsigned AsyncOutputPipeline::stalls() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stalls_;
+}
+
+//! Time staging as PHASE_STAGE and writing as PHASE_IO
+//!
+//! \param pinstr Instrumentation, not owned, nullptr to detach
+void AsyncOutputPipeline::attach_instrumentation(Instrumentation *pinstr) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pinstr_ = pinstr;
+}
+
+//! Trace staging, stalls and writing
+//!
+//! \param ptrace Trace recorder, not owned, nullptr to detach
+void AsyncOutputPipeline::attach_trace(TraceRecorder *ptrace) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ptrace_ = ptrace;
+}
+
+//! Stage fields of a lattice and multiscale map and queue them for writing
+//!
+//! Blocks while every staging frame is queued or being written.
+//!
+//! \param lat Lattice
+//! \param mmap Multiscale map
+//! \param step Time step of the fields
+void AsyncOutputPipeline::submit(const Lattice &lat,
+                                 const IncompFlowMultiscaleMap &mmap,
+                                 const unsigned step) {
+  FieldFrame *pframe;
+  Instrumentation *pinstr;
+  TraceRecorder *ptrace;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    pinstr = pinstr_;
+    ptrace = ptrace_;
+    rethrow_();
+    if (free_.empty()) {
+      ++stalls_;
+      ScopedTrace trace(ptrace, "stall", "io", step);
+      free_cv_.wait(lock, [this] { return !free_.empty() || error_; });
+      rethrow_();
+    }
+    pframe = free_.back();
+    free_.pop_back();
+  }
+
+  // the copy happens outside of the lock so writers are never held up
+  try {
+    BALBM_TIME_PHASE(pinstr, PHASE_STAGE);
+    ScopedTrace trace(ptrace, PHASE_STAGE, step);
+    pframe->stage(lat, mmap, step, fields_, region_);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(pframe);
+    throw;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(pframe);
+  }
+  queue_cv_.notify_one();
+}
+
+//! Wait until every submitted frame has been written
+void AsyncOutputPipeline::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [this] { return queue_.empty() && busy_ == 0; });
+  rethrow_();
+}
+
+//! Rethrow the first error of a writer thread, mutex_ must be held
+void AsyncOutputPipeline::rethrow_() {
+  if (error_) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+//! Writer thread, writes queued frames until the pipeline is destroyed
+void AsyncOutputPipeline::worker_() {
+  TraceRecorder *pnamed = nullptr;
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    queue_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+    if (queue_.empty())
+      return;
+
+    FieldFrame *pframe = queue_.front();
+    queue_.pop_front();
+    ++busy_;
+    Instrumentation *pinstr = pinstr_;
+    TraceRecorder *ptrace = ptrace_;
+    lock.unlock();
+
+    if (ptrace != nullptr && ptrace != pnamed) {
+      ptrace->set_thread_name("output writer");
+      pnamed = ptrace;
+    }
+    std::exception_ptr error;
+    try {
+      BALBM_TIME_PHASE(pinstr, PHASE_IO);
+      ScopedTrace trace(ptrace, PHASE_IO, pframe->step);
+      spwriter_->write(*pframe);
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    lock.lock();
+    --busy_;
+    if (error && !error_)
+      error_ = error;
+    else if (!error)
+      ++frames_written_;
+    free_.push_back(pframe);
+    free_cv_.notify_one();
+    if (queue_.empty() && busy_ == 0)
+      idle_cv_.notify_all();
+  }
+}
+
+//! Submit the fields of the simulation every `stride` time steps
+//!
+//! \param sim Incompressible flow simulation
+void OutputCallback::f_(AbstractSimulation &sim) const {
+  // callbacks run before the step counter is incremented
+  const unsigned step = sim.step() + 1;
+  if (step % stride_ != 0)
+    return;
+
+  const auto &incomp_sim = dynamic_cast<const IncompFlowSimulation &>(sim);
+  ppipeline_->submit(incomp_sim.lattice(), incomp_sim.multiscale_map(),
+                     step);
+}
+
+} // namespace d2q9
+
+} // namespace balbm
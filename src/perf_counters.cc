@@ -0,0 +1,146 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "perf_counters.hh"
+#include <sstream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Name of a hardware event
+//!
+//! \param event Hardware event
+//! \return Name of the event
+const char *hardware_event_name(const HardwareEvent event) {
+  static const char *names[NUM_HW_EVENTS] = {"cycles", "instructions",
+                                             "llc-references", "llc-misses"};
+  return (event < NUM_HW_EVENTS) ? names[event] : "unknown";
+}
+
+#ifdef __linux__
+//! Explain why perf_event_open failed
+//!
+//! \param err errno of the failure
+//! \return Explanation
+static std::string open_error(const int err) {
+  switch (err) {
+  case EACCES:
+  case EPERM:
+    return "not permitted, see /proc/sys/kernel/perf_event_paranoid";
+  case ENOENT:
+  case EOPNOTSUPP:
+    return "not supported by this processor or virtual machine";
+  case ENOSYS:
+    return "perf_event_open is not supported by the kernel";
+  default:
+    return std::strerror(err);
+  }
+}
+#endif
+
+//! Open counters of every hardware event for the calling thread
+PerfCounters::PerfCounters() {
+  for (auto &fd : fds_)
+    fd = -1;
+
+#ifdef __linux__
+  static const std::uint64_t configs[NUM_HW_EVENTS] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES};
+  std::ostringstream oss;
+  std::string last;
+  unsigned nfailed = 0;
+  bool same = true;
+  for (unsigned e = 0; e < NUM_HW_EVENTS; ++e) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[e];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds_[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fds_[e] >= 0)
+      continue;
+    const std::string error = open_error(errno);
+    oss << ((nfailed > 0) ? "; " : "")
+        << hardware_event_name(static_cast<HardwareEvent>(e)) << ": " << error;
+    same = same && (nfailed == 0 || error == last);
+    last = error;
+    ++nfailed;
+  }
+  // one reason for every event is given once
+  reason_ = (nfailed == NUM_HW_EVENTS && same) ? last : oss.str();
+#else
+  reason_ = "hardware counters require Linux";
+#endif
+}
+
+//! Close the counters
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+  for (const auto fd : fds_)
+    if (fd >= 0)
+      close(fd);
+#endif
+}
+
+//! Whether any hardware event is counted
+//!
+//! \return True if at least one counter is open
+bool PerfCounters::available() const noexcept {
+  for (const auto fd : fds_)
+    if (fd >= 0)
+      return true;
+  return false;
+}
+
+//! Read the counters, scaled up when the kernel multiplexed them
+//!
+//! \return Counts since construction
+HardwareCounts PerfCounters::read() const {
+  HardwareCounts counts{};
+#ifdef __linux__
+  for (unsigned e = 0; e < NUM_HW_EVENTS; ++e) {
+    if (fds_[e] < 0)
+      continue;
+    std::uint64_t buf[3]; // value, time enabled, time running
+    if (::read(fds_[e], buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0)
+      continue;
+    counts.values[e] =
+        (buf[1] == buf[2])
+            ? buf[0]
+            : static_cast<std::uint64_t>(static_cast<double>(buf[0]) *
+                                         buf[1] / buf[2]);
+  }
+#endif
+  return counts;
+}
+
+} // namespace d2q9
+
+} // namespace balbm
@@ -0,0 +1,272 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "lattice.hh"
+#include "multiscale_map.hh"
+#include "probe.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Virtual destructor for AbstractProbe base class
+AbstractProbe::~AbstractProbe() {}
+
+//! Velocity of a node with the half-force shift of the body force applied,
+//! the velocity the collision uses
+//!
+//! \param lat Lattice
+//! \param mmap Multiscale map
+//! \param pforce Body force, nullptr if there is none
+//! \param i Index in x-direction
+//! \param j Index in y-direction
+//! \return Velocity vector
+AbstractForce::vec AbstractProbe::velocity(const Lattice &lat,
+                                           const IncompFlowMultiscaleMap &mmap,
+                                           const AbstractForce *pforce,
+                                           const unsigned i,
+                                           const unsigned j) {
+  const AbstractForce::vec u(mmap.pu(i, j));
+  return (pforce != nullptr) ? pforce->u_trans(lat, u) : u;
+}
+
+//! Record rho, ux and uy of the node
+//!
+//! \param lat Lattice
+//! \param mmap Multiscale map
+//! \param pforce Body force, nullptr if there is none
+//! \param record Values of the sample
+void PointProbe::sample_(const Lattice &lat,
+                         const IncompFlowMultiscaleMap &mmap,
+                         const AbstractForce *pforce, double *record) const {
+  const auto u = velocity(lat, mmap, pforce, i_, j_);
+  record[0] = mmap.rho(i_, j_);
+  record[1] = u[0];
+  record[2] = u[1];
+}
+
+//! Constructor for a line probe
+//!
+//! \param name Name of the probe
+//! \param i0 x-coord of the first end
+//! \param j0 y-coord of the first end
+//! \param i1 x-coord of the second end
+//! \param j1 y-coord of the second end
+LineProbe::LineProbe(const std::string &name, const unsigned i0,
+                     const unsigned j0, const unsigned i1, const unsigned j1)
+    : AbstractProbe(name) {
+  const int di = static_cast<int>(i1) - static_cast<int>(i0);
+  const int dj = static_cast<int>(j1) - static_cast<int>(j0);
+  const int n = std::max(std::abs(di), std::abs(dj));
+  is_.reserve(n + 1);
+  js_.reserve(n + 1);
+  for (int s = 0; s <= n; ++s) {
+    const double t = (n == 0) ? 0.0 : static_cast<double>(s) / n;
+    is_.push_back(i0 + static_cast<int>(std::lround(t * di)));
+    js_.push_back(j0 + static_cast<int>(std::lround(t * dj)));
+  }
+}
+
+//! Record rho, ux and uy of each node on the line
+//!
+//! \param lat Lattice
+//! \param mmap Multiscale map
+//! \param pforce Body force, nullptr if there is none
+//! \param record Values of the sample
+void LineProbe::sample_(const Lattice &lat, const IncompFlowMultiscaleMap &mmap,
+                        const AbstractForce *pforce, double *record) const {
+  for (unsigned s = 0; s < is_.size(); ++s) {
+    const auto u = velocity(lat, mmap, pforce, is_[s], js_[s]);
+    record[3 * s] = mmap.rho(is_[s], js_[s]);
+    record[3 * s + 1] = u[0];
+    record[3 * s + 2] = u[1];
+  }
+}
+
+//! Whether every node of the line is in a lattice
+//!
+//! \param ni Number of nodes in the x-direction
+//! \param nj Number of nodes in the y-direction
+//! \return Whether the line fits
+bool LineProbe::fits_(const unsigned ni, const unsigned nj) const {
+  for (unsigned s = 0; s < is_.size(); ++s)
+    if (is_[s] >= ni || js_[s] >= nj)
+      return false;
+  return true;
+}
+
+//! Constructor for a flow rate probe
+//!
+//! \param name Name of the probe
+//! \param i0 x-coord of the first end of the section
+//! \param j0 y-coord of the first end of the section
+//! \param i1 x-coord of the second end of the section
+//! \param j1 y-coord of the second end of the section
+//! \throw invalid_argument
+FlowRateProbe::FlowRateProbe(const std::string &name, const unsigned i0,
+                             const unsigned j0, const unsigned i1,
+                             const unsigned j1)
+    : AbstractProbe(name), i0_(std::min(i0, i1)), j0_(std::min(j0, j1)),
+      i1_(std::max(i0, i1)), j1_(std::max(j0, j1)), c_(i0 == i1 ? 0 : 1) {
+  if (i0 != i1 && j0 != j1)
+    throw std::invalid_argument("Section of flow rate probe " + name +
+                                " must be a row or a column of nodes.");
+}
+
+//! Record the flow rate through and the mean density over the section
+//!
+//! \param lat Lattice
+//! \param mmap Multiscale map
+//! \param pforce Body force, nullptr if there is none
+//! \param record Values of the sample
+void FlowRateProbe::sample_(const Lattice &lat,
+                            const IncompFlowMultiscaleMap &mmap,
+                            const AbstractForce *pforce,
+                            double *record) const {
+  double q = 0.0;
+  double rho = 0.0;
+  for (unsigned i = i0_; i <= i1_; ++i)
+    for (unsigned j = j0_; j <= j1_; ++j) {
+      q += velocity(lat, mmap, pforce, i, j)[c_];
+      rho += mmap.rho(i, j);
+    }
+  record[0] = q;
+  record[1] = rho / ((i1_ - i0_ + 1) * (j1_ - j0_ + 1));
+}
+
+//! Constructor for a probe recorder
+//!
+//! \param prefix Prefix of the files samples are flushed to
+//! \param capacity Number of samples of each probe kept in memory
+//! \param block Number of samples flushed to disk at a time
+ProbeRecorder::ProbeRecorder(const std::string &prefix,
+                             const unsigned capacity, const unsigned block)
+    : prefix_(prefix), capacity_(std::max(capacity, 1u)),
+      block_(std::max(std::min(block, capacity_), 1u)) {}
+
+//! Destructor, flushes samples not yet on disk
+ProbeRecorder::~ProbeRecorder() {
+  try {
+    flush();
+  } catch (...) {
+  }
+}
+
+//! Add a probe, allocating its ring buffer and output file
+//!
+//! \param pprobe Probe, owned by the recorder
+//! \return Index of the probe
+//! \throw runtime_error
+unsigned ProbeRecorder::add(AbstractProbe *pprobe) {
+  Channel ch;
+  ch.spprobe.reset(pprobe);
+  ch.stride = 1 + pprobe->width();
+  ch.ring.assign(std::size_t(capacity_) * ch.stride, 0.0);
+  ch.head = 0;
+  ch.count = 0;
+  ch.unflushed = 0;
+  const std::string path = prefix_ + '_' + pprobe->name() + ".dat";
+  ch.ofs.open(path, std::ios::binary | std::ios::trunc);
+  if (!ch.ofs)
+    throw std::runtime_error("Unable to open " + path + '.');
+
+  channels_.push_back(std::move(ch));
+  return channels_.size() - 1;
+}
+
+//! Recent sample of a probe
+//!
+//! \param p Index of the probe
+//! \param age 0 for the latest sample, 1 for the one before, ...
+//! \return Record of 1 + width values, time step first
+//! \throw out_of_range
+const double *ProbeRecorder::sample(const unsigned p,
+                                    const unsigned age) const {
+  const Channel &ch = channels_.at(p);
+  if (age >= std::min(ch.count, capacity_))
+    throw std::out_of_range("Sample of probe " + ch.spprobe->name() +
+                            " is no longer, or not yet, recorded.");
+  const unsigned slot = (ch.head + capacity_ - 1 - age) % capacity_;
+  return &ch.ring[std::size_t(slot) * ch.stride];
+}
+
+//! Sample every probe; the nodes of a probe are checked against the lattice
+//! when it takes its first sample
+//!
+//! \param lat Lattice
+//! \param mmap Multiscale map
+//! \param pforce Body force of the simulation, nullptr if there is none
+//! \param step Time step of the sample
+//! \throw out_of_range
+void ProbeRecorder::record(const Lattice &lat,
+                           const IncompFlowMultiscaleMap &mmap,
+                           const AbstractForce *pforce, const unsigned step) {
+  for (auto &ch : channels_) {
+    if (ch.count == 0 && !ch.spprobe->fits(mmap.num_i(), mmap.num_j())) {
+      std::ostringstream oss;
+      oss << "Probe " << ch.spprobe->name() << " reaches outside the "
+          << mmap.num_i() << " x " << mmap.num_j() << " lattice.";
+      throw std::out_of_range(oss.str());
+    }
+    double *record = &ch.ring[std::size_t(ch.head) * ch.stride];
+    record[0] = step;
+    ch.spprobe->sample(lat, mmap, pforce, record + 1);
+    ch.head = (ch.head + 1 == capacity_) ? 0 : ch.head + 1;
+    ++ch.count;
+    if (++ch.unflushed == block_)
+      flush_(ch);
+  }
+}
+
+//! Append samples not yet on disk to the files of every probe
+void ProbeRecorder::flush() {
+  for (auto &ch : channels_)
+    flush_(ch);
+}
+
+//! Append samples not yet on disk to the file of a probe
+//!
+//! \param ch Probe and its ring buffer
+//! \throw runtime_error
+void ProbeRecorder::flush_(Channel &ch) {
+  if (ch.unflushed == 0)
+    return;
+
+  const unsigned first = (ch.head + capacity_ - ch.unflushed) % capacity_;
+  const unsigned n1 = std::min(ch.unflushed, capacity_ - first);
+  const auto write = [&](const unsigned slot, const unsigned n) {
+    ch.ofs.write(reinterpret_cast<const char *>(
+                     &ch.ring[std::size_t(slot) * ch.stride]),
+                 std::size_t(n) * ch.stride * sizeof(double));
+  };
+  write(first, n1);
+  if (n1 < ch.unflushed)
+    write(0, ch.unflushed - n1);
+  ch.ofs.flush();
+  ch.unflushed = 0;
+  if (!ch.ofs)
+    throw std::runtime_error("Unable to write samples of probe " +
+                             ch.spprobe->name() + '.');
+}
+
+} // namespace d2q9
+
+} // namespace balbm
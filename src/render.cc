@@ -0,0 +1,266 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "render.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#ifdef BALBM_USE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Evenly spaced control points of the colormaps, interpolated linearly
+static const unsigned char GRAY[][3] = {{0, 0, 0}, {255, 255, 255}};
+static const unsigned char VIRIDIS[][3] = {
+    {68, 1, 84},    {71, 44, 122},  {59, 81, 139},
+    {44, 113, 142}, {33, 144, 141}, {39, 173, 129},
+    {92, 200, 99},  {170, 220, 50}, {253, 231, 37}};
+static const unsigned char COOLWARM[][3] = {{59, 76, 192},
+                                            {141, 176, 254},
+                                            {221, 221, 221},
+                                            {244, 154, 123},
+                                            {180, 4, 38}};
+
+//! Map a normalized value to a color
+//!
+//! \param cmap Colormap
+//! \param t Value in [0, 1], clamped otherwise
+//! \param rgb Red, green and blue components
+void colormap_rgb(const Colormap cmap, const double t, unsigned char *rgb) {
+  const unsigned char(*pts)[3];
+  unsigned npts;
+  switch (cmap) {
+  case Colormap::Gray:
+    pts = GRAY;
+    npts = sizeof(GRAY) / sizeof(GRAY[0]);
+    break;
+  case Colormap::CoolWarm:
+    pts = COOLWARM;
+    npts = sizeof(COOLWARM) / sizeof(COOLWARM[0]);
+    break;
+  default:
+    pts = VIRIDIS;
+    npts = sizeof(VIRIDIS) / sizeof(VIRIDIS[0]);
+  }
+
+  // NaNs are clamped to the low end
+  const double x = (t > 0.0) ? std::min(t, 1.0) * (npts - 1) : 0.0;
+  const unsigned lo = std::min(static_cast<unsigned>(x), npts - 2);
+  const double w = x - lo;
+  for (unsigned c = 0; c < 3; ++c)
+    rgb[c] = static_cast<unsigned char>(
+        std::lround((1.0 - w) * pts[lo][c] + w * pts[lo + 1][c]));
+}
+
+//! Constructor for an image renderer
+//!
+//! \param prefix Prefix of the image files
+//! \param quantity Scalar field to render
+//! \param cmap Colormap
+//! \param vmin Value mapped to the low end of the colormap
+//! \param vmax Value mapped to the high end of the colormap
+//! \param format Image file format
+//! \param scale Pixels per node along each axis
+//! \throw invalid_argument
+ImageRenderer::ImageRenderer(const std::string &prefix,
+                             const RenderQuantity quantity,
+                             const Colormap cmap, const double vmin,
+                             const double vmax, const ImageFormat format,
+                             const unsigned scale)
+    : prefix_(prefix), quantity_(quantity), cmap_(cmap), vmin_(vmin),
+      vmax_(vmax), format_(format), scale_(std::max(scale, 1u)) {
+#ifndef BALBM_USE_ZLIB
+  if (format_ == ImageFormat::PNG)
+    throw std::invalid_argument("PNG rendering requires balbm to be built "
+                                "with zlib.");
+#endif
+}
+
+//! Fields an output pipeline must stage to render a quantity
+//!
+//! \param quantity Scalar field to render
+//! \return OutputField bit flags
+unsigned ImageRenderer::required_fields(const RenderQuantity quantity) {
+  return (quantity == RenderQuantity::Density) ? OUTPUT_RHO : OUTPUT_U;
+}
+
+//! Derive the scalar field to render from a frame
+//!
+//! Vorticity uses central differences inside the frame and one-sided
+//! differences on its edges.
+//!
+//! \param frame Staged fields
+//! \param quantity Scalar field to render
+//! \param values Scalar field in frame order
+static void derive(const FieldFrame &frame, const RenderQuantity quantity,
+                   std::vector<double> &values) {
+  const unsigned ni = frame.ni;
+  const unsigned nj = frame.nj;
+  const std::vector<double> &src =
+      (quantity == RenderQuantity::Density) ? frame.rho : frame.u;
+  const std::size_t ncomp = (quantity == RenderQuantity::Density) ? 1 : 2;
+  if (src.size() != std::size_t(ni) * nj * ncomp)
+    throw std::invalid_argument("Frame is missing the field to render.");
+
+  values.resize(std::size_t(ni) * nj);
+  const auto u = [&](const unsigned i, const unsigned j, const unsigned c) {
+    return src[2 * (std::size_t(i) * nj + j) + c];
+  };
+  for (unsigned i = 0; i < ni; ++i)
+    for (unsigned j = 0; j < nj; ++j) {
+      double &v = values[std::size_t(i) * nj + j];
+      switch (quantity) {
+      case RenderQuantity::Density:
+        v = src[std::size_t(i) * nj + j];
+        break;
+      case RenderQuantity::Speed:
+        v = std::sqrt(u(i, j, 0) * u(i, j, 0) + u(i, j, 1) * u(i, j, 1));
+        break;
+      case RenderQuantity::Vorticity: {
+        const unsigned im = (i > 0) ? i - 1 : i;
+        const unsigned ip = (i + 1 < ni) ? i + 1 : i;
+        const unsigned jm = (j > 0) ? j - 1 : j;
+        const unsigned jp = (j + 1 < nj) ? j + 1 : j;
+        const double duydx =
+            (ip > im) ? (u(ip, j, 1) - u(im, j, 1)) / (ip - im) : 0.0;
+        const double duxdy =
+            (jp > jm) ? (u(i, jp, 0) - u(i, jm, 0)) / (jp - jm) : 0.0;
+        v = (duydx - duxdy) / frame.spacing;
+        break;
+      }
+      }
+    }
+}
+
+#ifdef BALBM_USE_ZLIB
+//! Append a PNG chunk
+//!
+//! \param png PNG file contents
+//! \param type Four character chunk type
+//! \param data Chunk data
+static void png_chunk(std::string &png, const char *type,
+                      const std::string &data) {
+  const auto be32 = [&](const std::uint32_t x) {
+    for (int shift = 24; shift >= 0; shift -= 8)
+      png.push_back(static_cast<char>((x >> shift) & 0xff));
+  };
+  be32(static_cast<std::uint32_t>(data.size()));
+  const std::size_t start = png.size();
+  png.append(type, 4);
+  png.append(data);
+  be32(static_cast<std::uint32_t>(
+      crc32(0, reinterpret_cast<const Bytef *>(&png[start]),
+            static_cast<uInt>(png.size() - start))));
+}
+
+//! Encode an RGB image as PNG
+//!
+//! \param rgb Pixels, row by row from the top
+//! \param width Width in pixels
+//! \param height Height in pixels
+//! \return PNG file contents
+static std::string encode_png(const std::vector<unsigned char> &rgb,
+                              const unsigned width, const unsigned height) {
+  // every scanline is preceded by its filter type, 0 = none
+  std::vector<unsigned char> raw;
+  raw.reserve(std::size_t(height) * (3 * width + 1));
+  for (unsigned r = 0; r < height; ++r) {
+    raw.push_back(0);
+    raw.insert(raw.end(), rgb.begin() + std::size_t(r) * 3 * width,
+               rgb.begin() + std::size_t(r + 1) * 3 * width);
+  }
+  uLongf zbytes = compressBound(raw.size());
+  std::string zdata(zbytes, '\0');
+  if (compress2(reinterpret_cast<Bytef *>(&zdata[0]), &zbytes, raw.data(),
+                raw.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+    throw std::runtime_error("Unable to compress PNG image data.");
+  zdata.resize(zbytes);
+
+  std::string ihdr;
+  for (const std::uint32_t x : {width, height})
+    for (int shift = 24; shift >= 0; shift -= 8)
+      ihdr.push_back(static_cast<char>((x >> shift) & 0xff));
+  ihdr += std::string("\x08\x02\x00\x00\x00", 5); // 8 bit RGB
+
+  std::string png("\x89PNG\r\n\x1a\n", 8);
+  png_chunk(png, "IHDR", ihdr);
+  png_chunk(png, "IDAT", zdata);
+  png_chunk(png, "IEND", "");
+  return png;
+}
+#endif
+
+//! Render a frame to an image file
+//!
+//! \param frame Staged fields
+//! \throw runtime_error, invalid_argument
+void ImageRenderer::write_(const FieldFrame &frame) {
+  std::vector<double> values;
+  derive(frame, quantity_, values);
+
+  double vmin = vmin_;
+  double vmax = vmax_;
+  if (vmin == vmax && !values.empty()) {
+    const auto range = std::minmax_element(values.cbegin(), values.cend());
+    vmin = *range.first;
+    vmax = *range.second;
+  }
+  const double scale = (vmax > vmin) ? 1.0 / (vmax - vmin) : 0.0;
+
+  const unsigned width = frame.ni * scale_;
+  const unsigned height = frame.nj * scale_;
+  std::vector<unsigned char> rgb(std::size_t(width) * height * 3);
+  for (unsigned r = 0; r < height; ++r) {
+    const unsigned j = frame.nj - 1 - r / scale_;
+    for (unsigned i = 0; i < frame.ni; ++i) {
+      unsigned char color[3];
+      const double t = (values[std::size_t(i) * frame.nj + j] - vmin) * scale;
+      colormap_rgb(cmap_, t, color);
+      for (unsigned s = 0; s < scale_; ++s)
+        std::copy(color, color + 3,
+                  &rgb[(std::size_t(r) * width + i * scale_ + s) * 3]);
+    }
+  }
+
+  std::ostringstream path;
+  path << prefix_ << '_' << std::setfill('0') << std::setw(8) << frame.step
+       << ((format_ == ImageFormat::PNG) ? ".png" : ".ppm");
+  std::ofstream ofs(path.str(), std::ios::binary | std::ios::trunc);
+#ifdef BALBM_USE_ZLIB
+  if (format_ == ImageFormat::PNG)
+    ofs << encode_png(rgb, width, height);
+  else
+#endif
+  {
+    ofs << "P6\n" << width << ' ' << height << "\n255\n";
+    ofs.write(reinterpret_cast<const char *>(rgb.data()), rgb.size());
+  }
+  ofs.close();
+  if (!ofs)
+    throw std::runtime_error("Unable to write " + path.str() + '.');
+}
+
+} // namespace d2q9
+
+} // namespace balbm
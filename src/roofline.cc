@@ -0,0 +1,195 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "roofline.hh"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Measure the ceilings of the machine for the calling thread
+//!
+//! Bandwidth is the best of `reps` STREAM triads, a = b + s * c, over
+//! arrays that should exceed the last level cache; bytes are counted as
+//! STREAM does, without write allocation. Throughput is the best of `reps`
+//! runs of independent scalar multiply-adds, as the kernels are scalar.
+//!
+//! \param n Number of doubles per triad array
+//! \param reps Number of repetitions
+//! \return Ceilings
+//! \throw invalid_argument
+MachineCeilings measure_machine_ceilings(const std::size_t n,
+                                         const unsigned reps) {
+  if (n == 0 || reps == 0)
+    throw std::invalid_argument("Measuring machine ceilings needs at least "
+                                "one element and one repetition.");
+
+  using clock = std::chrono::steady_clock;
+  const auto seconds = [](const clock::time_point &start) {
+    return std::chrono::duration<double>(clock::now() - start).count();
+  };
+  constexpr double inf = std::numeric_limits<double>::infinity();
+
+  std::vector<double> a(n, 0.0), b(n, 1.0), c(n, 2.0);
+  const double s = 3.0;
+  double best_triad = inf;
+  for (unsigned r = 0; r < reps; ++r) {
+    const auto start = clock::now();
+    for (std::size_t i = 0; i < n; ++i)
+      a[i] = b[i] + s * c[i];
+    best_triad = std::min(best_triad, seconds(start));
+    std::swap(a, b); // keep the compiler from hoisting the triad
+  }
+
+  constexpr unsigned nacc = 8;
+  double acc[nacc] = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0};
+  const double mul = 0.999999, add = 1e-7;
+  double best_fma = inf;
+  for (unsigned r = 0; r < reps; ++r) {
+    const auto start = clock::now();
+    for (std::size_t i = 0; i < n; ++i)
+      for (unsigned q = 0; q < nacc; ++q)
+        acc[q] = acc[q] * mul + add;
+    best_fma = std::min(best_fma, seconds(start));
+  }
+  volatile double sink = a[n / 2];
+  for (unsigned q = 0; q < nacc; ++q)
+    sink = sink + acc[q];
+
+  best_triad = std::max(best_triad, 1e-9);
+  best_fma = std::max(best_fma, 1e-9);
+  return {3.0 * sizeof(double) * n / best_triad, 2.0 * nacc * n / best_fma};
+}
+
+//! Place a kernel on the roofline of a machine
+//!
+//! \param ceilings Ceilings of the machine
+//! \param flops Floating point operations of the kernel
+//! \param bytes Bytes moved to and from memory by the kernel
+//! \param seconds Wall time of the kernel
+//! \return Placement
+//! \throw invalid_argument
+RooflinePoint place_on_roofline(const MachineCeilings &ceilings,
+                                const double flops, const double bytes,
+                                const double seconds) {
+  if (!(seconds > 0.0) || !(bytes > 0.0) || flops < 0.0)
+    throw std::invalid_argument("A kernel needs positive time and bytes to "
+                                "be placed on a roofline.");
+  RooflinePoint pt;
+  pt.bytes_per_second = bytes / seconds;
+  pt.flops_per_second = flops / seconds;
+  pt.intensity = flops / bytes;
+  pt.attainable_flops_per_second = std::min(
+      ceilings.flops_per_second, pt.intensity * ceilings.bytes_per_second);
+  pt.memory_bound = pt.intensity * ceilings.bytes_per_second <
+                    ceilings.flops_per_second;
+  return pt;
+}
+
+//! Print the roofline placement of streaming and collision
+//!
+//! \param os Output stream
+//! \param instr Instrumentation of the simulation
+//! \param ceilings Ceilings of the machine
+//! \param nodes Number of nodes updated per step
+void roofline_report(std::ostream &os, const Instrumentation &instr,
+                     const MachineCeilings &ceilings, const std::size_t nodes) {
+  if (!instr.enabled()) {
+    os << "instrumentation is disabled, define BALBM_INSTRUMENT\n";
+    return;
+  }
+
+  const auto flags = os.flags();
+  const auto precision = os.precision();
+  os << std::fixed << std::setprecision(2)
+     << "memory bandwidth  " << ceilings.bytes_per_second * 1e-9 << " GB/s\n"
+     << "scalar throughput " << ceilings.flops_per_second * 1e-9
+     << " GFLOP/s\n"
+     << "ridge point       "
+     << ceilings.flops_per_second / ceilings.bytes_per_second << " flop/B\n";
+
+  const PerfCounters *pperf = instr.perf_counters();
+  if (pperf == nullptr)
+    os << "hardware counters were not requested, bytes are model estimates\n";
+  else if (!pperf->available())
+    os << "hardware counters unavailable (" << pperf->reason()
+       << "), bytes are model estimates\n";
+
+  struct Kernel {
+    Phase phase;
+    double bytes_per_node;
+    double flops_per_node;
+  };
+  const Kernel kernels[] = {
+      {PHASE_STREAM, stream_bytes_per_node, 0.0},
+      {PHASE_COLLIDE, collide_bytes_per_node, collide_flops_per_node}};
+
+  os << std::left << std::setw(10) << "kernel" << std::right << std::setw(10)
+     << "MLUPS" << std::setw(10) << "GB/s" << std::setw(10) << "GFLOP/s"
+     << std::setw(10) << "flop/B" << std::setw(10) << "roof" << std::setw(9)
+     << "% roof" << "  bound\n";
+  for (const auto &kernel : kernels) {
+    const PhaseTotals t = instr.phase(kernel.phase);
+    if (t.calls == 0 || !(t.seconds > 0.0))
+      continue;
+    const double n = static_cast<double>(t.calls) * nodes;
+    const RooflinePoint pt =
+        place_on_roofline(ceilings, n * kernel.flops_per_node,
+                          n * kernel.bytes_per_node, t.seconds);
+    const double fraction =
+        pt.memory_bound ? pt.bytes_per_second / ceilings.bytes_per_second
+                        : pt.flops_per_second / pt.attainable_flops_per_second;
+    os << std::left << std::setw(10) << phase_name(kernel.phase) << std::right
+       << std::setw(10) << n / t.seconds * 1e-6 << std::setw(10)
+       << pt.bytes_per_second * 1e-9 << std::setw(10)
+       << pt.flops_per_second * 1e-9 << std::setw(10) << pt.intensity
+       << std::setw(10) << pt.attainable_flops_per_second * 1e-9
+       << std::setw(9) << 100.0 * fraction << "  "
+       << (pt.memory_bound ? "memory" : "compute") << '\n';
+
+    if (pperf == nullptr)
+      continue;
+    const HardwareCounts hw = instr.hardware(kernel.phase);
+    if (pperf->available(HW_CYCLES) && pperf->available(HW_INSTRUCTIONS) &&
+        hw.values[HW_CYCLES] > 0)
+      os << "  " << static_cast<double>(hw.values[HW_INSTRUCTIONS]) /
+                        hw.values[HW_CYCLES]
+         << " instructions per cycle, " << hw.values[HW_CYCLES] / n
+         << " cycles per node\n";
+    if (pperf->available(HW_LLC_MISSES)) {
+      const double bytes =
+          static_cast<double>(hw.values[HW_LLC_MISSES]) *
+          PerfCounters::cache_line_bytes;
+      os << "  measured " << bytes / t.seconds * 1e-9 << " GB/s, "
+         << bytes / n << " B per node against " << kernel.bytes_per_node
+         << " modelled\n";
+    }
+  }
+  os.flags(flags);
+  os.precision(precision);
+}
+
+} // namespace d2q9
+
+} // namespace balbm
@@ -0,0 +1,193 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "lattice.hh"
+#include "multiscale_map.hh"
+#include "shared_fields.hh"
+#include "simulate.hh"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Alignment of the arrays of a shared field segment
+static const std::uint64_t SHARED_ALIGN = 64;
+
+//! Throw after a failed system call on a shared field segment
+//!
+//! \param what Name of the system call
+//! \param name Name of the segment
+static void throw_errno(const char *what, const std::string &name) {
+  std::ostringstream oss;
+  oss << "Shared fields " << name << ": " << what << " failed, "
+      << std::strerror(errno) << '.';
+  throw std::runtime_error(oss.str());
+}
+
+//! Whether a node has a boundary descriptor
+static bool is_boundary(const AbstractNodeDesc *pnd) {
+  return pnd != nullptr && dynamic_cast<const NodeActive *>(pnd) == nullptr &&
+         dynamic_cast<const NodePeriodic *>(pnd) == nullptr &&
+         dynamic_cast<const NodeInactive *>(pnd) == nullptr;
+}
+
+//! Constructor for a shared field publisher, creates the segment
+//!
+//! \param name Name of the segment, e.g. "/balbm"
+//! \param lat Lattice
+//! \param fields OutputField bit flags of the fields to publish
+//! \param boundary_f Publish particle distributions of boundary nodes
+//! \throw runtime_error
+SharedFieldPublisher::SharedFieldPublisher(const std::string &name,
+                                           const Lattice &lat,
+                                           const unsigned fields,
+                                           const bool boundary_f)
+    : name_(name), bytes_(0), pseg_(nullptr), pheader_(nullptr) {
+  const std::uint64_t n = std::uint64_t(lat.num_i()) * lat.num_j();
+  if (boundary_f)
+    for (std::uint32_t idx = 0; idx < n; ++idx)
+      if (is_boundary(lat.node_descs()[idx]))
+        bnodes_.push_back(idx);
+
+  std::uint64_t bytes[SHARED_NUM_ARRAYS] = {};
+  if (fields & OUTPUT_RHO)
+    bytes[SHARED_RHO] = n * sizeof(double);
+  if (fields & OUTPUT_U)
+    bytes[SHARED_U] = 2 * n * sizeof(double);
+  if (fields & OUTPUT_OMEGA)
+    bytes[SHARED_OMEGA] = n * sizeof(double);
+  if (fields & OUTPUT_F)
+    bytes[SHARED_F] = n * lat.num_k() * sizeof(double);
+  bytes[SHARED_BNODES] = bnodes_.size() * sizeof(std::uint32_t);
+  bytes[SHARED_BF] = bnodes_.size() * lat.num_k() * sizeof(double);
+
+  std::uint64_t offsets[SHARED_NUM_ARRAYS];
+  std::uint64_t offset = sizeof(SharedFieldsHeader);
+  for (unsigned a = 0; a < SHARED_NUM_ARRAYS; ++a) {
+    offset = (offset + SHARED_ALIGN - 1) / SHARED_ALIGN * SHARED_ALIGN;
+    offsets[a] = offset;
+    offset += bytes[a];
+  }
+  bytes_ = static_cast<std::size_t>(offset);
+
+  // replace a segment left behind by a crashed run of the same name
+  shm_unlink(name.c_str());
+  const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0)
+    throw_errno("shm_open", name);
+  if (ftruncate(fd, static_cast<off_t>(bytes_)) != 0) {
+    const int err = errno;
+    close(fd);
+    shm_unlink(name.c_str());
+    errno = err;
+    throw_errno("ftruncate", name);
+  }
+  void *p = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    const int err = errno;
+    shm_unlink(name.c_str());
+    errno = err;
+    throw_errno("mmap", name);
+  }
+  pseg_ = static_cast<char *>(p);
+
+  // readers check the magic bytes, which are written last
+  pheader_ = new (pseg_) SharedFieldsHeader;
+  pheader_->version = SHARED_FIELDS_VERSION;
+  pheader_->fields =
+      fields & (OUTPUT_RHO | OUTPUT_U | OUTPUT_OMEGA | OUTPUT_F);
+  pheader_->ni = lat.num_i();
+  pheader_->nj = lat.num_j();
+  pheader_->nk = lat.num_k();
+  pheader_->num_boundary_nodes = static_cast<std::uint32_t>(bnodes_.size());
+  pheader_->step = 0;
+  std::copy(offsets, offsets + SHARED_NUM_ARRAYS, pheader_->offsets);
+  std::copy(bytes, bytes + SHARED_NUM_ARRAYS, pheader_->bytes);
+  std::copy(bnodes_.cbegin(), bnodes_.cend(),
+            reinterpret_cast<std::uint32_t *>(pseg_ + offsets[SHARED_BNODES]));
+  std::copy(SHARED_FIELDS_MAGIC, SHARED_FIELDS_MAGIC + 8, pheader_->magic);
+  pheader_->sequence.store(0, std::memory_order_release);
+}
+
+//! Destructor, unmaps and unlinks the segment
+SharedFieldPublisher::~SharedFieldPublisher() {
+  munmap(pseg_, bytes_);
+  shm_unlink(name_.c_str());
+}
+
+//! Copy the fields of a simulation into the segment
+//!
+//! \param lat Lattice
+//! \param mmap Multiscale map
+//! \param step Time step of the fields
+void SharedFieldPublisher::publish(const Lattice &lat,
+                                   const IncompFlowMultiscaleMap &mmap,
+                                   const unsigned step) {
+  const std::uint64_t seq = pheader_->sequence.load(std::memory_order_relaxed);
+  const std::uint64_t odd = seq | 1;
+  pheader_->sequence.store(odd, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  pheader_->step = step;
+  const auto copy = [&](const SharedArray a, const double *src) {
+    std::memcpy(pseg_ + pheader_->offsets[a], src,
+                static_cast<std::size_t>(pheader_->bytes[a]));
+  };
+  if (pheader_->fields & OUTPUT_RHO)
+    copy(SHARED_RHO, mmap.prho());
+  if (pheader_->fields & OUTPUT_U)
+    copy(SHARED_U, mmap.pu());
+  if (pheader_->fields & OUTPUT_OMEGA)
+    copy(SHARED_OMEGA, mmap.pomega());
+  if (pheader_->fields & OUTPUT_F)
+    copy(SHARED_F, lat.pf());
+  const unsigned nk = lat.num_k();
+  double *pbf =
+      reinterpret_cast<double *>(pseg_ + pheader_->offsets[SHARED_BF]);
+  for (const auto idx : bnodes_)
+    pbf = std::copy(lat.pf() + std::size_t(idx) * nk,
+                    lat.pf() + std::size_t(idx + 1) * nk, pbf);
+
+  pheader_->sequence.store(odd + 1, std::memory_order_release);
+}
+
+//! Publish the fields of the simulation every `stride` time steps
+//!
+//! \param sim Incompressible flow simulation
+void SharedFieldCallback::f_(AbstractSimulation &sim) const {
+  // callbacks run before the step counter is incremented
+  const unsigned step = sim.step() + 1;
+  if (step % stride_ != 0)
+    return;
+
+  const auto &incomp_sim = dynamic_cast<const IncompFlowSimulation &>(sim);
+  ppublisher_->publish(incomp_sim.lattice(), incomp_sim.multiscale_map(),
+                       step);
+}
+
+} // namespace d2q9
+
+} // namespace balbm
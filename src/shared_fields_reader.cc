@@ -0,0 +1,155 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// The reader is kept apart from the publisher so that external consumers
+// only need this file and the headers, not the rest of balbm.
+
+#include "shared_fields.hh"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Throw on a shared field segment that can not be read
+//!
+//! \param what Description of the problem
+//! \param name Name of the segment
+static void throw_bad(const std::string &what, const std::string &name) {
+  std::ostringstream oss;
+  oss << "Shared fields " << name << ": " << what;
+  throw std::runtime_error(oss.str());
+}
+
+//! Constructor for a shared field reader, maps the segment read-only
+//!
+//! \param name Name of the segment
+//! \throw runtime_error
+SharedFieldReader::SharedFieldReader(const std::string &name)
+    : bytes_(0), pseg_(nullptr), pheader_(nullptr) {
+  const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    throw_bad(std::string("shm_open failed, ") + std::strerror(errno) + '.',
+              name);
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<std::size_t>(st.st_size) < sizeof(SharedFieldsHeader)) {
+    close(fd);
+    throw_bad("segment is not initialized.", name);
+  }
+  bytes_ = static_cast<std::size_t>(st.st_size);
+  void *p = mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    throw_bad(std::string("mmap failed, ") + std::strerror(errno) + '.', name);
+  pseg_ = static_cast<const char *>(p);
+  pheader_ = reinterpret_cast<const SharedFieldsHeader *>(pseg_);
+
+  std::string what;
+  if (!std::equal(SHARED_FIELDS_MAGIC, SHARED_FIELDS_MAGIC + 8,
+                  pheader_->magic))
+    what = "not a balbm shared field segment, or not initialized.";
+  else if (pheader_->version != SHARED_FIELDS_VERSION)
+    what = "layout version is not supported.";
+  else
+    for (unsigned a = 0; a < SHARED_NUM_ARRAYS; ++a)
+      if (pheader_->offsets[a] + pheader_->bytes[a] > bytes_)
+        what = "segment is truncated.";
+  if (!what.empty()) {
+    munmap(const_cast<char *>(pseg_), bytes_);
+    throw_bad(what, name);
+  }
+}
+
+//! Destructor, unmaps the segment
+SharedFieldReader::~SharedFieldReader() {
+  munmap(const_cast<char *>(pseg_), bytes_);
+}
+
+//! Start reading the arrays in place
+//!
+//! Waits while the publisher is copying fields.
+//!
+//! \return Sequence to pass to end_read
+std::uint64_t SharedFieldReader::begin_read() const {
+  for (;;) {
+    const std::uint64_t seq = sequence();
+    if (seq % 2 == 0)
+      return seq;
+    std::this_thread::yield();
+  }
+}
+
+//! Finish reading the arrays in place
+//!
+//! \param seq Sequence returned by begin_read
+//! \return Whether the arrays were consistent during the read
+bool SharedFieldReader::end_read(const std::uint64_t seq) const {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return pheader_->sequence.load(std::memory_order_relaxed) == seq;
+}
+
+//! Copy a consistent set of the published fields
+//!
+//! \param frame Frame to fill, unpublished fields are left empty
+//! \param pboundary_f Particle distributions of boundary nodes, optional
+//! \return Sequence of the copied fields
+std::uint64_t SharedFieldReader::snapshot(FieldFrame &frame,
+                                          std::vector<double> *pboundary_f)
+    const {
+  const std::size_t n = std::size_t(num_i()) * num_j();
+  frame.fields = pheader_->fields;
+  frame.ni = num_i();
+  frame.nj = num_j();
+  frame.nk = num_k();
+  frame.origin[0] = frame.origin[1] = 0.0;
+  frame.spacing = 1.0;
+  const auto copy = [&](const SharedArray a, const unsigned flag,
+                        const std::size_t size, std::vector<double> &dst) {
+    if (pheader_->fields & flag)
+      dst.assign(array(a), array(a) + size);
+    else
+      dst.clear();
+  };
+
+  std::uint64_t seq;
+  do {
+    seq = begin_read();
+    frame.step = step();
+    copy(SHARED_RHO, OUTPUT_RHO, n, frame.rho);
+    copy(SHARED_U, OUTPUT_U, 2 * n, frame.u);
+    copy(SHARED_OMEGA, OUTPUT_OMEGA, n, frame.omega);
+    copy(SHARED_F, OUTPUT_F, n * num_k(), frame.f);
+    if (pboundary_f != nullptr)
+      pboundary_f->assign(boundary_f(),
+                          boundary_f() +
+                              std::size_t(num_boundary_nodes()) * num_k());
+  } while (!end_read(seq));
+  return seq;
+}
+
+} // namespace d2q9
+
+} // namespace balbm
@@ -15,6 +15,13 @@
 // this program.  If not, see <http://www.gnu.org/licenses/>
 
 #include "simulate.hh"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
 
 namespace balbm {
 
@@ -33,13 +40,126 @@ AbstractSimulation::~AbstractSimulation() {}
 //! \param pconstiteq Pointer to base class for constitutive equations
 //! \param pforce Pointer to base class for external forcing scheme
 //! \param scbs Vector of callback functions to execute after each time step
+//! \param psource Pointer to base class for position dependent source terms
 IncompFlowSimulation::IncompFlowSimulation(
     const unsigned ni, const unsigned nj, const double rho, const double mu,
     AbstractIncompFlowEqFunct *pfeq, AbstractConstitutiveEq *pconstiteq,
-    AbstractForce *pforce, std::vector<AbstractSimCallback *> *pscbs = nullptr)
+    AbstractForce *pforce, std::vector<AbstractSimCallback *> *pscbs,
+    AbstractSourceTerm *psource)
     : AbstractSimulation(), lat_(ni, nj, rho),
       mmap_(ni, nj, mu_to_omega(mu, lat_.cssq(), lat_.dt())),
-      cman_(pfeq, pconstiteq, pforce), spscbs_(pscbs) {}
+      cman_(pfeq, pconstiteq, pforce, psource), spscbs_(pscbs),
+      pprobes_(nullptr), pstats_(nullptr), ptrace_(nullptr),
+      tiles_(sweep_tiles(ni, nj, sweep_)), sppool_(new SweepPool()) {
+  cman_.attach_instrumentation(&instr_);
+}
+
+//! Accumulate running statistics during the collision sweep
+//!
+//! \param pstats Statistics of the lattice, not owned, nullptr to detach
+//! \throw invalid_argument
+void IncompFlowSimulation::attach_statistics(FlowStatistics *pstats) {
+  if (pstats != nullptr &&
+      (pstats->num_i() != lat_.num_i() || pstats->num_j() != lat_.num_j()))
+    throw std::invalid_argument("Running statistics do not match the "
+                                "dimensions of the lattice.");
+  pstats_ = pstats;
+  cman_.attach_statistics(pstats);
+}
+
+//! Split the sweeps into tiles and threads
+//!
+//! \param config Sweep configuration
+//! \throw invalid_argument
+//! \throw logic_error if called from a callback while the simulation steps
+void IncompFlowSimulation::set_sweep_config(const SweepConfig &config) {
+  if (sppool_->running())
+    throw std::logic_error("Sweeps cannot be reconfigured while the "
+                           "simulation steps.");
+  SweepTiles tiles = sweep_tiles(lat_.num_i(), lat_.num_j(), config);
+#ifndef BALBM_INSTRUMENT_NODES
+  if (config.nthreads != sppool_->num_threads())
+    sppool_.reset(new SweepPool(config.nthreads));
+#endif
+  tiles_ = std::move(tiles);
+  sweep_ = config;
+}
+
+//! Time candidate sweep configurations on the current state for a few steps
+//! each and keep the fastest
+//!
+//! The state is restored afterwards; no step is counted and no statistics,
+//! probes, callbacks or traces are recorded. A configuration cached for this
+//! CPU model and domain size is taken without timing unless opts.retune is
+//! set, and the chosen one is cached.
+//!
+//! \param opts Options
+//! \return Chosen configuration, also set on the simulation
+AutotuneResult IncompFlowSimulation::autotune(const AutotuneOptions &opts) {
+  if (sppool_->running())
+    throw std::logic_error("Sweeps cannot be autotuned while the simulation "
+                           "steps.");
+  const unsigned ni = lat_.num_i(), nj = lat_.num_j();
+  AutotuneResult result = {sweep_, false, false, 0.0, 0};
+  const std::string cpu = cpu_model();
+  const bool cache = !opts.cache_path.empty();
+  if (cache && !opts.retune &&
+      lookup_sweep_config(opts.cache_path, cpu, ni, nj, result.config)) {
+    set_sweep_config(result.config);
+    result.cached = true;
+    return result;
+  }
+
+  const std::size_t nn = std::size_t(ni) * nj, nf = nn * lat_.num_k();
+  const std::vector<double> f(lat_.pf(), lat_.pf() + nf),
+      ftemp(lat_.pftemp(), lat_.pftemp() + nf),
+      rho(mmap_.prho(), mmap_.prho() + nn),
+      u(mmap_.pu(), mmap_.pu() + 2 * nn),
+      omega(mmap_.pomega(), mmap_.pomega() + nn);
+  const auto restore = [&]() {
+    std::copy(f.cbegin(), f.cend(), lat_.pf());
+    std::copy(ftemp.cbegin(), ftemp.cend(), lat_.pftemp());
+    std::copy(rho.cbegin(), rho.cend(), mmap_.prho());
+    std::copy(u.cbegin(), u.cend(), mmap_.pu());
+    std::copy(omega.cbegin(), omega.cend(), mmap_.pomega());
+    cman_.attach_statistics(pstats_);
+    cman_.attach_instrumentation(&instr_);
+  };
+  cman_.attach_statistics(nullptr);
+  cman_.attach_instrumentation(nullptr);
+
+  double best = std::numeric_limits<double>::infinity();
+  try {
+    for (const auto &c : sweep_candidates(ni, nj, opts.max_threads)) {
+      const SweepTiles tiles = sweep_tiles(ni, nj, c);
+      SweepPool pool(c.nthreads);
+      // the mean of the timed steps, after one to warm up
+      run_steps_(pool, tiles, 1, false);
+      const auto start = std::chrono::steady_clock::now();
+      run_steps_(pool, tiles, std::max(1u, opts.nsteps), false);
+      const double seconds =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                        start).count() /
+          std::max(1u, opts.nsteps);
+      ++result.ntried;
+      if (seconds < best) {
+        best = seconds;
+        result.config = c;
+      }
+    }
+  } catch (...) {
+    restore();
+    throw;
+  }
+  restore();
+
+  set_sweep_config(result.config);
+  result.seconds = best;
+  if (cache)
+    result.stored =
+        store_sweep_config(opts.cache_path, cpu, ni, nj, result.config);
+  return result;
+}
 
 //! Run an imcompressible flow simulation
 //!
@@ -49,28 +169,133 @@ unsigned IncompFlowSimulation::simulate_(const unsigned nsteps) {
   unsigned init_step = step();
 
   try {
-    for (unsigned k = init_step; k <= nsteps; ++k)
-      simulate_();
+    run_steps_(*sppool_, tiles_, nsteps, true);
   } catch (std::exception &e) {
     std::cerr << "ERROR: simulation terminated after " << step() << " steps.\n"
               << e.what() << '\n';
     throw;
   }
 
-  return nsteps - init_step;
+  return step() - init_step;
 }
 
-//! Simulate a time step
-unsigned IncompFlowSimulation::simulate_() {
-  // code for one time step
-  lat_.stream();
-  lat_.swap_f_ptrs();
-  lat_.collide_and_bound(mmap_, cman_);
-  if (spscbs_)
-    for (const auto &cb : *spscbs_)
-      (*cb)(*this);
-  ++step_;
-  return 1;
+//! Stream, swap and collide time steps on the threads of a pool
+//!
+//! Every thread sweeps a contiguous chunk of the tiles, and the threads meet
+//! after streaming and after the swap. When recording, thread 0 also times
+//! the phases, begins the steps of the statistics and counts the steps; with
+//! probes or callbacks attached it runs them between two more barriers, so
+//! that they see the whole collided lattice and the workers wait for them.
+//!
+//! \param pool Pool of threads
+//! \param tiles Tiles covering the lattice once
+//! \param nsteps Steps to sweep
+//! \param record Whether to instrument, trace, record and count the steps
+void IncompFlowSimulation::run_steps_(SweepPool &pool,
+                                      const SweepTiles &tiles,
+                                      const unsigned nsteps,
+                                      const bool record) {
+  const unsigned nthreads = pool.num_threads();
+  const unsigned first_step = step_ + 1;
+  const bool hooks = record && (pprobes_ != nullptr || spscbs_ != nullptr);
+  TraceRecorder *const ptrace = record ? ptrace_ : nullptr;
+
+  pool.run([&](const unsigned t) {
+#ifdef BALBM_INSTRUMENT_NODES
+    static_cast<void>(tiles);
+#else
+    const std::size_t bt = tiles.size() * t / nthreads;
+    const std::size_t et = tiles.size() * (t + 1) / nthreads;
+#endif
+    const int tile = t;
+    Instrumentation *const pinstr = (record && t == 0) ? &instr_ : nullptr;
+    const auto sync = [&](const unsigned step) {
+      if (nthreads == 1)
+        return true;
+      ScopedTrace trace(ptrace, "barrier", "sync", step, tile);
+      return pool.barrier();
+    };
+    if (ptrace != nullptr && t != 0)
+      ptrace->set_thread_name("sweep " + std::to_string(t));
+
+    for (unsigned step = first_step; step < first_step + nsteps; ++step) {
+      BALBM_TIME_PHASE(pinstr, PHASE_STEP);
+      ScopedTrace trace_step((t == 0) ? ptrace : nullptr, PHASE_STEP, step);
+      {
+        BALBM_TIME_PHASE(pinstr, PHASE_STREAM);
+#ifdef BALBM_INSTRUMENT_NODES
+        if (t == 0) {
+          ScopedTrace trace(ptrace, PHASE_STREAM, step, tile);
+          for (unsigned i = 0; i < lat_.num_i(); ++i)
+            for (unsigned j = 0; j < lat_.num_j(); ++j) {
+              BALBM_TIME_NODE_TYPE(pinstr, typeid(lat_.node_desc(i, j)),
+                                   PHASE_STREAM);
+              lat_.stream(i, j);
+            }
+        }
+#else
+        if (bt < et) {
+          ScopedTrace trace(ptrace, PHASE_STREAM, step, tile);
+          for (std::size_t b = bt; b < et; ++b)
+            lat_.stream(tiles[b][0], tiles[b][1], tiles[b][2], tiles[b][3]);
+        }
+#endif
+        if (!sync(step))
+          return;
+      }
+      if (t == 0) {
+        {
+          BALBM_TIME_PHASE(pinstr, PHASE_SWAP);
+          ScopedTrace trace(ptrace, PHASE_SWAP, step);
+          lat_.swap_f_ptrs();
+        }
+        if (record && pstats_)
+          pstats_->begin_step(step);
+      }
+      if (!sync(step))
+        return;
+      {
+        BALBM_TIME_PHASE(pinstr, PHASE_COLLIDE);
+#ifdef BALBM_INSTRUMENT_NODES
+        if (t == 0) {
+          ScopedTrace trace(ptrace, PHASE_COLLIDE, step, tile);
+          for (unsigned i = 0; i < lat_.num_i(); ++i)
+            for (unsigned j = 0; j < lat_.num_j(); ++j) {
+              BALBM_TIME_NODE_TYPE(pinstr, typeid(lat_.node_desc(i, j)),
+                                   PHASE_COLLIDE);
+              lat_.collide_and_bound(mmap_, cman_, i, j);
+            }
+        }
+#else
+        if (bt < et) {
+          ScopedTrace trace(ptrace, PHASE_COLLIDE, step, tile);
+          for (std::size_t b = bt; b < et; ++b)
+            lat_.collide_and_bound(mmap_, cman_, tiles[b][0], tiles[b][1],
+                                   tiles[b][2], tiles[b][3]);
+        }
+#endif
+        if (hooks && !sync(step))
+          return;
+      }
+      if (t == 0) {
+        if (hooks && pprobes_) {
+          BALBM_TIME_PHASE(pinstr, PHASE_PROBES);
+          ScopedTrace trace(ptrace, PHASE_PROBES, step);
+          pprobes_->record(lat_, mmap_, cman_.pforce(), step);
+        }
+        if (hooks && spscbs_) {
+          BALBM_TIME_PHASE(pinstr, PHASE_CALLBACKS);
+          ScopedTrace trace(ptrace, PHASE_CALLBACKS, step);
+          for (const auto &cb : *spscbs_)
+            (*cb)(*this);
+        }
+        if (record)
+          ++step_;
+      }
+      if (hooks && !sync(step))
+        return;
+    }
+  });
 }
 
 } // namespace d2q9
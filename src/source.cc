@@ -0,0 +1,74 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "kernels.hh"
+#include "lattice.hh"
+#include "source.hh"
+#include <armadillo>
+
+namespace balbm {
+
+//! Virtual destructor for AbstractSourceTerm base class
+template <typename VS> AbstractSourceTerm<VS>::~AbstractSourceTerm() {}
+
+template class AbstractSourceTerm<D2Q9>;
+template class AbstractSourceTerm<D3Q19>;
+
+namespace d2q9 {
+
+//! Values to add to particle distributions to simulate axisymmetric flow
+//!
+//! \param lat Lattice
+//! \param fneq Non-equilibrium particle distributions
+//! \param omega Collision frequency
+//! \param rho Density
+//! \param u Macroscopic velocity vector (axial, radial)
+//! \param x Coordinates of the node, (axial, radial)
+//! \param fcol Values to add for each lattice direction
+void AxisymmetricSourceTerm::f_col_(const Lattice &lat, const arma::vec &fneq,
+                                    const double omega, const double rho,
+                                    const vec &u, const Coords &x,
+                                    double *fcol) const {
+  using VS = Lattice::velocity_set;
+  const double rj = r(x[1]);
+  const double nu = VS::cssq * (1.0 / omega - 0.5) * lat.dt();
+  const double ux = u(0);
+  const double ur = u(1);
+
+  // rho * (grad(u) + grad(u)^T) from the non-equilibrium momentum flux
+  double pixr = 0.0;
+  double pirr = 0.0;
+  for_each_k<VS>([&](const unsigned k) {
+    pixr += VS::c[k][0] * VS::c[k][1] * fneq(k);
+    pirr += VS::c[k][1] * VS::c[k][1] * fneq(k);
+  });
+  const double coeff = -omega / (VS::cssq * lat.dt());
+  const double sxr = coeff * pixr;
+  const double srr = coeff * pirr;
+
+  const double F[] = {-rho * ux * ur / rj + nu * sxr / rj,
+                      -rho * ur * ur / rj + nu * srr / rj -
+                          2.0 * nu * rho * ur / (rj * rj)};
+  const double mass = -rho * ur / rj;
+
+  for_each_k<VS>([&](const unsigned k) {
+    fcol[k] = lat.dt() * VS::w[k] * (mass + cdot<VS>(k, F) / VS::cssq);
+  });
+}
+
+} // namespace d2q9
+
+} // namespace balbm
@@ -0,0 +1,76 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "statistics.hh"
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Constructor for running statistics
+//!
+//! \param ni Number of nodes in the x-direction
+//! \param nj Number of nodes in the y-direction
+//! \param start First time step sampled
+//! \param interval Number of time steps between samples
+FlowStatistics::FlowStatistics(const unsigned ni, const unsigned nj,
+                               const unsigned start, const unsigned interval)
+    : ni_(ni), nj_(nj), start_(start), interval_(std::max(interval, 1u)),
+      nsamples_(0), inv_nsamples_(0.0), sampling_(false),
+      data_(std::size_t(ni) * nj * NUM_SLOTS, 0.0) {}
+
+//! Decide whether a time step is sampled, before its collision sweep
+//!
+//! \param step Time step about to be computed
+void FlowStatistics::begin_step(const unsigned step) {
+  sampling_ = (step >= start_ && (step - start_) % interval_ == 0);
+  if (sampling_)
+    set_num_samples(nsamples_ + 1);
+}
+
+//! Discard every sample
+void FlowStatistics::reset() {
+  std::fill(data_.begin(), data_.end(), 0.0);
+  set_num_samples(0);
+  sampling_ = false;
+}
+
+//! Reynolds stress <u_a' u_b'> of a node
+//!
+//! \param i Index in x-direction
+//! \param j Index in y-direction
+//! \param a First velocity component
+//! \param b Second velocity component
+//! \return Covariance of the two velocity components
+double FlowStatistics::reynolds_stress(const unsigned i, const unsigned j,
+                                       const unsigned a,
+                                       const unsigned b) const {
+  if (a == b)
+    return var_u(i, j, a);
+  return (nsamples_ > 0) ? record(i, j)[C2_UXUY] / nsamples_ : 0.0;
+}
+
+//! Set the number of samples the records hold, e.g. after restoring them
+//!
+//! \param nsamples Number of samples
+void FlowStatistics::set_num_samples(const unsigned nsamples) {
+  nsamples_ = nsamples;
+  inv_nsamples_ = (nsamples > 0) ? 1.0 / nsamples : 0.0;
+}
+
+} // namespace d2q9
+
+} // namespace balbm
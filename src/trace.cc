@@ -0,0 +1,217 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "trace.hh"
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#ifdef __unix__
+#include <unistd.h>
+#endif
+
+namespace balbm {
+
+namespace d2q9 {
+
+//! Identifies recorders in the buffer caches of threads
+static std::atomic<std::uint64_t> next_id(1);
+
+//! Write a string as a JSON string
+//!
+//! \param os Output stream
+//! \param s String
+static void write_json_string(std::ostream &os, const std::string &s) {
+  os << '"';
+  for (const char c : s) {
+    if (c == '"' || c == '\\')
+      os << '\\' << c;
+    else if (static_cast<unsigned char>(c) < 0x20)
+      os << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+         << static_cast<unsigned>(c) << std::dec << std::setfill(' ');
+    else
+      os << c;
+  }
+  os << '"';
+}
+
+//! Constructor
+//!
+//! \param capacity Maximum number of events recorded per thread
+//! \throw invalid_argument
+TraceRecorder::TraceRecorder(const std::size_t capacity)
+    : id_(next_id.fetch_add(1)), capacity_(capacity),
+      epoch_(std::chrono::steady_clock::now()) {
+  if (capacity == 0)
+    throw std::invalid_argument("A trace recorder needs room for at least "
+                                "one event per thread.");
+}
+
+//! Destructor
+TraceRecorder::~TraceRecorder() {}
+
+//! Buffer of the calling thread, created on first use
+//!
+//! \return Buffer
+TraceRecorder::Buffer &TraceRecorder::buffer_() {
+  thread_local std::vector<std::pair<std::uint64_t, Buffer *>> cache;
+  for (const auto &entry : cache)
+    if (entry.first == id_)
+      return *entry.second;
+
+  std::unique_ptr<Buffer> spbuffer(new Buffer());
+  spbuffer->events.reset(new Event[capacity_]);
+  std::lock_guard<std::mutex> lock(mutex_);
+  spbuffer->tid = buffers_.size();
+  spbuffer->name = "thread " + std::to_string(spbuffer->tid);
+  buffers_.push_back(std::move(spbuffer));
+  cache.emplace_back(id_, buffers_.back().get());
+  return *buffers_.back();
+}
+
+//! Record an event of the calling thread that ends now
+//!
+//! \param name Name of the event, must outlive the recorder
+//! \param category Category of the event, must outlive the recorder
+//! \param start_ns Start of the event, from now_ns()
+//! \param step Time step of the event
+//! \param tile Tile of the event, negative for none
+void TraceRecorder::record(const char *name, const char *category,
+                           const std::uint64_t start_ns, const unsigned step,
+                           const int tile) {
+  const std::uint64_t end_ns = now_ns();
+  Buffer &buffer = buffer_();
+  const std::size_t n = buffer.size.load(std::memory_order_relaxed);
+  if (n == capacity_) {
+    buffer.dropped.store(buffer.dropped.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+    return;
+  }
+  buffer.events[n] = {name, category, start_ns, end_ns - start_ns, step, tile};
+  // publishes the event to write_json()
+  buffer.size.store(n + 1, std::memory_order_release);
+}
+
+//! Name the calling thread in the timeline
+//!
+//! \param name Name of the thread
+void TraceRecorder::set_thread_name(const std::string &name) {
+  Buffer &buffer = buffer_();
+  std::lock_guard<std::mutex> lock(mutex_);
+  buffer.name = name;
+}
+
+//! Number of recorded events
+//!
+//! \return Events of every thread
+std::size_t TraceRecorder::size() const {
+  std::size_t n = 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &spbuffer : buffers_)
+    n += spbuffer->size.load(std::memory_order_acquire);
+  return n;
+}
+
+//! Number of events dropped because a buffer was full
+//!
+//! \return Dropped events of every thread
+std::size_t TraceRecorder::dropped() const {
+  std::size_t n = 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &spbuffer : buffers_)
+    n += spbuffer->dropped.load(std::memory_order_relaxed);
+  return n;
+}
+
+//! Discard every event, while no thread records
+void TraceRecorder::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &spbuffer : buffers_) {
+    spbuffer->size.store(0, std::memory_order_relaxed);
+    spbuffer->dropped.store(0, std::memory_order_relaxed);
+  }
+}
+
+//! Write the events as Chrome trace-event JSON
+//!
+//! Events recorded while writing may or may not be included.
+//!
+//! \param os Output stream
+void TraceRecorder::write_json(std::ostream &os) const {
+#ifdef __unix__
+  const long pid = getpid();
+#else
+  const long pid = 1;
+#endif
+  const auto flags = os.flags();
+  const auto precision = os.precision();
+  os << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+  bool first = true;
+  std::size_t dropped = 0;
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto &spbuffer : buffers_) {
+    os << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\","
+       << "\"pid\":" << pid << ",\"tid\":" << spbuffer->tid
+       << ",\"args\":{\"name\":";
+    write_json_string(os, spbuffer->name);
+    os << "}}";
+    first = false;
+    dropped += spbuffer->dropped.load(std::memory_order_relaxed);
+
+    const std::size_t n = spbuffer->size.load(std::memory_order_acquire);
+    for (std::size_t e = 0; e < n; ++e) {
+      const Event &event = spbuffer->events[e];
+      os << ",\n{\"name\":\"" << event.name << "\",\"cat\":\""
+         << event.category << "\",\"ph\":\"X\",\"ts\":"
+         << 1e-3 * event.start_ns << ",\"dur\":" << 1e-3 * event.dur_ns
+         << ",\"pid\":" << pid << ",\"tid\":" << spbuffer->tid
+         << ",\"args\":{\"step\":" << event.step;
+      if (event.tile >= 0)
+        os << ",\"tile\":" << event.tile;
+      os << "}}";
+    }
+  }
+  os << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":"
+     << dropped << "}}\n";
+  os.flags(flags);
+  os.precision(precision);
+}
+
+//! Write the events as Chrome trace-event JSON to a file
+//!
+//! \param path Path of the file
+//! \throw runtime_error
+void TraceRecorder::write_json(const std::string &path) const {
+  std::ofstream ofs(path);
+  if (!ofs) {
+    std::ostringstream oss;
+    oss << "Unable to open " << path << " to write a trace.";
+    throw std::runtime_error(oss.str());
+  }
+  write_json(ofs);
+  if (!ofs) {
+    std::ostringstream oss;
+    oss << "Unable to write a trace to " << path << '.';
+    throw std::runtime_error(oss.str());
+  }
+}
+
+} // namespace d2q9
+
+} // namespace balbm
@@ -0,0 +1,38 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "velocity_set.hh"
+
+namespace balbm {
+
+// Out-of-class definitions of static constexpr members, required when the
+// tables are indexed with a runtime direction
+
+constexpr unsigned D2Q9::nd;
+constexpr unsigned D2Q9::nk;
+constexpr int D2Q9::c[D2Q9::nk][D2Q9::nd];
+constexpr double D2Q9::w[D2Q9::nk];
+constexpr unsigned D2Q9::opp[D2Q9::nk];
+constexpr double D2Q9::cssq;
+
+constexpr unsigned D3Q19::nd;
+constexpr unsigned D3Q19::nk;
+constexpr int D3Q19::c[D3Q19::nk][D3Q19::nd];
+constexpr double D3Q19::w[D3Q19::nk];
+constexpr unsigned D3Q19::opp[D3Q19::nk];
+constexpr double D3Q19::cssq;
+
+} // namespace balbm
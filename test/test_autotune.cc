@@ -0,0 +1,253 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm.hh"
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 48;
+const static unsigned nj = 20;
+const static double rho = 1.0;
+const static double mu = 0.1;
+static double F[] = {1e-5, 0.0};
+const static unsigned nsteps = 20;
+const static string cache_path =
+    "test_autotune." + to_string(getpid()) + ".cache";
+
+//! Channel with a square obstacle
+IncompFlowSimulation *channel(const unsigned ni, const unsigned nj) {
+  auto psim =
+      new IncompFlowSimulation(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                               new NewtonianConstitutiveEq(mu),
+                               new GuoForce(F));
+  for (unsigned i = 0; i < ni; ++i)
+    for (unsigned j = 1; j < nj - 1; ++j)
+      psim->set_node_desc<NodePeriodic>(i, j);
+  for (unsigned i = 0; i < ni; ++i) {
+    psim->set_node_desc<NodeNorthFacingWall>(i, 0);
+    psim->set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+  }
+  for (unsigned i = ni / 4; i < ni / 4 + 4; ++i)
+    for (unsigned j = nj / 2 - 2; j < nj / 2 + 2; ++j)
+      psim->set_node_desc<NodeInactive>(i, j);
+  return psim;
+}
+
+//! Whether two simulations have the same populations and velocities
+bool identical(const IncompFlowSimulation &a, const IncompFlowSimulation &b) {
+  const size_t nn = size_t(a.lattice().num_i()) * a.lattice().num_j();
+  for (size_t idx = 0; idx < nn * Lattice::num_k(); ++idx)
+    if (a.lattice().pf()[idx] != b.lattice().pf()[idx])
+      return false;
+  for (size_t idx = 0; idx < 2 * nn; ++idx)
+    if (a.multiscale_map().pu()[idx] != b.multiscale_map().pu()[idx])
+      return false;
+  return true;
+}
+
+//! Number of occurrences of a pattern
+size_t count(const string &s, const string &pattern) {
+  size_t n = 0;
+  for (size_t pos = s.find(pattern); pos != string::npos;
+       pos = s.find(pattern, pos + 1))
+    ++n;
+  return n;
+}
+
+//! Callback that records the steps it sees
+class StepLog : public AbstractSimCallback {
+public:
+  StepLog(vector<unsigned> &steps) : steps_(steps) {}
+
+private:
+  vector<unsigned> &steps_;
+  void f_(AbstractSimulation &sim) const { steps_.push_back(sim.step()); }
+};
+
+int main() {
+  // tiles cover the lattice once
+  {
+    for (const auto &c : {SweepConfig(), SweepConfig(0, 0, 3),
+                          SweepConfig(7, 0, 1), SweepConfig(5, 6, 4),
+                          SweepConfig(100, 100, 2)}) {
+      vector<unsigned> covered(ni * nj, 0);
+      for (const auto &t : sweep_tiles(ni, nj, c))
+        for (unsigned i = t[0]; i <= t[1]; ++i)
+          for (unsigned j = t[2]; j <= t[3]; ++j)
+            ++covered[i * nj + j];
+      for (const unsigned n : covered)
+        assert(n == 1);
+    }
+    assert(sweep_tiles(ni, nj, SweepConfig(0, 0, 3)).size() == 3);
+    bool threw = false;
+    try {
+      sweep_tiles(ni, nj, SweepConfig(0, 0, 0));
+    } catch (invalid_argument &e) {
+      threw = true;
+    }
+    assert(threw);
+  }
+  cout << "sweep tiles ... ok\n";
+
+  // every candidate reproduces the whole-lattice sweep bit for bit
+  {
+    unique_ptr<IncompFlowSimulation> spref(channel(ni, nj));
+    spref->simulate(nsteps);
+    const auto candidates = sweep_candidates(ni, nj, 4);
+    assert(candidates.front() == SweepConfig());
+    for (const auto &c : candidates) {
+      unique_ptr<IncompFlowSimulation> spsim(channel(ni, nj));
+      spsim->set_sweep_config(c);
+      spsim->simulate(nsteps);
+      if (!identical(*spref, *spsim))
+        cout << "differs: tiles " << c.tile_i << " x " << c.tile_j << " on "
+             << c.nthreads << " threads\n";
+      assert(identical(*spref, *spsim));
+    }
+    cout << candidates.size() << " candidates ";
+  }
+  cout << "match the whole-lattice sweep ... ok\n";
+
+  // the workers of a pool persist between runs and share their failures
+  {
+    SweepPool pool(4);
+    atomic<unsigned> ran(0);
+    for (unsigned run = 0; run < 3; ++run)
+      pool.run([&](const unsigned t) {
+        ran += t + 1;
+        assert(pool.barrier());
+        assert(pool.running() || t != 0);
+      });
+    assert(ran == 30 && !pool.running());
+    bool threw = false;
+    try {
+      pool.run([&](const unsigned t) {
+        if (t == 2)
+          throw runtime_error("worker failed");
+        while (pool.barrier())
+          ;
+      });
+    } catch (runtime_error &e) {
+      threw = true;
+    }
+    assert(threw);
+    ran = 0;
+    pool.run([&](const unsigned t) { ran += pool.barrier() ? t : 0; });
+    assert(ran == 6);
+  }
+  cout << "sweep pool ... ok\n";
+
+  // threaded sweeps trace every chunk and barrier, four per step with a
+  // callback, and callbacks see every step in order
+  {
+    vector<unsigned> steps;
+    vector<AbstractSimCallback *> *pcbs = new vector<AbstractSimCallback *>();
+    pcbs->push_back(new StepLog(steps));
+    IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                             new NewtonianConstitutiveEq(mu),
+                             new GuoForce(F), pcbs);
+    for (unsigned i = 0; i < ni; ++i)
+      for (unsigned j = 0; j < nj; ++j)
+        sim.set_node_desc<NodePeriodic>(i, j);
+    TraceRecorder trace;
+    sim.set_sweep_config(SweepConfig(0, 0, 3));
+    sim.attach_trace(&trace);
+    sim.simulate(nsteps);
+    assert(steps.size() == nsteps && steps.front() == 0 &&
+           steps.back() == nsteps - 1 && sim.step() == nsteps);
+
+    ostringstream oss;
+    trace.write_json(oss);
+    const string json = oss.str();
+    for (const char *phase : {"step", "swap", "callbacks"})
+      assert(count(json, string("\"name\":\"") + phase + '"') == nsteps);
+    for (const char *phase : {"stream", "collide"})
+      assert(count(json, string("\"name\":\"") + phase + '"') ==
+             3 * nsteps);
+    assert(count(json, "\"name\":\"barrier\"") == 3 * 4 * nsteps);
+    assert(json.find("\"name\":\"sweep 2\"") != string::npos);
+    assert(json.find("\"tile\":2}") != string::npos);
+  }
+  cout << "threaded trace and callbacks ... ok\n";
+
+  // autotuning leaves the state alone, then caches its choice
+  remove(cache_path.c_str());
+  {
+    AutotuneOptions opts;
+    opts.cache_path = cache_path;
+    opts.nsteps = 2;
+    opts.max_threads = 4;
+
+    unique_ptr<IncompFlowSimulation> spref(channel(ni, nj));
+    unique_ptr<IncompFlowSimulation> sptuned(channel(ni, nj));
+    spref->simulate(5);
+    sptuned->simulate(5);
+    const AutotuneResult tuned = sptuned->autotune(opts);
+    assert(!tuned.cached && tuned.stored && tuned.seconds > 0.0);
+    assert(tuned.ntried == sweep_candidates(ni, nj, 4).size());
+    assert(sptuned->sweep_config() == tuned.config);
+    assert(sptuned->step() == 5 && identical(*spref, *sptuned));
+    spref->simulate(nsteps);
+    sptuned->simulate(nsteps);
+    assert(identical(*spref, *sptuned));
+    cout << "chose tiles " << tuned.config.tile_i << " x "
+         << tuned.config.tile_j << " on " << tuned.config.nthreads
+         << " threads, " << tuned.seconds << " s per step\n";
+
+    // a later run of the same domain starts tuned, another domain does not
+    unique_ptr<IncompFlowSimulation> spagain(channel(ni, nj));
+    const AutotuneResult again = spagain->autotune(opts);
+    assert(again.cached && again.ntried == 0 && again.config == tuned.config);
+    assert(spagain->sweep_config() == tuned.config);
+
+    unique_ptr<IncompFlowSimulation> spother(channel(ni / 2, nj));
+    const AutotuneResult other = spother->autotune(opts);
+    assert(!other.cached && other.stored);
+
+    // entries are replaced, not duplicated, and junk lines survive
+    { ofstream(cache_path, ios::app) << "not an entry\n"; }
+    opts.retune = true;
+    const AutotuneResult retuned = spagain->autotune(opts);
+    assert(!retuned.cached && retuned.stored);
+    ifstream ifs(cache_path);
+    unsigned nlines = 0, njunk = 0;
+    for (string line; getline(ifs, line); ++nlines) {
+      const bool junk = (line == "not an entry");
+      njunk += junk;
+      assert(junk || line.find(cpu_model()) != string::npos);
+    }
+    assert(nlines == 3 && njunk == 1);
+  }
+  remove(cache_path.c_str());
+  cout << "autotune and cache ... ok\n";
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
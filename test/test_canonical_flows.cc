@@ -0,0 +1,435 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Accuracy and performance regression suite of canonical flows.
+//
+// Every flow is compared with its analytic solution, or with the benchmark
+// data of Ghia, Ghia and Shin (1982) for the lid-driven cavity, and fails if
+// its error norm exceeds a fixed threshold. Given a directory of baselines,
+// its throughput is also compared with the baseline of the flow, and fails
+// if it is slower by more than the allowed slowdown; flows without a
+// baseline are not timed against anything. Baselines are recorded into the
+// directory with --record, on the machine and build they are meant for.
+//
+// usage: test_canonical_flows [FLOW ...] [--baselines DIR [--record]]
+//                             [--slowdown X]
+//
+// FLOW is poiseuille_force, poiseuille_pressure, poiseuille_velocity,
+// couette, cavity, taylor_green or gray_medium, all of them by default.
+
+#include "balbm.hh"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! \struct Outcome
+//!
+//! \brief Error norm and cost of a flow
+struct Outcome {
+  double error;     //!< error norm
+  double threshold; //!< largest acceptable error norm
+  double updates;   //!< lattice node updates
+  double seconds;   //!< wall time of the updates
+};
+
+//! Time steps of a simulation
+template <typename F> double timed(F &&f) {
+  const auto start = chrono::steady_clock::now();
+  f();
+  return chrono::duration<double>(chrono::steady_clock::now() - start)
+      .count();
+}
+
+//! Channel between walls at j = -1/2 and j = nj - 1/2
+template <typename Inlet, typename Outlet, typename... Args>
+void set_channel(IncompFlowSimulation &sim, const unsigned ni,
+                 const unsigned nj, Args... args) {
+  for (unsigned i = 1; i < ni - 1; ++i)
+    for (unsigned j = 1; j < nj - 1; ++j)
+      sim.set_node_desc<NodeActive>(i, j);
+  for (unsigned i = 0; i < ni; ++i) {
+    sim.set_node_desc<NodeNorthFacingWall>(i, 0);
+    sim.set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+  }
+  for (unsigned j = 1; j < nj - 1; ++j) {
+    sim.set_node_desc<Inlet>(0, j, args...);
+    sim.set_node_desc<Outlet>(ni - 1, j, args...);
+  }
+}
+
+//! Steady plane Poiseuille flow driven by a body force
+Outcome poiseuille_force() {
+  const unsigned ni = 8, nj = 16, nsteps = 6000;
+  const double rho = 1.0, mu = 0.1;
+  static double F[] = {2e-6, 0.0};
+  IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                           new NewtonianConstitutiveEq(mu), new GuoForce(F));
+  set_channel<NodePeriodic, NodePeriodic>(sim, ni, nj);
+  const double seconds = timed([&] { sim.simulate(nsteps); });
+
+  // a probe samples the velocity with the half-force shift of the force
+  const string prefix = "test_canonical_flows." + to_string(getpid());
+  ProbeRecorder probes(prefix, 1, 1);
+  probes.add(new LineProbe("u", ni / 2, 0, ni / 2, nj - 1));
+  sim.attach_probes(&probes);
+  sim.simulate(1);
+  const double *psample = probes.sample(0, 0);
+  remove((prefix + "_u.dat").c_str());
+
+  const double h = nj / 2.0, umax = F[0] * h * h / (2.0 * mu * rho);
+  double error = 0.0;
+  for (unsigned j = 0; j < nj; ++j) {
+    const double y = j + 0.5 - h;
+    const double ua = umax * (1.0 - y * y / (h * h));
+    error = max(error, abs(psample[1 + 3 * j + 1] - ua) / umax);
+  }
+  return {error, 4e-3, double(ni) * nj * nsteps, seconds};
+}
+
+//! Steady plane Poiseuille flow driven by a pressure drop between Zou and He
+//! pressure boundaries
+Outcome poiseuille_pressure() {
+  const unsigned ni = 32, nj = 12, nsteps = 8000;
+  const double rho = 1.0, mu = 0.1, drho = 2e-3;
+  IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowHLEqFunct(rho),
+                           new NewtonianConstitutiveEq(mu), nullptr);
+  set_channel<NodeActive, NodeActive>(sim, ni, nj);
+  for (unsigned j = 1; j < nj - 1; ++j) {
+    sim.set_node_desc<NodeZouHePressure<EastFacing>>(0, j, rho + drho / 2);
+    sim.set_node_desc<NodeZouHePressure<WestFacing>>(ni - 1, j,
+                                                     rho - drho / 2);
+  }
+  const double seconds = timed([&] { sim.simulate(nsteps); });
+
+  // away from the corners of the pressure boundaries
+  const double h = nj / 2.0;
+  const double G = Lattice::cssq() * drho / (ni - 1);
+  const double umax = G * h * h / (2.0 * mu * rho);
+  double error = 0.0;
+  for (unsigned i = ni / 4; i < 3 * ni / 4; ++i)
+    for (unsigned j = 0; j < nj; ++j) {
+      const double y = j + 0.5 - h;
+      const double ua = umax * (1.0 - y * y / (h * h));
+      error = max(error, abs(sim.multiscale_map().u(i, j, 0) - ua) / umax);
+    }
+  return {error, 7e-2, double(ni) * nj * nsteps, seconds};
+}
+
+//! Steady plane Poiseuille flow from a Zou and He velocity inlet with the
+//! parabolic profile to a Zou and He pressure outlet
+Outcome poiseuille_velocity() {
+  const unsigned ni = 32, nj = 12, nsteps = 6000;
+  const double rho = 1.0, mu = 0.1, umax = 0.01;
+  const double h = nj / 2.0;
+  const auto parabola = [&](const unsigned j) {
+    const double y = j + 0.5 - h;
+    return 1.0 - y * y / (h * h);
+  };
+  IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                           new NewtonianConstitutiveEq(mu), nullptr);
+  set_channel<NodeActive, NodeActive>(sim, ni, nj);
+  for (unsigned j = 1; j < nj - 1; ++j) {
+    sim.set_node_desc<NodeZouHeVelocity<EastFacing>>(0, j, umax * parabola(j),
+                                                     0.0);
+    sim.set_node_desc<NodeZouHePressure<WestFacing>>(ni - 1, j, rho);
+  }
+  // closed corners, so that no mass wraps around between inlet and outlet
+  sim.set_node_desc<NodeCornerWall<EastFacing, NorthFacing>>(0, 0);
+  sim.set_node_desc<NodeCornerWall<EastFacing, SouthFacing>>(0, nj - 1);
+  sim.set_node_desc<NodeCornerWall<WestFacing, NorthFacing>>(ni - 1, 0);
+  sim.set_node_desc<NodeCornerWall<WestFacing, SouthFacing>>(ni - 1, nj - 1);
+  const double seconds = timed([&] { sim.simulate(nsteps); });
+
+  // the wall nodes of the inlet inject nothing, so the developed profile is
+  // the parabola carrying the flux of the other inlet nodes
+  double inflow = 0.0, total = 0.0;
+  for (unsigned j = 0; j < nj; ++j) {
+    total += parabola(j);
+    if (j > 0 && j < nj - 1)
+      inflow += parabola(j);
+  }
+  const double uc = umax * inflow / total;
+  double error = 0.0;
+  for (unsigned i = ni / 4; i < 3 * ni / 4; ++i)
+    for (unsigned j = 0; j < nj; ++j) {
+      const auto &mmap = sim.multiscale_map();
+      error = max(error, abs(mmap.u(i, j, 0) - uc * parabola(j)) / uc);
+      error = max(error, abs(mmap.u(i, j, 1)) / uc);
+    }
+  return {error, 2e-2, double(ni) * nj * nsteps, seconds};
+}
+
+//! Steady plane Couette flow under a moving wall
+Outcome couette() {
+  const unsigned ni = 8, nj = 16, nsteps = 6000;
+  const double rho = 1.0, mu = 0.1, U = 0.05;
+  IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                           new NewtonianConstitutiveEq(mu), nullptr);
+  set_channel<NodePeriodic, NodePeriodic>(sim, ni, nj);
+  for (unsigned i = 0; i < ni; ++i)
+    sim.set_node_desc<NodeMovingWall<SouthFacing>>(i, nj - 1, U, 0.0);
+  const double seconds = timed([&] { sim.simulate(nsteps); });
+
+  double error = 0.0;
+  for (unsigned i = 0; i < ni; ++i)
+    for (unsigned j = 0; j < nj; ++j) {
+      const double ua = U * (j + 0.5) / nj;
+      error = max(error, abs(sim.multiscale_map().u(i, j, 0) - ua) / U);
+    }
+  return {error, 1e-8, double(ni) * nj * nsteps, seconds};
+}
+
+//! Lid-driven cavity at a Reynolds number of 100
+Outcome cavity() {
+  // centerline velocities of Ghia, Ghia and Shin (1982), Re = 100
+  static const double ghia_y[] = {0.9766, 0.9688, 0.9609, 0.9531, 0.8516,
+                                  0.7344, 0.6172, 0.5000, 0.4531, 0.2813,
+                                  0.1719, 0.1016, 0.0703, 0.0625, 0.0547};
+  static const double ghia_u[] = {0.84123,  0.78871,  0.73722,  0.68717,
+                                  0.23151,  0.00332,  -0.13641, -0.20581,
+                                  -0.21090, -0.15662, -0.10150, -0.06434,
+                                  -0.04775, -0.04192, -0.03717};
+  static const double ghia_x[] = {0.9688, 0.9609, 0.9531, 0.9453, 0.9063,
+                                  0.8594, 0.8047, 0.5000, 0.2344, 0.2266,
+                                  0.1563, 0.0938, 0.0781, 0.0703, 0.0625};
+  static const double ghia_v[] = {-0.05906, -0.07391, -0.08864, -0.10313,
+                                  -0.16914, -0.22445, -0.24533, 0.05454,
+                                  0.17527,  0.17507,  0.16077,  0.12317,
+                                  0.10890,  0.10091,  0.09233};
+  const unsigned n = 40, stride = 500, max_steps = 40000;
+  const double rho = 1.0, U = 0.1, mu = U * n / 100.0;
+  IncompFlowSimulation sim(n, n, rho, mu, new IncompFlowEqFunct(),
+                           new NewtonianConstitutiveEq(mu), nullptr);
+  for (unsigned i = 1; i < n - 1; ++i) {
+    for (unsigned j = 1; j < n - 1; ++j)
+      sim.set_node_desc<NodeActive>(i, j);
+    sim.set_node_desc<NodeNorthFacingWall>(i, 0);
+    sim.set_node_desc<NodeMovingWall<SouthFacing>>(i, n - 1, U, 0.0);
+    sim.set_node_desc<NodeEastFacingWall>(0, i);
+    sim.set_node_desc<NodeWestFacingWall>(n - 1, i);
+  }
+  sim.set_node_desc<NodeCornerWall<EastFacing, NorthFacing>>(0, 0);
+  sim.set_node_desc<NodeCornerWall<WestFacing, NorthFacing>>(n - 1, 0);
+  sim.set_node_desc<NodeCornerWall<EastFacing, SouthFacing>>(0, n - 1);
+  sim.set_node_desc<NodeCornerWall<WestFacing, SouthFacing>>(n - 1, n - 1);
+
+  // until the velocity settles
+  const auto &mmap = sim.multiscale_map();
+  vector<double> last(mmap.pu(), mmap.pu() + 2 * n * n);
+  double seconds = 0.0;
+  unsigned steps = 0;
+  for (double change = 1.0; change > 1e-6 && steps < max_steps;
+       steps += stride) {
+    seconds += timed([&] { sim.simulate(stride); });
+    change = 0.0;
+    for (unsigned idx = 0; idx < 2 * n * n; ++idx) {
+      change = max(change, abs(mmap.pu()[idx] - last[idx]) / U);
+      last[idx] = mmap.pu()[idx];
+    }
+  }
+
+  // bilinear interpolation between node centers at ((i + 1/2) / n, ...)
+  const auto u_at = [&](const double x, const double y, const unsigned c) {
+    const double s = x * n - 0.5, t = y * n - 0.5;
+    const unsigned i = min(unsigned(s), n - 2), j = min(unsigned(t), n - 2);
+    const double a = s - i, b = t - j;
+    return (1 - a) * (1 - b) * mmap.u(i, j, c) + a * (1 - b) *
+           mmap.u(i + 1, j, c) + (1 - a) * b * mmap.u(i, j + 1, c) +
+           a * b * mmap.u(i + 1, j + 1, c);
+  };
+  double error = 0.0;
+  for (unsigned p = 0; p < sizeof(ghia_y) / sizeof(ghia_y[0]); ++p) {
+    error = max(error, abs(u_at(0.5, ghia_y[p], 0) / U - ghia_u[p]));
+    error = max(error, abs(u_at(ghia_x[p], 0.5, 1) / U - ghia_v[p]));
+  }
+  return {error, 1.5e-2, double(n) * n * steps, seconds};
+}
+
+//! Decaying Taylor-Green vortex on a periodic square
+Outcome taylor_green() {
+  const unsigned n = 32, nsteps = 400;
+  const double rho0 = 1.0, mu = 0.05, U = 0.02;
+  const double k = 2.0 * M_PI / n;
+  const auto field = [&](const unsigned i, const unsigned j, const double t,
+                         double *u) {
+    const double decay = exp(-2.0 * mu * k * k * t);
+    u[0] = -U * decay * cos(k * i) * sin(k * j);
+    u[1] = U * decay * sin(k * i) * cos(k * j);
+    // pressure of the vortex as a density deviation
+    return rho0 - rho0 * U * U * decay * decay / (4.0 * Lattice::cssq()) *
+                      (cos(2.0 * k * i) + cos(2.0 * k * j));
+  };
+
+  Lattice lat(n, n, rho0);
+  IncompFlowMultiscaleMap mmap(n, n, mu_to_omega(mu, lat.cssq(), lat.dt()));
+  IncompFlowCollisionManager cman(new IncompFlowEqFunct(),
+                                  new NewtonianConstitutiveEq(mu));
+  for (unsigned i = 0; i < n; ++i)
+    for (unsigned j = 0; j < n; ++j) {
+      lat.set_node_desc<NodePeriodic>(i, j);
+      double u[2];
+      const double rho = field(i, j, 0.0, u);
+      for (unsigned kk = 0; kk < lat.num_k(); ++kk)
+        lat.f(i, j, kk) = balbm::incomp_feq<Lattice::velocity_set>(rho, u, kk);
+    }
+  const double seconds = timed([&] {
+    for (unsigned step = 0; step < nsteps; ++step)
+      sweep_step(lat, mmap, cman);
+  });
+
+  double dusq = 0.0, usq = 0.0;
+  for (unsigned i = 0; i < n; ++i)
+    for (unsigned j = 0; j < n; ++j) {
+      double u[2];
+      field(i, j, nsteps, u);
+      for (unsigned c = 0; c < 2; ++c) {
+        dusq += pow(mmap.u(i, j, c) - u[c], 2);
+        usq += u[c] * u[c];
+      }
+    }
+  return {sqrt(dusq / usq), 1.2e-2, double(n) * n * nsteps, seconds};
+}
+
+//! Uniform flow through a gray medium of solid fraction ns driven by a body
+//! force, where partial bounce-back balances the force at
+//! u = (1 - ns) F / (2 ns rho); ns is exact in the single precision the
+//! solid fractions are kept in
+Outcome gray_medium() {
+  const unsigned n = 16, nsteps = 400;
+  const double rho = 1.0, mu = 0.1, ns = 0.25;
+  static double F[] = {1e-5, 0.0};
+  IncompFlowSimulation sim(n, n, rho, mu, new IncompFlowEqFunct(),
+                           new NewtonianConstitutiveEq(mu), new GuoForce(F));
+  for (unsigned i = 0; i < n; ++i)
+    for (unsigned j = 0; j < n; ++j) {
+      sim.set_node_desc<NodePeriodic>(i, j);
+      sim.set_solid_fraction(i, j, ns);
+    }
+  const double seconds = timed([&] { sim.simulate(nsteps); });
+
+  const double ua = (1.0 - ns) * F[0] / (2.0 * ns * rho);
+  double error = 0.0;
+  for (unsigned i = 0; i < n; ++i)
+    for (unsigned j = 0; j < n; ++j) {
+      const auto &mmap = sim.multiscale_map();
+      error = max(error, abs(mmap.u(i, j, 0) - ua) / ua);
+      error = max(error, abs(mmap.u(i, j, 1)) / ua);
+    }
+  return {error, 1e-8, double(n) * n * nsteps, seconds};
+}
+
+//! Read a recorded baseline, 0 if there is none
+double read_baseline(const string &path) {
+  ifstream ifs(path);
+  string key;
+  double mlups = 0.0;
+  while (ifs >> key)
+    if (key == "mlups")
+      ifs >> mlups;
+  return mlups;
+}
+
+int main(int argc, char **argv) {
+  const map<string, function<Outcome()>> flows = {
+      {"poiseuille_force", poiseuille_force},
+      {"poiseuille_pressure", poiseuille_pressure},
+      {"poiseuille_velocity", poiseuille_velocity},
+      {"couette", couette},
+      {"cavity", cavity},
+      {"taylor_green", taylor_green},
+      {"gray_medium", gray_medium}};
+  vector<string> names;
+  string baselines;
+  bool record = false;
+  double slowdown = 1.5;
+  try {
+    for (int a = 1; a < argc; ++a) {
+      const string arg = argv[a];
+      if ((arg == "--baselines" || arg == "--slowdown") && a + 1 >= argc)
+        throw invalid_argument(arg + " requires a value.");
+      if (arg == "--baselines")
+        baselines = argv[++a];
+      else if (arg == "--slowdown")
+        slowdown = stod(argv[++a]);
+      else if (arg == "--record")
+        record = true;
+      else if (flows.count(arg))
+        names.push_back(arg);
+      else
+        throw invalid_argument("Unknown flow or option " + arg + '.');
+    }
+    if (record && baselines.empty())
+      throw invalid_argument("--record requires --baselines.");
+  } catch (exception &e) {
+    cerr << e.what() << "\nusage: " << argv[0]
+         << " [FLOW ...] [--baselines DIR [--record]] [--slowdown X]\n";
+    return 1;
+  }
+  if (names.empty())
+    for (const auto &flow : flows)
+      names.push_back(flow.first);
+
+  bool passed = true;
+  for (const auto &name : names) {
+    const Outcome outcome = flows.at(name)();
+    const double mlups = outcome.updates / outcome.seconds / 1e6;
+    const bool accurate = outcome.error <= outcome.threshold;
+    cout << name << ": error " << outcome.error << " (threshold "
+         << outcome.threshold << ") ... " << (accurate ? "ok" : "REGRESSED")
+         << '\n';
+
+    bool fast = true;
+    if (baselines.empty()) {
+      cout << name << ": " << mlups << " MLUPS\n";
+    } else if (record) {
+      const string path = baselines + '/' + name + ".baseline";
+      ofstream ofs(path);
+      ofs << "mlups " << mlups << "\nerror " << outcome.error << '\n';
+      cout << name << ": " << mlups << " MLUPS, recorded as the baseline in "
+           << path << (ofs ? "\n" : " FAILED\n");
+      fast = bool(ofs);
+    } else {
+      const double baseline =
+          read_baseline(baselines + '/' + name + ".baseline");
+      if (baseline > 0.0) {
+        fast = mlups * slowdown >= baseline;
+        cout << name << ": " << mlups << " MLUPS (baseline " << baseline
+             << ") ... " << (fast ? "ok" : "SLOWER") << '\n';
+      } else {
+        cout << name << ": " << mlups << " MLUPS, no baseline\n";
+      }
+    }
+    passed = passed && accurate && fast;
+  }
+
+  if (!passed)
+    return 1;
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
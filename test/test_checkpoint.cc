@@ -0,0 +1,169 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm.hh"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 30;
+const static unsigned nj = 12;
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+static double F[] = {1e-5, 0.0};
+const static unsigned nsteps_before = 200;
+const static unsigned nsteps_after = 300;
+
+//! Channel flow partially obstructed by a porous block
+unique_ptr<IncompFlowSimulation> make_sim(const bool obstructed = true) {
+  unique_ptr<IncompFlowSimulation> psim(new IncompFlowSimulation(
+      ni, nj, rho, mu, new IncompFlowEqFunct(), new NewtonianConstitutiveEq(mu),
+      new GuoForce(F)));
+
+  for (unsigned i = 0; i < ni; ++i) {
+    for (unsigned j = 1; j < nj - 1; ++j)
+      psim->set_node_desc<NodePeriodic>(i, j);
+    psim->set_node_desc<NodeNorthFacingWall>(i, 0);
+    psim->set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+  }
+  if (obstructed)
+    for (unsigned i = 10; i < 15; ++i)
+      for (unsigned j = 3; j < 7; ++j)
+        psim->set_solid_fraction(i, j, 0.25);
+
+  return psim;
+}
+
+//! Restart from a checkpoint and check that the continued run is bitwise
+//! identical to an uninterrupted one
+void check_restart(const IncompFlowSimulation &reference,
+                   const string &path) {
+  auto psim = make_sim();
+  psim->restart(path);
+  assert(psim->step() == nsteps_before);
+  psim->simulate(nsteps_after);
+  assert(psim->step() == reference.step());
+
+  const auto &mmap = psim->multiscale_map();
+  const auto &ref_mmap = reference.multiscale_map();
+  for (unsigned i = 0; i < ni; ++i)
+    for (unsigned j = 0; j < nj; ++j) {
+      assert(mmap.rho(i, j) == ref_mmap.rho(i, j));
+      assert(mmap.u(i, j, 0) == ref_mmap.u(i, j, 0));
+      assert(mmap.u(i, j, 1) == ref_mmap.u(i, j, 1));
+      assert(mmap.solid_fraction(i, j) == ref_mmap.solid_fraction(i, j));
+    }
+}
+
+int main() {
+  // one path names its directory, the other does not
+  const string path = "./test_checkpoint.bin";
+  const string zpath = "test_checkpoint.bin.z";
+
+  auto psim = make_sim();
+  psim->simulate(nsteps_before);
+  psim->checkpoint(path);
+  if (checkpoint_compression_available())
+    psim->checkpoint(zpath, true);
+  psim->simulate(nsteps_after);
+
+  check_restart(*psim, path);
+  cout << "restart from checkpoint ... ok\n";
+  if (checkpoint_compression_available()) {
+    check_restart(*psim, zpath);
+    cout << "restart from compressed checkpoint ... ok\n";
+  }
+
+  // restarting with a different geometry must be refused
+  bool threw = false;
+  IncompFlowSimulation other(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                             new NewtonianConstitutiveEq(mu), new GuoForce(F));
+  for (unsigned i = 0; i < ni; ++i)
+    for (unsigned j = 0; j < nj; ++j)
+      other.set_node_desc<NodePeriodic>(i, j);
+  try {
+    other.restart(path);
+  } catch (runtime_error &e) {
+    cout << "mismatched geometry ... " << e.what() << '\n';
+    threw = true;
+  }
+  assert(threw);
+
+  // a corrupt compressed section must be found before any state changes,
+  // so the simulation carries on as if restart had not been called
+  if (checkpoint_compression_available()) {
+    const string bad_path = "test_checkpoint.bin.bad";
+    ifstream in(zpath, ios::binary);
+    vector<char> bytes((istreambuf_iterator<char>(in)),
+                       istreambuf_iterator<char>());
+    CheckpointHeader header;
+    memcpy(&header, bytes.data(), sizeof(header));
+    for (unsigned s = 0; s < header.nsections; ++s) {
+      const auto &section = header.sections[s];
+      if (section.id == uint32_t(CheckpointSectionId::Omega)) {
+        assert(section.compressed);
+        fill(bytes.begin() + section.offset + section.stored_bytes / 2,
+             bytes.begin() + section.offset + section.stored_bytes, char(0x5a));
+      }
+    }
+    ofstream(bad_path, ios::binary).write(bytes.data(), bytes.size());
+
+    auto pbefore = make_sim();
+    pbefore->simulate(nsteps_before / 2);
+    auto pafter = make_sim();
+    pafter->simulate(nsteps_before / 2);
+    threw = false;
+    try {
+      pafter->restart(bad_path);
+    } catch (runtime_error &e) {
+      cout << "corrupt section ... " << e.what() << '\n';
+      threw = true;
+    }
+    assert(threw);
+    assert(pafter->step() == pbefore->step());
+    const auto &lat = pafter->lattice();
+    const auto &ref_lat = pbefore->lattice();
+    for (unsigned idx = 0; idx < ni * nj * lat.num_k(); ++idx)
+      assert(lat.pf()[idx] == ref_lat.pf()[idx]);
+    const auto &mmap = pafter->multiscale_map();
+    const auto &ref_mmap = pbefore->multiscale_map();
+    for (unsigned i = 0; i < ni; ++i)
+      for (unsigned j = 0; j < nj; ++j) {
+        assert(mmap.rho(i, j) == ref_mmap.rho(i, j));
+        assert(mmap.u(i, j, 0) == ref_mmap.u(i, j, 0));
+        assert(mmap.u(i, j, 1) == ref_mmap.u(i, j, 1));
+      }
+    remove(bad_path.c_str());
+  }
+
+  remove(path.c_str());
+  remove(zpath.c_str());
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
@@ -0,0 +1,140 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm.hh"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 24;
+const static unsigned nj = 16;
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+static double F[] = {1e-5, 0.0};
+const static unsigned nframes = 40;
+const static unsigned stride = 25;
+const static unsigned keyframe_interval = 8;
+const static double tolerance = 1e-9;
+
+int main() {
+  IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                           new NewtonianConstitutiveEq(mu), new GuoForce(F));
+  for (unsigned i = 0; i < ni; ++i) {
+    for (unsigned j = 1; j < nj - 1; ++j)
+      sim.set_node_desc<NodePeriodic>(i, j);
+    sim.set_node_desc<NodeNorthFacingWall>(i, 0);
+    sim.set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+  }
+
+  // a channel flow developing towards steady state
+  const unsigned fields = OUTPUT_RHO | OUTPUT_U | OUTPUT_F;
+  vector<FieldFrame> frames(nframes);
+  {
+    DeltaSeriesWriter lossless("test_delta_series.lossless", 0.0,
+                               keyframe_interval);
+    DeltaSeriesWriter lossy("test_delta_series.lossy", tolerance,
+                            keyframe_interval);
+    for (auto &frame : frames) {
+      sim.simulate(stride);
+      frame.stage(sim.lattice(), sim.multiscale_map(), sim.step(), fields);
+      lossless.write(frame);
+      lossy.write(frame);
+    }
+    assert(lossless.num_frames() == nframes);
+    cout << "lossless: " << lossless.raw_bytes() << " -> "
+         << lossless.stored_bytes() << " bytes\n";
+    cout << "lossy: " << lossy.raw_bytes() << " -> " << lossy.stored_bytes()
+         << " bytes\n";
+    assert(lossless.stored_bytes() < lossless.raw_bytes());
+    assert(lossy.stored_bytes() * 4 < lossy.raw_bytes());
+
+    // frames of a different shape do not fit in the series
+    FieldFrame other;
+    other.stage(sim.lattice(), sim.multiscale_map(), sim.step(), fields,
+                OutputRegion(0, 0, ni / 2));
+    bool threw = false;
+    try {
+      lossless.write(other);
+    } catch (invalid_argument &) {
+      threw = true;
+    }
+    assert(threw);
+  }
+
+  // random access reproduces every frame exactly
+  DeltaSeriesReader reader("test_delta_series.lossless");
+  assert(reader.num_frames() == nframes);
+  FieldFrame frame;
+  const unsigned order[] = {17, 3, 39, 0, 8, 9, 10, 38};
+  for (const unsigned n : order) {
+    reader.read(n, frame);
+    assert(frame.step == frames[n].step && frame.fields == fields);
+    assert(frame.ni == ni && frame.nj == nj && frame.nk == 9);
+    assert(frame.rho == frames[n].rho);
+    assert(frame.u == frames[n].u);
+    assert(frame.f == frames[n].f);
+    assert(frame.omega.empty());
+  }
+  assert(reader.find(frames[21].step) == 21);
+  cout << "lossless random access ... ok\n";
+
+  // lossy frames stay within the tolerance, without drift
+  DeltaSeriesReader lossy_reader("test_delta_series.lossy");
+  assert(lossy_reader.header().tolerance == tolerance);
+  for (unsigned n = 0; n < nframes; ++n) {
+    lossy_reader.read(n, frame);
+    for (unsigned idx = 0; idx < frame.u.size(); ++idx)
+      assert(abs(frame.u[idx] - frames[n].u[idx]) <= tolerance);
+    for (unsigned idx = 0; idx < frame.f.size(); ++idx)
+      assert(abs(frame.f[idx] - frames[n].f[idx]) <= tolerance);
+  }
+  cout << "lossy error bound ... ok\n";
+
+  // a series cut short keeps its complete frames
+  {
+    ifstream ifs("test_delta_series.lossless", ios::binary);
+    vector<char> bytes((istreambuf_iterator<char>(ifs)),
+                       istreambuf_iterator<char>());
+    ofstream ofs("test_delta_series.cut", ios::binary);
+    ofs.write(bytes.data(), bytes.size() - 10);
+  }
+  DeltaSeriesReader cut("test_delta_series.cut");
+  assert(cut.num_frames() == nframes - 1);
+  cut.read(nframes - 2, frame);
+  assert(frame.f == frames[nframes - 2].f);
+  bool threw = false;
+  try {
+    cut.read(nframes - 1, frame);
+  } catch (out_of_range &) {
+    threw = true;
+  }
+  assert(threw);
+  cout << "truncated series ... ok\n";
+
+  remove("test_delta_series.lossless");
+  remove("test_delta_series.lossy");
+  remove("test_delta_series.cut");
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
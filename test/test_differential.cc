@@ -0,0 +1,145 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm.hh"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! test parameters
+const static unsigned ncases = 24;
+const static unsigned nsteps = 8;
+
+//! Random rectangles covering a domain once
+vector<array<unsigned, 4>> random_tiles(const unsigned ni, const unsigned nj,
+                                        mt19937 &gen) {
+  const auto cuts = [&](const unsigned n) {
+    vector<unsigned> ends;
+    for (unsigned e = 0; e < n;)
+      ends.push_back(e = min(n, e + uniform_int_distribution<unsigned>(
+                                        1, n / 2)(gen)));
+    return ends;
+  };
+  vector<array<unsigned, 4>> tiles;
+  unsigned bi = 0;
+  for (const unsigned ei : cuts(ni)) {
+    unsigned bj = 0;
+    for (const unsigned ej : cuts(nj)) {
+      tiles.push_back({{bi, ei - 1, bj, ej - 1}});
+      bj = ej;
+    }
+    bi = ei;
+  }
+  shuffle(tiles.begin(), tiles.end(), gen);
+  return tiles;
+}
+
+//! Sweep mode that changes one population at one step, to the next double
+//! if factor is 0
+ExecutionMode faulty_mode(const unsigned fault_step, const unsigned fi,
+                          const unsigned fj, const unsigned fk,
+                          const double factor, unsigned &step) {
+  return [=, &step](Lattice &lat, IncompFlowMultiscaleMap &mmap,
+                    const IncompFlowCollisionManager &cman) {
+    sweep_step(lat, mmap, cman);
+    if (++step == fault_step)
+      lat.f(fi, fj, fk) = (factor == 0.0)
+                              ? nextafter(lat.f(fi, fj, fk), 1.0)
+                              : lat.f(fi, fj, fk) * factor;
+  };
+}
+
+int main() {
+  {
+    assert(ulp_distance(1.0, nextafter(1.0, 2.0)) == 1);
+    assert(ulp_distance(0.0, -0.0) == 0);
+    const double tiny = numeric_limits<double>::denorm_min();
+    assert(ulp_distance(-tiny, tiny) == 2);
+    assert(ulp_distance(-1.0, 1.0) > ulp_distance(0.0, 1.0));
+    assert(ulp_distance(nan(""), 1.0) == numeric_limits<uint64_t>::max());
+  }
+  cout << "ulp distance ... ok\n";
+
+  // every execution mode reproduces the reference bit for bit
+  const auto start = chrono::steady_clock::now();
+  for (unsigned seed = 1; seed <= ncases; ++seed) {
+    const DifferentialCase c(seed);
+    const DifferentialHarness harness(c);
+    mt19937 gen(seed);
+    const vector<pair<string, ExecutionMode>> modes = {
+        {"sweep", sweep_step},
+        {"bounds", bounds_mode(random_tiles(c.ni, c.nj, gen))},
+        {"slabs", slab_mode(3)}};
+    for (const auto &mode : modes) {
+      const DiffReport report = harness.compare(mode.second, nsteps);
+      if (!report.passed || report.max_ulps != 0) {
+        write_case(cout, c);
+        cout << "\n  " << mode.first << ": ";
+        write_report(cout, report);
+        cout << '\n';
+      }
+      assert(report.passed && report.steps == nsteps);
+      assert(report.max_ulps == 0);
+    }
+  }
+  const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  cout << ncases << " random cases in " << elapsed.count() << " s\n";
+  cout << "execution modes match the reference ... ok\n";
+
+  // differences are located and tolerances honored
+  {
+    const DifferentialCase c(7);
+    const DifferentialHarness harness(c);
+    const unsigned fi = c.ni / 2, fj = c.nj / 2;
+    unsigned step = 0;
+    DiffReport report =
+        harness.compare(faulty_mode(3, fi, fj, 4, 0.0, step), 5);
+    ostringstream oss;
+    write_report(oss, report);
+    cout << oss.str() << '\n';
+    assert(!report.passed && report.steps == 3 && report.step == 3);
+    assert(report.i == fi && report.j == fj && report.k == 4);
+    assert(ulp_distance(report.reference, report.candidate) == 1);
+    assert(oss.str().find("direction 4") != string::npos);
+
+    step = 0;
+    report = harness.compare(faulty_mode(3, fi, fj, 4, 0.0, step), 3,
+                             DiffTolerance(1));
+    assert(report.passed && report.max_ulps == 1);
+
+    step = 0;
+    report = harness.compare(faulty_mode(2, fi, fj, 4, 1.0 + 1e-12, step), 2,
+                             DiffTolerance(0, 1e-11));
+    assert(report.passed && report.max_ulps > 1);
+  }
+  cout << "first difference located ... ok\n";
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
@@ -0,0 +1,149 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm.hh"
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 24;
+const static unsigned nj = 10;
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+static double F[] = {1e-5, 0.0};
+const static unsigned nsteps = 100;
+const static unsigned stride = 50;
+
+//! Count occurences of a string in a file
+unsigned count_in_file(const string &path, const string &what) {
+  ifstream ifs(path);
+  const string contents((istreambuf_iterator<char>(ifs)),
+                        istreambuf_iterator<char>());
+  unsigned count = 0;
+  for (size_t pos = contents.find(what); pos != string::npos;
+       pos = contents.find(what, pos + 1))
+    ++count;
+  return count;
+}
+
+int main() {
+  AsyncOutputPipeline vtk_pipeline(new VtkImageWriter("test_fw"),
+                                   OUTPUT_RHO | OUTPUT_U | OUTPUT_F);
+  OutputCallback vtk_output(vtk_pipeline, stride);
+  vector<AbstractSimCallback *> *pscbs = new vector<AbstractSimCallback *>();
+  pscbs->push_back(&vtk_output);
+#ifdef BALBM_USE_HDF5
+  AsyncOutputPipeline h5_pipeline(new Hdf5FieldWriter("test_fw", 8, 4),
+                                  OUTPUT_RHO | OUTPUT_U | OUTPUT_F);
+  OutputCallback h5_output(h5_pipeline, stride);
+  pscbs->push_back(&h5_output);
+#endif
+
+  IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                           new NewtonianConstitutiveEq(mu), new GuoForce(F),
+                           pscbs);
+  for (unsigned i = 0; i < ni; ++i) {
+    for (unsigned j = 1; j < nj - 1; ++j)
+      sim.set_node_desc<NodePeriodic>(i, j);
+    sim.set_node_desc<NodeNorthFacingWall>(i, 0);
+    sim.set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+  }
+  sim.simulate(nsteps);
+  vtk_pipeline.flush();
+  const auto &mmap = sim.multiscale_map();
+  const auto &lat = sim.lattice();
+
+  // VTK: index lists every frame, appended arrays are x (i) fastest
+  assert(count_in_file("test_fw.pvd", "<DataSet ") == nsteps / stride);
+  {
+    ifstream ifs("test_fw_00000100.vti", ios::binary);
+    const string contents((istreambuf_iterator<char>(ifs)),
+                          istreambuf_iterator<char>());
+    size_t pos = contents.find("encoding=\"raw\">");
+    pos = contents.find('_', pos) + 1;
+    uint64_t bytes;
+    contents.copy(reinterpret_cast<char *>(&bytes), sizeof(bytes), pos);
+    assert(bytes == ni * nj * sizeof(double));
+    vector<double> vtk_rho(ni * nj);
+    contents.copy(reinterpret_cast<char *>(vtk_rho.data()), bytes,
+                  pos + sizeof(bytes));
+    for (unsigned i = 0; i < ni; ++i)
+      for (unsigned j = 0; j < nj; ++j)
+        assert(vtk_rho[j * ni + i] == mmap.rho(i, j));
+
+    pos += sizeof(bytes) + bytes;
+    contents.copy(reinterpret_cast<char *>(&bytes), sizeof(bytes), pos);
+    assert(bytes == 3 * ni * nj * sizeof(double));
+    vector<double> vtk_u(3 * ni * nj);
+    contents.copy(reinterpret_cast<char *>(vtk_u.data()), bytes,
+                  pos + sizeof(bytes));
+    for (unsigned i = 0; i < ni; ++i)
+      for (unsigned j = 0; j < nj; ++j) {
+        assert(vtk_u[3 * (j * ni + i)] == mmap.u(i, j, 0));
+        assert(vtk_u[3 * (j * ni + i) + 1] == mmap.u(i, j, 1));
+        assert(vtk_u[3 * (j * ni + i) + 2] == 0.0);
+      }
+  }
+  cout << "VTK image data ... ok\n";
+
+#ifdef BALBM_USE_HDF5
+  h5_pipeline.flush();
+  assert(count_in_file("test_fw.xmf", "<Time ") == nsteps / stride);
+  assert(count_in_file("test_fw.xmf", " 3\">test_fw.h5:/step_100/u<") == 1);
+  {
+    const hid_t file = H5Fopen("test_fw.h5", H5F_ACC_RDONLY, H5P_DEFAULT);
+    assert(file >= 0);
+    vector<double> h5_u(3 * ni * nj);
+    vector<double> h5_f(ni * nj * lat.num_k());
+    hid_t dset = H5Dopen2(file, "/step_100/u", H5P_DEFAULT);
+    H5Dread(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+            h5_u.data());
+    H5Dclose(dset);
+    dset = H5Dopen2(file, "/step_100/f", H5P_DEFAULT);
+    H5Dread(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+            h5_f.data());
+    H5Dclose(dset);
+    H5Fclose(file);
+    for (unsigned i = 0; i < ni; ++i)
+      for (unsigned j = 0; j < nj; ++j) {
+        assert(h5_u[3 * (i * nj + j)] == mmap.u(i, j, 0));
+        assert(h5_u[3 * (i * nj + j) + 1] == mmap.u(i, j, 1));
+        assert(h5_u[3 * (i * nj + j) + 2] == 0.0);
+        for (unsigned k = 0; k < lat.num_k(); ++k)
+          assert(h5_f[(i * nj + j) * lat.num_k() + k] == lat.f(i, j, k));
+      }
+  }
+  cout << "HDF5/XDMF ... ok\n";
+  remove("test_fw.h5");
+  remove("test_fw.xmf");
+#endif
+
+  remove("test_fw.pvd");
+  remove("test_fw_00000050.vti");
+  remove("test_fw_00000100.vti");
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
@@ -0,0 +1,243 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm.hh"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef BALBM_USE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 48;
+const static unsigned nj = 24;
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+static double F[] = {1e-5, 0.0};
+const static unsigned nsteps = 200;
+
+//! Sum of the particle distributions of every fluid node
+double fluid_mass(const IncompFlowSimulation &sim, const Geometry &geom) {
+  double mass = 0.0;
+  for (unsigned i = 0; i < ni; ++i)
+    for (unsigned j = 0; j < nj; ++j)
+      if (geom.node_class(i, j) != NODE_CLASS_INACTIVE)
+        for (unsigned k = 0; k < 9; ++k)
+          mass += sim.lattice().f(i, j, k);
+  return mass;
+}
+
+#ifdef BALBM_USE_ZLIB
+//! Write a mask as an 8 bit gray PNG, cycling through the scanline filters
+void write_png(const string &path, const GeometryMask &mask) {
+  const unsigned w = mask.num_i(), h = mask.num_j();
+  vector<unsigned char> raw, prev(w, 0), row(w);
+  for (unsigned r = 0; r < h; ++r) {
+    for (unsigned x = 0; x < w; ++x)
+      row[x] = mask.solid(x, h - 1 - r) ? 20 : 235;
+    const unsigned char filter = r % 3;
+    raw.push_back(filter);
+    for (unsigned x = 0; x < w; ++x) {
+      const unsigned char left = (x > 0) ? row[x - 1] : 0;
+      raw.push_back(filter == 0 ? row[x]
+                                : row[x] - (filter == 1 ? left : prev[x]));
+    }
+    prev = row;
+  }
+  uLongf zbytes = compressBound(raw.size());
+  string zdata(zbytes, '\0');
+  compress(reinterpret_cast<Bytef *>(&zdata[0]), &zbytes, raw.data(),
+           raw.size());
+  zdata.resize(zbytes);
+
+  string png("\x89PNG\r\n\x1a\n", 8);
+  const auto be32 = [&](const uint32_t x) {
+    for (int shift = 24; shift >= 0; shift -= 8)
+      png.push_back(static_cast<char>((x >> shift) & 0xff));
+  };
+  const auto chunk = [&](const char *type, const string &data) {
+    be32(data.size());
+    const size_t start = png.size();
+    png.append(type, 4);
+    png.append(data);
+    be32(crc32(0, reinterpret_cast<const Bytef *>(&png[start]),
+               png.size() - start));
+  };
+  string ihdr;
+  for (const uint32_t x : {w, h})
+    for (int shift = 24; shift >= 0; shift -= 8)
+      ihdr.push_back(static_cast<char>((x >> shift) & 0xff));
+  ihdr += string("\x08\x00\x00\x00\x00", 5); // 8 bit gray
+  chunk("IHDR", ihdr);
+  chunk("IDAT", zdata);
+  chunk("IEND", "");
+  ofstream(path, ios::binary) << png;
+}
+#endif
+
+int main() {
+  // a closed box: walls along the edges and concave corners
+  {
+    GeometryMask mask(8, 6);
+    Geometry geom(mask);
+    assert(geom.node_class(0, 0) == NODE_CLASS_CORNER_EAST_NORTH);
+    assert(geom.node_class(7, 0) == NODE_CLASS_CORNER_WEST_NORTH);
+    assert(geom.node_class(7, 5) == NODE_CLASS_CORNER_WEST_SOUTH);
+    assert(geom.node_class(0, 5) == NODE_CLASS_CORNER_EAST_SOUTH);
+    assert(geom.count(NODE_CLASS_NORTH_FACING_WALL) == 6);
+    assert(geom.count(NODE_CLASS_SOUTH_FACING_WALL) == 6);
+    assert(geom.count(NODE_CLASS_EAST_FACING_WALL) == 4);
+    assert(geom.count(NODE_CLASS_WEST_FACING_WALL) == 4);
+    assert(geom.count(NODE_CLASS_ACTIVE) == 24);
+    assert(geom.node_class(3, 0) == NODE_CLASS_NORTH_FACING_WALL);
+    assert(geom.links(3, 0) == (1u << 4 | 1u << 7 | 1u << 8));
+  }
+  cout << "walls and corners ... ok\n";
+
+  // a channel, periodic in x, matches the hand built one bit for bit
+  {
+    GeometryMask mask(ni, nj);
+    Geometry geom(mask, true, false, 3);
+    assert(geom.count(NODE_CLASS_PERIODIC) == 2 * (nj - 2));
+    assert(geom.count(NODE_CLASS_NORTH_FACING_WALL) == ni);
+
+    IncompFlowSimulation by_hand(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                                 new NewtonianConstitutiveEq(mu),
+                                 new GuoForce(F));
+    for (unsigned i = 0; i < ni; ++i) {
+      for (unsigned j = 1; j < nj - 1; ++j)
+        by_hand.set_node_desc<NodePeriodic>(i, j);
+      by_hand.set_node_desc<NodeNorthFacingWall>(i, 0);
+      by_hand.set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+    }
+    IncompFlowSimulation from_mask(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                                   new NewtonianConstitutiveEq(mu),
+                                   new GuoForce(F));
+    from_mask.set_geometry(geom);
+    by_hand.simulate(nsteps);
+    from_mask.simulate(nsteps);
+    const size_t nf = size_t(ni) * nj * 9;
+    assert(equal(by_hand.lattice().pf(), by_hand.lattice().pf() + nf,
+                 from_mask.lattice().pf()));
+  }
+  cout << "channel matches hand built geometry ... ok\n";
+
+  // a cylinder in a channel: convex boundaries bounce back link by link
+  GeometryMask mask(ni, nj);
+  for (unsigned i = 0; i < ni; ++i)
+    for (unsigned j = 0; j < nj; ++j) {
+      const double dx = i - 12.0, dy = j - 11.5;
+      mask.set_solid(i, j, j == 0 || j == nj - 1 || dx * dx + dy * dy < 25.0);
+    }
+  mask.set_solid(30, 12); // a lone solid node
+  Geometry geom(mask, true, false);
+  assert(geom.count(NODE_CLASS_BOUNCE_BACK) > 0);
+  assert(geom.node_class(31, 13) == NODE_CLASS_BOUNCE_BACK);
+  assert(geom.links(31, 13) == 1u << 7);
+  assert(geom.node_class(30, 13) == NODE_CLASS_BOUNCE_BACK);
+  assert(geom.links(30, 13) == 1u << 4);
+  {
+    IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                             new NewtonianConstitutiveEq(mu),
+                             new GuoForce(F));
+    sim.set_geometry(geom);
+    const double mass = fluid_mass(sim, geom);
+    sim.simulate(nsteps);
+    assert(abs(fluid_mass(sim, geom) - mass) < 1e-10 * mass);
+    assert(sim.multiscale_map().u(40, 12, 0) > 0.0);
+  }
+  cout << "mass is conserved around obstacles ... ok\n";
+
+  // the run length encoded cache reproduces the geometry
+  geom.save("test_geometry.cache");
+  {
+    Geometry cached("test_geometry.cache");
+    assert(cached.num_i() == ni && cached.num_j() == nj);
+    assert(cached.periodic_i() && !cached.periodic_j());
+    for (unsigned i = 0; i < ni; ++i)
+      for (unsigned j = 0; j < nj; ++j) {
+        assert(cached.node_class(i, j) == geom.node_class(i, j));
+        assert(cached.links(i, j) == geom.links(i, j));
+      }
+    ifstream ifs("test_geometry.cache", ios::binary | ios::ate);
+    const size_t bytes = ifs.tellg();
+    cout << ni * nj << " nodes cached in " << bytes << " bytes\n";
+    assert(bytes < ni * nj);
+
+    vector<char> contents(bytes);
+    ifs.seekg(0);
+    ifs.read(contents.data(), bytes);
+    ofstream("test_geometry.cut", ios::binary).write(contents.data(),
+                                                     bytes - 3);
+    bool threw = false;
+    try {
+      Geometry cut("test_geometry.cut");
+    } catch (runtime_error &) {
+      threw = true;
+    }
+    assert(threw);
+  }
+  cout << "geometry cache ... ok\n";
+
+  // masks read from images and raw files
+  {
+    ofstream pgm("test_geometry.pgm", ios::binary);
+    pgm << "P5\n# mask\n" << ni << ' ' << nj << "\n255\n";
+    for (unsigned r = 0; r < nj; ++r)
+      for (unsigned x = 0; x < ni; ++x)
+        pgm.put(mask.solid(x, nj - 1 - r) ? char(0) : char(255));
+    ofstream raw("test_geometry.raw", ios::binary);
+    raw.write(reinterpret_cast<const char *>(mask.pmask()), ni * nj);
+  }
+  vector<string> paths = {"test_geometry.pgm", "test_geometry.raw"};
+#ifdef BALBM_USE_ZLIB
+  write_png("test_geometry.png", mask);
+  paths.push_back("test_geometry.png");
+#endif
+  for (const auto &path : paths) {
+    const bool is_raw = path == "test_geometry.raw";
+    unique_ptr<GeometryMask> spread(is_raw ? new GeometryMask(path, ni, nj)
+                                           : new GeometryMask(path));
+    assert(spread->num_i() == ni && spread->num_j() == nj);
+    assert(equal(spread->pmask(), spread->pmask() + ni * nj, mask.pmask()));
+  }
+  {
+    // raw masks are mapped copy-on-write
+    GeometryMask raw("test_geometry.raw", ni, nj);
+    raw.set_solid(1, 1, true);
+    GeometryMask again("test_geometry.raw", ni, nj);
+    assert(!again.solid(1, 1));
+  }
+  cout << "image and raw masks ... ok\n";
+
+  for (const char *path : {"test_geometry.cache", "test_geometry.cut",
+                           "test_geometry.pgm", "test_geometry.raw",
+                           "test_geometry.png"})
+    remove(path);
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
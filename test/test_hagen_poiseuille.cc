@@ -0,0 +1,80 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm.hh"
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 10;
+const static unsigned nj = 12;
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+const static double pgrad = -1.0e-5;
+static double F[] = {-pgrad, 0.0};
+const static unsigned nsteps = 10000;
+
+int main() {
+  // the axis lies halfway below j = 0 and the pipe wall halfway above
+  // j = nj - 1, so the radius of the pipe is nj
+  const double R = nj;
+  const auto analytic_soln = [&](const double r) {
+    return -1.0 / (4.0 * mu) * pgrad * (R * R - r * r);
+  };
+
+  AxisymmetricSourceTerm *paxi = new AxisymmetricSourceTerm();
+  IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                           new NewtonianConstitutiveEq(mu),
+                           new GuoForce(F), nullptr, paxi);
+
+  for (unsigned i = 1; i < ni - 1; ++i)
+    for (unsigned j = 1; j < nj - 1; ++j)
+      sim.set_node_desc<NodeActive>(i, j);
+
+  for (unsigned j = 1; j < nj - 1; ++j) {
+    sim.set_node_desc<NodePeriodic>(0, j);
+    sim.set_node_desc<NodePeriodic>(ni - 1, j);
+  }
+  for (unsigned i = 0; i < ni; ++i) {
+    sim.set_node_desc<NodeAxis>(i, 0);
+    sim.set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+  }
+
+  baprof::tic();
+  unsigned steps_simmed = sim.simulate(nsteps); // run simulation
+  baprof::toc();                                // time simulation
+  cout << "Steps simulated: " << steps_simmed << " / " << nsteps << '\n';
+
+  const unsigned i = ni / 2;
+  const auto &mmap = sim.multiscale_map();
+  const double umax = analytic_soln(0.0);
+
+  for (unsigned j = 0; j < nj; ++j) {
+    const double u = mmap.u(i, j, 0) + 0.5 * F[0] / mmap.rho(i, j);
+    const double ua = analytic_soln(paxi->r(j));
+    cout << "analyt == lbm ? " << ua << " == " << u << '\n';
+    assert(fabs(ua - u) / umax <= 5e-3);
+    assert(fabs(mmap.u(i, j, 1)) / umax <= 1e-8);
+  }
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
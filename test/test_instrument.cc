@@ -0,0 +1,138 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// built with BALBM_INSTRUMENT_NODES defined
+
+#include "balbm.hh"
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 20;
+const static unsigned nj = 12;
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+static double F[] = {1e-5, 0.0};
+const static unsigned nsteps = 50;
+const static unsigned stride = 10;
+
+//! Writer that only sleeps
+class SleepingWriter : public AbstractFieldWriter {
+private:
+  void write_(const FieldFrame &) {
+    this_thread::sleep_for(chrono::milliseconds(2));
+  }
+};
+
+//! Callback that does nothing
+class NoOpCallback : public AbstractSimCallback {
+private:
+  void f_(AbstractSimulation &) const {}
+};
+
+int main() {
+  assert(Instrumentation::enabled() && Instrumentation::nodes_enabled());
+
+  // every phase of every step is counted
+  {
+    AsyncOutputPipeline pipeline(new SleepingWriter());
+    vector<AbstractSimCallback *> *pcbs = new vector<AbstractSimCallback *>();
+    pcbs->push_back(new NoOpCallback());
+    pcbs->push_back(new OutputCallback(pipeline, stride));
+    IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                             new NewtonianConstitutiveEq(mu),
+                             new GuoForce(F), pcbs);
+    for (unsigned i = 0; i < ni; ++i) {
+      for (unsigned j = 1; j < nj - 1; ++j)
+        sim.set_node_desc<NodePeriodic>(i, j);
+      sim.set_node_desc<NodeNorthFacingWall>(i, 0);
+      sim.set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+    }
+    Instrumentation &instr = sim.instrumentation();
+    pipeline.attach_instrumentation(&instr);
+    sim.simulate(nsteps);
+    pipeline.flush();
+
+    for (const Phase p : {PHASE_STEP, PHASE_STREAM, PHASE_SWAP, PHASE_COLLIDE,
+                          PHASE_CALLBACKS})
+      assert(instr.phase(p).calls == nsteps);
+    assert(instr.phase(PHASE_PROBES).calls == 0);
+    assert(instr.phase(PHASE_MACRO).calls == nsteps * ni * nj);
+    assert(instr.phase(PHASE_STAGE).calls == nsteps / stride);
+    assert(instr.phase(PHASE_IO).calls == nsteps / stride);
+    assert(instr.phase(PHASE_IO).seconds >= 2e-3 * nsteps / stride);
+    assert(instr.phase(PHASE_STEP).seconds >=
+           instr.phase(PHASE_COLLIDE).seconds);
+
+    const auto nodes = instr.node_types();
+    assert(nodes.size() == 3);
+    for (const auto &node : nodes) {
+      const unsigned n = (node.name.find("NodePeriodic") != string::npos)
+                             ? ni * (nj - 2)
+                             : ni;
+      assert(node.stream.calls == nsteps * n);
+      assert(node.collide.calls == nsteps * n);
+    }
+
+    // checkpoints are I/O too
+    sim.checkpoint("test_instrument.chk");
+    assert(instr.phase(PHASE_IO).calls == nsteps / stride + 1);
+    remove("test_instrument.chk");
+
+    instr.report(cout);
+    instr.reset();
+    for (unsigned p = 0; p < NUM_PHASES; ++p)
+      assert(instr.phase(static_cast<Phase>(p)).calls == 0);
+    for (const auto &node : instr.node_types())
+      assert(node.stream.calls == 0 && node.collide.calls == 0);
+  }
+  cout << "phases and node types ... ok\n";
+
+  // threads accumulate into slots of their own
+  {
+    const unsigned nthreads = 4, ncalls = 10000;
+    Instrumentation instr;
+    vector<thread> threads;
+    for (unsigned t = 0; t < nthreads; ++t)
+      threads.emplace_back([&] {
+        for (unsigned k = 0; k < ncalls; ++k) {
+          ScopedPhase timer(&instr, PHASE_STREAM);
+          instr.add_node(typeid(NodePeriodic), PHASE_COLLIDE, 1);
+        }
+      });
+    for (auto &thread : threads)
+      thread.join();
+    assert(instr.phase(PHASE_STREAM).calls == nthreads * ncalls);
+    const auto nodes = instr.node_types();
+    assert(nodes.size() == 1);
+    assert(nodes[0].collide.calls == nthreads * ncalls);
+    assert(abs(nodes[0].collide.seconds - 1e-9 * nthreads * ncalls) < 1e-15);
+    assert(nodes[0].stream.calls == 0);
+  }
+  cout << "concurrent timers ... ok\n";
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
@@ -1,5 +1,6 @@
 #include "lattice.hh"
 #include <cassert>
+#include <cmath>
 #include <iostream>
 
 using namespace balbm::d2q9;
@@ -28,6 +29,25 @@ int main()
   assert(1 == lat.c(8, 0));
   assert(-1 == lat.c(8, 1));
 
+  cout << "Testing opposite directions...\n";
+
+  for (unsigned k = 0; k < lat.num_k(); ++k) {
+    assert(-lat.c(k, 0) == lat.c(lat.opp(k), 0));
+    assert(-lat.c(k, 1) == lat.c(lat.opp(k), 1));
+  }
+
+  cout << "Testing D3Q19 descriptor...\n";
+
+  double wsum = 0.0;
+  for (unsigned k = 0; k < balbm::D3Q19::nk; ++k) {
+    const unsigned kopp = balbm::D3Q19::opp[k];
+    for (unsigned d = 0; d < balbm::D3Q19::nd; ++d)
+      assert(-balbm::D3Q19::c[k][d] == balbm::D3Q19::c[kopp][d]);
+    assert(balbm::D3Q19::w[k] == balbm::D3Q19::w[kopp]);
+    wsum += balbm::D3Q19::w[k];
+  }
+  assert(fabs(wsum - 1.0) < 1e-15);
+
   cout << "TEST PASSED\n";
 
   return 0;
@@ -0,0 +1,149 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm.hh"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 40;
+const static unsigned nj = 22;
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+static double F[] = {1e-5, 0.0};
+
+//! Writer held until the solver is done, so every staging frame gets used
+//! however loaded the machine is
+class HeldWriter : public AbstractFieldWriter {
+public:
+  HeldWriter(const atomic<bool> &released) : released_(released) {}
+
+private:
+  const atomic<bool> &released_;
+  void write_(const FieldFrame &) {
+    while (!released_)
+      this_thread::sleep_for(chrono::milliseconds(1));
+  }
+};
+
+int main() {
+  // the plan of a configuration is what a simulation built with it holds
+  {
+    MemoryConfig config(ni, nj);
+    config.solid_fractions = true;
+    config.statistics = true;
+    config.output_fields = OUTPUT_U | OUTPUT_F;
+    config.output_buffers = 3;
+    config.output_region = OutputRegion(4, 2, 0, 15, 2, true);
+    const MemoryFootprint plan = plan_memory(config);
+
+    FlowStatistics stats(ni, nj);
+    atomic<bool> released(false);
+    AsyncOutputPipeline pipeline(new HeldWriter(released), config.output_fields,
+                                 config.output_buffers, 1,
+                                 config.output_region);
+    vector<AbstractSimCallback *> *pcbs = new vector<AbstractSimCallback *>();
+    pcbs->push_back(new OutputCallback(pipeline, 1));
+    IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                             new NewtonianConstitutiveEq(mu),
+                             new GuoForce(F), pcbs);
+    for (unsigned i = 0; i < ni; ++i) {
+      for (unsigned j = 1; j < nj - 1; ++j)
+        sim.set_node_desc<NodePeriodic>(i, j);
+      sim.set_node_desc<NodeNorthFacingWall>(i, 0);
+      sim.set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+    }
+    sim.set_solid_fraction(ni / 2, nj / 2, 0.5);
+    sim.attach_statistics(&stats);
+    sim.simulate(config.output_buffers);
+    released = true;
+    pipeline.flush();
+
+    const MemoryFootprint actual = memory_footprint(sim, &pipeline);
+    for (unsigned c = 0; c < NUM_MEMORY_COMPONENTS; ++c) {
+      assert(plan.bytes[c] > 0);
+      assert(plan.bytes[c] == actual.bytes[c]);
+    }
+    assert(plan.bytes[MEMORY_OUTPUT] ==
+           3 * (36 / 2) * (15 / 2) * (2 + 9) * sizeof(double));
+
+    ostringstream oss;
+    write_memory_report(oss, plan, &actual);
+    cout << oss.str();
+    assert(oss.str().find("accounted") != string::npos);
+    assert(oss.str().find("solid_fractions") != string::npos);
+  }
+  cout << "plan matches accounting ... ok\n";
+
+  // the largest domain fits and keeps the aspect ratio
+  {
+    MemoryConfig config(400, 100);
+    config.statistics = true;
+    config.output_fields = OUTPUT_RHO | OUTPUT_U;
+    const size_t budget = parse_bytes("64MiB");
+    const MemoryConfig largest = largest_domain(config, budget);
+    cout << largest.ni << " x " << largest.nj << " fits in 64 MiB\n";
+    assert(plan_memory(largest).total() <= budget);
+    MemoryConfig bigger(largest);
+    bigger.ni += 4;
+    bigger.nj += 1;
+    assert(plan_memory(bigger).total() > budget);
+    assert(abs(double(largest.ni) / largest.nj - 4.0) < 0.1);
+    assert(largest.statistics && largest.output_fields == config.output_fields);
+
+    bool threw = false;
+    try {
+      largest_domain(config, 1024);
+    } catch (length_error &) {
+      threw = true;
+    }
+    assert(threw);
+  }
+  cout << "largest domain in a budget ... ok\n";
+
+  {
+    assert(parse_bytes("4096") == 4096);
+    assert(parse_bytes("1.5k") == 1536);
+    assert(parse_bytes("512M") == size_t(512) << 20);
+    assert(parse_bytes("8GiB") == size_t(8) << 30);
+    assert(parse_bytes("2TB") == size_t(2) << 40);
+    for (const char *s : {"", "G", "-1M", "12Q", "3 apples"}) {
+      bool threw = false;
+      try {
+        parse_bytes(s);
+      } catch (invalid_argument &) {
+        threw = true;
+      }
+      assert(threw);
+    }
+  }
+  cout << "budgets ... ok\n";
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
@@ -0,0 +1,187 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// built with BALBM_INSTRUMENT defined
+
+#include "balbm.hh"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 30;
+const static unsigned nj = 16;
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+static double F[] = {1e-5, 0.0};
+const static unsigned nsteps = 60;
+const static unsigned stride = 10;
+const static unsigned target = 200;
+
+//! Send an HTTP request and read the whole response
+string http(const int port, const string &path, const string &request) {
+  const int fd = socket(port > 0 ? AF_INET : AF_UNIX, SOCK_STREAM, 0);
+  assert(fd >= 0);
+  int rc;
+  if (port > 0) {
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    rc = connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+  } else {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    rc = connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+  }
+  assert(rc == 0);
+  const ssize_t sent = send(fd, request.data(), request.size(), 0);
+  assert(sent == ssize_t(request.size()));
+  string response;
+  char buf[4096];
+  for (ssize_t n; (n = recv(fd, buf, sizeof(buf), 0)) > 0;)
+    response.append(buf, n);
+  close(fd);
+  return response;
+}
+
+//! Value of a metric in a response, NaN if absent
+double metric(const string &response, const string &name) {
+  const size_t pos = response.find('\n' + name + ' ');
+  if (pos == string::npos)
+    return NAN;
+  istringstream iss(response.substr(pos + name.size() + 2));
+  string value;
+  iss >> value;
+  return (value == "NaN") ? NAN : stod(value);
+}
+
+int main() {
+  MetricsPublisher publisher(target);
+  {
+    ostringstream oss;
+    publisher.write_prometheus(oss);
+    assert(oss.str().find("balbm_samples_total 0\n") != string::npos);
+    assert(oss.str().find("balbm_step") == string::npos);
+  }
+
+  vector<AbstractSimCallback *> *pcbs = new vector<AbstractSimCallback *>();
+  pcbs->push_back(new MetricsCallback(publisher, stride));
+  IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                           new NewtonianConstitutiveEq(mu), new GuoForce(F),
+                           pcbs);
+  for (unsigned i = 0; i < ni; ++i) {
+    for (unsigned j = 1; j < nj - 1; ++j)
+      sim.set_node_desc<NodePeriodic>(i, j);
+    sim.set_node_desc<NodeNorthFacingWall>(i, 0);
+    sim.set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+  }
+
+  // scrapes while the solver runs see whole samples, in order
+  {
+    MetricsServer server(publisher, "127.0.0.1:0");
+    assert(server.port() > 0);
+    atomic<bool> done(false);
+    unsigned scrapes = 0;
+    thread scraper([&] {
+      double last_step = 0.0;
+      while (!done.load()) {
+        const string r = http(server.port(), "", "GET /metrics HTTP/1.1\r\n"
+                                                 "Host: localhost\r\n\r\n");
+        assert(r.compare(0, 15, "HTTP/1.1 200 OK") == 0);
+        const double step = metric(r, "balbm_step");
+        if (!isnan(step)) {
+          assert(fmod(step, stride) == 0.0 && step >= last_step);
+          assert(metric(r, "balbm_samples_total") == step / stride);
+          last_step = step;
+        }
+        ++scrapes;
+      }
+    });
+    sim.simulate(nsteps);
+    done.store(true);
+    scraper.join();
+    cout << scrapes << " scrapes during the run\n";
+    assert(server.requests() == scrapes);
+
+    const string r = http(server.port(), "", "GET / HTTP/1.0\r\n\r\n");
+    assert(r.find("Content-Type: text/plain; version=0.0.4") != string::npos);
+    assert(metric(r, "balbm_step") == nsteps);
+    assert(metric(r, "balbm_target_step") == target);
+    assert(metric(r, "balbm_nodes") == ni * nj);
+    assert(metric(r, "balbm_mlups") > 0.0);
+    assert(metric(r, "balbm_eta_seconds") > 0.0);
+    assert(metric(r, "balbm_residual") > 0.0);
+    assert(metric(r, "balbm_resident_bytes") > 0.0);
+    assert(metric(r, "balbm_memory_bytes{component=\"populations\"}") ==
+           2 * ni * nj * 9 * sizeof(double));
+    assert(metric(r, "balbm_phase_calls_total{phase=\"stream\"}") == nsteps);
+    assert(metric(r, "balbm_phase_seconds_total{phase=\"collide\"}") > 0.0);
+
+    assert(http(server.port(), "", "GET /nope HTTP/1.1\r\n\r\n")
+               .compare(0, 12, "HTTP/1.1 404") == 0);
+    assert(http(server.port(), "", "POST /metrics HTTP/1.1\r\n\r\n")
+               .compare(0, 12, "HTTP/1.1 405") == 0);
+  }
+  cout << "localhost port ... ok\n";
+
+  {
+    const string path = "test_metrics.sock";
+    {
+      MetricsServer server(publisher, "unix:" + path);
+      assert(server.socket_path() == path);
+      const string r = http(0, path, "GET /metrics HTTP/1.1\r\n\r\n");
+      assert(metric(r, "balbm_step") == nsteps);
+    }
+    struct stat st;
+    assert(stat(path.c_str(), &st) != 0); // removed with the server
+  }
+  cout << "unix domain socket ... ok\n";
+
+  for (const char *address : {"10.0.0.1:9100", "localhost:http", "70000"}) {
+    bool threw = false;
+    try {
+      MetricsServer server(publisher, address);
+    } catch (invalid_argument &) {
+      threw = true;
+    }
+    assert(threw);
+  }
+  cout << "only localhost ... ok\n";
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
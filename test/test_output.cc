@@ -0,0 +1,157 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm.hh"
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 20;
+const static unsigned nj = 12;
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+static double F[] = {1e-5, 0.0};
+const static unsigned nsteps = 400;
+const static unsigned stride = 10;
+
+//! Slow writer that keeps the velocity field of every frame
+class RecordingWriter : public AbstractFieldWriter {
+public:
+  map<unsigned, vector<double>> us;
+
+private:
+  mutex mutex_;
+  void write_(const FieldFrame &frame) {
+    this_thread::sleep_for(chrono::milliseconds(20));
+    assert(frame.ni == ni && frame.nj == nj);
+    assert(frame.u.size() == 2 * ni * nj && frame.omega.empty());
+    lock_guard<mutex> lock(mutex_);
+    us[frame.step] = frame.u;
+  }
+};
+
+//! Writer that keeps a copy of the latest frame
+class LastFrameWriter : public AbstractFieldWriter {
+public:
+  FieldFrame frame;
+
+private:
+  void write_(const FieldFrame &f) { frame = f; }
+};
+
+void set_geometry(IncompFlowSimulation &sim) {
+  for (unsigned i = 0; i < ni; ++i) {
+    for (unsigned j = 1; j < nj - 1; ++j)
+      sim.set_node_desc<NodePeriodic>(i, j);
+    sim.set_node_desc<NodeNorthFacingWall>(i, 0);
+    sim.set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+  }
+}
+
+int main() {
+  RecordingWriter *pwriter = new RecordingWriter();
+  AsyncOutputPipeline pipeline(pwriter, OUTPUT_RHO | OUTPUT_U, 2, 1);
+  OutputCallback output(pipeline, stride);
+  vector<AbstractSimCallback *> *pscbs = new vector<AbstractSimCallback *>();
+  pscbs->push_back(&output);
+
+  IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                           new NewtonianConstitutiveEq(mu), new GuoForce(F),
+                           pscbs);
+  set_geometry(sim);
+  sim.simulate(nsteps);
+  pipeline.flush();
+
+  cout << "Frames written: " << pipeline.frames_written() << '\n';
+  cout << "Stalls: " << pipeline.stalls() << '\n';
+  assert(pipeline.frames_written() == nsteps / stride);
+  assert(pwriter->us.size() == nsteps / stride);
+
+  // staged frames must hold the fields as they were at their time step
+  IncompFlowSimulation ref_sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                               new NewtonianConstitutiveEq(mu),
+                               new GuoForce(F));
+  set_geometry(ref_sim);
+  const auto &ref_mmap = ref_sim.multiscale_map();
+  for (unsigned step = stride; step <= nsteps; step += stride) {
+    ref_sim.simulate(stride);
+    const auto &u = pwriter->us.at(step);
+    for (unsigned i = 0; i < ni; ++i)
+      for (unsigned j = 0; j < nj; ++j) {
+        assert(u[2 * (i * nj + j)] == ref_mmap.u(i, j, 0));
+        assert(u[2 * (i * nj + j) + 1] == ref_mmap.u(i, j, 1));
+      }
+  }
+
+  // regions of interest, decimated and block averaged
+  LastFrameWriter *pdecimated = new LastFrameWriter();
+  LastFrameWriter *paveraged = new LastFrameWriter();
+  AsyncOutputPipeline decimated(pdecimated, OUTPUT_U, 2, 1,
+                                OutputRegion(3, 2, 11, 0, 2));
+  AsyncOutputPipeline averaged(paveraged, OUTPUT_RHO | OUTPUT_U, 2, 1,
+                               OutputRegion(4, 1, 8, 9, 3, true));
+  OutputCallback decimated_output(decimated, stride);
+  OutputCallback averaged_output(averaged, stride);
+  vector<AbstractSimCallback *> *proi_scbs =
+      new vector<AbstractSimCallback *>{&decimated_output, &averaged_output};
+  IncompFlowSimulation roi_sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                               new NewtonianConstitutiveEq(mu),
+                               new GuoForce(F), proi_scbs);
+  set_geometry(roi_sim);
+  roi_sim.simulate(nsteps);
+  decimated.flush();
+  averaged.flush();
+  const auto &roi_mmap = roi_sim.multiscale_map();
+
+  const FieldFrame &dframe = pdecimated->frame;
+  assert(dframe.step == nsteps && dframe.ni == 6 && dframe.nj == 5);
+  assert(dframe.origin[0] == 3.0 && dframe.origin[1] == 2.0);
+  assert(dframe.spacing == 2.0 && dframe.rho.empty());
+  for (unsigned i = 0; i < dframe.ni; ++i)
+    for (unsigned j = 0; j < dframe.nj; ++j)
+      assert(dframe.u[2 * (i * dframe.nj + j)] ==
+             roi_mmap.u(3 + 2 * i, 2 + 2 * j, 0));
+  cout << "decimated region ... ok\n";
+
+  const FieldFrame &aframe = paveraged->frame;
+  assert(aframe.ni == 2 && aframe.nj == 3);
+  assert(aframe.origin[0] == 5.0 && aframe.origin[1] == 2.0);
+  for (unsigned i = 0; i < aframe.ni; ++i)
+    for (unsigned j = 0; j < aframe.nj; ++j) {
+      double rho_mean = 0.0;
+      double ux_mean = 0.0;
+      for (unsigned bi = 0; bi < 3; ++bi)
+        for (unsigned bj = 0; bj < 3; ++bj) {
+          rho_mean += roi_mmap.rho(4 + 3 * i + bi, 1 + 3 * j + bj) / 9.0;
+          ux_mean += roi_mmap.u(4 + 3 * i + bi, 1 + 3 * j + bj, 0) / 9.0;
+        }
+      assert(fabs(aframe.rho[i * aframe.nj + j] - rho_mean) < 1e-14);
+      assert(fabs(aframe.u[2 * (i * aframe.nj + j)] - ux_mean) < 1e-14);
+    }
+  cout << "block averaged region ... ok\n";
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
@@ -0,0 +1,128 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm.hh"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 20;
+const static unsigned nj = 12;
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+static double F[] = {1e-5, 0.0};
+const static unsigned nsteps = 250;
+const static unsigned capacity = 64;
+const static unsigned block = 16;
+
+int main() {
+  unsigned point, line, section;
+  {
+    ProbeRecorder probes("test_probes", capacity, block);
+    point = probes.add(new PointProbe("point", ni / 2, nj / 2));
+    line = probes.add(new LineProbe("line", ni / 2, 0, ni / 2, nj - 1));
+    section = probes.add(new FlowRateProbe("q", ni / 2, 0, ni / 2, nj - 1));
+
+    IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                             new NewtonianConstitutiveEq(mu),
+                             new GuoForce(F));
+    for (unsigned i = 0; i < ni; ++i) {
+      for (unsigned j = 1; j < nj - 1; ++j)
+        sim.set_node_desc<NodePeriodic>(i, j);
+      sim.set_node_desc<NodeNorthFacingWall>(i, 0);
+      sim.set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+    }
+    sim.attach_probes(&probes);
+    sim.simulate(nsteps);
+
+    // latest samples hold the fields at the end of the run, the velocity
+    // shifted by half the body force
+    const auto &mmap = sim.multiscale_map();
+    assert(probes.num_samples(point) == nsteps);
+    const double *psample = probes.sample(point, 0);
+    assert(psample[0] == nsteps);
+    assert(psample[2] == mmap.u(ni / 2, nj / 2, 0) + 0.5 * F[0]);
+
+    assert(static_cast<const LineProbe &>(probes.probe(line)).num_nodes() ==
+           nj);
+    psample = probes.sample(line, 0);
+    double q = 0.0;
+    for (unsigned j = 0; j < nj; ++j) {
+      const double u = mmap.u(ni / 2, j, 0) + 0.5 * F[0];
+      assert(psample[1 + 3 * j + 1] == u);
+      q += u;
+    }
+    assert(probes.sample(section, 0)[1] == q);
+    cout << "flow rate = " << q << '\n';
+
+    // the flow accelerates from rest, older samples are still in the ring
+    assert(probes.sample(section, capacity - 1)[0] == nsteps - capacity + 1);
+    assert(probes.sample(section, capacity - 1)[1] < q);
+    bool threw = false;
+    try {
+      probes.sample(section, capacity);
+    } catch (out_of_range &) {
+      threw = true;
+    }
+    assert(threw);
+  }
+
+  // probes reaching outside the lattice are rejected on their first sample
+  {
+    Lattice lat(ni, nj, rho);
+    IncompFlowMultiscaleMap mmap(ni, nj, 1.0);
+    for (AbstractProbe *pprobe :
+         {static_cast<AbstractProbe *>(new PointProbe("out", ni, 0)),
+          static_cast<AbstractProbe *>(new LineProbe("out", 0, 0, 0, nj)),
+          static_cast<AbstractProbe *>(
+              new FlowRateProbe("out", 0, nj / 2, ni, nj / 2))}) {
+      ProbeRecorder probes("test_probes", capacity, block);
+      probes.add(pprobe);
+      bool threw = false;
+      try {
+        probes.record(lat, mmap, nullptr, 1);
+      } catch (out_of_range &) {
+        threw = true;
+      }
+      assert(threw && probes.num_samples(0) == 0);
+    }
+    remove("test_probes_out.dat");
+  }
+  cout << "probes outside the lattice ... ok\n";
+
+  // every sample ends up on disk, in order
+  ifstream ifs("test_probes_q.dat", ios::binary);
+  vector<double> records(3 * nsteps + 1);
+  ifs.read(reinterpret_cast<char *>(records.data()),
+           records.size() * sizeof(double));
+  assert(static_cast<unsigned>(ifs.gcount()) == 3 * nsteps * sizeof(double));
+  for (unsigned s = 0; s < nsteps; ++s)
+    assert(records[3 * s] == s + 1);
+  cout << "samples on disk ... ok\n";
+
+  remove("test_probes_point.dat");
+  remove("test_probes_line.dat");
+  remove("test_probes_q.dat");
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
@@ -0,0 +1,138 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm.hh"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#ifdef BALBM_USE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace balbm::d2q9;
+using namespace std;
+
+const static unsigned ni = 5;
+const static unsigned nj = 4;
+const static double Omega = 1e-3;
+
+string read_file(const string &path) {
+  ifstream ifs(path, ios::binary);
+  return string((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+}
+
+//! Pixels of a binary PPM image
+string ppm_pixels(const string &path, const unsigned width,
+                  const unsigned height) {
+  const string ppm = read_file(path);
+  const string header =
+      "P6\n" + to_string(width) + ' ' + to_string(height) + "\n255\n";
+  assert(ppm.compare(0, header.size(), header) == 0);
+  assert(ppm.size() == header.size() + 3 * width * height);
+  return ppm.substr(header.size());
+}
+
+int main() {
+  // solid body rotation about node (2, 1), constant vorticity 2 Omega
+  FieldFrame frame;
+  frame.step = 7;
+  frame.fields = OUTPUT_U;
+  frame.ni = ni;
+  frame.nj = nj;
+  frame.nk = 9;
+  frame.origin[0] = frame.origin[1] = 0.0;
+  frame.spacing = 1.0;
+  for (unsigned i = 0; i < ni; ++i)
+    for (unsigned j = 0; j < nj; ++j) {
+      frame.u.push_back(-Omega * (j - 1.0));
+      frame.u.push_back(Omega * (i - 2.0));
+    }
+
+  // speed in gray, 2x magnified, y up
+  ImageRenderer(string("test_render_speed"), RenderQuantity::Speed,
+                Colormap::Gray, 0.0, 5.0 * Omega, ImageFormat::PPM, 2)
+      .write(frame);
+  const string speed = ppm_pixels("test_render_speed_00000007.ppm", 10, 8);
+  for (unsigned r = 0; r < 8; ++r)
+    for (unsigned c = 0; c < 10; ++c) {
+      const unsigned i = c / 2;
+      const unsigned j = nj - 1 - r / 2;
+      const double ux = frame.u[2 * (i * nj + j)];
+      const double uy = frame.u[2 * (i * nj + j) + 1];
+      unsigned char rgb[3];
+      colormap_rgb(Colormap::Gray, sqrt(ux * ux + uy * uy) / (5.0 * Omega),
+                   rgb);
+      for (unsigned k = 0; k < 3; ++k)
+        assert(static_cast<unsigned char>(speed[3 * (r * 10 + c) + k]) ==
+               rgb[k]);
+    }
+  assert(static_cast<unsigned char>(speed[3 * (4 * 10 + 4)]) == 0);
+  assert(static_cast<unsigned char>(speed[3 * (1 * 10 + 4)]) != 0);
+  cout << "speed ... ok\n";
+
+  // vorticity centered in a diverging colormap is its middle color
+  ImageRenderer(string("test_render_vort"), RenderQuantity::Vorticity,
+                Colormap::CoolWarm, 0.0, 4.0 * Omega)
+      .write(frame);
+  const string vort = ppm_pixels("test_render_vort_00000007.ppm", ni, nj);
+  for (const char c : vort)
+    assert(static_cast<unsigned char>(c) == 221);
+  cout << "vorticity ... ok\n";
+
+  // density is missing from the frame
+  bool threw = false;
+  try {
+    ImageRenderer("test_render_rho", RenderQuantity::Density).write(frame);
+  } catch (invalid_argument &) {
+    threw = true;
+  }
+  assert(threw);
+
+#ifdef BALBM_USE_ZLIB
+  ImageRenderer(string("test_render_speed"), RenderQuantity::Speed,
+                Colormap::Gray, 0.0, 5.0 * Omega, ImageFormat::PNG, 2)
+      .write(frame);
+  const string png = read_file("test_render_speed_00000007.png");
+  assert(png.compare(0, 8, "\x89PNG\r\n\x1a\n") == 0);
+  const size_t idat = png.find("IDAT");
+  const size_t zbytes = (static_cast<unsigned char>(png[idat - 2]) << 8) |
+                        static_cast<unsigned char>(png[idat - 1]);
+  vector<unsigned char> raw(8 * (3 * 10 + 1));
+  uLongf nraw = raw.size();
+  assert(uncompress(raw.data(), &nraw,
+                    reinterpret_cast<const Bytef *>(&png[idat + 4]),
+                    zbytes) == Z_OK);
+  assert(nraw == raw.size());
+  for (unsigned r = 0; r < 8; ++r) {
+    assert(raw[r * 31] == 0);
+    assert(speed.compare(r * 30, 30,
+                         reinterpret_cast<const char *>(&raw[r * 31 + 1]),
+                         30) == 0);
+  }
+  cout << "png ... ok\n";
+  remove("test_render_speed_00000007.png");
+#endif
+
+  remove("test_render_speed_00000007.ppm");
+  remove("test_render_vort_00000007.ppm");
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
@@ -0,0 +1,132 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// built with BALBM_INSTRUMENT defined
+
+#include "balbm.hh"
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 40;
+const static unsigned nj = 20;
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+static double F[] = {1e-5, 0.0};
+const static unsigned nsteps = 20;
+
+int main() {
+  // placement left and right of the ridge point
+  {
+    const MachineCeilings ceilings{10e9, 5e9};
+    const RooflinePoint low = place_on_roofline(ceilings, 1e9, 4e9, 2.0);
+    assert(low.memory_bound);
+    assert(abs(low.intensity - 0.25) < 1e-15);
+    assert(abs(low.attainable_flops_per_second - 2.5e9) < 1.0);
+    assert(abs(low.bytes_per_second - 2e9) < 1.0);
+    const RooflinePoint high = place_on_roofline(ceilings, 4e9, 1e9, 1.0);
+    assert(!high.memory_bound);
+    assert(abs(high.attainable_flops_per_second - 5e9) < 1.0);
+    bool threw = false;
+    try {
+      place_on_roofline(ceilings, 1.0, 1.0, 0.0);
+    } catch (invalid_argument &) {
+      threw = true;
+    }
+    assert(threw);
+  }
+  cout << "roofline placement ... ok\n";
+
+  const MachineCeilings ceilings = measure_machine_ceilings(1u << 20, 3);
+  for (const double ceiling :
+       {ceilings.bytes_per_second, ceilings.flops_per_second})
+    assert(ceiling > 0.0 && isfinite(ceiling));
+  cout << "machine ceilings ... ok\n";
+
+  // counters degrade to zero counts and a reason when they cannot be opened
+  {
+    PerfCounters counters;
+    const HardwareCounts before = counters.read();
+    volatile double x = 0.0;
+    for (unsigned k = 0; k < 100000; ++k)
+      x = x + 1.0;
+    const HardwareCounts after = counters.read();
+    for (unsigned e = 0; e < NUM_HW_EVENTS; ++e) {
+      const HardwareEvent event = static_cast<HardwareEvent>(e);
+      if (!counters.available(event))
+        assert(after.values[e] == 0);
+      else if (event == HW_INSTRUCTIONS)
+        assert(after.values[e] > before.values[e]);
+    }
+    if (!counters.available())
+      cout << "hardware counters unavailable: " << counters.reason() << '\n';
+    else if (!counters.reason().empty())
+      cout << "some hardware counters unavailable: " << counters.reason()
+           << '\n';
+  }
+  cout << "hardware counters ... ok\n";
+
+  // report of a channel flow
+  {
+    IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                             new NewtonianConstitutiveEq(mu),
+                             new GuoForce(F));
+    for (unsigned i = 0; i < ni; ++i) {
+      for (unsigned j = 1; j < nj - 1; ++j)
+        sim.set_node_desc<NodePeriodic>(i, j);
+      sim.set_node_desc<NodeNorthFacingWall>(i, 0);
+      sim.set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+    }
+    Instrumentation &instr = sim.instrumentation();
+    const bool counting = instr.count_hardware_events();
+    assert(instr.counting_hardware());
+    sim.simulate(nsteps);
+
+    const PerfCounters &counters = *instr.perf_counters();
+    assert(counting == counters.available());
+    const HardwareCounts hw = instr.hardware(PHASE_COLLIDE);
+    if (counters.available(HW_INSTRUCTIONS))
+      assert(hw.values[HW_INSTRUCTIONS] > 0);
+    else
+      assert(hw.values[HW_INSTRUCTIONS] == 0);
+
+    ostringstream oss;
+    roofline_report(oss, instr, ceilings, ni * nj);
+    instr.report(oss);
+    cout << oss.str();
+    const string report = oss.str();
+    assert(report.find("collide") != string::npos);
+    // streaming does no arithmetic, it can only be bandwidth bound
+    const size_t stream_row = report.find("\nstream");
+    assert(stream_row != string::npos);
+    assert(report.find("memory", stream_row) <
+           report.find('\n', stream_row + 1));
+    if (!counting)
+      assert(report.find("unavailable") != string::npos);
+  }
+  cout << "roofline report ... ok\n";
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
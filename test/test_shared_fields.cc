@@ -0,0 +1,190 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm.hh"
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 32;
+const static unsigned nj = 16;
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+static double F[] = {1e-5, 0.0};
+const static unsigned nsteps = 300;
+
+//! FNV-1a hash of density and velocity fields
+uint64_t hash_fields(const double *prho, const double *pu, const size_t n) {
+  uint64_t hash = 14695981039346656037ull;
+  const auto add = [&](const double *p, const size_t count) {
+    const unsigned char *pc = reinterpret_cast<const unsigned char *>(p);
+    for (size_t b = 0; b < count * sizeof(double); ++b) {
+      hash ^= pc[b];
+      hash *= 1099511628211ull;
+    }
+  };
+  add(prho, n);
+  add(pu, 2 * n);
+  return hash;
+}
+
+//! Records the hash of the fields of every step
+class HashCallback : public AbstractSimCallback {
+public:
+  ~HashCallback() {}
+  HashCallback(map<unsigned, uint64_t> &hashes) : phashes_(&hashes) {}
+
+private:
+  map<unsigned, uint64_t> *phashes_;
+  void f_(AbstractSimulation &sim) const {
+    const auto &mmap =
+        dynamic_cast<IncompFlowSimulation &>(sim).multiscale_map();
+    (*phashes_)[sim.step() + 1] = hash_fields(mmap.prho(), mmap.pu(), ni * nj);
+  }
+};
+
+//! Reader process, reports the step and hash of every frame it sees
+int reader_process(const string &name, const int fd) {
+  SharedFieldReader reader(name);
+  if (reader.num_i() != ni || reader.num_j() != nj)
+    return 1;
+
+  const auto deadline = chrono::steady_clock::now() + chrono::seconds(60);
+  FieldFrame frame;
+  unsigned last = 0;
+  for (unsigned iter = 0; last < nsteps; ++iter) {
+    if (chrono::steady_clock::now() > deadline)
+      return 2;
+    uint64_t record[2];
+    if (iter % 2 == 0) {
+      // zero-copy, in place
+      uint64_t seq;
+      do {
+        seq = reader.begin_read();
+        record[0] = reader.step();
+        record[1] = hash_fields(reader.rho(), reader.u(), ni * nj);
+      } while (!reader.end_read(seq));
+      if (seq == 0)
+        continue;
+    } else {
+      if (reader.snapshot(frame) == 0)
+        continue;
+      record[0] = frame.step;
+      record[1] = hash_fields(frame.rho.data(), frame.u.data(), ni * nj);
+    }
+    if (record[0] == last)
+      continue;
+    last = static_cast<unsigned>(record[0]);
+    if (write(fd, record, sizeof(record)) != sizeof(record))
+      return 3;
+  }
+  return 0;
+}
+
+int main() {
+  map<unsigned, uint64_t> hashes;
+  HashCallback hash_cb(hashes);
+  const string name = "/balbm_test_" + to_string(getpid());
+
+  // the geometry has to be set before the boundary nodes are collected
+  vector<AbstractSimCallback *> *pscbs = new vector<AbstractSimCallback *>();
+  unique_ptr<IncompFlowSimulation> spsim(new IncompFlowSimulation(
+      ni, nj, rho, mu, new IncompFlowEqFunct(), new NewtonianConstitutiveEq(mu),
+      new GuoForce(F), pscbs));
+  for (unsigned i = 0; i < ni; ++i) {
+    for (unsigned j = 1; j < nj - 1; ++j)
+      spsim->set_node_desc<NodePeriodic>(i, j);
+    spsim->set_node_desc<NodeNorthFacingWall>(i, 0);
+    spsim->set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+  }
+  SharedFieldPublisher publisher(name, spsim->lattice(), OUTPUT_RHO | OUTPUT_U,
+                                 true);
+  SharedFieldCallback publish_cb(publisher, 1);
+  pscbs->push_back(&publish_cb);
+  pscbs->push_back(&hash_cb);
+
+  int fds[2];
+  const int piped = pipe(fds);
+  assert(piped == 0);
+  const pid_t pid = fork();
+  assert(pid >= 0);
+  if (pid == 0) {
+    close(fds[0]);
+    int status;
+    try {
+      status = reader_process(name, fds[1]);
+    } catch (exception &e) {
+      cerr << e.what() << '\n';
+      status = 4;
+    }
+    close(fds[1]);
+    _exit(status);
+  }
+  close(fds[1]);
+
+  spsim->simulate(nsteps);
+
+  int status;
+  const pid_t waited = waitpid(pid, &status, 0);
+  assert(waited == pid);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  uint64_t record[2];
+  unsigned nseen = 0;
+  uint64_t last = 0;
+  while (read(fds[0], record, sizeof(record)) == sizeof(record)) {
+    // every frame the reader saw is exactly one published step
+    assert(hashes.count(record[0]) == 1);
+    assert(hashes[record[0]] == record[1]);
+    last = record[0];
+    ++nseen;
+  }
+  close(fds[0]);
+  assert(nseen > 0 && last == nsteps);
+  cout << "reader process saw " << nseen << " consistent frames ... ok\n";
+
+  // boundary populations are those of the walls
+  SharedFieldReader reader(name);
+  assert(reader.sequence() == 2 * nsteps);
+  assert(reader.num_boundary_nodes() == 2 * ni);
+  vector<double> boundary_f;
+  FieldFrame frame;
+  reader.snapshot(frame, &boundary_f);
+  assert(frame.omega.empty() && frame.f.empty());
+  const unsigned nk = spsim->lattice().num_k();
+  const double *pf = spsim->lattice().pf();
+  for (unsigned b = 0; b < reader.num_boundary_nodes(); ++b) {
+    const unsigned idx = reader.boundary_nodes()[b];
+    assert(idx % nj == 0 || idx % nj == nj - 1);
+    for (unsigned k = 0; k < nk; ++k)
+      assert(boundary_f[b * nk + k] == pf[idx * nk + k]);
+  }
+  cout << "boundary populations ... ok\n";
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
@@ -0,0 +1,172 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm.hh"
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 16;
+const static unsigned nj = 10;
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+static double F[] = {1e-5, 0.0};
+const static unsigned start = 20;
+const static unsigned interval = 3;
+const static unsigned nsteps = 200;
+
+IncompFlowSimulation *make_channel() {
+  IncompFlowSimulation *psim = new IncompFlowSimulation(
+      ni, nj, rho, mu, new IncompFlowEqFunct(), new NewtonianConstitutiveEq(mu),
+      new GuoForce(F));
+  for (unsigned i = 0; i < ni; ++i) {
+    for (unsigned j = 1; j < nj - 1; ++j)
+      psim->set_node_desc<NodePeriodic>(i, j);
+    psim->set_node_desc<NodeNorthFacingWall>(i, 0);
+    psim->set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+  }
+  return psim;
+}
+
+bool close(const double a, const double b) {
+  return abs(a - b) <= 1e-12 * max(1.0, max(abs(a), abs(b)));
+}
+
+int main() {
+  // Welford accumulation against two pass statistics
+  {
+    FlowStatistics stats(1, 1, 2, 2);
+    const double xs[][3] = {
+        {1.0, 0.1, -0.2}, {1.1, 0.3, 0.0}, {0.9, -0.2, 0.4}, {1.05, 0.0, 0.1}};
+    unsigned step = 0;
+    for (const auto &x : xs) {
+      do
+        stats.begin_step(++step);
+      while (!stats.sampling());
+      stats.accumulate(0, 0, x[0], x[1], x[2]);
+    }
+    assert(step == 8 && stats.num_samples() == 4);
+
+    double mean[3] = {0.0, 0.0, 0.0};
+    for (const auto &x : xs)
+      for (unsigned c = 0; c < 3; ++c)
+        mean[c] += x[c] / 4;
+    double var[3] = {0.0, 0.0, 0.0};
+    double cov = 0.0;
+    for (const auto &x : xs) {
+      for (unsigned c = 0; c < 3; ++c)
+        var[c] += (x[c] - mean[c]) * (x[c] - mean[c]) / 4;
+      cov += (x[1] - mean[1]) * (x[2] - mean[2]) / 4;
+    }
+    assert(close(stats.mean_rho(0, 0), mean[0]));
+    assert(close(stats.var_rho(0, 0), var[0]));
+    for (unsigned c = 0; c < 2; ++c) {
+      assert(close(stats.mean_u(0, 0, c), mean[c + 1]));
+      assert(close(stats.reynolds_stress(0, 0, c, c), var[c + 1]));
+    }
+    assert(close(stats.reynolds_stress(0, 0, 0, 1), cov));
+    assert(close(stats.reynolds_stress(0, 0, 1, 0), cov));
+    assert(stats.min_rho(0, 0) == 0.9 && stats.max_rho(0, 0) == 1.1);
+    assert(stats.min_u(0, 0, 0) == -0.2 && stats.max_u(0, 0, 0) == 0.3);
+    assert(stats.min_u(0, 0, 1) == -0.2 && stats.max_u(0, 0, 1) == 0.4);
+    cout << "welford ... ok\n";
+  }
+
+  // accumulated from the collision sweep, sampled from the start step on
+  unique_ptr<IncompFlowSimulation> spsim(make_channel());
+  FlowStatistics stats(ni, nj, start, interval);
+  ProbeRecorder probes("test_statistics", nsteps, nsteps);
+  const unsigned point = probes.add(new PointProbe("point", ni / 2, nj / 2));
+  spsim->attach_statistics(&stats);
+  spsim->attach_probes(&probes);
+  spsim->simulate(nsteps / 2);
+  spsim->checkpoint("test_statistics.cp");
+  spsim->simulate(nsteps / 2);
+
+  double mean = 0.0;
+  double umin = 1.0;
+  double umax = -1.0;
+  unsigned nsamples = 0;
+  for (unsigned age = 0; age < nsteps; ++age) {
+    const double *psample = probes.sample(point, age);
+    const unsigned step = static_cast<unsigned>(psample[0]);
+    if (step < start || (step - start) % interval != 0)
+      continue;
+    mean += psample[2];
+    umin = min(umin, psample[2]);
+    umax = max(umax, psample[2]);
+    ++nsamples;
+  }
+  mean /= nsamples;
+  assert(stats.num_samples() == nsamples);
+  assert(close(stats.mean_u(ni / 2, nj / 2, 0), mean));
+  assert(stats.min_u(ni / 2, nj / 2, 0) == umin);
+  assert(stats.max_u(ni / 2, nj / 2, 0) == umax);
+  assert(stats.rms_u(ni / 2, nj / 2, 0) > 0.0);
+  cout << "mean velocity = " << mean << " over " << nsamples
+       << " samples ... ok\n";
+
+  // restarting resumes the statistics exactly
+  {
+    unique_ptr<IncompFlowSimulation> sprestart(make_channel());
+    FlowStatistics restarted(ni, nj, start, interval);
+    sprestart->attach_statistics(&restarted);
+    sprestart->restart("test_statistics.cp");
+    assert(restarted.num_samples() != 0);
+    sprestart->simulate(nsteps / 2);
+    assert(restarted.num_samples() == stats.num_samples());
+    assert(memcmp(restarted.pdata(), stats.pdata(),
+                  ni * nj * FlowStatistics::NUM_SLOTS * sizeof(double)) == 0);
+  }
+  cout << "restart ... ok\n";
+
+  // a checkpoint without statistics leaves none behind
+  {
+    unique_ptr<IncompFlowSimulation> sprestart(make_channel());
+    sprestart->simulate(1);
+    sprestart->checkpoint("test_statistics.cp");
+    spsim->restart("test_statistics.cp");
+    assert(stats.num_samples() == 0 && stats.mean_u(ni / 2, nj / 2, 0) == 0.0);
+  }
+
+  // written out as VTK image data
+  spsim->simulate(nsteps);
+  write_statistics("test_statistics.vti", stats);
+  ifstream ifs("test_statistics.vti", ios::binary);
+  const string vti((istreambuf_iterator<char>(ifs)),
+                   istreambuf_iterator<char>());
+  for (const char *name : {"\"mean_u\"", "\"rms_u\"", "\"reynolds_stress\"",
+                           "\"min_rho\"", "\"max_u\""})
+    assert(vti.find(name) != string::npos);
+  cout << "written ... ok\n";
+
+  remove("test_statistics.cp");
+  remove("test_statistics.vti");
+  remove("test_statistics_point.dat");
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
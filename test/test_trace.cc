@@ -0,0 +1,164 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+#include "balbm.hh"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! simulation parameters
+const static unsigned ni = 20;
+const static unsigned nj = 12;
+const static double rho = 1.0;
+const static double mu = 1.0 / 6.0;
+static double F[] = {1e-5, 0.0};
+const static unsigned nsteps = 40;
+const static unsigned stride = 2;
+
+//! Writer that holds its frame until released, so submissions stall
+class HeldWriter : public AbstractFieldWriter {
+public:
+  HeldWriter(const atomic<bool> &released) : released_(released) {}
+
+private:
+  const atomic<bool> &released_;
+  void write_(const FieldFrame &) {
+    while (!released_)
+      this_thread::sleep_for(chrono::milliseconds(1));
+  }
+};
+
+//! Number of occurrences of a pattern
+size_t count(const string &s, const string &pattern) {
+  size_t n = 0;
+  for (size_t pos = s.find(pattern); pos != string::npos;
+       pos = s.find(pattern, pos + 1))
+    ++n;
+  return n;
+}
+
+int main() {
+  // solver phases, output stalls and writes land in one timeline
+  {
+    TraceRecorder trace;
+    atomic<bool> released(false);
+    AsyncOutputPipeline pipeline(new HeldWriter(released),
+                                 OUTPUT_RHO | OUTPUT_U, 1);
+    vector<AbstractSimCallback *> *pcbs = new vector<AbstractSimCallback *>();
+    pcbs->push_back(new OutputCallback(pipeline, stride));
+    IncompFlowSimulation sim(ni, nj, rho, mu, new IncompFlowEqFunct(),
+                             new NewtonianConstitutiveEq(mu),
+                             new GuoForce(F), pcbs);
+    for (unsigned i = 0; i < ni; ++i) {
+      for (unsigned j = 1; j < nj - 1; ++j)
+        sim.set_node_desc<NodePeriodic>(i, j);
+      sim.set_node_desc<NodeNorthFacingWall>(i, 0);
+      sim.set_node_desc<NodeSouthFacingWall>(i, nj - 1);
+    }
+    trace.set_thread_name("solver \"main\"");
+    sim.attach_trace(&trace);
+    pipeline.attach_trace(&trace);
+    // the first frame is held until the next submission has stalled on it
+    thread releaser([&] {
+      while (pipeline.stalls() == 0)
+        this_thread::sleep_for(chrono::milliseconds(1));
+      released = true;
+    });
+    sim.simulate(nsteps);
+    releaser.join();
+    pipeline.flush();
+    const string chk_path = "test_trace." + to_string(getpid()) + ".chk";
+    sim.checkpoint(chk_path);
+    remove(chk_path.c_str());
+    assert(pipeline.stalls() > 0);
+
+    ostringstream oss;
+    trace.write_json(oss);
+    const string json = oss.str();
+    assert(json.compare(0, 16, "{\"traceEvents\":[") == 0);
+    assert(json.find("\"dropped\":0}}") != string::npos);
+    for (const char *phase : {"step", "stream", "swap", "collide"})
+      assert(count(json, string("\"name\":\"") + phase + '"') == nsteps);
+    assert(count(json, "\"name\":\"stage\"") == nsteps / stride);
+    assert(count(json, "\"name\":\"io\"") == nsteps / stride + 1);
+    assert(count(json, "\"name\":\"stall\"") == pipeline.stalls());
+    assert(count(json, "\"name\":\"thread_name\"") == 2);
+    assert(json.find("\"name\":\"output writer\"") != string::npos);
+    assert(json.find("\"name\":\"solver \\\"main\\\"\"") != string::npos);
+    assert(json.find("\"args\":{\"step\":" + to_string(nsteps) + "}") !=
+           string::npos);
+    assert(trace.size() == count(json, "\"ph\":\"X\""));
+  }
+  cout << "solver and output timeline ... ok\n";
+
+  // full buffers drop events instead of growing
+  {
+    TraceRecorder trace(4);
+    for (unsigned k = 0; k < 10; ++k)
+      ScopedTrace event(&trace, "tiny", "test", k, 3);
+    assert(trace.size() == 4 && trace.dropped() == 6);
+    ostringstream oss;
+    trace.write_json(oss);
+    assert(oss.str().find("\"tile\":3}") != string::npos);
+    assert(oss.str().find("\"dropped\":6}}") != string::npos);
+    trace.clear();
+    assert(trace.size() == 0 && trace.dropped() == 0);
+  }
+  cout << "bounded buffers ... ok\n";
+
+  // threads record concurrently and cheaply
+  {
+    const unsigned nthreads = 4, nevents = 20000;
+    TraceRecorder trace(nevents);
+    vector<thread> threads;
+    const auto start = chrono::steady_clock::now();
+    for (unsigned t = 0; t < nthreads; ++t)
+      threads.emplace_back([&, t] {
+        trace.set_thread_name("worker " + to_string(t));
+        for (unsigned k = 0; k < nevents; ++k)
+          ScopedTrace event(&trace, PHASE_COLLIDE, k, t);
+      });
+    ostringstream concurrent;
+    trace.write_json(concurrent); // while recording
+    for (auto &thread : threads)
+      thread.join();
+    const chrono::duration<double> elapsed =
+        chrono::steady_clock::now() - start;
+    assert(trace.size() == nthreads * nevents && trace.dropped() == 0);
+    // reported only, the cost depends on the load of the machine
+    cout << 1e9 * elapsed.count() / (nthreads * nevents)
+         << " ns per event\n";
+    ostringstream oss;
+    trace.write_json(oss);
+    assert(count(oss.str(), "\"ph\":\"X\"") == nthreads * nevents);
+    assert(count(oss.str(), "\"name\":\"worker ") == nthreads);
+  }
+  cout << "concurrent recording ... ok\n";
+
+  cout << "TEST PASSED\n";
+
+  return 0;
+}
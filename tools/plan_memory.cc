@@ -0,0 +1,123 @@
+// Complex flow simulator using lattice Boltzmann method
+// Copyright (C) 2015 Matthew Grasinger
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// A copy of the GNU General Public License is at the root directory of
+// this program.  If not, see <http://www.gnu.org/licenses/>
+
+// Predicts the memory of a simulation before it is allocated, e.g.
+//
+//   plan_memory 4000 1000 --statistics --output rho,u --budget 8G
+//
+// prints the bytes of every subsystem, whether they fit in the budget and
+// the largest domain of the same aspect ratio that does.
+//
+// usage: plan_memory NI NJ [--budget BYTES] [--solid-fractions]
+//                    [--statistics] [--output rho,u,omega,f] [--buffers N]
+//                    [--factor N] [--average]
+
+#include "balbm.hh"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace balbm::d2q9;
+using namespace std;
+
+//! \struct Options
+//!
+//! \brief Command line options
+struct Options {
+  MemoryConfig config;
+  size_t budget = 0;
+};
+
+//! Parse the command line
+Options parse(const int argc, char **argv) {
+  Options opts;
+  unsigned npositional = 0;
+  for (int a = 1; a < argc; ++a) {
+    const string arg = argv[a];
+    const auto value = [&]() {
+      if (a + 1 >= argc)
+        throw invalid_argument(arg + " requires a value.");
+      return string(argv[++a]);
+    };
+    if (arg == "--budget") {
+      opts.budget = parse_bytes(value());
+    } else if (arg == "--solid-fractions") {
+      opts.config.solid_fractions = true;
+    } else if (arg == "--statistics") {
+      opts.config.statistics = true;
+    } else if (arg == "--output") {
+      istringstream iss(value());
+      for (string field; getline(iss, field, ',');) {
+        if (field == "rho")
+          opts.config.output_fields |= OUTPUT_RHO;
+        else if (field == "u")
+          opts.config.output_fields |= OUTPUT_U;
+        else if (field == "omega")
+          opts.config.output_fields |= OUTPUT_OMEGA;
+        else if (field == "f")
+          opts.config.output_fields |= OUTPUT_F;
+        else
+          throw invalid_argument("Unknown output field " + field + '.');
+      }
+    } else if (arg == "--buffers") {
+      opts.config.output_buffers = stoul(value());
+    } else if (arg == "--factor") {
+      opts.config.output_region.factor = stoul(value());
+    } else if (arg == "--average") {
+      opts.config.output_region.average = true;
+    } else if (arg.compare(0, 2, "--") != 0 && npositional < 2) {
+      (npositional++ == 0 ? opts.config.ni : opts.config.nj) = stoul(arg);
+    } else {
+      throw invalid_argument("Unknown option " + arg + '.');
+    }
+  }
+  if (opts.config.ni == 0 || opts.config.nj == 0)
+    throw invalid_argument("A domain of NI by NJ nodes is required.");
+  return opts;
+}
+
+int main(int argc, char **argv) {
+  Options opts;
+  try {
+    opts = parse(argc, argv);
+  } catch (exception &e) {
+    cerr << e.what() << "\nusage: " << argv[0]
+         << " NI NJ [--budget BYTES] [--solid-fractions] [--statistics]"
+         << " [--output rho,u,omega,f] [--buffers N] [--factor N]"
+         << " [--average]\n";
+    return 1;
+  }
+
+  const MemoryConfig &config = opts.config;
+  const MemoryFootprint plan = plan_memory(config);
+  cout << config.ni << " x " << config.nj << " nodes\n";
+  write_memory_report(cout, plan);
+  if (opts.budget == 0)
+    return 0;
+
+  cout << "\nbudget " << opts.budget << " bytes: "
+       << (plan.total() <= opts.budget ? "fits" : "does not fit") << '\n';
+  try {
+    const MemoryConfig largest = largest_domain(config, opts.budget);
+    cout << "largest domain " << largest.ni << " x " << largest.nj << " ("
+         << plan_memory(largest).total() << " bytes)\n";
+  } catch (exception &e) {
+    cerr << e.what() << '\n';
+    return 1;
+  }
+  return (plan.total() <= opts.budget) ? 0 : 2;
+}